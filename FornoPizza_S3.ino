@@ -21,12 +21,15 @@
  *    [SIM-E] Forza SensorMode::SINGLE + setpoint default in setup()
  *    [SIM-F] simulator_tick() + simulator_set_relay() in Task_PID
  *    [SIM-G] simulator_test_tick() in Task_PID
+ *
+ *  [CORE] Task_PID, emergency_shutdown, helper NVS e oggetti hardware
+ *         spostati in forno_control.cpp (compilabile anche su host Linux,
+ *         vedi host/Makefile). Qui restano setup(), Task_LVGL e Task_WDG.
  * ================================================================
  */
 
 #include <Arduino.h>
 #include <SPI.h>
-#include <PID_v1.h>
 #include <lvgl.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -38,8 +41,6 @@
 // ── [SIM-A]: mock hardware quando SIMULATOR_MODE=1 ──────────────
 #if SIMULATOR_MODE
   #include "simulator.h"
-  extern uint32_t g_runaway_down_ms_override;
-  #define MAX6675 SimulatedMAX6675
   #undef  RELAY_WRITE
   #define RELAY_WRITE(pin, inv, state)  /* no-op simulator */
   #undef  RELAY_ON
@@ -48,8 +49,6 @@
   #define RELAY_OFF(pin, inv)           /* no-op simulator */
   #undef  RELAY_INIT
   #define RELAY_INIT(pin, inv)          /* no-op simulator */
-#else
-  #include <max6675.h>
 #endif
 
 // ── Display + LVGL ──────────────────────────────────────────────
@@ -58,8 +57,7 @@
 // ── Core progetto ───────────────────────────────────────────────
 #include "hardware.h"
 #include "ui.h"
-#include "pid_ctrl.h"
-#include "nvs_storage.h"
+#include "forno_control.h"
 #include "splash_screen.h"
 
 #if TASK_WIFI_ENABLE
@@ -67,118 +65,20 @@
   #include "ui_wifi.h"
 #endif
 
-#if FEATURE_AUTOTUNE
-  #include "autotune.h"
-#endif
-
-// ================================================================
-//  PARAMETRI CONTROLLO RELAY
-// ================================================================
-#ifndef RELAY_WINDOW_MS
-#define RELAY_WINDOW_MS  30000UL
-#endif
-// Limiti duty cycle relay sono definiti in hardware.h come RELAY_DUTY_MIN_PCT e RELAY_DUTY_MAX_PCT
-
 #if FEATURE_OTA && TASK_WIFI_ENABLE
   #include "ota_manager.h"
   #include "web_ota.h"
 #endif
 
 // ================================================================
-//  OGGETTI HARDWARE — puntatori (FIX: no costruttori globali)
-// ================================================================
-static MAX6675*       tc_base  = nullptr;
-static MAX6675*       tc_cielo = nullptr;
-static NVSStorage*    nvs      = nullptr;
-static PIDController* pid_base  = nullptr;
-static PIDController* pid_cielo = nullptr;
-
-// ================================================================
-//  SINCRONIZZAZIONE
+//  STATO APPLICAZIONE — g_state, g_mutex e flag di sicurezza sono
+//  definiti in forno_control.cpp
 // ================================================================
-SemaphoreHandle_t    g_mutex              = nullptr;
-volatile uint32_t    g_pid_heartbeat      = 0;
-volatile bool        g_emergency_shutdown = false;
-
-// ================================================================
-//  STATO APPLICAZIONE (SRAM interna — accesso real-time)
-// ================================================================
-AppState    g_state = {};
 extern GraphBuffer g_graph;
 
 // ── [SIM-B]: richiesto da extern bool g_arc_snap in ui_animations.h
 bool g_arc_snap = false;
 
-// ================================================================
-//  EMERGENCY SHUTDOWN
-// ================================================================
-void IRAM_ATTR emergency_shutdown(SafetyReason reason) {
-  RELAY_WRITE(RELAY_BASE,  RELAY_BASE_INV,  false);
-  RELAY_WRITE(RELAY_CIELO, RELAY_CIELO_INV, false);
-
-  g_emergency_shutdown    = true;
-  g_state.relay_base      = false;
-  g_state.relay_cielo     = false;
-  g_state.base_enabled    = false;
-  g_state.cielo_enabled   = false;
-  g_state.safety_shutdown = true;
-  g_state.safety_reason   = reason;
-
-  // Porta PID in MANUAL
-  if (pid_base)  pid_base->setEnabled(false);
-  if (pid_cielo) pid_cielo->setEnabled(false);
-
-  const char* reasons[] = {
-    "NONE","TC_ERROR","OVERTEMP","RUNAWAY_DOWN","RUNAWAY_UP","WDG_TIMEOUT"
-  };
-  int idx = (int)reason;
-  LOG_E(LOG_SAFETY, "!!! SHUTDOWN SICUREZZA: %s !!!\n",
-        (idx >= 0 && idx <= 5) ? reasons[idx] : "?");
-
-  // ── [SIM-C]: notifica il simulatore per validazione test ──
-#if SIMULATOR_MODE
-  simulator_notify_shutdown((int)reason);
-#endif
-}
-
-// ================================================================
-//  NVS HELPERS
-// ================================================================
-static void nvs_load_to_state() {
-  NVSData d;
-  nvs->load(d);
-  g_state.set_base    = d.set_base;
-  g_state.set_cielo   = d.set_cielo;
-  g_state.kp_base     = d.kp_base;
-  g_state.ki_base     = d.ki_base;
-  g_state.kd_base     = d.kd_base;
-  g_state.kp_cielo    = d.kp_cielo;
-  g_state.ki_cielo    = d.ki_cielo;
-  g_state.kd_cielo    = d.kd_cielo;
-  g_state.sensor_mode = (d.single_mode == 1) ? SensorMode::SINGLE : SensorMode::DUAL;
-  g_state.pct_base    = d.pct_base;
-  g_state.pct_cielo   = d.pct_cielo;
-}
-
-static void nvs_save_from_state() {
-  NVSData d;
-  if (!MUTEX_TAKE()) return;
-  d.set_base    = (float)g_state.set_base;
-  d.set_cielo   = (float)g_state.set_cielo;
-  d.kp_base     = (float)g_state.kp_base;
-  d.ki_base     = (float)g_state.ki_base;
-  d.kd_base     = (float)g_state.kd_base;
-  d.kp_cielo    = (float)g_state.kp_cielo;
-  d.ki_cielo    = (float)g_state.ki_cielo;
-  d.kd_cielo    = (float)g_state.kd_cielo;
-  d.single_mode = (g_state.sensor_mode == SensorMode::SINGLE) ? 1 : 0;
-  d.pct_base    = g_state.pct_base;
-  d.pct_cielo   = g_state.pct_cielo;
-  g_state.nvs_dirty = false;
-  MUTEX_GIVE();
-  nvs->save(d);
-}
-
 // ================================================================
 //  TASK_WATCHDOG
 // ================================================================
@@ -224,383 +124,6 @@ static void Task_Watchdog(void* param) {
 }
 #endif // TASK_WDG_ENABLE
 
-// ================================================================
-//  TASK_PID
-// ================================================================
-#if TASK_PID_ENABLE
-static void Task_PID(void* param) {
-  LOG_I(LOG_PID, "[Core %d] Task_PID avviato%s\n",
-        xPortGetCoreID(),
-        SIMULATOR_MODE ? " [SIMULATORE]" : "");
-
-  unsigned long win_base  = 0;
-  unsigned long win_cielo = 0;
-  uint32_t      last_nvs_ms   = millis();
-  uint32_t      last_tick_ms  = millis();   // [SIM-F]
-  uint32_t      last_graph_ms = millis();   // [FIX-2] campionamento grafico
-
-  // [FIX-1]: traccia stato precedente per gestire transizioni ON/OFF
-  bool prev_base_enabled  = false;
-  bool prev_cielo_enabled = false;
-
-#if FEATURE_SAFETY
-  static uint32_t s_ru_ms       = 0;
-  static float    s_ru_t0       = 0.0f;
-  static float    s_rd_peak     = 0.0f;
-  static uint32_t s_rd_below_ms = 0;
-#if SIMULATOR_MODE
-  static uint32_t s_last_sim_reset_seq = 0;
-#endif
-#endif
-
-  for (;;) {
-    // FIX: heartbeat PRIMA di tutto
-    g_pid_heartbeat++;
-
-    uint32_t now = millis();
-
-    // ── [SIM-F]: aggiorna modello termico PRIMA di leggere sensori ──
-#if SIMULATOR_MODE
-    {
-      uint32_t dt_ms = now - last_tick_ms;
-      if (dt_ms == 0) dt_ms = PID_SAMPLE_MS;
-      last_tick_ms = now;
-      simulator_tick(dt_ms);
-    }
-#endif
-
-    if (g_emergency_shutdown) {
-      RELAY_WRITE(RELAY_BASE,  RELAY_BASE_INV,  false);
-      RELAY_WRITE(RELAY_CIELO, RELAY_CIELO_INV, false);
-#if SIMULATOR_MODE
-      simulator_set_relay(false, false);
-      // Avanza la sequenza test anche durante shutdown (altrimenti le fasi restano bloccate)
-      simulator_test_tick(now);
-#endif
-      bool hot = (!g_state.tc_cielo_err && g_state.temp_cielo > FAN_OFF_TEMP);
-      if (g_state.sensor_mode == SensorMode::DUAL &&
-          !g_state.tc_base_err && g_state.temp_base > FAN_OFF_TEMP) {
-        hot = true;
-      }
-      if (hot != g_state.fan_on) {
-        g_state.fan_on = hot;
-        RELAY_WRITE(RELAY_FAN, RELAY_FAN_INV, hot);
-      }
-      vTaskDelay(pdMS_TO_TICKS(1000));
-      continue;
-    }
-
-    // ── Lettura sensori ──
-    float t_cielo_raw = tc_cielo->readCelsius();
-    bool  err_cielo   = isnan(t_cielo_raw) || t_cielo_raw <= 0.0f;
-    float t_base_raw  = 0.0f;
-    bool  err_base    = false;
-
-    if (g_state.sensor_mode == SensorMode::SINGLE) {
-      t_base_raw = t_cielo_raw;
-    } else {
-      t_base_raw = tc_base->readCelsius();
-      err_base   = isnan(t_base_raw) || t_base_raw <= 0.0f;
-    }
-
-    LOG_D(LOG_PID, "[PID] raw B=%.1f C=%.1f errB=%d errC=%d\n",
-          t_base_raw, t_cielo_raw, err_base, err_cielo);
-
-    // ── Gestione errore TC ──
-    if (err_cielo) {
-#if FEATURE_SAFETY
-      if (g_state.sensor_mode == SensorMode::DUAL) {
-        emergency_shutdown(SafetyReason::TC_ERROR);
-        continue;
-      }
-#endif
-      static uint32_t last_warn = 0;
-      if (now - last_warn > 5000) {
-        LOG_W(LOG_PID, "[PID] TC_CIELO ERR — open-loop\n");
-        last_warn = now;
-      }
-      err_cielo = false;
-    }
-
-    if (err_base && g_state.sensor_mode == SensorMode::DUAL) {
-#if FEATURE_SAFETY
-      emergency_shutdown(SafetyReason::TC_ERROR);
-      continue;
-#endif
-    }
-
-    // ── Aggiorna stato ──
-    if (MUTEX_TAKE()) {
-      if (!err_cielo) g_state.temp_cielo = (double)t_cielo_raw;
-      if (!err_base)  g_state.temp_base  = (double)t_base_raw;
-      g_state.tc_cielo_err = err_cielo;
-      g_state.tc_base_err  = err_base;
-      MUTEX_GIVE();
-    }
-
-    // ── Overtemp ──
-#if FEATURE_SAFETY
-    if (g_state.temp_cielo > TEMP_MAX_SAFE || g_state.temp_base > TEMP_MAX_SAFE) {
-      emergency_shutdown(SafetyReason::OVERTEMP);
-      continue;
-    }
-#endif
-
-    // ── [FIX-1]: gestione transizioni ON/OFF del PID ──────────────
-    // Il PID deve essere in AUTOMATIC per calcolare l'output.
-    // Viene portato in AUTOMATIC quando enabled diventa true,
-    // in MANUAL quando diventa false o in emergenza.
-    if (g_state.base_enabled != prev_base_enabled) {
-      pid_base->setEnabled(g_state.base_enabled);
-      if (g_state.base_enabled) {
-        win_base = millis();   // resetta finestra relay
-        LOG_I(LOG_PID, "[PID] BASE: AUTOMATIC (setpoint=%.0f°C)\n", g_state.set_base);
-      } else {
-        LOG_I(LOG_PID, "[PID] BASE: MANUAL\n");
-      }
-      prev_base_enabled = g_state.base_enabled;
-    }
-    if (g_state.cielo_enabled != prev_cielo_enabled) {
-      pid_cielo->setEnabled(g_state.cielo_enabled);
-      if (g_state.cielo_enabled) {
-        win_cielo = millis();
-        LOG_I(LOG_PID, "[PID] CIELO: AUTOMATIC (setpoint=%.0f°C)\n", g_state.set_cielo);
-      } else {
-        LOG_I(LOG_PID, "[PID] CIELO: MANUAL\n");
-      }
-      prev_cielo_enabled = g_state.cielo_enabled;
-    }
-
-    // ── PID + relay duty cycle ──
-    bool base_on  = false;
-    bool cielo_on = false;
-
-    if (g_state.base_enabled) {
-      pid_base->compute();
-      double duty_base = g_state.pid_out_base * (g_state.pct_base / 100.0);
-      if (duty_base < RELAY_DUTY_MIN_PCT) duty_base = 0.0;
-      else if (duty_base > RELAY_DUTY_MAX_PCT) duty_base = 100.0;
-
-      uint32_t window_ms = RELAY_WINDOW_MS;
-      uint32_t on_time   = 0;
-
-      if (duty_base > 0.0) {
-        on_time = (uint32_t)(duty_base / 100.0 * (double)window_ms);
-        if (on_time > window_ms) on_time = window_ms;
-      }
-
-      if (millis() - win_base >= window_ms) win_base = millis();
-      base_on = (on_time > 0 && (millis() - win_base) < on_time);
-
-      LOG_D(LOG_PID, "[PID] base out=%.1f duty=%.1f on=%lu/%lums base_on=%d\n",
-            g_state.pid_out_base, duty_base,
-            (unsigned long)on_time, (unsigned long)window_ms, base_on);
-    }
-
-    if (g_state.cielo_enabled) {
-      pid_cielo->compute();
-      double duty_cielo = g_state.pid_out_cielo * (g_state.pct_cielo / 100.0);
-      if (duty_cielo < RELAY_DUTY_MIN_PCT) duty_cielo = 0.0;
-      else if (duty_cielo > RELAY_DUTY_MAX_PCT) duty_cielo = 100.0;
-
-      uint32_t window_ms = RELAY_WINDOW_MS;
-      uint32_t on_time   = 0;
-
-      if (duty_cielo > 0.0) {
-        on_time = (uint32_t)(duty_cielo / 100.0 * (double)window_ms);
-        if (on_time > window_ms) on_time = window_ms;
-      }
-
-      if (millis() - win_cielo >= window_ms) win_cielo = millis();
-      cielo_on = (on_time > 0 && (millis() - win_cielo) < on_time);
-    }
-
-    // Sonda non rilevata: disabilita relay
-    if (g_state.tc_base_err)  base_on  = false;
-    if (g_state.tc_cielo_err) cielo_on = false;
-
-#if FEATURE_AUTOTUNE
-    if (!autotune_is_running()) {
-#endif
-    RELAY_WRITE(RELAY_BASE,  RELAY_BASE_INV,  base_on);
-    RELAY_WRITE(RELAY_CIELO, RELAY_CIELO_INV, cielo_on);
-#if FEATURE_AUTOTUNE
-    }
-#endif
-
-#if FEATURE_AUTOTUNE
-    if (autotune_is_running()) {
-      float pv_at = t_cielo_raw;
-      if (g_state.sensor_mode == SensorMode::DUAL) {
-        if (!err_base && !err_cielo) {
-          pv_at = (t_base_raw + t_cielo_raw) * 0.5f;
-        } else if (!err_cielo) {
-          pv_at = t_cielo_raw;
-        } else if (!err_base) {
-          pv_at = t_base_raw;
-        }
-      }
-      autotune_run(pv_at, now);
-    }
-#endif
-
-    if (MUTEX_TAKE()) {
-#if FEATURE_AUTOTUNE
-      if (!autotune_is_running()) {
-        if (!autotune_consume_just_completed()) {
-          g_state.relay_base  = base_on;
-          g_state.relay_cielo = cielo_on;
-        }
-      }
-#else
-      g_state.relay_base  = base_on;
-      g_state.relay_cielo = cielo_on;
-#endif
-
-      bool res_on = g_state.relay_base || g_state.relay_cielo;
-      bool hot = (!g_state.tc_cielo_err && g_state.temp_cielo > FAN_OFF_TEMP);
-      if (g_state.sensor_mode == SensorMode::DUAL &&
-          !g_state.tc_base_err && g_state.temp_base > FAN_OFF_TEMP) {
-        hot = true;
-      }
-      bool fan = res_on || hot;
-      if (fan != g_state.fan_on) {
-        g_state.fan_on = fan;
-        RELAY_WRITE(RELAY_FAN, RELAY_FAN_INV, fan);
-      }
-      MUTEX_GIVE();
-    }
-
-#if SIMULATOR_MODE
-    simulator_set_relay(g_state.relay_base, g_state.relay_cielo);
-#endif
-
-#if FEATURE_SAFETY
-    {
-#if FEATURE_AUTOTUNE
-      const bool at_run = autotune_is_running();
-#else
-      const bool at_run = false;
-#endif
-#if SIMULATOR_MODE
-      if (g_sim.thermal_reset_seq != s_last_sim_reset_seq) {
-        s_last_sim_reset_seq = g_sim.thermal_reset_seq;
-        s_ru_ms       = 0;
-        s_ru_t0       = 0.0f;
-        s_rd_peak     = 0.0f;
-        s_rd_below_ms = 0;
-      }
-#endif
-      float tb, tc;
-      double sb, sc;
-      bool rb, rc, en_b, en_c;
-      if (MUTEX_TAKE()) {
-        tb   = (float)g_state.temp_base;
-        tc   = (float)g_state.temp_cielo;
-        sb   = g_state.set_base;
-        sc   = g_state.set_cielo;
-        rb   = g_state.relay_base;
-        rc   = g_state.relay_cielo;
-        en_b = g_state.base_enabled;
-        en_c = g_state.cielo_enabled;
-        MUTEX_GIVE();
-
-        bool res_on = rb || rc;
-        uint32_t rwd_ms = RUNAWAY_DOWN_MS;
-#if SIMULATOR_MODE
-        if (g_runaway_down_ms_override != 0) rwd_ms = g_runaway_down_ms_override;
-#endif
-#if RUNAWAY_UP_ENABLED
-        if (!at_run) {
-          float tmax = (tb > tc) ? tb : tc;
-          if (!res_on && !en_b && !en_c) {
-            if (s_ru_ms == 0) {
-              s_ru_ms = now;
-              s_ru_t0 = tmax;
-            } else if ((now - s_ru_ms) >= (uint32_t)RUNAWAY_RISE_MS) {
-              if (tmax - s_ru_t0 > RUNAWAY_RISE_DEG) {
-                emergency_shutdown(SafetyReason::RUNAWAY_UP);
-                continue;
-              }
-              s_ru_ms = now;
-              s_ru_t0 = tmax;
-            }
-          } else {
-            s_ru_ms = 0;
-          }
-        }
-#endif
-#if RUNAWAY_DOWN_ENABLED
-        if (!at_run) {
-          float tmax  = (tb > tc) ? tb : tc;
-          float spmax = (float)((sb > sc) ? sb : sc);
-          if (res_on && (en_b || en_c)) {
-            if (tmax > s_rd_peak) {
-              s_rd_peak     = tmax;
-              s_rd_below_ms = 0;
-            }
-            if (s_rd_peak >= spmax - 20.0f) {
-              if (s_rd_peak - tmax >= RUNAWAY_MIN_DROP) {
-                if (s_rd_below_ms == 0) s_rd_below_ms = now;
-                else if ((now - s_rd_below_ms) >= rwd_ms) {
-                  emergency_shutdown(SafetyReason::RUNAWAY_DOWN);
-                  continue;
-                }
-              } else {
-                s_rd_below_ms = 0;
-              }
-            }
-          } else {
-            s_rd_peak     = 0.0f;
-            s_rd_below_ms = 0;
-          }
-        }
-#endif
-      }
-    }
-#endif
-
-    // ── [FIX-2]: campionamento grafico ogni GRAPH_SAMPLE_S secondi ──
-    // I puntatori base/cielo del GraphBuffer sono allocati in PSRAM da
-    // graph_alloc_psram() in setup(). Qui ci scriviamo i dati effettivi.
-    if (now - last_graph_ms >= (uint32_t)(GRAPH_SAMPLE_S * 1000UL)) {
-      last_graph_ms = now;
-      if (g_graph.base && g_graph.cielo) {
-        uint16_t idx = g_graph.head;
-        g_graph.base[idx]  = (float)g_state.temp_base;
-        g_graph.cielo[idx] = (float)g_state.temp_cielo;
-        g_graph.head = (idx + 1) % GRAPH_BUF_SIZE;
-        if (g_graph.count < GRAPH_BUF_SIZE) g_graph.count++;
-        LOG_D(LOG_PID, "[GRAPH] push idx=%d B=%.1f C=%.1f count=%d\n",
-              idx, g_state.temp_base, g_state.temp_cielo, g_graph.count);
-      }
-    }
-
-    // ── NVS save periodico ──
-    if (g_state.nvs_dirty && (now - last_nvs_ms > 5000)) {
-      last_nvs_ms = now;
-      nvs_save_from_state();
-    }
-
-    // ── Log PID periodico ──
-    LOG_I(LOG_PID, "[C1 %5.1fs] %s B:%5.1f/%.0f %3.0f%%%c C:%5.1f/%.0f %3.0f%%%c\n",
-      millis() / 1000.0f,
-      g_state.sensor_mode == SensorMode::SINGLE ? "SGL" : "DUA",
-      g_state.temp_base,  g_state.set_base,  g_state.pid_out_base,
-      g_state.relay_base  ? '*' : '.',
-      g_state.temp_cielo, g_state.set_cielo, g_state.pid_out_cielo,
-      g_state.relay_cielo ? '*' : '.');
-
-    // ── [SIM-G]: avanza macchina a stati del test ──
-#if SIMULATOR_MODE
-    simulator_test_tick(now);
-#endif
-
-    vTaskDelay(pdMS_TO_TICKS(PID_SAMPLE_MS));
-  }
-}
-#endif // TASK_PID_ENABLE
-
 // ================================================================
 //  TASK_LVGL
 // ================================================================
@@ -729,72 +252,8 @@ void setup() {
   splash_set_progress(15, "Graph PSRAM OK");
 #endif
 
-  // ---- 6. Oggetti hardware (DOPO lcd.init) ----
-  tc_base  = new MAX6675(TC_SCK, TC_CS_BASE,  TC_MISO);
-  tc_cielo = new MAX6675(TC_SCK, TC_CS_CIELO, TC_MISO);
-  nvs      = new NVSStorage();
-  LOG_I(LOG_SYSTEM, "[SETUP] MAX6675 + NVS allocati\n");
-
-  // ── [SIM-D]: inizializza simulatore ──
-#if SIMULATOR_MODE
-  simulator_init();
-#endif
-
-#if FEATURE_SPLASH
-  splash_set_progress(20, SIMULATOR_MODE ? "Simulatore OK" : "Sensori OK");
-#endif
-
-  // ---- 7. NVS ----
-  nvs_load_to_state();
-
-  // ── [SIM-E]: forza SINGLE mode e setpoint valido per il test ──
-#if SIMULATOR_MODE
-  g_state.sensor_mode = SensorMode::SINGLE;
-  if (g_state.set_base  < 100.0 || g_state.set_base  > 450.0) g_state.set_base  = 250.0;
-  if (g_state.set_cielo < 100.0 || g_state.set_cielo > 450.0) g_state.set_cielo = 250.0;
-#endif
-
-  LOG_I(LOG_SYSTEM, "[SETUP] NVS: mode=%s set=%.0f/%.0f split=%d/%d\n",
-    g_state.sensor_mode == SensorMode::SINGLE ? "SINGLE" : "DUAL",
-    g_state.set_base, g_state.set_cielo,
-    g_state.pct_base, g_state.pct_cielo);
-#if FEATURE_SPLASH
-  splash_set_progress(30, "NVS OK");
-#endif
-
-  // ---- 8. PID — allocato DOPO nvs_load (usa Kp/Ki/Kd corretti) ----
-  pid_base  = new PIDController(&g_state.temp_base,  &g_state.pid_out_base,
-                                 &g_state.set_base,
-                                 g_state.kp_base,  g_state.ki_base,  g_state.kd_base);
-  pid_cielo = new PIDController(&g_state.temp_cielo, &g_state.pid_out_cielo,
-                                 &g_state.set_cielo,
-                                 g_state.kp_cielo, g_state.ki_cielo, g_state.kd_cielo);
-  pid_base->begin();
-  pid_cielo->begin();
-  // Nota: i PID partono in MANUAL. Vengono portati in AUTOMATIC
-  // da Task_PID quando base_enabled/cielo_enabled diventano true.
-  LOG_I(LOG_SYSTEM, "[SETUP] PID OK (Kp=%.2f Ki=%.3f Kd=%.2f) — modo MANUAL\n",
-        g_state.kp_base, g_state.ki_base, g_state.kd_base);
-#if FEATURE_SPLASH
-  splash_set_progress(40, "PID OK");
-#endif
-
-  // ---- 9. Prima lettura sensori ----
-  delay(300);
-  float t2 = tc_cielo->readCelsius();
-  g_state.tc_cielo_err = isnan(t2) || t2 <= 0.0f;
-  if (!g_state.tc_cielo_err) g_state.temp_cielo = (double)t2;
-  if (g_state.sensor_mode == SensorMode::SINGLE) {
-    g_state.tc_base_err = false;
-    g_state.temp_base   = g_state.temp_cielo;
-  } else {
-    float t1 = tc_base->readCelsius();
-    g_state.tc_base_err = isnan(t1) || t1 <= 0.0f;
-    if (!g_state.tc_base_err) g_state.temp_base = (double)t1;
-  }
-  LOG_I(LOG_SYSTEM, "[SETUP] Temp: B=%.1f°C  C=%.1f°C%s\n",
-        g_state.temp_base, g_state.temp_cielo,
-        SIMULATOR_MODE ? " (simulata)" : "");
+  // ---- 6-9. Core controllo: sensori, NVS, PID, prima lettura ----
+  control_init();
 #if FEATURE_SPLASH
   splash_set_progress(55, SIMULATOR_MODE ? "Temp simulata OK" : "Sensori OK");
 #endif
@@ -5,9 +5,11 @@
 #endif
 
 #include <PID_AutoTune_v0.h>
+#include <math.h>
+#include "control_clock.h"   // tempo del controllo (virtuale in simulazione)
 
 
-PID_ATune::PID_ATune(double* Input, double* Output)
+PID_ATune::PID_ATune(float* Input, float* Output)
 {
 	input = Input;
 	output = Output;
@@ -16,8 +18,22 @@ PID_ATune::PID_ATune(double* Input, double* Output)
 	running = false;
 	oStep = 30;
 	SetLookbackSec(10);
-	lastTime = millis();
-	
+	convTol = 0;
+	convStop = true;
+	kuSum = puSum = 0;
+	nEst = 0;
+	Ku = Pu = 0;
+	halfCycles = 0;
+	nExt = 0;
+	converged = false;
+	lastTime = clock_ms();
+	// Storia iniziale a 0 °C, come il vecchio lastInputs[] statico: una
+	// sola voce per deque, scade dopo nLookBack campioni
+	for (int i = 0; i < RING; i++) ring[i] = 0;
+	ringPos  = 0;
+	qMax[0]  = qMin[0] = RING - 1;
+	qMaxHead = qMinHead = 0;
+	qMaxLen  = qMinLen  = 1;
 }
 
 
@@ -30,23 +46,28 @@ void PID_ATune::Cancel()
 int PID_ATune::Runtime()
 {
 	justevaled=false;
-	if(peakCount>9 && running)
+	if(peakCount>ATUNE_MAX_PEAKS-1 && running)
 	{
 		running = false;
 		FinishUp();
 		return 1;
 	}
-	unsigned long now = millis();
+	unsigned long now = clock_ms();
 	
-	if((now-lastTime)<sampleTime) return 0;
+	if((now-lastTime)<(unsigned long)sampleTime) return 0;
 	lastTime = now;
-	double refVal = *input;
+	float refVal = *input;
 	justevaled=true;
 	if(!running)
 	{ //initialize working variables the first time around
 		peakType = 0;
 		peakCount=0;
 		justchanged=false;
+		halfCycles = 0;
+		nExt = 0;
+		converged = false;
+		kuSum = puSum = 0;
+		nEst = 0;
 		absMax=refVal;
 		absMin=refVal;
 		setpoint = refVal;
@@ -66,17 +87,8 @@ int PID_ATune::Runtime()
 	else if (refVal<setpoint-noiseBand) *output = outputStart+oStep;
 	
 	
-  //bool isMax=true, isMin=true;
-  isMax=true;isMin=true;
   //id peaks
-  for(int i=nLookBack-1;i>=0;i--)
-  {
-    double val = lastInputs[i];
-    if(isMax) isMax = refVal>val;
-    if(isMin) isMin = refVal<val;
-    lastInputs[i+1] = lastInputs[i];
-  }
-  lastInputs[0] = refVal;  
+  lookback(refVal);
   if(nLookBack<9)
   {  //we don't want to trust the maxes or mins until the inputs array has been filled
 	return 0;
@@ -105,12 +117,38 @@ int PID_ATune::Runtime()
       justchanged=true;
     }
     
-    if(peakCount<10)peaks[peakCount] = refVal;
+    if(peakCount<ATUNE_MAX_PEAKS)peaks[peakCount] = refVal;
+  }
+
+  // Estremo della fase: l'inversione chiude un semiperiodo. La prima fase
+  // parte dal PV di avvio e non è un estremo dell'oscillazione. Il tempo
+  // è quello dell'inversione: il fondo piatto di un minimo (sonda a
+  // 0.25 °C) sposta l'istante dell'estremo, l'inversione no
+  if(isMax || isMin)
+  {
+    if(justchanged && halfCycles++ > 0)
+    {
+      if(nExt==ATUNE_EXT)
+      {
+        for(int i=0;i<ATUNE_EXT-1;i++) { extVal[i]=extVal[i+1]; extTime[i]=extTime[i+1]; }
+        nExt=ATUNE_EXT-1;
+      }
+      extVal[nExt]=curExt; extTime[nExt]=now; nExt++;
+      float ku, pu;
+      if(nExt>=3 && cycleEstimate(nExt-1, ku, pu)) { kuSum+=ku; puSum+=pu; nEst++; }
+    }
+    curExt=refVal;
+    if(justchanged && convStop && checkConvergence())
+    {
+      *output = outputStart;
+      running = false;
+      return 1;
+    }
   }
   
-  if(justchanged && peakCount>2)
+  if(justchanged && peakCount>2 && convStop)
   { //we've transitioned.  check if we can autotune based on the last peaks
-    double avgSeparation = (abs(peaks[peakCount-1]-peaks[peakCount-2])+abs(peaks[peakCount-2]-peaks[peakCount-3]))/2;
+    float avgSeparation = (fabsf(peaks[peakCount-1]-peaks[peakCount-2])+fabsf(peaks[peakCount-2]-peaks[peakCount-3]))/2;
     if( avgSeparation < 0.05*(absMax-absMin))
     {
 		FinishUp();
@@ -122,35 +160,102 @@ int PID_ATune::Runtime()
    justchanged=false;
 	return 0;
 }
+// isMax/isMin: refVal oltre tutti gli ultimi nLookBack campioni (stretto),
+// poi refVal entra nella finestra. Ogni posizione entra ed esce da una
+// deque una volta sola: O(1) ammortizzato, qualunque sia nLookBack
+void PID_ATune::lookback(float refVal)
+{
+	// Scadute: più vecchie di nLookBack campioni
+	while (qMaxLen && (ringPos - qMax[qMaxHead] + RING) % RING > nLookBack)
+	{ qMaxHead = (qMaxHead + 1) % RING; qMaxLen--; }
+	while (qMinLen && (ringPos - qMin[qMinHead] + RING) % RING > nLookBack)
+	{ qMinHead = (qMinHead + 1) % RING; qMinLen--; }
+
+	isMax = !qMaxLen || refVal > ring[qMax[qMaxHead]];
+	isMin = !qMinLen || refVal < ring[qMin[qMinHead]];
+
+	// Il nuovo campione toglie dal fondo chi non potrà più essere max/min
+	ring[ringPos] = refVal;
+	while (qMaxLen && ring[qMax[(qMaxHead + qMaxLen - 1) % RING]] <= refVal) qMaxLen--;
+	qMax[(qMaxHead + qMaxLen++) % RING] = ringPos;
+	while (qMinLen && ring[qMin[(qMinHead + qMinLen - 1) % RING]] >= refVal) qMinLen--;
+	qMin[(qMinHead + qMinLen++) % RING] = ringPos;
+	ringPos = (ringPos + 1) % RING;
+}
+
+// Un ciclo dagli estremi newest-2..newest: ampiezza media dei due
+// semiperiodi, periodo fra la prima e la terza inversione. Un semiperiodo
+// sotto 2·noiseBand è rumore, non l'oscillazione del relay
+bool PID_ATune::cycleEstimate(int newest, float& ku, float& pu)
+{
+	float a1 = fabsf(extVal[newest-1]-extVal[newest-2]);
+	float a2 = fabsf(extVal[newest]-extVal[newest-1]);
+	if(a1 < 2*noiseBand || a2 < 2*noiseBand) return false;
+	ku = 4*(2*oStep)/((a1+a2)/2*3.14159f);
+	pu = (float)(extTime[newest]-extTime[newest-2]) / 1000;
+	return pu > 0;
+}
+
+// Cicli disgiunti: estremi 0..2, 2..4, ..., ogni estremo pari chiude un
+// ciclo e apre il successivo. Due stime a un'inversione di distanza condividono un
+// semiperiodo e si somigliano anche se l'oscillazione deriva ancora
+bool PID_ATune::checkConvergence()
+{
+	if(convTol<=0 || nExt<ATUNE_EXT) return false;
+	float ku[ATUNE_CONV_CYCLES], pu[ATUNE_CONV_CYCLES];
+	float kuM = 0, puM = 0;
+	for(int c=0;c<ATUNE_CONV_CYCLES;c++)
+	{
+		if(!cycleEstimate(2*c+2, ku[c], pu[c])) return false;
+		kuM += ku[c]/ATUNE_CONV_CYCLES;
+		puM += pu[c]/ATUNE_CONV_CYCLES;
+	}
+	for(int c=0;c<ATUNE_CONV_CYCLES;c++)
+		if(fabsf(ku[c]-kuM) > convTol*kuM || fabsf(pu[c]-puM) > convTol*puM) return false;
+	Ku = kuM;
+	Pu = puM;
+	converged = true;
+	return true;
+}
+
+// Con la convergenza attiva Ku e Pu sono la media delle stime di ciclo:
+// absMax-absMin comprende la salita dall'avvio, peak1-peak2 il ripple
+// della finestra dei relay sui massimi piatti
 void PID_ATune::FinishUp()
 {
 	  *output = outputStart;
+	  if(convTol>0 && nEst>0)
+	  {
+		  Ku = kuSum/nEst;
+		  Pu = puSum/nEst;
+		  return;
+	  }
       //we can generate tuning parameters!
-      Ku = 4*(2*oStep)/((absMax-absMin)*3.14159);
-      Pu = (double)(peak1-peak2) / 1000;
+      Ku = 4*(2*oStep)/((absMax-absMin)*3.14159f);
+      Pu = (float)(peak1-peak2) / 1000;
 }
 
-double PID_ATune::GetKp()
+float PID_ATune::GetKp()
 {
-	return controlType==1 ? 0.6 * Ku : 0.4 * Ku;
+	return controlType==1 ? 0.6f * Ku : 0.4f * Ku;
 }
 
-double PID_ATune::GetKi()
+float PID_ATune::GetKi()
 {
-	return controlType==1? 1.2*Ku / Pu : 0.48 * Ku / Pu;  // Ki = Kc/Ti
+	return controlType==1? 1.2f*Ku / Pu : 0.48f * Ku / Pu;  // Ki = Kc/Ti
 }
 
-double PID_ATune::GetKd()
+float PID_ATune::GetKd()
 {
-	return controlType==1? 0.075 * Ku * Pu : 0;  //Kd = Kc * Td
+	return controlType==1? 0.075f * Ku * Pu : 0;  //Kd = Kc * Td
 }
 
-void PID_ATune::SetOutputStep(double Step)
+void PID_ATune::SetOutputStep(float Step)
 {
 	oStep = Step;
 }
 
-double PID_ATune::GetOutputStep()
+float PID_ATune::GetOutputStep()
 {
 	return oStep;
 }
@@ -164,12 +269,12 @@ int PID_ATune::GetControlType()
 	return controlType;
 }
 	
-void PID_ATune::SetNoiseBand(double Band)
+void PID_ATune::SetNoiseBand(float Band)
 {
 	noiseBand = Band;
 }
 
-double PID_ATune::GetNoiseBand()
+float PID_ATune::GetNoiseBand()
 {
 	return noiseBand;
 }
@@ -178,18 +283,55 @@ void PID_ATune::SetLookbackSec(int value)
 {
     if (value<1) value = 1;
 	
-	if(value<25)
+	// La finestra cresce senza costi fino a ATUNE_LOOKBACK_MAX campioni
+	if(value * 4 <= ATUNE_LOOKBACK_MAX)
 	{
 		nLookBack = value * 4;
 		sampleTime = 250;
 	}
 	else
 	{
-		nLookBack = 100;
-		sampleTime = value*10;
+		nLookBack = ATUNE_LOOKBACK_MAX;
+		sampleTime = value * 1000 / ATUNE_LOOKBACK_MAX;
 	}
 }
 
+void PID_ATune::SetConvergence(float tol, bool stop)
+{
+	convTol = tol;
+	convStop = stop;
+}
+
+int PID_ATune::GetHalfCycles()
+{
+	return halfCycles;
+}
+
+float PID_ATune::GetAmplitude()
+{
+	return nExt>=3 ? (fabsf(extVal[nExt-1]-extVal[nExt-2])+fabsf(extVal[nExt-2]-extVal[nExt-3]))/2 : 0;
+}
+
+float PID_ATune::GetPeriod()
+{
+	return nExt>=3 ? (float)(extTime[nExt-1]-extTime[nExt-3]) / 1000 : 0;
+}
+
+bool PID_ATune::GetConverged()
+{
+	return converged;
+}
+
+float PID_ATune::GetKu()
+{
+	return Ku;
+}
+
+float PID_ATune::GetPu()
+{
+	return Pu;
+}
+
 int PID_ATune::GetLookbackSec()
 {
 	return nLookBack * sampleTime / 1000;
@@ -2,54 +2,114 @@
 #define PID_AutoTune_v0
 #define LIBRARY_VERSION	0.0.1
 
+#include <stdint.h>
+
+// Campioni massimi nel lookback (250 ms l'uno): oltre, SetLookbackSec()
+// allunga il passo di campionamento invece della finestra
+#ifndef ATUNE_LOOKBACK_MAX
+#define ATUNE_LOOKBACK_MAX  240
+#endif
+// Massimi oltre i quali la taratura chiude comunque (cicli completi)
+#define ATUNE_MAX_PEAKS     10
+// Cicli completi disgiunti che devono concordare per la convergenza. Con
+// i contattori i semiperiodi cadono su multipli della finestra dei relay:
+// 3 cicli concordi non arrivano quasi mai prima del criterio sui picchi
+#ifndef ATUNE_CONV_CYCLES
+#define ATUNE_CONV_CYCLES   2
+#endif
+// Estremi tenuti per la convergenza (2 semiperiodi per ciclo)
+#define ATUNE_EXT           (2*ATUNE_CONV_CYCLES+1)
+
 class PID_ATune
 {
 
 
   public:
   //commonly used functions **************************************************************************
-    PID_ATune(double*, double*);                       	// * Constructor.  links the Autotune to a given PID
+    PID_ATune(float*, float*);                         	// * Constructor.  links the Autotune to a given PID
     int Runtime();						   			   	// * Similar to the PID Compue function, returns non 0 when done
-	void Cancel();									   	// * Stops the AutoTune	
-	
-	void SetOutputStep(double);						   	// * how far above and below the starting value will the output step?	
-	double GetOutputStep();							   	// 
-	
+	void Cancel();									   	// * Stops the AutoTune
+
+	void SetOutputStep(float);						   	// * how far above and below the starting value will the output step?
+	float GetOutputStep();							   	//
+
 	void SetControlType(int); 						   	// * Determies if the tuning parameters returned will be PI (D=0)
-	int GetControlType();							   	//   or PID.  (0=PI, 1=PID)			
-	
+	int GetControlType();							   	//   or PID.  (0=PI, 1=PID)
+
 	void SetLookbackSec(int);							// * how far back are we looking to identify peaks
 	int GetLookbackSec();								//
-	
-	void SetNoiseBand(double);							// * the autotune will ignore signal chatter smaller than this value
-	double GetNoiseBand();								//   this should be acurately set
-	
-	double GetKp();										// * once autotune is complete, these functions contain the
-	double GetKi();										//   computed tuning parameters.  
-	double GetKd();										//
-	
+
+	void SetNoiseBand(float);							// * the autotune will ignore signal chatter smaller than this value
+	float GetNoiseBand();								//   this should be acurately set
+
+	float GetKp();										// * once autotune is complete, these functions contain the
+	float GetKi();										//   computed tuning parameters.
+	float GetKd();										//
+
+	// Convergenza: una stima di Ku e Pu a ogni inversione max/min, dal
+	// ciclo completo appena chiuso (due semiperiodi). Chiude quando
+	// gli ultimi ATUNE_CONV_CYCLES cicli disgiunti (nessun semiperiodo in
+	// comune) stanno entro tol relativo dalla loro media. Se chiude
+	// il criterio sui picchi o ATUNE_MAX_PEAKS, Ku e Pu sono la media
+	// delle stime. stop = false: niente chiusure anticipate, sempre
+	// ATUNE_MAX_PEAKS (riferimento per la convergenza). 0 = off
+	void SetConvergence(float tol, bool stop = true);
+	int GetHalfCycles();								// semiperiodi completati (inversioni max/min)
+	float GetAmplitude();								// ultimo ciclo: picco-picco [unità input], 0 = nessuno
+	float GetPeriod();									// ultimo ciclo: periodo [s], 0 = nessuno
+	bool GetConverged();								// fine per convergenza, non per i picchi
+	float GetKu();										// guadagno critico [output/input], a taratura finita
+	float GetPu();										// periodo critico [s]
+
+#if HOST_BUILD
+	friend struct ATuneLookbackCheck;					// host/atune_check.cpp
+#endif
+
   private:
     void FinishUp();
+	void lookback(float refVal);
 	bool isMax, isMin;
-	double *input, *output;
-	double setpoint;
-	double noiseBand;
+	float *input, *output;
+	float setpoint;
+	float noiseBand;
 	int controlType;
 	bool running;
 	unsigned long peak1, peak2, lastTime;
 	int sampleTime;
 	int nLookBack;
 	int peakType;
-	double lastInputs[101];
-    double peaks[10];
+	// Lookback: ring degli ultimi campioni + deque monotone di posizioni
+	// nel ring (massimi decrescenti, minimi crescenti). isMax/isMin in
+	// O(1) ammortizzato invece di scorrere tutta la finestra. Una voce
+	// arriva a nLookBack+1 campioni prima di scadere: con RING più corto la
+	// distanza si avvolge a 0 e un estremo vecchio non scade più
+	static const int RING = ATUNE_LOOKBACK_MAX + 2;
+	float    ring[RING];
+	uint16_t ringPos;
+	uint16_t qMax[RING], qMin[RING];
+	uint16_t qMaxHead, qMaxLen, qMinHead, qMinLen;
+    float peaks[ATUNE_MAX_PEAKS];
 	int peakCount;
+	// Estremi delle fasi chiuse e istante dell'inversione (ultimi
+	// ATUNE_EXT: ATUNE_CONV_CYCLES cicli), estremo della fase in corso
+	float extVal[ATUNE_EXT];
+	unsigned long extTime[ATUNE_EXT];
+	int nExt;
+	float curExt;
+	int halfCycles;
+	float convTol;
+	bool convStop;
+	bool converged;
+	float kuSum, puSum;									// stime di ciclo, per la media a fine corsa
+	int nEst;
+	bool cycleEstimate(int newest, float& ku, float& pu);
+	bool checkConvergence();
 	bool justchanged;
 	bool justevaled;
-	double absMax, absMin;
-	double oStep;
-	double outputStart;
-	double Ku, Pu;
-	
+	float absMax, absMin;
+	float oStep;
+	float outputStart;
+	float Ku, Pu;
+
 };
 #endif
-
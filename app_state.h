@@ -0,0 +1,104 @@
+/**
+ * app_state.h — Forno Pizza S3 — Stato applicazione condiviso
+ * ================================================================
+ * Enumerazioni, AppState e GraphBuffer estratti da ui.h perché sono
+ * usati anche dal core di controllo (forno_control.cpp, simulator.cpp,
+ * autotune.cpp). Questo header NON include LVGL né API ESP-IDF:
+ * può essere compilato anche dalla build host (vedi host/Makefile).
+ *
+ * ui.h lo include: tutti gli accessi esistenti restano invariati.
+ * ================================================================
+ */
+#pragma once
+#include <stdint.h>
+#include "gain_sched.h"
+#include "zone_coupling.h"
+
+// ----------------------------------------------------------------
+//  ENUMERAZIONI
+// ----------------------------------------------------------------
+// OFFERED: guadagni SIMC dal preriscaldo in autotune_kp_*, non applicati
+enum class AutotuneStatus { IDLE=0, RUNNING=1, DONE=2, ABORTED=3, OFFERED=4 };
+enum class SafetyReason   { NONE=0, TC_ERROR=1, OVERTEMP=2,
+                            RUNAWAY_DOWN=3, RUNAWAY_UP=4, WDG_TIMEOUT=5 };
+enum class SensorMode     { SINGLE, DUAL };
+enum class Screen         {
+  MAIN,
+  TEMP,
+  PID_BASE,
+  PID_CIELO,
+  AUTOTUNE,     // nuova schermata autotune PID
+  GRAPH,
+  WIFI_SCAN,
+  WIFI_PWD,
+  MQTT,         // configurazione broker MQTT
+  OTA,
+  TIMER,
+  RICETTE
+};
+
+// ----------------------------------------------------------------
+//  STATO APPLICAZIONE — in SRAM interna (accesso real-time da Task_PID)
+// ----------------------------------------------------------------
+struct AppState {
+  double  temp_base,     temp_cielo;
+  double  set_base,      set_cielo;
+  double  pid_out_base,  pid_out_cielo;
+  double  kp_base,  ki_base,  kd_base;
+  double  kp_cielo, ki_cielo, kd_cielo;
+  GainTable gains_base, gains_cielo;   // a fasce di T; vuote = kp_/ki_/kd_ piatti
+  float   ff_k;                        // perdita del forno [W/°C] per il feedforward, 0 = nessun modello
+  ZoneCoupling coupling;               // matrice di accoppiamento Base/Cielo (DUAL), valid = 0 = nessuna stima
+  uint32_t relay_cycles_base, relay_cycles_cielo;   // chiusure totali dei relay (NVS, usura)
+  SensorMode sensor_mode;
+  int     pct_base;
+  int     pct_cielo;
+  bool    base_enabled, cielo_enabled, luce_on;
+  bool    relay_base,   relay_cielo,   fan_on;
+  bool    preheat_base, preheat_cielo;
+  int     preheat_eta_base, preheat_eta_cielo;   // s al pronto, -1 = ancora nessuna stima
+  bool    tc_base_err,  tc_cielo_err;
+  bool    safety_shutdown;
+  SafetyReason safety_reason;
+  AutotuneStatus autotune_status;
+  int     autotune_split, autotune_cycles;
+  int     autotune_band, autotune_bands;   // taratura a fasce: corrente (1..n) / totale, 0 = singola
+  // Risultato dell'ultima taratura per zona: fuori da autotune_per_zone
+  // Base e Cielo sono uguali (un relay test sul PV medio o sul Cielo)
+  float   autotune_kp_base,  autotune_ki_base,  autotune_kd_base;
+  float   autotune_kp_cielo, autotune_ki_cielo, autotune_kd_cielo;
+  float   autotune_ku_base,  autotune_pu_base;    // relay test finito: guadagno [%/°C] e periodo [s] critici
+  float   autotune_ku_cielo, autotune_pu_cielo;
+  bool    autotune_converged;              // chiuso dalla convergenza Ku/Pu, non dai picchi (Cielo)
+  bool    autotune_per_zone;               // DUAL per zona: due relay test, guadagni distinti
+  int     timer_minutes;
+  bool    timer_running;
+  Screen  active_screen;
+  bool    nvs_dirty;
+};
+extern AppState g_state;
+
+// ----------------------------------------------------------------
+//  RING BUFFER GRAFICO — allocato in PSRAM via graph_alloc_psram() (ui.h)
+//  360 campioni × 2 array float × 4 byte = 2.880 byte in PSRAM
+//  head e count rimangono in SRAM (accesso frequente, 4 byte totali)
+// ----------------------------------------------------------------
+#define TIMER_DEFAULT_MIN  10
+#define GRAPH_SAMPLE_S     5
+#define GRAPH_MAX_MINUTES  30
+#define GRAPH_BUF_SIZE     (GRAPH_MAX_MINUTES * 60 / GRAPH_SAMPLE_S)  // 360
+
+struct GraphBuffer {
+  float*   base;   // puntatore → array in PSRAM
+  float*   cielo;  // puntatore → array in PSRAM
+  uint16_t head;
+  uint16_t count;
+};
+extern GraphBuffer g_graph;
+
+// ================================================================
+//  VARIABILI GLOBALI (definite in forno_control.cpp)
+// ================================================================
+extern volatile uint32_t g_pid_heartbeat;
+extern volatile bool     g_emergency_shutdown;
+void emergency_shutdown(SafetyReason reason);
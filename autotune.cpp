@@ -8,15 +8,33 @@
 #include "autotune.h"
 #include "hardware.h"
 #include "pid_ctrl.h"
+#include "relay_sched.h"
+#include "forno_control.h"  // heater_output
+#include "control_clock.h"
+#include "nvs_storage.h"   // NVS_K*_MAX
+#include "gain_sched.h"
+#include "preheat.h"        // rampa del primo ordine per la taratura a gradino
 
 // ================================================================
 //  STATO INTERNO
 // ================================================================
-static double at_input  = 0.0;   // temperatura corrente (input libreria)
-static double at_output = 0.0;   // output relay 0-100% (gestito dalla lib)
+static float at_input  = 0.0f;   // temperatura corrente (input libreria)
+static float at_output = 0.0f;   // output relay 0-100% (gestito dalla lib)
 
 static PID_ATune at_tuner(&at_input, &at_output);
 
+// DUAL con entrambe le sonde: at_tuner tara il Cielo sulla sua sonda,
+// at_tuner_base la Base, ognuno col suo relay. Base parte dopo il primo
+// semiperiodo del Cielo: le due oscillazioni restano sfasate
+static float at_input_base  = 0.0f;
+static float at_output_base = 0.0f;
+static PID_ATune at_tuner_base(&at_input_base, &at_output_base);
+static bool  s_dual       = false;
+static bool  s_base_live  = false;   // relay test Base partito
+static bool  s_done_base  = false;
+static bool  s_done_cielo = false;
+static GainPoint s_gain_base, s_gain_cielo;   // relay test per zona già finiti
+
 static bool     at_running        = false;
 static float    saved_kp_base     = 0;
 static float    saved_ki_base     = 0;
@@ -26,9 +44,35 @@ static float    saved_ki_cielo    = 0;
 static float    saved_kd_cielo    = 0;
 static bool     saved_base_enabled  = false;
 static bool     saved_cielo_enabled = false;
-static uint32_t at_start_ms       = 0;
+static uint32_t at_start_ms       = 0;   // inizio relay test (fascia corrente)
 static int      at_prev_cycles    = 0;
 static bool     s_just_completed  = false;
+static bool     s_early_stop      = true;    // autotune_set_early_stop()
+
+// Taratura a fasce: s_band_n = 0 → taratura singola
+static const float k_sched_temps[] = AUTOTUNE_SCHED_TEMPS;
+#define AT_SCHED_MAX  (int)(sizeof(k_sched_temps) / sizeof(k_sched_temps[0]))
+static_assert(AT_SCHED_MAX <= GAIN_SCHED_POINTS, "più fasce che punti in GainTable");
+static float     s_band_t[AT_SCHED_MAX];
+static int       s_band_n    = 0;
+static int       s_band_i    = 0;
+static bool      s_approach  = false;   // piena potenza verso la fascia
+static float     s_tune_t    = 0.0f;    // PV all'avvio del relay test
+static float     s_peak_t    = 0.0f;    // salita in approccio (stallo)
+static uint32_t  s_peak_ms   = 0;
+static GainTable s_table;        // Cielo, o entrambe fuori da s_dual
+static GainTable s_table_base;   // Base con s_dual
+
+// Taratura a gradino: rampa a piena potenza verso s_step_sp, poi un ciclo
+// al duty di regime stimato (s_step_done) prima di chiudere
+static bool      s_step      = false;
+static bool      s_step_done = false;
+static float     s_step_sp   = 0.0f;
+static Preheat   s_step_ramp;
+
+// Taratura passiva: guadagni SIMC dal preriscaldo di Task_PID, per zona
+static GainPoint s_offer[RELAY_ZONES];
+static bool      s_offer_ok[RELAY_ZONES] = { false, false };
 
 bool autotune_consume_just_completed(void) {
   bool v = s_just_completed;
@@ -48,6 +92,33 @@ void autotune_apply_default_split(void) {
   xSemaphoreGive(g_mutex);
 }
 
+static float clampf(float x, float hi) { return x < 0.0f ? 0.0f : (x > hi ? hi : x); }
+
+static void tuner_setup(PID_ATune& t) {
+  t.Cancel();
+  t.SetOutputStep(AUTOTUNE_OUTPUT_STEP);
+  t.SetNoiseBand(AUTOTUNE_NOISE_BAND);
+  t.SetLookbackSec(AUTOTUNE_LOOKBACK_S);
+  t.SetConvergence(AUTOTUNE_CONVERGE_TOL, s_early_stop);
+  t.SetControlType(1);   // 1 = PID (non solo PI)
+}
+
+// Relay test della libreria da PV corrente (nuova fascia o taratura singola);
+// con s_dual anche la Base, dalla sua sonda
+static void tuner_begin(float pv, float pv_base = 0.0f, float pv_cielo = 0.0f) {
+  tuner_setup(at_tuner);
+  tuner_setup(at_tuner_base);
+  at_input       = s_dual ? pv_cielo : pv;
+  at_output      = 50.0f;  // output iniziale 50%
+  at_input_base  = pv_base;
+  at_output_base = 50.0f;
+  s_base_live    = false;
+  s_done_base    = false;
+  s_done_cielo   = false;
+  s_tune_t  = pv;
+  at_start_ms = clock_ms();
+}
+
 // ================================================================
 //  autotune_start
 // ================================================================
@@ -81,9 +152,11 @@ void autotune_start() {
     }
 
     double pv = g_state.temp_cielo;
+    s_dual = false;
     if (g_state.sensor_mode == SensorMode::DUAL) {
       if (!g_state.tc_base_err && !g_state.tc_cielo_err) {
         pv = (g_state.temp_base + g_state.temp_cielo) * 0.5;
+        s_dual = AUTOTUNE_DUAL_ZONES;
       } else if (!g_state.tc_cielo_err) {
         pv = g_state.temp_cielo;
       } else if (!g_state.tc_base_err) {
@@ -91,32 +164,102 @@ void autotune_start() {
       }
     }
 
-    at_input  = pv;
-    at_output = 50.0;  // output iniziale 50%
+    tuner_begin((float)pv, (float)g_state.temp_base, (float)g_state.temp_cielo);
+    s_step_sp = (float)g_state.set_cielo;
 
     g_state.autotune_status = AutotuneStatus::RUNNING;
     g_state.autotune_cycles = 0;
-    g_state.autotune_kp     = 0;
-    g_state.autotune_ki     = 0;
-    g_state.autotune_kd     = 0;
+    g_state.autotune_band   = 0;
+    g_state.autotune_bands  = 0;
+    g_state.autotune_kp_base  = g_state.autotune_ki_base  = g_state.autotune_kd_base  = 0;
+    g_state.autotune_kp_cielo = g_state.autotune_ki_cielo = g_state.autotune_kd_cielo = 0;
+    g_state.autotune_ku_base  = g_state.autotune_pu_base  = 0;
+    g_state.autotune_ku_cielo = g_state.autotune_pu_cielo = 0;
+    g_state.autotune_converged = false;
+    g_state.autotune_per_zone  = s_dual;
     xSemaphoreGive(g_mutex);
   }
 
-  // Configura libreria autotune
-  at_tuner.SetOutputStep(AUTOTUNE_OUTPUT_STEP);
-  at_tuner.SetNoiseBand(AUTOTUNE_NOISE_BAND);
-  at_tuner.SetLookbackSec(AUTOTUNE_LOOKBACK_S);
-  at_tuner.SetControlType(1);   // 1 = PID (non solo PI)
-
   at_running     = true;
-  at_start_ms    = millis();
   at_prev_cycles = 0;
+  s_offer_ok[0]  = s_offer_ok[1] = false;   // l'autotune sostituisce l'offerta
+  s_band_n       = 0;
+  s_approach     = false;
+  s_step         = false;
+  s_step_done    = false;
+
+  if (s_dual)
+    Serial.printf("[AUTOTUNE] Avviato — mode=DUAL per zona  Base=%.1f°C  Cielo=%.1f°C\n",
+                  at_input_base, at_input);
+  else
+    Serial.printf("[AUTOTUNE] Avviato — mode=%s  PV=%.1f°C  split=%d/%d\n",
+      g_state.sensor_mode == SensorMode::SINGLE ? "SINGLE" : "DUAL",
+      at_input,
+      g_state.autotune_split,
+      100 - g_state.autotune_split);
+}
+
+// ================================================================
+//  autotune_start_schedule — una taratura per fascia
+// ================================================================
+void autotune_start_schedule() {
+  if (at_running) return;
+  autotune_start();
+  if (!at_running) return;
+
+  // Fasce raggiungibili scaldando: sopra il PV, sotto il limite di sicurezza
+  int n = 0;
+  for (int i = 0; i < AT_SCHED_MAX; i++) {
+    float t = k_sched_temps[i];
+    if (t - AUTOTUNE_SETPOINT_OFFSET < s_tune_t) {
+      Serial.printf("[AUTOTUNE] Fascia %.0f°C saltata: forno già a %.1f°C\n", t, s_tune_t);
+      continue;
+    }
+    if (t > TEMP_MAX_SAFE - 30.0f) continue;
+    s_band_t[n++] = t;
+  }
+  if (n == 0) {
+    Serial.println("[AUTOTUNE] Nessuna fascia sopra la temperatura attuale");
+    autotune_stop();
+    return;
+  }
+  s_band_n   = n;
+  s_band_i   = 0;
+  s_approach = true;
+  s_peak_t   = s_tune_t;
+  s_peak_ms  = clock_ms();
+  s_table.clear();
+  s_table_base.clear();
+  at_output  = 100.0f;
+  if (MUTEX_TAKE_MS(50)) {
+    g_state.autotune_band  = 1;
+    g_state.autotune_bands = n;
+    xSemaphoreGive(g_mutex);
+  }
+  Serial.printf("[AUTOTUNE] A fasce: %d fasce da %.0f°C a %.0f°C\n", n, s_band_t[0], s_band_t[n - 1]);
+}
+
+// ================================================================
+//  autotune_start_step — FOPDT dalla rampa di preriscaldo
+// ================================================================
+void autotune_start_step() {
+  if (at_running) return;
+  autotune_start();
+  if (!at_running) return;
 
-  Serial.printf("[AUTOTUNE] Avviato — mode=%s  PV=%.1f°C  split=%d/%d\n",
-    g_state.sensor_mode == SensorMode::SINGLE ? "SINGLE" : "DUAL",
-    (float)at_input,
-    g_state.autotune_split,
-    100 - g_state.autotune_split);
+  uint32_t now = clock_ms();
+  if (s_tune_t > s_step_sp - AUTOTUNE_STEP_MIN_RISE || !s_step_ramp.start(s_tune_t, s_step_sp, now)) {
+    Serial.printf("[AUTOTUNE] Gradino: forno a %.1f°C, serve partire almeno %.0f°C sotto il setpoint %.0f°C\n",
+                  s_tune_t, AUTOTUNE_STEP_MIN_RISE, s_step_sp);
+    autotune_stop();
+    return;
+  }
+  s_step      = true;
+  s_step_done = false;
+  s_dual      = false;   // un FOPDT sul PV medio, stessi guadagni
+  at_output   = 100.0f;
+  Serial.printf("[AUTOTUNE] Gradino: piena potenza da %.1f°C a %.0f°C\n",
+                s_tune_t, s_step_sp - PREHEAT_MARGIN_DEG);
 }
 
 // ================================================================
@@ -125,7 +268,10 @@ void autotune_start() {
 void autotune_stop() {
   if (!at_running) return;
   at_running = false;
+  s_approach = false;
+  s_step     = false;
   at_tuner.Cancel();
+  at_tuner_base.Cancel();
 
   if (MUTEX_TAKE_MS(50)) {
     // Ripristina parametri originali
@@ -138,11 +284,17 @@ void autotune_stop() {
     g_state.autotune_status = AutotuneStatus::ABORTED;
     g_state.base_enabled  = saved_base_enabled;
     g_state.cielo_enabled = saved_cielo_enabled;
+    g_state.relay_base    = false;
+    g_state.relay_cielo   = false;
     xSemaphoreGive(g_mutex);
   }
 
-  RELAY_WRITE(RELAY_BASE,  RELAY_BASE_INV,  false);
-  RELAY_WRITE(RELAY_CIELO, RELAY_CIELO_INV, false);
+  // Come at_finish: lo scheduler deve sapere che i relay sono spenti
+  // (tempi minimi OFF e chiusure per l'usura al ritorno del PID)
+  uint32_t now_ms = clock_ms();
+  g_relays.forceOff(RelayZone::BASE,  now_ms);
+  g_relays.forceOff(RelayZone::CIELO, now_ms);
+  heater_output(false, false);
 
   Serial.println("[AUTOTUNE] Interrotto — parametri originali ripristinati");
 }
@@ -152,37 +304,309 @@ void autotune_stop() {
 // ================================================================
 bool autotune_is_running() { return at_running; }
 
+void autotune_set_early_stop(bool on) { s_early_stop = on; }
+
+// ================================================================
+//  Fine taratura: guadagni in AppState, relay spenti, PID ripristinato
+//    tb/tc  : taratura a fasce → tabelle Base/Cielo, piatti = tabella al setpoint
+//    altrimenti gb/gc; con tabella presente aggiornano la loro fascia
+//    Fuori da s_dual tb == tc e gb == gc: stessi guadagni per le due zone
+// ================================================================
+static void at_finish(const GainTable* tb, const GainTable* tc, GainPoint gb, GainPoint gc,
+                      uint32_t now_ms) {
+  at_running = false;
+  s_approach = false;
+  s_step     = false;
+
+  if (MUTEX_TAKE_MS(50)) {
+    if (tb && tc) {
+      gb = tb->at((float)(s_dual ? g_state.set_base : g_state.set_cielo));
+      gc = tc->at((float)g_state.set_cielo);
+      g_state.gains_base.assign(*tb);
+      g_state.gains_cielo.assign(*tc);
+    } else if (!g_state.gains_base.empty()) {
+      gb.t_c = gc.t_c = s_tune_t;
+      g_state.gains_base.put(gb);
+      g_state.gains_cielo.put(gc);
+    }
+    g_state.kp_base  = gb.kp;  g_state.ki_base  = gb.ki;  g_state.kd_base  = gb.kd;
+    g_state.kp_cielo = gc.kp;  g_state.ki_cielo = gc.ki;  g_state.kd_cielo = gc.kd;
+    g_state.autotune_kp_base  = gb.kp;  g_state.autotune_ki_base  = gb.ki;  g_state.autotune_kd_base  = gb.kd;
+    g_state.autotune_kp_cielo = gc.kp;  g_state.autotune_ki_cielo = gc.ki;  g_state.autotune_kd_cielo = gc.kd;
+    g_state.autotune_per_zone = s_dual;
+    g_state.autotune_status = AutotuneStatus::DONE;
+    g_state.nvs_dirty       = true;   // salva su flash
+    g_state.base_enabled    = saved_base_enabled;
+    g_state.cielo_enabled   = saved_cielo_enabled;
+    g_state.relay_base      = false;
+    g_state.relay_cielo     = false;
+    xSemaphoreGive(g_mutex);
+  }
+
+  g_relays.forceOff(RelayZone::BASE,  now_ms);
+  g_relays.forceOff(RelayZone::CIELO, now_ms);
+  heater_output(false, false);
+  s_just_completed = true;
+}
+
+// Fasce finite o fuori portata: chiude con quelle tarate, se ce ne sono
+static void sched_finish(uint32_t now_ms) {
+  if (s_table.empty()) {
+    autotune_stop();
+    return;
+  }
+  const GainTable& tb = s_dual ? s_table_base : s_table;
+  Serial.printf("[AUTOTUNE] A fasce COMPLETATO — %d punti:\n", s_table.n);
+  for (int i = 0; i < s_table.n; i++) {
+    if (s_dual)
+      Serial.printf("[AUTOTUNE]   %5.0f°C  BASE Kp=%.3f Ki=%.4f Kd=%.3f  CIELO Kp=%.3f Ki=%.4f Kd=%.3f\n",
+                    s_table.pt[i].t_c, tb.pt[i].kp, tb.pt[i].ki, tb.pt[i].kd,
+                    s_table.pt[i].kp, s_table.pt[i].ki, s_table.pt[i].kd);
+    else
+      Serial.printf("[AUTOTUNE]   %5.0f°C  Kp=%.3f Ki=%.4f Kd=%.3f\n",
+                    s_table.pt[i].t_c, s_table.pt[i].kp, s_table.pt[i].ki, s_table.pt[i].kd);
+  }
+  at_finish(&tb, &s_table, GainPoint{}, GainPoint{}, now_ms);
+}
+
+// Guadagni del relay test finito, limitati agli intervalli NVS
+static GainPoint tuner_gains(PID_ATune& t, const char* zone, uint32_t now_ms) {
+  GainPoint g = { s_tune_t, clampf(t.GetKp(), NVS_KP_MAX), clampf(t.GetKi(), NVS_KI_MAX),
+                  clampf(t.GetKd(), NVS_KD_MAX) };
+  Serial.printf("[AUTOTUNE] %sCOMPLETATO — Kp=%.3f Ki=%.4f Kd=%.3f (grezzi Kp=%.3f Ki=%.4f Kd=%.3f)\n",
+                zone, g.kp, g.ki, g.kd, t.GetKp(), t.GetKi(), t.GetKd());
+  Serial.printf("[AUTOTUNE] %s%s dopo %d cicli in %lus\n", zone,
+                t.GetConverged() ? "Convergenza Ku/Pu" : "Criterio sui picchi",
+                t.GetHalfCycles() / 2, (unsigned long)((now_ms - at_start_ms) / 1000));
+  Serial.printf("[AUTOTUNE] %sKu=%.2f Pu=%.1fs\n", zone, t.GetKu(), t.GetPu());
+  // Fuori da s_dual un solo relay test: stesso Ku/Pu per le due zone
+  if (MUTEX_TAKE_MS(10)) {
+    if (&t == &at_tuner_base) {
+      g_state.autotune_ku_base = t.GetKu();
+      g_state.autotune_pu_base = t.GetPu();
+    } else {
+      g_state.autotune_ku_cielo  = t.GetKu();
+      g_state.autotune_pu_cielo  = t.GetPu();
+      g_state.autotune_converged = t.GetConverged();
+      if (!s_dual) {
+        g_state.autotune_ku_base = g_state.autotune_ku_cielo;
+        g_state.autotune_pu_base = g_state.autotune_pu_cielo;
+      }
+    }
+    xSemaphoreGive(g_mutex);
+  }
+  return g;
+}
+
+// SIMC sul FOPDT di una rampa a piena potenza (autotune.h). Ritardo medio
+// dell'uscita della zona: mezza finestra relay, mezzo periodo PWM per un
+// SSR. false: la rampa non è un primo ordine
+struct SimcFit { float k, tau, dead, win_s, kp, ki; };
+
+static bool simc_fit(const Preheat& ph, RelayZone z, SimcFit& f) {
+  float t_inf;
+  if (!ph.model(t_inf, f.tau) || !ph.deadS(f.dead)) return false;
+  uint32_t win_ms = g_relays.type(z) == RelayType::SSR ? SSR_PWM_PERIOD_MS : g_relays.windowMs(z);
+  f.win_s     = win_ms / 2000.0f;
+  f.k         = (t_inf - PREHEAT_T_AMB_C) / 100.0f;
+  float theta = f.dead + f.win_s;
+  float tc    = theta > AUTOTUNE_STEP_TC_MIN * f.tau ? theta : AUTOTUNE_STEP_TC_MIN * f.tau;
+  float ti    = f.tau < 4.0f * (tc + theta) ? f.tau : 4.0f * (tc + theta);
+  f.kp        = f.tau / (f.k * (tc + theta));
+  f.ki        = f.kp / ti;
+  return true;
+}
+
+// Gradino finito: SIMC sul FOPDT della rampa (autotune.h)
+static void step_finish(uint32_t now_ms) {
+  SimcFit f;
+  if (!simc_fit(s_step_ramp, RelayZone::CIELO, f)) {
+    Serial.println("[AUTOTUNE] Gradino: la rampa non è un primo ordine, nessun guadagno");
+    autotune_stop();
+    return;
+  }
+
+  Serial.printf("[AUTOTUNE] Gradino: K=%.2f°C/%% τ=%.0fs θ=%.1fs (rampa %.1fs + finestra %.1fs) in %lus\n",
+                f.k, f.tau, f.dead + f.win_s, f.dead, f.win_s, (unsigned long)((now_ms - at_start_ms) / 1000));
+  Serial.printf("[AUTOTUNE] COMPLETATO — Kp=%.3f Ki=%.4f Kd=%.3f (grezzi Kp=%.3f Ki=%.4f)\n",
+                clampf(f.kp, NVS_KP_MAX), clampf(f.ki, NVS_KI_MAX), 0.0f, f.kp, f.ki);
+  s_tune_t = s_step_sp;
+  GainPoint g = { s_step_sp, clampf(f.kp, NVS_KP_MAX), clampf(f.ki, NVS_KI_MAX), 0.0f };
+  at_finish(nullptr, nullptr, g, g, now_ms);
+}
+
+// ================================================================
+//  Taratura passiva: SIMC dal preriscaldo di Task_PID (autotune.h)
+// ================================================================
+void autotune_offer_preheat(RelayZone z, const Preheat& ph, float sp) {
+  if (at_running || sp - ph.startC() < AUTOTUNE_STEP_MIN_RISE) return;
+  SimcFit f;
+  if (!simc_fit(ph, z, f)) return;
+
+  int i = (int)z;
+  s_offer[i]    = GainPoint{ sp, clampf(f.kp, NVS_KP_MAX), clampf(f.ki, NVS_KI_MAX), 0.0f };
+  s_offer_ok[i] = true;
+  const char* name = z == RelayZone::BASE ? "BASE" : "CIELO";
+  Serial.printf("[AUTOTUNE] Preriscaldo %s: K=%.2f°C/%% τ=%.0fs θ=%.1fs → offerti Kp=%.3f Ki=%.4f\n",
+                name, f.k, f.tau, f.dead + f.win_s, s_offer[i].kp, s_offer[i].ki);
+
+  if (!MUTEX_TAKE_MS(10)) return;
+  // Prima zona dell'offerta: l'altra mostra i guadagni in uso
+  if (g_state.autotune_status != AutotuneStatus::OFFERED) {
+    g_state.autotune_kp_base  = g_state.kp_base;   g_state.autotune_ki_base  = g_state.ki_base;
+    g_state.autotune_kd_base  = g_state.kd_base;
+    g_state.autotune_kp_cielo = g_state.kp_cielo;  g_state.autotune_ki_cielo = g_state.ki_cielo;
+    g_state.autotune_kd_cielo = g_state.kd_cielo;
+    g_state.autotune_ku_base  = g_state.autotune_pu_base  = 0;
+    g_state.autotune_ku_cielo = g_state.autotune_pu_cielo = 0;
+    g_state.autotune_converged = false;
+  }
+  if (z == RelayZone::BASE) {
+    g_state.autotune_kp_base = s_offer[i].kp;  g_state.autotune_ki_base = s_offer[i].ki;
+    g_state.autotune_kd_base = 0;
+  } else {
+    g_state.autotune_kp_cielo = s_offer[i].kp;  g_state.autotune_ki_cielo = s_offer[i].ki;
+    g_state.autotune_kd_cielo = 0;
+  }
+  g_state.autotune_per_zone = g_state.sensor_mode == SensorMode::DUAL;
+  g_state.autotune_status   = AutotuneStatus::OFFERED;
+  xSemaphoreGive(g_mutex);
+}
+
+bool autotune_accept_offer() {
+  if (at_running || !(s_offer_ok[0] || s_offer_ok[1])) return false;
+  if (!MUTEX_TAKE_MS(50)) return false;
+  if (g_state.autotune_status != AutotuneStatus::OFFERED) {
+    xSemaphoreGive(g_mutex);
+    return false;
+  }
+  const GainPoint& gb = s_offer[(int)RelayZone::BASE];
+  const GainPoint& gc = s_offer[(int)RelayZone::CIELO];
+  if (s_offer_ok[(int)RelayZone::BASE]) {
+    g_state.kp_base = gb.kp;  g_state.ki_base = gb.ki;  g_state.kd_base = gb.kd;
+    if (!g_state.gains_base.empty()) g_state.gains_base.put(gb);
+  }
+  if (s_offer_ok[(int)RelayZone::CIELO]) {
+    g_state.kp_cielo = gc.kp;  g_state.ki_cielo = gc.ki;  g_state.kd_cielo = gc.kd;
+    if (!g_state.gains_cielo.empty()) g_state.gains_cielo.put(gc);
+  }
+  g_state.autotune_status = AutotuneStatus::DONE;
+  g_state.nvs_dirty       = true;   // salva su flash
+  GainPoint lb = { 0, (float)g_state.kp_base,  (float)g_state.ki_base,  0 };
+  GainPoint lc = { 0, (float)g_state.kp_cielo, (float)g_state.ki_cielo, 0 };
+  xSemaphoreGive(g_mutex);
+
+  Serial.printf("[AUTOTUNE] Guadagni del preriscaldo applicati — BASE Kp=%.3f Ki=%.4f  CIELO Kp=%.3f Ki=%.4f\n",
+                lb.kp, lb.ki, lc.kp, lc.ki);
+  s_offer_ok[0] = s_offer_ok[1] = false;
+  return true;
+}
+
 // ================================================================
 //  autotune_run — chiamato ogni PID_SAMPLE_MS in Task_PID
 //
 //  Logica relay durante autotune:
 //    output = 0..100% (gestito dalla libreria)
+//    approccio a una fascia: 100% su Base e Cielo, split ignorata
 //    split applica: base = output * split/100
 //                   cielo= output * (100-split)/100
-//    Relay BASE e CIELO commutano con time-proportional
-//    usando la stessa finestra PID normale (PID_WINDOW_MS)
+//    DUAL per zona (s_dual): ogni zona dal suo tuner, 0..100%, split
+//    ignorata; la zona che finisce prima resta al 50% fino all'altra
+//    Relay BASE e CIELO: richieste a g_relays (relay_sched.h), stessa
+//    finestra, clamp duty e tempi minimi del PID normale
 // ================================================================
-void autotune_run(float temp_pv, uint32_t now_ms) {
+void autotune_run(float temp_pv, float t_base, float t_cielo, uint32_t now_ms) {
   if (!at_running) return;
 
   // Aggiorna input libreria (PV: Cielo in SINGLE, media in DUAL — calcolata in Task_PID)
-  at_input = (double)temp_pv;
-
-  // Chiama libreria — restituisce 0 se ancora in corso, 1 se finita
-  int result = at_tuner.Runtime();
-
-  // Aggiorna cicli completati per barra progresso
-  // La libreria accumula picchi; ogni 2 picchi = 1 ciclo completo
-  // Non c'è un getter diretto, quindi stimiamo dal tempo trascorso
-  // e dal lookback (ogni ciclo ~= 2x lookback in condizioni tipiche)
-  uint32_t elapsed_s = (now_ms - at_start_ms) / 1000;
-  int estimated_cycles = (int)(elapsed_s / (AUTOTUNE_LOOKBACK_S * 2));
-  if (estimated_cycles != at_prev_cycles) {
-    at_prev_cycles = estimated_cycles;
+  at_input = temp_pv;
+  if (s_dual) {
+    if (isnan(t_base) || isnan(t_cielo)) {
+      Serial.println("[AUTOTUNE] Sonda in errore: taratura per zona interrotta");
+      autotune_stop();
+      return;
+    }
+    at_input      = t_cielo;
+    at_input_base = t_base;
+  }
+
+  // Approccio alla fascia: piena potenza su entrambe le zone, relay
+  // test centrato sulla temperatura della fascia
+  if (s_approach) {
+    if (temp_pv >= s_band_t[s_band_i]) {
+      tuner_begin(temp_pv, t_base, t_cielo);
+      s_approach = false;
+      Serial.printf("[AUTOTUNE] Fascia %d/%d (%.0f°C): relay test da %.1f°C\n",
+                    s_band_i + 1, s_band_n, s_band_t[s_band_i], temp_pv);
+    } else if (temp_pv > s_peak_t + 0.5f) {
+      s_peak_t  = temp_pv;
+      s_peak_ms = now_ms;
+    } else if (now_ms - s_peak_ms >= AUTOTUNE_SCHED_STALL_S * 1000UL) {
+      Serial.printf("[AUTOTUNE] Fascia %.0f°C fuori portata: a piena potenza fermo a %.1f°C\n",
+                    s_band_t[s_band_i], s_peak_t);
+      sched_finish(now_ms);
+      return;
+    }
+  }
+
+  // Gradino: la rampa decide l'hand-off, poi un ciclo al duty di regime
+  // stimato perché i PID lo aggancino (pid_track_autotune) prima di chiudere
+  if (s_step && s_step_done) {
+    step_finish(now_ms);
+    return;
+  }
+  if (s_step && s_step_ramp.step(temp_pv, s_step_sp, now_ms)) {
+    s_step_done = true;
+    at_output   = s_step_ramp.preloadPct();
+  }
+  bool full = s_approach || (s_step && !s_step_done);
+
+  // Chiama libreria — restituisce 0 se ancora in corso, 1 se finita.
+  // Per zona: la Base parte al primo semiperiodo del Cielo, fine quando
+  // hanno finito entrambe
+  int result = 0;
+  if (s_approach || s_step) {
+    result = 0;
+  } else if (!s_dual) {
+    result = at_tuner.Runtime();
+  } else {
+    if (!s_done_cielo && at_tuner.Runtime()) {
+      s_done_cielo = true;
+      s_gain_cielo = tuner_gains(at_tuner, "CIELO ", now_ms);
+    }
+    if (!s_base_live && (at_tuner.GetHalfCycles() >= 1 || s_done_cielo)) {
+      s_base_live = true;
+      Serial.printf("[AUTOTUNE] BASE: relay test da %.1f°C, sfasato di un semiperiodo\n", t_base);
+    }
+    if (s_base_live && !s_done_base && at_tuner_base.Runtime()) {
+      s_done_base = true;
+      s_gain_base = tuner_gains(at_tuner_base, "BASE ", now_ms);
+    }
+    result = s_done_base && s_done_cielo;
+  }
+
+  // Cicli completati per barra progresso e MQTT: due inversioni max/min
+  // della libreria = un ciclo (in approccio a una fascia: 0). Per zona:
+  // la zona più indietro
+  int half = at_tuner.GetHalfCycles();
+  if (s_dual) {
+    int hb = at_tuner_base.GetHalfCycles();
+    if (s_done_cielo || (!s_done_base && hb < half)) half = hb;
+  }
+  int cycles = (s_approach || s_step) ? 0 : half / 2;
+  if (cycles != at_prev_cycles) {
+    at_prev_cycles = cycles;
     if (MUTEX_TAKE_MS(10)) {
-      g_state.autotune_cycles = estimated_cycles;
+      g_state.autotune_cycles = cycles;
       xSemaphoreGive(g_mutex);
     }
+    if (s_dual && cycles > 0 && at_tuner.GetPeriod() > 0 && at_tuner_base.GetPeriod() > 0)
+      Serial.printf("[AUTOTUNE] Ciclo %d: BASE ampiezza %.2f°C periodo %.1fs  CIELO ampiezza %.2f°C periodo %.1fs\n",
+                    cycles, at_tuner_base.GetAmplitude(), at_tuner_base.GetPeriod(),
+                    at_tuner.GetAmplitude(), at_tuner.GetPeriod());
+    else if (!s_dual && cycles > 0 && at_tuner.GetPeriod() > 0)
+      Serial.printf("[AUTOTUNE] Ciclo %d: ampiezza %.2f°C  periodo %.1fs\n",
+                    cycles, at_tuner.GetAmplitude(), at_tuner.GetPeriod());
   }
 
   // Applica output relay con split configurata
@@ -194,60 +618,53 @@ void autotune_run(float temp_pv, uint32_t now_ms) {
     xSemaphoreGive(g_mutex);
   }
 
-  double out_base  = at_output * split_base  / 100.0;
-  double out_cielo = at_output * split_cielo / 100.0;
+  float out_base  = full ? 100.0f : at_output * split_base  / 100.0f;
+  float out_cielo = full ? 100.0f : at_output * split_cielo / 100.0f;
+  if (s_step && s_step_done) out_base = out_cielo = at_output;   // stessa uscita: PID Base e Cielo uguali
+  if (s_dual && !full) {
+    out_base  = at_output_base;
+    out_cielo = at_output;
+  }
 
   // Durante autotune il PID non comanda i relay: la UI mostrerebbe 0%.
   // Pubbliciamo il duty richiesto dalla libreria (0–100% per zona) come pid_out_*.
   if (MUTEX_TAKE_MS(10)) {
-    g_state.pid_out_base  = (float)out_base;
-    g_state.pid_out_cielo = (float)out_cielo;
+    g_state.pid_out_base  = out_base;
+    g_state.pid_out_cielo = out_cielo;
     xSemaphoreGive(g_mutex);
   }
 
   // Time-proportional relay
-  static uint32_t win_base  = 0;
-  static uint32_t win_cielo = 0;
-  if (now_ms - win_base  >= PID_WINDOW_MS) win_base  = now_ms;
-  if (now_ms - win_cielo >= PID_WINDOW_MS) win_cielo = now_ms;
-
-  bool rb = (now_ms - win_base  < (uint32_t)(out_base  / 100.0 * PID_WINDOW_MS));
-  bool rc = (now_ms - win_cielo < (uint32_t)(out_cielo / 100.0 * PID_WINDOW_MS));
+  bool rb = g_relays.request(RelayZone::BASE,  out_base,  now_ms);
+  bool rc = g_relays.request(RelayZone::CIELO, out_cielo, now_ms);
 
-  // Usa RELAY_WRITE (rispetta RELAY_*_INV), non digitalWrite grezzo
-  RELAY_WRITE(RELAY_BASE,  RELAY_BASE_INV,  rb);
-  RELAY_WRITE(RELAY_CIELO, RELAY_CIELO_INV, rc);
+  // heater_output: RELAY_*_INV e zone SSR, non digitalWrite grezzo
+  heater_output(rb, rc);
   g_state.relay_base  = rb;
   g_state.relay_cielo = rc;
 
-  // Autotune terminato
+  // Autotune terminato (taratura singola o fascia corrente)
   if (result != 0) {
-    at_running = false;
-
-    float kp = (float)at_tuner.GetKp();
-    float ki = (float)at_tuner.GetKi();
-    float kd = (float)at_tuner.GetKd();
-
-    Serial.printf("[AUTOTUNE] COMPLETATO — Kp=%.3f Ki=%.4f Kd=%.3f\n", kp, ki, kd);
-
-    if (MUTEX_TAKE_MS(50)) {
-      // Applica stessi parametri a Base e Cielo
-      g_state.kp_base  = kp;  g_state.ki_base  = ki;  g_state.kd_base  = kd;
-      g_state.kp_cielo = kp;  g_state.ki_cielo = ki;  g_state.kd_cielo = kd;
-      g_state.autotune_kp     = kp;
-      g_state.autotune_ki     = ki;
-      g_state.autotune_kd     = kd;
-      g_state.autotune_status = AutotuneStatus::DONE;
-      g_state.nvs_dirty       = true;   // salva su flash
-      g_state.base_enabled    = saved_base_enabled;
-      g_state.cielo_enabled   = saved_cielo_enabled;
-      g_state.relay_base      = false;
-      g_state.relay_cielo     = false;
+    GainPoint gc = s_dual ? s_gain_cielo : tuner_gains(at_tuner, "", now_ms);
+    GainPoint gb = s_dual ? s_gain_base  : gc;
+
+    if (s_band_n == 0) {
+      at_finish(nullptr, nullptr, gb, gc, now_ms);
+      return;
+    }
+    s_table.put(gc);
+    s_table_base.put(gb);
+    if (++s_band_i >= s_band_n) {
+      sched_finish(now_ms);
+      return;
+    }
+    s_approach = true;
+    s_peak_t   = temp_pv;
+    s_peak_ms  = now_ms;
+    at_output  = 100.0f;
+    if (MUTEX_TAKE_MS(10)) {
+      g_state.autotune_band = s_band_i + 1;
       xSemaphoreGive(g_mutex);
     }
-
-    RELAY_WRITE(RELAY_BASE,  RELAY_BASE_INV,  false);
-    RELAY_WRITE(RELAY_CIELO, RELAY_CIELO_INV, false);
-    s_just_completed = true;
   }
 }
@@ -10,28 +10,97 @@
  * FUNZIONAMENTO:
  *   1. Utente imposta autotune_split (% potenza Base, default 50)
  *   2. START  → entra in modalità AUTOTUNE
- *      - Sospende PID normale
+ *      - Sospende PID normale: i PID seguono il duty applicato
+ *        (PIDControllerT::track) e a fine taratura ripartono da lì
  *      - SINGLE: PV = sonda Cielo (Base segue la stessa lettura)
  *      - DUAL:   PV = media (Base+Cielo) se entrambe valide, altrimenti la sonda ok
  *      - Accende Base e Cielo con la split impostata
+ *      - DUAL con entrambe le sonde (AUTOTUNE_DUAL_ZONES): due relay test
+ *        in parallelo, ognuno sulla sua sonda e sul suo relay (0/100%,
+ *        split ignorata). La Base parte al primo semiperiodo del Cielo:
+ *        eccitazioni sfasate, l'accoppiamento fra le zone non le aggancia
+ *        in fase. Chi finisce prima resta al 50% fino all'altra; una
+ *        sonda in errore interrompe la taratura
  *      - La libreria oscilla attorno al setpoint_cielo corrente
- *   3. Dopo ~5 cicli completi → calcola Kp/Ki/Kd
- *      - Applica gli stessi valori a Base e Cielo
+ *   3. Appena Ku e Pu convergono → calcola Kp/Ki/Kd
+ *      - a ogni inversione max/min una stima di Ku e Pu, dall'ultimo
+ *        ciclo completo (due semiperiodi, periodo fra la prima e la
+ *        terza inversione); le stime di ATUNE_CONV_CYCLES cicli
+ *        disgiunti (2: l'ultima e quella di due inversioni prima) entro
+ *        AUTOTUNE_CONVERGE_TOL chiudono la taratura (almeno 4 semiperiodi)
+ *      - con i contattori Pu ha la risoluzione della finestra dei relay:
+ *        due cicli corti di fila possono concordare e chiudere con un Pu
+ *        basso di una o due finestre; Ku resta entro l'1%
+ *      - altrimenti chiude il criterio originale sui picchi, al più
+ *        ATUNE_MAX_PEAKS cicli, con Ku e Pu medi delle stime di ciclo
+ *      - autotune_cycles = cicli completi veri (semiperiodi / 2)
+ *      - autotune_ku_base/cielo, autotune_pu_base/cielo, autotune_converged:
+ *        Ku, Pu e se ha chiuso la convergenza
+ *      - Applica gli stessi valori a Base e Cielo (per zona: i suoi)
+ *      - AppState autotune_kp_base…/autotune_kp_cielo…: risultato di ogni
+ *        zona, autotune_per_zone = due relay test distinti; MQTT li
+ *        pubblica su forno/<id>/autotune/status (retained) a fine taratura
  *      - Salva su NVS
  *      - Torna al PID normale
  *   4. STOP   → interrompe, ripristina parametri precedenti
  *
+ * TARATURA A FASCE (autotune_start_schedule):
+ *   Le dispersioni crescono più che linearmente con T (irraggiamento):
+ *   una taratura per ogni AUTOTUNE_SCHED_TEMPS, dal basso. Per ogni
+ *   fascia Base e Cielo a piena potenza (split ignorata) fino a T, poi
+ *   relay test centrato su T; il punto (T, Kp, Ki, Kd) va in gains_base/gains_cielo
+ *   (gain_sched.h), che il PID interpola sul PV. Le fasce a meno di
+ *   AUTOTUNE_SETPOINT_OFFSET sopra la temperatura di partenza si saltano (raffreddare costa troppo); se a
+ *   piena potenza la salita si ferma (AUTOTUNE_SCHED_STALL_S senza
+ *   +0.5°C) la fascia è fuori portata e la taratura chiude con le
+ *   precedenti. Kp/Ki/Kd piatti = tabella al setpoint corrente.
+ *   Una taratura singola con tabella già presente aggiorna la sua fascia.
+ *
+ * TARATURA A GRADINO (autotune_start_step):
+ *   Nessuna oscillazione: il preriscaldo da freddo al setpoint Cielo è
+ *   già un gradino di potenza. Base e Cielo a piena potenza (split
+ *   ignorata) fino a SP - PREHEAT_MARGIN_DEG; la rampa dà il primo
+ *   ordine con ritardo (FOPDT) di preheat.h:
+ *     K = (T∞ - T_amb) / 100  [°C per % di uscita]   τ   θ
+ *   A θ si somma mezza finestra relay (mezzo periodo PWM per un SSR):
+ *   l'uscita del PID arriva in media così in ritardo. Regole SIMC
+ *   (Skogestad) con τc = max(θ, AUTOTUNE_STEP_TC_MIN·τ):
+ *     Kp = τ / (K·(τc + θ))   Ti = min(τ, 4·(τc + θ))   Ki = Kp/Ti   Kd = 0
+ *   Un ciclo al duty di regime stimato, poi il PID riparte da lì: la
+ *   taratura non costa tempo di forno oltre al preriscaldo. Serve una
+ *   salita di almeno AUTOTUNE_STEP_MIN_RISE.
+ *
+ * TARATURA PASSIVA (autotune_offer_preheat):
+ *   Il preriscaldo normale di Task_PID (preheat.h) fa già lo stesso
+ *   fit FOPDT per zona. All'hand-off, se la salita è di almeno
+ *   AUTOTUNE_STEP_MIN_RISE, le stesse regole SIMC danno i guadagni della
+ *   zona, con la finestra di quella zona. Non si applicano da soli:
+ *   autotune_status = OFFERED e autotune_kp_base…/autotune_kp_cielo…
+ *   li mostrano (UI, MQTT); le zone senza rampa restano sui guadagni in
+ *   uso. autotune_accept_offer() (ACCEPT su forno/<id>/autotune/cmd,
+ *   ARRESTO lungo in UI, autotune accept negli scenari) li applica e li
+ *   salva come una taratura finita. Un autotune avviato scarta l'offerta.
+ *
+ *   Guadagni sempre limitati a NVS_KP_MAX/NVS_KI_MAX/NVS_KD_MAX
+ *   (nvs_storage.h): sono quelli che il PID usa subito e dopo un riavvio.
+ *
  * OUTPUT STEP:
  *   La libreria usa un output step (relay bang-bang) per misurare
  *   le oscillazioni. L'output è mappato su potenza relay 0-100%.
  *   AUTOTUNE_OUTPUT_STEP = ampiezza oscillazione relay (default 50%)
  *   AUTOTUNE_NOISE_BAND  = banda morta temperatura (default 2°C)
- *   AUTOTUNE_LOOKBACK    = secondi di storia (default 20s)
+ *   AUTOTUNE_LOOKBACK    = secondi di storia (default 20s): i picchi si
+ *     riconoscono con deque min/max in O(1), quindi un forno lento può
+ *     allungarlo senza costo fino a ATUNE_LOOKBACK_MAX/4 s (60 s)
  * ================================================================
  */
 
 #pragma once
-#include "ui.h"
+#include <PID_AutoTune_v0.h>   // ATUNE_MAX_PEAKS
+#include "app_state.h"
+#include "relay_sched.h"       // RelayZone
+
+class Preheat;
 
 // ================================================================
 //  PARAMETRI AUTOTUNE — modificabili
@@ -39,16 +108,31 @@
 #define AUTOTUNE_OUTPUT_STEP   50.0   // % ampiezza step relay (0-100)
 #define AUTOTUNE_NOISE_BAND    2.0    // °C banda morta
 #define AUTOTUNE_LOOKBACK_S    20     // secondi lookback
+#define AUTOTUNE_CONVERGE_TOL  0.05f  // scarto relativo Ku/Pu dei cicli disgiunti per chiudere (0 = off)
 #define AUTOTUNE_SETPOINT_OFFSET  10.0  // parte 10°C sotto il setpoint corrente
+#define AUTOTUNE_SCHED_TEMPS   { 200.0f, 300.0f, 400.0f }   // fasce, crescenti (≤ GAIN_SCHED_POINTS)
+#define AUTOTUNE_SCHED_STALL_S 120    // s senza +0.5°C a piena potenza: fascia fuori portata
+#define AUTOTUNE_DUAL_ZONES    1      // DUAL con due sonde: relay test e guadagni per zona (0 = PV medio)
+#define AUTOTUNE_STEP_MIN_RISE 60.0f  // °C di salita minima per la taratura a gradino
+#define AUTOTUNE_STEP_TC_MIN   0.1f   // τc SIMC almeno questa frazione di τ (θ ≈ 0 con un SSR)
 
 // ================================================================
 //  API
 // ================================================================
 void autotune_start();   // avvia — chiamato da Task_PID o callback MQTT
+void autotune_start_schedule();   // una taratura per fascia AUTOTUNE_SCHED_TEMPS
+void autotune_start_step();       // FOPDT dal preriscaldo al setpoint Cielo, regole SIMC
 void autotune_stop();    // interrompe
+/** Task_PID, hand-off del preriscaldo di una zona: guadagni SIMC dalla rampa, offerti (OFFERED) */
+void autotune_offer_preheat(RelayZone z, const Preheat& ph, float sp);
+/** Applica e salva l'offerta del preriscaldo; false se non ce n'è una */
+bool autotune_accept_offer();
 /** Split % Base da parzializzazione (clamp 5–95); chiamare prima di autotune_start se serve override manuale */
 void autotune_apply_default_split(void);
-void autotune_run(float temp_pv, uint32_t now_ms);  // PV = Cielo (SINGLE) o media (DUAL)
+/** PV = Cielo (SINGLE) o media (DUAL); t_base/t_cielo sonde di zona, NAN se in errore */
+void autotune_run(float temp_pv, float t_base, float t_cielo, uint32_t now_ms);
 bool autotune_is_running();
+/** false = nessuna chiusura anticipata, fino a ATUNE_MAX_PEAKS (scenari: riferimento per la convergenza); dal prossimo avvio */
+void autotune_set_early_stop(bool on);
 /** Task_PID: se true, non sovrascrivere g_state.relay con l'uscita PID (appena finito autotune nello stesso tick) */
 bool autotune_consume_just_completed(void);
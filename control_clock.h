@@ -0,0 +1,29 @@
+/**
+ * control_clock.h — Forno Pizza S3 — Sorgente di tempo del controllo
+ * ================================================================
+ * Unica sorgente di tempo per Task_PID, PIDController, autotune
+ * (PID_ATune) e rilevatori runaway. Il watchdog e la UI restano su
+ * millis() reale: sorvegliano il task, non il processo termico.
+ *
+ *   SIM_VIRTUAL_CLOCK=0 → clock_ms() == millis()
+ *   SIM_VIRTUAL_CLOCK=1 → tempo virtuale a tick discreti: avanza solo
+ *                         con clock_advance(), chiamato da Task_PID
+ *                         (o dal runner host) dopo ogni control_step().
+ *                         Il gating sample-time di PID/autotune resta
+ *                         coerente a qualunque velocità di esecuzione.
+ * ================================================================
+ */
+#pragma once
+#include <Arduino.h>
+#include <stdint.h>
+#include "debug_config.h"
+
+#if SIM_VIRTUAL_CLOCK
+extern volatile uint32_t g_clock_virtual_ms;
+
+inline uint32_t clock_ms()              { return g_clock_virtual_ms; }
+inline void     clock_advance(uint32_t ms) { g_clock_virtual_ms += ms; }
+#else
+inline uint32_t clock_ms()              { return (uint32_t)millis(); }
+inline void     clock_advance(uint32_t) {}
+#endif
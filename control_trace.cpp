@@ -0,0 +1,123 @@
+/**
+ * control_trace.cpp — Forno Pizza S3 — Trace binaria di Task_PID
+ * ================================================================
+ * Gli ingressi si catturano subito dopo la lettura sensori (prima che
+ * un emergency_shutdown tocchi enable e relay), le decisioni a fine
+ * control_step(). I cicli in shutdown non leggono i sensori e non
+ * producono record.
+ * ================================================================
+ */
+#include <Arduino.h>
+#include <string.h>
+
+#include "debug_config.h"
+#include "app_state.h"
+#include "pid_ctrl.h"
+#include "control_trace.h"
+
+#if FEATURE_TRACE
+
+#if FEATURE_AUTOTUNE
+  #include "autotune.h"
+#endif
+#if SIMULATOR_MODE
+  extern uint32_t g_runaway_down_ms_override;
+#endif
+
+// Device: log seriale. Host: muta finché un runner non installa un sink.
+#if defined(HOST_BUILD)
+static TraceSink s_sink = nullptr;
+#else
+static TraceSink s_sink = trace_sink_serial;
+#endif
+static void*     s_ctx  = nullptr;
+
+static TraceTick s_tick    = {};
+static bool      s_pending = false;
+static uint8_t   s_seq     = 0;
+
+void control_trace_set_sink(TraceSink sink, void* ctx) {
+  s_sink = sink;
+  s_ctx  = ctx;
+}
+
+void trace_sink_serial(const uint8_t* rec, size_t len, void* ctx) {
+  static const char hex[] = "0123456789abcdef";
+  char line[8 + 2 * sizeof(TraceConfig) + 1];
+  memcpy(line, "[TRC] ", 6);
+  size_t n = 6;
+  for (size_t i = 0; i < len && n + 2 < sizeof(line); i++) {
+    line[n++] = hex[rec[i] >> 4];
+    line[n++] = hex[rec[i] & 0x0F];
+  }
+  line[n] = '\0';
+  Serial.println(line);
+}
+
+void control_trace_begin(uint32_t now, uint32_t window_ms) {
+  s_pending = false;
+  s_seq     = 0;
+  if (!s_sink) return;
+
+  TraceConfig c = {};
+  c.kind      = TRACE_KIND_CONFIG;
+  c.version   = TRACE_VERSION;
+  c.sample_ms = PID_SAMPLE_MS;
+  c.window_ms = window_ms;
+  c.now_ms    = now;
+  c.rwd_ms    = RUNAWAY_DOWN_MS;
+  c.gains[0]  = (float)g_state.kp_base;
+  c.gains[1]  = (float)g_state.ki_base;
+  c.gains[2]  = (float)g_state.kd_base;
+  c.gains[3]  = (float)g_state.kp_cielo;
+  c.gains[4]  = (float)g_state.ki_cielo;
+  c.gains[5]  = (float)g_state.kd_cielo;
+  s_sink((const uint8_t*)&c, sizeof(c), s_ctx);
+}
+
+void control_trace_inputs(float raw_base, float raw_cielo) {
+  if (!s_sink) return;
+  uint8_t f = 0;
+  if (g_state.base_enabled)                    f |= TRC_F_EN_BASE;
+  if (g_state.cielo_enabled)                   f |= TRC_F_EN_CIELO;
+  if (g_state.sensor_mode == SensorMode::DUAL) f |= TRC_F_DUAL;
+#if FEATURE_AUTOTUNE
+  if (autotune_is_running())                   f |= TRC_F_AUTOTUNE;
+#endif
+
+  s_tick.kind        = TRACE_KIND_TICK;
+  s_tick.flags       = f;
+  s_tick.raw_base    = raw_base;
+  s_tick.raw_cielo   = raw_cielo;
+  s_tick.set_base_q  = trace_q_set(g_state.set_base);
+  s_tick.set_cielo_q = trace_q_set(g_state.set_cielo);
+  s_tick.pct_base    = (uint8_t)g_state.pct_base;
+  s_tick.pct_cielo   = (uint8_t)g_state.pct_cielo;
+  s_tick.at_split    = (uint8_t)g_state.autotune_split;
+  s_tick.rwd_ms      = RUNAWAY_DOWN_MS;
+#if SIMULATOR_MODE
+  if (g_runaway_down_ms_override != 0) s_tick.rwd_ms = g_runaway_down_ms_override;
+#endif
+  s_pending = true;
+}
+
+void control_trace_reset() {
+  if (s_pending) s_tick.flags |= TRC_F_RESET;
+}
+
+void control_trace_commit(uint32_t now) {
+  if (!s_pending || !s_sink) return;
+  s_pending = false;
+
+  if (g_state.relay_base)  s_tick.flags |= TRC_F_RELAY_BASE;
+  if (g_state.relay_cielo) s_tick.flags |= TRC_F_RELAY_CIELO;
+  if (g_emergency_shutdown) s_tick.flags |= TRC_F_SHUTDOWN;
+  s_tick.seq         = s_seq++;
+  s_tick.reason      = (uint8_t)g_state.safety_reason;
+  s_tick.now_ms      = now;
+  s_tick.out_base_q  = trace_q_out(g_state.pid_out_base);
+  s_tick.out_cielo_q = trace_q_out(g_state.pid_out_cielo);
+  s_sink((const uint8_t*)&s_tick, sizeof(s_tick), s_ctx);
+}
+
+#endif // FEATURE_TRACE
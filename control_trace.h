@@ -0,0 +1,88 @@
+/**
+ * control_trace.h — Forno Pizza S3 — Trace binaria di Task_PID
+ * ================================================================
+ * Con FEATURE_TRACE=1 ogni control_step() che legge i sensori emette un
+ * record TraceTick: letture grezze, setpoint, enable, split, uscite PID,
+ * decisioni relay e ragione di shutdown. control_loop_begin() emette un
+ * TraceConfig (guadagni come salvati in NVS, tempi del ciclo).
+ *
+ * I record vanno a un sink:
+ *   device → trace_sink_serial: una riga "[TRC] <hex>" per record,
+ *            mescolabile al log seriale (cattura con un terminale)
+ *   host   → nessuno di default; forno_host --trace FILE scrive binario
+ *
+ * host/trace_replay rilegge la trace (binaria o log seriale), ripassa
+ * gli ingressi nel core di controllo compilato e confronta le decisioni.
+ *
+ * Formato little-endian, record a lunghezza fissa per tipo (kind).
+ * Setpoint in 0.25 °C: i valori da UI/NVS sono interi.
+ * ================================================================
+ */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "debug_config.h"
+
+#define TRACE_VERSION      1
+#define TRACE_FILE_MAGIC   "FTRC"    // intestazione file binario (host)
+
+#define TRACE_KIND_CONFIG  'C'
+#define TRACE_KIND_TICK    'T'
+
+// TraceTick::flags
+#define TRC_F_EN_BASE      0x01
+#define TRC_F_EN_CIELO     0x02
+#define TRC_F_DUAL         0x04
+#define TRC_F_RELAY_BASE   0x08   // decisione a fine ciclo (g_state.relay_base)
+#define TRC_F_RELAY_CIELO  0x10
+#define TRC_F_AUTOTUNE     0x20   // autotune in corso a inizio ciclo
+#define TRC_F_SHUTDOWN     0x40   // g_emergency_shutdown a fine ciclo
+#define TRC_F_RESET        0x80   // stato runaway azzerato nel ciclo (reset simulatore)
+
+struct __attribute__((packed)) TraceConfig {
+  uint8_t  kind;          // TRACE_KIND_CONFIG
+  uint8_t  version;
+  uint16_t sample_ms;     // PID_SAMPLE_MS
+  uint32_t window_ms;     // RELAY_WINDOW_MS
+  uint32_t now_ms;
+  uint32_t rwd_ms;        // RUNAWAY_DOWN_MS del firmware che ha registrato
+  float    gains[6];      // Kp/Ki/Kd base, Kp/Ki/Kd cielo
+};
+
+struct __attribute__((packed)) TraceTick {
+  uint8_t  kind;          // TRACE_KIND_TICK
+  uint8_t  seq;           // contatore a 8 bit: righe perse nel log seriale
+  uint8_t  flags;         // TRC_F_*
+  uint8_t  reason;        // SafetyReason a fine ciclo
+  uint32_t now_ms;
+  float    raw_base;      // readCelsius() grezzo (NAN incluso)
+  float    raw_cielo;
+  int16_t  set_base_q;    // setpoint ×4
+  int16_t  set_cielo_q;
+  uint8_t  pct_base;
+  uint8_t  pct_cielo;
+  uint8_t  at_split;      // g_state.autotune_split (replay di autotune_start)
+  uint8_t  reserved;
+  uint16_t out_base_q;    // pid_out ×100
+  uint16_t out_cielo_q;
+  uint32_t rwd_ms;        // finestra RUNAWAY_DOWN in vigore (override scenari)
+};
+
+static_assert(sizeof(TraceConfig) == 40, "TraceConfig: layout fisso");
+static_assert(sizeof(TraceTick)   == 32, "TraceTick: layout fisso");
+
+inline int16_t  trace_q_set(double sp)  { return (int16_t)(sp * 4.0 + (sp >= 0 ? 0.5 : -0.5)); }
+inline uint16_t trace_q_out(double out) { return (uint16_t)(out * 100.0 + 0.5); }
+
+/** Riceve un record completo (TraceConfig o TraceTick). */
+typedef void (*TraceSink)(const uint8_t* rec, size_t len, void* ctx);
+
+/** nullptr disattiva la trace. */
+void control_trace_set_sink(TraceSink sink, void* ctx);
+void trace_sink_serial(const uint8_t* rec, size_t len, void* ctx);
+
+// ── Punti di aggancio in forno_control.cpp ──
+void control_trace_begin(uint32_t now, uint32_t window_ms);
+void control_trace_inputs(float raw_base, float raw_cielo);
+void control_trace_reset();
+void control_trace_commit(uint32_t now);
@@ -20,7 +20,16 @@
 // ================================================================
 //  SIMULATORE HARDWARE
 // ================================================================
+#ifndef SIMULATOR_MODE
 #define SIMULATOR_MODE        1   // 1=simulatore, 0=hardware reale
+#endif
+
+// Tempo virtuale a tick discreti (vedi control_clock.h). Con 1 Task_PID
+// non attende PID_SAMPLE_MS reali: ogni tick RTOS avanza il clock di un
+// ciclo PID. La build host lo forza a 1 (host/Makefile).
+#ifndef SIM_VIRTUAL_CLOCK
+#define SIM_VIRTUAL_CLOCK     0
+#endif
 
 // ================================================================
 //  TASK ENABLE
@@ -37,6 +46,54 @@
 #define FEATURE_SAFETY        1
 #define FEATURE_AUTOTUNE      1
 #define FEATURE_OTA           0
+// Trace binaria di Task_PID (control_trace.h): righe [TRC] sul seriale,
+// ~150 byte/s. La build host la forza a 1 per forno_host --trace e
+// trace_replay.
+#ifndef FEATURE_TRACE
+#define FEATURE_TRACE         0
+#endif
+// Stima online del modello termico (plant_id.h): riga [PLANT] ogni
+// PLANT_ID_LOG_MS con k, C, T_amb e ritardo, da copiare in un file
+// SIM_PLANT_FILE. ~2 KB di RAM, 15 sistemi 4×4 per riga.
+#ifndef FEATURE_PLANT_ID
+#define FEATURE_PLANT_ID      0
+#endif
+#define PLANT_ID_LOG_MS     600000
+// Preriscaldo a piena potenza con hand-off al PID (preheat.h): pubblica
+// preheat_* e il tempo stimato al pronto. 0 = il PID parte da freddo
+#ifndef FEATURE_PREHEAT
+#define FEATURE_PREHEAT       1
+#endif
+// Feedforward dal modello di perdita (feedforward.h): uscita PID =
+// k·(SP - T_amb)/P + correzione, k imparato a regime e salvato in NVS.
+// 0 = PID puro
+#ifndef FEATURE_FEEDFORWARD
+#define FEATURE_FEEDFORWARD   1
+#endif
+// Controllo predittivo (mpc_ctrl.h) al posto di PID e preriscaldo: a
+// ogni finestra relay l'uscita che minimizza errore previsto, sbalzi e
+// energia con tempi minimi relay e budget di potenza nel modello. I PID
+// restano per l'autotune e ne seguono l'uscita. 0 = PID
+#ifndef FEATURE_MPC
+#define FEATURE_MPC           0
+#endif
+// Disaccoppiamento Base/Cielo (zone_coupling.h): in DUAL la matrice di
+// accoppiamento stimata dai dati fa il feedforward di ciascuna zona col
+// setpoint proprio e la temperatura dell'altra. Solo DUAL: in SINGLE
+// Task_PID resta quello di FEATURE_DECOUPLE 0. Richiede FEATURE_FEEDFORWARD
+#ifndef FEATURE_DECOUPLE
+#define FEATURE_DECOUPLE      1
+#endif
+#if FEATURE_DECOUPLE && !FEATURE_FEEDFORWARD
+#error "FEATURE_DECOUPLE richiede FEATURE_FEEDFORWARD"
+#endif
+// Finestra relay adattiva (relay_window.h): corta vicino al setpoint
+// (meno ripple), lunga nelle rampe, entro il budget di usura dei
+// contattori. 0 = RELAY_WINDOW_MS fissa, su cui sono tarati i guadagni
+// di default. Le chiusure per relay vanno in NVS in entrambi i casi
+#ifndef FEATURE_RELAY_WINDOW
+#define FEATURE_RELAY_WINDOW  0
+#endif
 
 // ================================================================
 //  LOG SERIALE
@@ -79,3 +136,6 @@
 #if SIMULATOR_MODE && !TASK_PID_ENABLE
   #warning "SIMULATOR_MODE=1 richiede TASK_PID_ENABLE=1"
 #endif
+#if SIM_VIRTUAL_CLOCK && !SIMULATOR_MODE
+  #error "SIM_VIRTUAL_CLOCK=1 richiede SIMULATOR_MODE=1 (il clock reale serve all'hardware)"
+#endif
@@ -0,0 +1,120 @@
+/**
+ * feedforward.h — Forno Pizza S3 — Feedforward dal modello di perdita
+ * ================================================================
+ * A regime il forno disperde k·(T - T_amb) (nodo singolo, come
+ * SIM_K_LOSS e plant_id.h): il duty che tiene il setpoint è noto prima
+ * che l'integrale lo trovi,
+ *
+ *   duty_ff = k·(SP - T_amb) / (P_base + P_cielo)
+ *
+ * uguale per le due zone, ciascuna sul proprio setpoint. Task_PID lo
+ * passa a PIDControllerT::setFeedforward(): l'uscita è ff + PID e
+ * guadagni e integrale lavorano solo sullo scarto dal modello. A un
+ * cambio di setpoint (ricette, MQTT set/base) l'uscita si sposta subito
+ * sul duty del nuovo setpoint.
+ *
+ * Un solo k [W/°C] per il forno, 0 = nessun modello (PID puro): con la
+ * sonda unica (SINGLE) la quota di perdita di Base e Cielo non si
+ * distingue, e due stime per zona si scambierebbero la perdita.
+ *   - dal preriscaldo (preheat.h), se non c'è ancora: a piena potenza
+ *     il forno tende a T∞, quindi k = P / (T∞ - T_amb)
+ *   - a regime: setpoint fermi, entrambe le zone in AUTOMATIC, PV entro
+ *     FF_LEARN_BAND_DEG per FF_LEARN_MS. Potenza relay media ū e PV
+ *     medio T̄ danno k_mis = ū·P / (T̄ - T_amb); k si muove di
+ *     FF_LEARN_GAIN verso k_mis
+ * seed()/learn() ritornano true quando k cambia; takeSave() dice se si
+ * è spostato di FF_SAVE_FRAC dall'ultimo salvataggio (ff_k in
+ * nvs_storage.h), così la flash non si scrive a ogni finestra.
+ *
+ * Header-only, nessuna allocazione: una istanza in Task_PID.
+ * ================================================================
+ */
+#pragma once
+#include <math.h>
+#include <stdint.h>
+
+#define FF_T_AMB_C          25.0f
+#define FF_LEARN_MS         120000UL   // finestra di regime (4 finestre relay)
+#define FF_LEARN_BAND_DEG   20.0f      // scostamento max dal setpoint (ripple della finestra relay)
+#define FF_LEARN_GAIN       0.5f
+#define FF_SAVE_FRAC        0.05f
+#define FF_K_MAX            100.0f     // [W/°C] oltre: stima scartata
+
+class LossFeedforward {
+public:
+  void begin(float power_w, float k_w_per_c) {
+    _power_w = power_w;
+    _k       = _valid(k_w_per_c) ? k_w_per_c : 0.0f;
+    _k_saved = _k;
+    reset();
+  }
+
+  float k() const { return _k; }
+
+  /** Duty [% della potenza] che tiene sp a regime; 0 senza modello. */
+  float dutyPct(float sp) const {
+    if (_k <= 0.0f || _power_w <= 0.0f || sp <= FF_T_AMB_C) return 0.0f;
+    float d = _k * (sp - FF_T_AMB_C) / _power_w * 100.0f;
+    return d > 100.0f ? 100.0f : d;
+  }
+
+  /** T∞ a piena potenza dal modello del preriscaldo: vale solo se k non c'è ancora. */
+  bool seed(float t_inf) {
+    if (_k > 0.0f || !(t_inf > FF_T_AMB_C + 1.0f)) return false;
+    float k = _power_w / (t_inf - FF_T_AMB_C);
+    if (!_valid(k)) return false;
+    _k = k;
+    return true;
+  }
+
+  /** Finestra di regime interrotta: zona spenta, preriscaldo, autotune, sonda in errore. */
+  void reset() { _n = 0; }
+
+  /**
+   * Un ciclo in AUTOMATIC. duty_pct = potenza relay applicata nel ciclo
+   * [% di P]. Ritorna true se k è cambiato.
+   */
+  bool learn(float temp, float sp, float duty_pct, uint32_t now) {
+    if (isnan(temp) || fabsf(temp - sp) > FF_LEARN_BAND_DEG || (_n && sp != _sp)) {
+      reset();
+      return false;
+    }
+    if (_n == 0) {
+      _sp       = sp;
+      _start_ms = now;
+      _sum_t    = _sum_u = 0.0;
+    }
+    _n++;
+    _sum_t += temp;
+    _sum_u += duty_pct;
+    if (now - _start_ms < FF_LEARN_MS) return false;
+
+    float t_avg = (float)(_sum_t / _n);
+    float u_avg = (float)(_sum_u / _n) / 100.0f;
+    reset();
+    if (t_avg <= FF_T_AMB_C + 1.0f) return false;
+    float k_mis = u_avg * _power_w / (t_avg - FF_T_AMB_C);
+    if (!_valid(k_mis)) return false;
+    _k = _k > 0.0f ? _k + FF_LEARN_GAIN * (k_mis - _k) : k_mis;
+    return true;
+  }
+
+  /** true (una volta) se k va salvato in NVS. */
+  bool takeSave() {
+    if (_k_saved > 0.0f && fabsf(_k - _k_saved) < FF_SAVE_FRAC * _k_saved) return false;
+    if (_k == _k_saved) return false;
+    _k_saved = _k;
+    return true;
+  }
+
+private:
+  float    _power_w  = 0.0f;
+  float    _k        = 0.0f;
+  float    _k_saved  = 0.0f;
+  float    _sp       = 0.0f;
+  uint32_t _start_ms = 0;
+  uint32_t _n        = 0;
+  double   _sum_t    = 0, _sum_u = 0;
+
+  static bool _valid(float k) { return k > 0.0f && k <= FF_K_MAX; }
+};
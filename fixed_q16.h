@@ -0,0 +1,64 @@
+/**
+ * fixed_q16.h — Forno Pizza S3 — Virgola fissa Q16.16
+ * ================================================================
+ * Tipo numerico per PIDCoreT<Q16> (pid_core.h): 16 bit interi con
+ * segno, 16 frazionari → ±32767, risoluzione 1.5e-5. Basta per
+ * temperature (≤ 500 °C), uscite 0-100 e guadagni scalati sul sample
+ * time (ki·dt ≥ 1e-3 con le tarature del forno).
+ *
+ * Somme e prodotti saturano invece di andare in overflow; prodotto e
+ * divisione passano per un intermedio a 64 bit e arrotondano. NaN
+ * (sonda in errore) diventa 0: i relay li spegne tc_*_err. Le
+ * conversioni da double/float servono solo fuori dal ciclo (guadagni,
+ * limiti): il calcolo di compute() è tutto intero.
+ * ================================================================
+ */
+#pragma once
+#include <stdint.h>
+
+struct Q16 {
+  int32_t v;
+
+  static constexpr int32_t ONE = 1 << 16;
+
+  constexpr Q16() : v(0) {}
+  constexpr Q16(int i) : v(_sat((int64_t)i * ONE)) {}
+  constexpr Q16(double d) : v(d != d ? 0 : _sat(_round(d * ONE))) {}   // NaN → 0
+  constexpr Q16(float f) : Q16((double)f) {}
+
+  static constexpr Q16 raw(int32_t r) { Q16 q; q.v = r; return q; }
+
+  explicit constexpr operator double() const { return (double)v / ONE; }
+  explicit constexpr operator float()  const { return (float)v / ONE; }
+
+  friend constexpr Q16 operator+(Q16 a, Q16 b) { return raw(_sat((int64_t)a.v + b.v)); }
+  friend constexpr Q16 operator-(Q16 a, Q16 b) { return raw(_sat((int64_t)a.v - b.v)); }
+  friend constexpr Q16 operator-(Q16 a)        { return raw(_sat(-(int64_t)a.v)); }
+  friend constexpr Q16 operator*(Q16 a, Q16 b) {
+    return raw(_sat(((int64_t)a.v * b.v + (ONE >> 1)) >> 16));
+  }
+  friend constexpr Q16 operator/(Q16 a, Q16 b) {
+    if (b.v == 0) return raw(a.v >= 0 ? INT32_MAX : INT32_MIN);
+    int64_t n = (int64_t)a.v * ONE;
+    int64_t h = (b.v > 0 ? b.v : -(int64_t)b.v) / 2;
+    return raw(_sat(((n >= 0) == (b.v > 0) ? n + h : n - h) / b.v));
+  }
+  Q16& operator+=(Q16 b) { return *this = *this + b; }
+  Q16& operator-=(Q16 b) { return *this = *this - b; }
+  Q16& operator*=(Q16 b) { return *this = *this * b; }
+
+  friend constexpr bool operator< (Q16 a, Q16 b) { return a.v <  b.v; }
+  friend constexpr bool operator> (Q16 a, Q16 b) { return a.v >  b.v; }
+  friend constexpr bool operator<=(Q16 a, Q16 b) { return a.v <= b.v; }
+  friend constexpr bool operator>=(Q16 a, Q16 b) { return a.v >= b.v; }
+  friend constexpr bool operator==(Q16 a, Q16 b) { return a.v == b.v; }
+  friend constexpr bool operator!=(Q16 a, Q16 b) { return a.v != b.v; }
+
+private:
+  static constexpr int64_t _round(double x) {
+    return x >= 9.2e18 ? INT64_MAX : (x <= -9.2e18 ? INT64_MIN : (int64_t)(x + (x >= 0 ? 0.5 : -0.5)));
+  }
+  static constexpr int32_t _sat(int64_t x) {
+    return x > INT32_MAX ? INT32_MAX : (x < INT32_MIN ? INT32_MIN : (int32_t)x);
+  }
+};
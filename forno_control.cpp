@@ -0,0 +1,1265 @@
+/**
+ * forno_control.cpp — Forno Pizza S3 — Core di controllo
+ * ================================================================
+ * Spostato da FornoPizza_S3.ino senza modifiche di comportamento:
+ *   [FIX-1] PID in AUTOMATIC quando base/cielo_enabled=true
+ *   [FIX-2] campionamento grafico ogni GRAPH_SAMPLE_S
+ *   [SIM-A] mock MAX6675 + relay no-op
+ *   [SIM-C] simulator_notify_shutdown() in emergency_shutdown()
+ *   [SIM-D] simulator_init() in control_init()
+ *   [SIM-E] forza SensorMode::SINGLE + setpoint di test
+ *   [SIM-F] simulator_tick() + simulator_set_relay() nel ciclo PID
+ *   [SIM-G] simulator_test_tick() nel ciclo PID
+ *   [TRC]   trace ingressi/decisioni per replay (FEATURE_TRACE)
+ *   [PLANT] stima online del modello termico (FEATURE_PLANT_ID)
+ *   [FF]    feedforward dal modello di perdita (FEATURE_FEEDFORWARD)
+ *   [MPC]   controllo predittivo al posto del PID (FEATURE_MPC)
+ *   [DEC]   disaccoppiamento Base/Cielo (FEATURE_DECOUPLE)
+ *   [RELAY] finestra relay adattiva e usura (FEATURE_RELAY_WINDOW)
+ *   [SSR]   PWM a semionde per le zone a relè statico (ssr_pwm.h)
+ *
+ * Il corpo del vecchio for(;;) di Task_PID è ora control_step():
+ * Task_PID lo richiama in loop, la build host lo richiama a tempo
+ * virtuale (host/forno_host.cpp).
+ * ================================================================
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#include "debug_config.h"
+#include "hardware.h"
+#include "app_state.h"
+#include "pid_ctrl.h"
+#include "relay_sched.h"
+#include "ssr_pwm.h"
+#include "nvs_storage.h"
+#include "control_clock.h"
+#include "forno_control.h"
+
+// ── [SIM-A]: mock hardware quando SIMULATOR_MODE=1 ──────────────
+// (dopo hardware.h, altrimenti le sue RELAY_* sovrascrivono le no-op)
+#if SIMULATOR_MODE
+  #include "simulator.h"
+  extern uint32_t g_runaway_down_ms_override;
+  #define MAX6675 SimulatedMAX6675
+  #undef  RELAY_WRITE
+  #define RELAY_WRITE(pin, inv, state)  /* no-op simulator */
+#else
+  #include <max6675.h>
+  #include <esp_timer.h>
+#endif
+
+#if FEATURE_AUTOTUNE
+  #include "autotune.h"
+#endif
+
+#if FEATURE_TRACE
+  #include "control_trace.h"
+#endif
+
+#if FEATURE_PLANT_ID
+  #include "plant_id.h"
+#endif
+
+#if FEATURE_PREHEAT
+  #include "preheat.h"
+#endif
+
+#if FEATURE_FEEDFORWARD
+  #include "feedforward.h"
+#endif
+
+#if FEATURE_DECOUPLE
+  #include "zone_coupling.h"
+#endif
+#if FEATURE_MPC
+  #include "mpc_ctrl.h"
+#endif
+#if FEATURE_RELAY_WINDOW
+  #include "relay_window.h"
+#endif
+
+// ================================================================
+//  OGGETTI HARDWARE — puntatori (FIX: no costruttori globali)
+// ================================================================
+static MAX6675*       tc_base  = nullptr;
+static MAX6675*       tc_cielo = nullptr;
+static NVSStorage*    nvs      = nullptr;
+static PIDController* pid_base  = nullptr;
+static PIDController* pid_cielo = nullptr;
+
+// ================================================================
+//  SINCRONIZZAZIONE
+// ================================================================
+SemaphoreHandle_t    g_mutex              = nullptr;
+volatile uint32_t    g_pid_heartbeat      = 0;
+volatile bool        g_emergency_shutdown = false;
+#if SIM_VIRTUAL_CLOCK
+volatile uint32_t    g_clock_virtual_ms   = 0;
+#endif
+
+// ================================================================
+//  STATO APPLICAZIONE (SRAM interna — accesso real-time)
+// ================================================================
+AppState    g_state = {};
+
+// Finestre, clamp duty e commutazioni dei relay Base/Cielo (relay_sched.h)
+RelayScheduler g_relays;
+
+// ================================================================
+//  USCITE BASE/CIELO — [SSR]
+//  Contattore: RELAY_WRITE col ciclo PID. SSR: semionde ON del periodo
+//  a s_ssr, i pin li scrive l'esp_timer a semionda.
+// ================================================================
+static SsrPwm s_ssr;
+static const uint8_t k_heater_pin[RELAY_ZONES] = { RELAY_BASE, RELAY_CIELO };
+static const bool    k_heater_inv[RELAY_ZONES] = { RELAY_BASE_INV, RELAY_CIELO_INV };
+
+void heater_output(bool base_on, bool cielo_on) {
+  const bool on[RELAY_ZONES] = { base_on, cielo_on };
+  for (int i = 0; i < RELAY_ZONES; i++) {
+    RelayZone z = (RelayZone)i;
+    if (g_relays.type(z) == RelayType::SSR) {
+      s_ssr.set(z, on[i] ? (uint32_t)(g_relays.level(z) * (float)SSR_PWM_STEPS + 0.5f) : 0);
+    } else {
+      RELAY_WRITE(k_heater_pin[i], k_heater_inv[i], on[i]);
+    }
+  }
+}
+
+#if !SIMULATOR_MODE
+// Una semionda: pin delle zone SSR; dopo lo shutdown sempre spenti
+static void ssr_pwm_tick(void*) {
+  bool out[RELAY_ZONES];
+  s_ssr.tick(out);
+  for (int i = 0; i < RELAY_ZONES; i++) {
+    if (g_relays.type((RelayZone)i) != RelayType::SSR) continue;
+    RELAY_WRITE(k_heater_pin[i], k_heater_inv[i], out[i] && !g_emergency_shutdown);
+  }
+}
+
+static void ssr_pwm_begin() {
+  static esp_timer_handle_t timer = nullptr;
+  if (timer) return;
+  esp_timer_create_args_t args = {};
+  args.callback = ssr_pwm_tick;
+  args.name     = "ssr_pwm";
+  if (esp_timer_create(&args, &timer) != ESP_OK ||
+      esp_timer_start_periodic(timer, SSR_PWM_TICK_US) != ESP_OK) {
+    LOG_E(LOG_SYSTEM, "[SSR] esp_timer non avviato: zone SSR spente\n");
+    return;
+  }
+  LOG_I(LOG_SYSTEM, "[SSR] PWM %lu ms, %lu semionde (Base %s, Cielo %s)\n",
+        (unsigned long)SSR_PWM_PERIOD_MS, (unsigned long)SSR_PWM_STEPS,
+        RELAY_TYPE_BASE  == RELAY_TYPE_SSR ? "SSR" : "contattore",
+        RELAY_TYPE_CIELO == RELAY_TYPE_SSR ? "SSR" : "contattore");
+}
+#endif
+
+// ================================================================
+//  STATO PERSISTENTE DEL CICLO PID (ex variabili locali di Task_PID)
+// ================================================================
+static uint32_t last_nvs_ms   = 0;
+static uint32_t last_tick_ms  = 0;   // [SIM-F]
+static uint32_t last_graph_ms = 0;   // [FIX-2] campionamento grafico
+
+// [FIX-1]: traccia stato precedente per gestire transizioni ON/OFF
+static bool prev_base_enabled  = false;
+static bool prev_cielo_enabled = false;
+
+// [RELAY] Chiusure dei relay: NVS al boot + RelayScheduler::cycles()
+static uint32_t s_cyc_nvs[RELAY_ZONES];
+static uint32_t s_cyc_save_ms = 0;
+
+#if FEATURE_RELAY_WINDOW
+static RelayWindowPolicy s_rwin;
+
+// [RELAY] Finestra di ciascuna zona dall'errore e dal credito di usura.
+// fixed: MPC (fixed_ms, la finestra è il suo passo) e autotune
+// (RELAY_WINDOW_MS) non la cambiano; il credito si aggiorna comunque
+static void relay_window_tick(uint32_t now, float t_base, float t_cielo, bool fixed,
+                              uint32_t fixed_ms) {
+  const RelayZone zone[RELAY_ZONES] = { RelayZone::BASE, RelayZone::CIELO };
+  const float     err[RELAY_ZONES]  = {
+    g_state.tc_base_err  ? NAN : fabsf(t_base  - (float)g_state.set_base),
+    g_state.tc_cielo_err ? NAN : fabsf(t_cielo - (float)g_state.set_cielo) };
+  for (int i = 0; i < RELAY_ZONES; i++) {
+    uint32_t ms = s_rwin.choose(zone[i], err[i], g_relays.cycles(zone[i]), now);
+    g_relays.setWindowMs(zone[i], fixed ? fixed_ms : ms);
+  }
+}
+#endif
+
+#if FEATURE_FEEDFORWARD
+static LossFeedforward s_ff;
+static bool            s_ff_rebase = false;   // k cambiato: i PID in AUTOMATIC non saltano
+
+#if FEATURE_DECOUPLE
+static CouplingIdentifier s_cid;
+static uint32_t           s_cid_solve_ms = 0;
+static bool               s_dc_on = false;                 // ff dalla matrice di accoppiamento
+static uint8_t            s_dc_rev = 0, s_dc_rev_seen = 0; // matrice sostituita: i PID non saltano
+static float              s_dc_t[RELAY_ZONES];             // temperature filtrate
+static float              s_dc_from[RELAY_ZONES];          // da dove parte la zona verso il setpoint
+static float              s_dc_sp[RELAY_ZONES];            // setpoint correnti
+
+// Filtro delle temperature: costante di tempo un quarto di finestra
+// relay. Smussa il ripple della finestra (che altrimenti passerebbe nel
+// duty dell'altra zona) senza ritardare il gradino: con una finestra
+// intera la correzione arrivava dopo il PID dell'altra zona e, a parità
+// di seed, il Cielo si spostava al gradino della Base quanto senza matrice
+#define DECOUPLE_T_EMA  (4.0f * (float)PID_SAMPLE_MS / (float)RELAY_WINDOW_MS)
+
+// [DEC] Matrice in uso: DUAL, entrambe le zone in mano al PID, sonde
+// buone, zone separabili (rga). Ritorna true se l'uscita va ribasata
+// (attivazione, disattivazione, nuova matrice)
+static bool decouple_update(float t_base, float t_cielo) {
+  bool on = g_state.coupling.valid && g_state.coupling.rga() <= DECOUPLE_RGA_MAX &&
+            g_state.sensor_mode == SensorMode::DUAL &&
+            g_state.base_enabled && g_state.cielo_enabled &&
+            !g_state.tc_base_err && !g_state.tc_cielo_err;
+#if FEATURE_AUTOTUNE
+  on = on && !autotune_is_running();
+#endif
+#if SIMULATOR_MODE
+  on = on && !g_sim.decouple_off;
+  g_sim.decouple_on = on;
+#endif
+  const float t[RELAY_ZONES]  = { t_base, t_cielo };
+  const float sp[RELAY_ZONES] = { (float)g_state.set_base, (float)g_state.set_cielo };
+  for (int i = 0; i < RELAY_ZONES; i++) {
+    if (on && s_dc_on) s_dc_t[i] += DECOUPLE_T_EMA * (t[i] - s_dc_t[i]);
+    else               s_dc_t[i] = s_dc_from[i] = t[i];
+    if (sp[i] != s_dc_sp[i]) s_dc_from[i] = s_dc_t[i];
+    s_dc_sp[i] = sp[i];
+  }
+  bool rebase = on != s_dc_on || (on && s_dc_rev != s_dc_rev_seen);
+  s_dc_on       = on;
+  s_dc_rev_seen = s_dc_rev;
+  return rebase;
+}
+
+// Dove l'altra zona scambia calore: la temperatura misurata finché va
+// verso il setpoint, poi il setpoint. A regime la misura dell'altra zona
+// chiuderebbe un giro (Cielo sale → Base taglia → Base scende → Cielo
+// spinge) di guadagno G²/((k_b+G)(k_c+G)), ≈ 1 con zone molto accoppiate
+static float decouple_ref(int j) {
+  float lo = s_dc_from[j] < s_dc_sp[j] ? s_dc_from[j] : s_dc_sp[j];
+  float hi = s_dc_from[j] < s_dc_sp[j] ? s_dc_sp[j]   : s_dc_from[j];
+  float r  = s_dc_t[j] < lo ? lo : (s_dc_t[j] > hi ? hi : s_dc_t[j]);
+  if (r == s_dc_sp[j]) s_dc_from[j] = s_dc_sp[j];   // arrivata: resta sul setpoint
+  return r;
+}
+
+// Potenza che tiene la zona al setpoint con l'altra dov'è [% della resistenza]
+static float decouple_duty_pct(RelayZone z) {
+  int   i = (int)z;
+  float w = z == RelayZone::BASE ? HEATER_BASE_W : HEATER_CIELO_W;
+  float d = g_state.coupling.powerW(i, s_dc_sp[i], decouple_ref(1 - i)) / w * 100.0f;
+  return d < 0.0f ? 0.0f : (d > 100.0f ? 100.0f : d);
+}
+#endif
+
+// Duty di modello in unità di uscita PID: duty() la riscala per pct_*
+static void ff_apply(RelayZone z, PIDController* pid, bool rebase) {
+  double sp  = z == RelayZone::BASE ? g_state.set_base : g_state.set_cielo;
+  int    pct = z == RelayZone::BASE ? g_state.pct_base : g_state.pct_cielo;
+  float  ff  = s_ff.dutyPct((float)sp);
+#if FEATURE_DECOUPLE
+  if (s_dc_on) ff = decouple_duty_pct(z);
+#endif
+#if SIMULATOR_MODE
+  if (g_sim.ff_off) ff = 0.0f;
+#endif
+  pid->setFeedforward(pct > 0 ? ff * 100.0 / pct : 0.0, rebase);
+}
+#endif
+
+#if FEATURE_AUTOTUNE
+// Duty applicato dall'autotune (pid_out_*) → uscita PID da cui ripartire
+// (duty() la riscala per pct_*). DUAL: ogni zona dal suo duty. SINGLE: una
+// sonda per due PID, la quota Base/Cielo non si osserva: entrambi dalla
+// stessa uscita che dà la stessa potenza con pct_*, così a fine taratura
+// torna il bilanciamento dell'utente e non la split dell'autotune
+static void pid_track_autotune() {
+  double db = g_state.pid_out_base, dc = g_state.pid_out_cielo;
+  int    pb = g_state.pct_base,     pc = g_state.pct_cielo;
+  if (g_state.sensor_mode == SensorMode::DUAL) {
+    pid_base->track(pb > 0 ? db * 100.0 / pb : 0.0);
+    pid_cielo->track(pc > 0 ? dc * 100.0 / pc : 0.0);
+    return;
+  }
+  double w   = HEATER_BASE_W * pb + HEATER_CIELO_W * pc;
+  double out = w > 0 ? (HEATER_BASE_W * db + HEATER_CIELO_W * dc) * 100.0 / w : 0.0;
+  pid_base->track(out);
+  pid_cielo->track(out);
+}
+#endif
+
+#if FEATURE_PREHEAT
+static Preheat s_preheat[RELAY_ZONES];
+static double  s_preheat_sp[RELAY_ZONES];   // setpoint del ciclo precedente
+
+static void preheat_abort_all() {
+  for (Preheat& ph : s_preheat) ph.abort();
+  g_state.preheat_base     = g_state.preheat_cielo     = false;
+  g_state.preheat_eta_base = g_state.preheat_eta_cielo = 0;
+}
+
+// AUTOMATIC dall'uscita di regime stimata: l'integrale prende lo scarto dal
+// ff. Rampa troppo corta per un modello (gradino appena oltre il margine):
+// preloadPct() è ancora quella di un preriscaldo precedente, a un altro
+// setpoint, e il duty del ff al nuovo setpoint è la stima migliore
+static void preheat_handoff(PIDController* pid, const Preheat& ph) {
+  double out = ph.preloadPct();
+#if FEATURE_FEEDFORWARD
+  float t_inf, tau;
+  if (!ph.model(t_inf, tau) && pid->feedforward() > 0) out = pid->feedforward();
+#endif
+  pid->startFrom(out);
+}
+
+// Un ciclo di preriscaldo per zona. Parte all'abilitazione o quando il
+// setpoint sale oltre PREHEAT_MARGIN_DEG sopra la zona; in RAMP il PID
+// resta in MANUAL con uscita 100 %. Sonda in errore o autotune: il PID
+// riprende subito, dall'ultima stima del duty di regime.
+static void preheat_zone(RelayZone z, PIDController* pid, bool enabled, bool started,
+                         float t_raw, double sp, double* out, uint32_t now) {
+  Preheat&    ph    = s_preheat[(int)z];
+  const char* name  = z == RelayZone::BASE ? "BASE" : "CIELO";
+  bool        sp_up = sp > s_preheat_sp[(int)z];
+  s_preheat_sp[(int)z] = sp;
+
+  if (!enabled) { ph.abort(); return; }
+  bool hold = isnan(t_raw) || t_raw <= 0.0f;
+#if FEATURE_AUTOTUNE
+  hold = hold || autotune_is_running();
+#endif
+  if (hold) {
+    if (ph.ramping()) {
+      preheat_handoff(pid, ph);
+      LOG_W(LOG_PID, "[PREHEAT] %s: interrotto, PID da %.0f%%\n", name, *out);
+    }
+    ph.abort();
+    return;
+  }
+
+  if ((started || sp_up) && !ph.ramping() && ph.start(t_raw, (float)sp, now)) {
+    pid->setEnabled(false);
+    LOG_I(LOG_PID, "[PREHEAT] %s: piena potenza da %.0f°C a %.0f°C\n",
+          name, t_raw, sp - PREHEAT_MARGIN_DEG);
+  }
+  if (!ph.active()) return;
+
+  if (ph.ramping()) *out = 100.0;
+  if (ph.step(t_raw, (float)sp, now)) {
+    float t_inf, tau;
+    bool  model = ph.model(t_inf, tau);
+#if FEATURE_FEEDFORWARD
+    // Primo modello del forno dalla rampa; l'hand-off parte dal ff aggiornato
+    if (model && s_ff.seed(t_inf)) {
+      s_ff_rebase = true;
+      LOG_I(LOG_PID, "[FF] k=%.2f W/°C dal preriscaldo %s\n", s_ff.k(), name);
+    }
+    ff_apply(z, pid, false);
+#endif
+    preheat_handoff(pid, ph);
+#if FEATURE_AUTOTUNE
+    // La stessa rampa dà i guadagni SIMC della zona: offerti, non applicati
+    if (model) autotune_offer_preheat(z, ph, (float)sp);
+#endif
+    if (model)
+      LOG_I(LOG_PID, "[PREHEAT] %s: hand-off dopo %lus, PID da %.0f%% (T∞=%.0f°C τ=%.0fs)\n",
+            name, (unsigned long)ph.elapsedS(now), *out, t_inf, tau);
+    else
+      LOG_I(LOG_PID, "[PREHEAT] %s: hand-off dopo %lus, nessun modello, PID da %.0f%%\n",
+            name, (unsigned long)ph.elapsedS(now), *out);
+  } else if (!ph.active()) {
+    LOG_I(LOG_PID, "[PREHEAT] %s: pronto dopo %lus\n", name, (unsigned long)ph.elapsedS(now));
+  }
+}
+#endif
+
+#if FEATURE_MPC
+static MpcController s_mpc;
+static PlantModel    s_mpc_model;       // default, poi plant_id; k dal ff
+static uint8_t       s_mpc_zones = 0;   // zone in mano all'MPC (bit 0 Base, 1 Cielo, 2 DUAL)
+static uint32_t      s_mpc_win_ms = 0;  // finestra relay dell'MPC (windowMs())
+
+// Attuatori, modello e zone comandate. Zone abilitate, fuori autotune:
+// l'MPC parte con una finestra relay nuova e il preriscaldo non serve
+// (a piena potenza finché la previsione non dice di rallentare). In DUAL
+// un'uscita per zona, in SINGLE una sola sulla sonda
+static void mpc_update(uint32_t now) {
+  bool    en_b  = g_state.base_enabled,  en_c = g_state.cielo_enabled;
+  bool    dual  = g_state.sensor_mode == SensorMode::DUAL;
+  uint8_t zones = (en_b ? 1 : 0) | (en_c ? 2 : 0);
+#if FEATURE_AUTOTUNE
+  if (autotune_is_running()) zones = 0;
+#endif
+  if (zones && dual) zones |= 4;
+  PlantModel m = s_mpc_model;
+#if FEATURE_FEEDFORWARD
+  if (s_ff.k() > 0.0f) { m.k_loss = s_ff.k(); m.mass = m.k_loss * m.tau_s; }
+#endif
+#if SIMULATOR_MODE
+  // Modello in tempo del forno, finestre in tempo di controllo
+  m.mass   /= g_sim.time_scale;
+  m.dead_s /= g_sim.time_scale;
+#endif
+  s_mpc.setModel(m);
+  const float pw[RELAY_ZONES]  = { en_b && !g_state.tc_base_err  ? HEATER_BASE_W  : 0.0f,
+                                   en_c && !g_state.tc_cielo_err ? HEATER_CIELO_W : 0.0f };
+  const int   pct[RELAY_ZONES] = { g_state.pct_base, g_state.pct_cielo };
+  s_mpc_win_ms = s_mpc.windowMs();
+  s_mpc.setActuators(pw, pct, g_relays.powerBudget(), RELAY_MIN_ON_MS, RELAY_MIN_OFF_MS,
+                     s_mpc_win_ms);
+  // Finestra dei relay, sfasata come nel modello: cambia insieme a
+  // quella dell'MPC
+  for (int z = 0; z < RELAY_ZONES; z++)
+    g_relays.setWindowMs((RelayZone)z, zones ? s_mpc_win_ms : 0);
+  g_relays.setStagger(zones != 0);
+
+  if (zones == s_mpc_zones) return;
+  const float out[RELAY_ZONES] = { (float)g_state.pid_out_base, (float)g_state.pid_out_cielo };
+  s_mpc_zones = zones;
+  if (!zones) { s_mpc.stop(); return; }
+  if (en_b && en_c) g_relays.restartAll(now);
+  else g_relays.restart(en_b ? RelayZone::BASE : RelayZone::CIELO, now);
+  s_mpc.start(out, dual, now);
+  LOG_I(LOG_PID, "[MPC] %s%s %s: k=%.2f W/°C C=%.0f J/°C, finestra %lus, da %.0f/%.0f%%\n",
+        en_b ? "BASE " : "", en_c ? "CIELO" : "", dual ? "DUAL" : "SINGLE",
+        s_mpc.model().k_loss, s_mpc.model().mass, (unsigned long)(s_mpc_win_ms / 1000),
+        out[0], out[1]);
+}
+
+// Un ciclo MPC: PV e SP delle zone (SINGLE: l'MPC ne fa la media); i PID
+// seguono l'uscita della loro zona (track) e alla fine dell'MPC ripartono da lì
+static void mpc_step(uint32_t now, float* duty_base, float* duty_cielo) {
+  bool        en_b = s_mpc_zones & 1, en_c = s_mpc_zones & 2;
+  const float pv[RELAY_ZONES] = { (float)g_state.temp_base, (float)g_state.temp_cielo };
+  const float sp[RELAY_ZONES] = { (float)g_state.set_base,  (float)g_state.set_cielo };
+  if (s_mpc.step(pv, sp, now))
+    LOG_D(LOG_PID, "[MPC] uscite %.0f/%.0f%%, previsto %.1f/%.1f°C, disturbo %.0f/%.0f W (%lu passi)\n",
+          s_mpc.outPct(0), s_mpc.outPct(1), s_mpc.predicted(0), s_mpc.predicted(1),
+          s_mpc.disturbanceW(0), s_mpc.disturbanceW(1), (unsigned long)s_mpc.evals());
+  if (en_b) {
+    double out = s_mpc.outPct(0);
+    g_state.pid_out_base = out;
+    pid_base->track(out);
+    *duty_base = (float)(out * g_state.pct_base / 100.0);
+  }
+  if (en_c) {
+    double out = s_mpc.outPct(1);
+    g_state.pid_out_cielo = out;
+    pid_cielo->track(out);
+    *duty_cielo = (float)(out * g_state.pct_cielo / 100.0);
+  }
+}
+#endif
+
+#if FEATURE_FEEDFORWARD
+// Regime del forno: PV come plant_id_tick (Cielo, media in DUAL), potenza
+// dai relay decisi in questo ciclo (lb/lc 0-1: livello PWM di una zona
+// SSR, 0/1 un contattore); solo con entrambe le zone in mano al PID
+static void ff_learn(bool on, float t_base, float t_cielo, float lb, float lc, uint32_t now) {
+#if FEATURE_PREHEAT
+  on = on && !s_preheat[0].active() && !s_preheat[1].active();
+#endif
+  on = on && g_state.base_enabled && g_state.cielo_enabled &&
+       !g_state.tc_base_err && !g_state.tc_cielo_err;
+  if (!on) { s_ff.reset(); return; }
+  bool  dual = g_state.sensor_mode == SensorMode::DUAL;
+  float t    = dual ? 0.5f * (t_base + t_cielo) : t_cielo;
+  float sp   = dual ? 0.5f * (float)(g_state.set_base + g_state.set_cielo) : (float)g_state.set_cielo;
+  float u    = (lb * HEATER_BASE_W + lc * HEATER_CIELO_W) * 100.0f /
+               (HEATER_BASE_W + HEATER_CIELO_W);
+  if (!s_ff.learn(t, sp, u, now)) return;
+  s_ff_rebase = true;
+  LOG_D(LOG_PID, "[FF] k=%.2f W/°C, a %.0f°C duty di modello %.0f%%\n",
+        s_ff.k(), sp, s_ff.dutyPct(sp));
+}
+#endif
+
+#if FEATURE_DECOUPLE
+// [DEC] Stima della matrice: solo DUAL con le due sonde buone, potenza
+// dai relay del ciclo (anche quelli dell'autotune: più scarto fra le
+// zone, stima migliore). La matrice in uso cambia solo se la nuova se ne
+// scosta di DECOUPLE_SAVE_FRAC, e allora va anche in NVS
+static void decouple_tick(uint32_t now, float t_base, bool err_base,
+                          float t_cielo, bool err_cielo, bool rb, bool rc) {
+  bool valid = g_state.sensor_mode == SensorMode::DUAL && !err_base && !err_cielo;
+#if SIMULATOR_MODE
+  s_cid.feed((uint32_t)(g_sim.time_elapsed_s * 1000.0f), t_base, t_cielo, rb, rc, valid);
+#else
+  s_cid.feed(now, t_base, t_cielo, rb, rc, valid);
+#endif
+
+  if (now - s_cid_solve_ms < DECOUPLE_SOLVE_MS) return;
+  s_cid_solve_ms = now;
+  ZoneCoupling c;
+  if (!s_cid.solve(c)) return;
+  if (!MUTEX_TAKE()) return;
+  bool changed = c.diff(g_state.coupling) > DECOUPLE_SAVE_FRAC;
+  if (changed) {
+    g_state.coupling  = c;
+    g_state.nvs_dirty = true;
+    s_dc_rev++;
+  }
+  MUTEX_GIVE();
+  if (changed)
+    LOG_I(LOG_PID, "[DEC] K=[%.1f %.1f; %.1f %.1f] W/°C P0=%.0f/%.0f W (G=%.1f W/°C, RGA %.1f) salvata\n",
+          c.kii[0], c.kij[0], c.kij[1], c.kii[1], c.p0[0], c.p0[1], c.gW(), c.rga());
+}
+#endif
+
+#if FEATURE_PLANT_ID
+static PlantIdentifier s_plant_id;
+static uint32_t        s_plant_log_ms = 0;
+
+// [PLANT] un campione per ciclo: letture grezze delle sonde, potenza
+// relativa dei relay appena decisi (vale fino al ciclo successivo)
+static void plant_id_tick(uint32_t now, float t_base, bool err_base,
+                          float t_cielo, bool err_cielo, bool rb, bool rc) {
+  float t = t_cielo;
+  if (g_state.sensor_mode == SensorMode::DUAL && !err_base)
+    t = err_cielo ? t_base : 0.5f * (t_base + t_cielo);
+  bool  valid = !(err_cielo && (g_state.sensor_mode == SensorMode::SINGLE || err_base));
+  float u = ((rb ? HEATER_BASE_W : 0.0f) + (rc ? HEATER_CIELO_W : 0.0f)) /
+            (HEATER_BASE_W + HEATER_CIELO_W);
+#if SIMULATOR_MODE
+  s_plant_id.feed((uint32_t)(g_sim.time_elapsed_s * 1000.0f), t, u, valid);   // tempo del plant
+#else
+  s_plant_id.feed(now, t, u, valid);
+#endif
+
+  if (now - s_plant_log_ms < PLANT_ID_LOG_MS) return;
+  s_plant_log_ms = now;
+  PlantModel m;
+  if (!s_plant_id.solve(m)) {
+    LOG_I(LOG_PID, "[PLANT] %lu blocchi, stima non ancora disponibile\n",
+          (unsigned long)s_plant_id.blocks());
+    return;
+  }
+  LOG_I(LOG_PID, "[PLANT] k=%.2f W/°C C=%.0f J/°C T_amb=%.1f ritardo=%.0fs tau=%.0fs rmse=%.2f\n",
+        m.k_loss, m.mass, m.t_amb, m.dead_s, m.tau_s, m.rmse);
+#if FEATURE_MPC
+  s_mpc_model = m;
+#endif
+}
+#endif
+
+#if FEATURE_SAFETY
+static uint32_t s_ru_ms       = 0;
+static float    s_ru_t0       = 0.0f;
+static float    s_rd_peak     = 0.0f;
+static uint32_t s_rd_below_ms = 0;
+#if SIMULATOR_MODE
+static uint32_t s_last_sim_reset_seq = 0;
+#endif
+#endif
+
+// ================================================================
+//  EMERGENCY SHUTDOWN
+// ================================================================
+void IRAM_ATTR emergency_shutdown(SafetyReason reason) {
+  RELAY_WRITE(RELAY_BASE,  RELAY_BASE_INV,  false);
+  RELAY_WRITE(RELAY_CIELO, RELAY_CIELO_INV, false);
+  s_ssr.off();
+
+  g_emergency_shutdown    = true;
+  g_state.relay_base      = false;
+  g_state.relay_cielo     = false;
+  g_state.base_enabled    = false;
+  g_state.cielo_enabled   = false;
+  g_state.safety_shutdown = true;
+  g_state.safety_reason   = reason;
+
+  // Porta PID in MANUAL
+  if (pid_base)  pid_base->setEnabled(false);
+  if (pid_cielo) pid_cielo->setEnabled(false);
+  // [FIX-1]: la riaccensione dopo lo shutdown deve essere vista come
+  // transizione, altrimenti i PID restano in MANUAL con output 0
+  prev_base_enabled  = false;
+  prev_cielo_enabled = false;
+#if FEATURE_PREHEAT
+  preheat_abort_all();
+#endif
+
+  const char* reasons[] = {
+    "NONE","TC_ERROR","OVERTEMP","RUNAWAY_DOWN","RUNAWAY_UP","WDG_TIMEOUT"
+  };
+  int idx = (int)reason;
+  LOG_E(LOG_SAFETY, "!!! SHUTDOWN SICUREZZA: %s !!!\n",
+        (idx >= 0 && idx <= 5) ? reasons[idx] : "?");
+
+  // ── [SIM-C]: notifica il simulatore per validazione test ──
+#if SIMULATOR_MODE
+  simulator_notify_shutdown((int)reason);
+#endif
+}
+
+// ================================================================
+//  NVS HELPERS
+// ================================================================
+static void nvs_load_to_state() {
+  NVSData d;
+  nvs->load(d);
+  g_state.set_base    = d.set_base;
+  g_state.set_cielo   = d.set_cielo;
+  g_state.kp_base     = d.kp_base;
+  g_state.ki_base     = d.ki_base;
+  g_state.kd_base     = d.kd_base;
+  g_state.kp_cielo    = d.kp_cielo;
+  g_state.ki_cielo    = d.ki_cielo;
+  g_state.kd_cielo    = d.kd_cielo;
+  g_state.sensor_mode = (d.single_mode == 1) ? SensorMode::SINGLE : SensorMode::DUAL;
+  g_state.pct_base    = d.pct_base;
+  g_state.pct_cielo   = d.pct_cielo;
+  g_state.gains_base  = d.gains_base;
+  g_state.gains_cielo = d.gains_cielo;
+  g_state.ff_k        = d.ff_k;
+  g_state.coupling    = d.coupling;
+  g_state.relay_cycles_base  = d.cycles_base;
+  g_state.relay_cycles_cielo = d.cycles_cielo;
+}
+
+static void nvs_save_from_state() {
+  NVSData d;
+  if (!MUTEX_TAKE()) return;
+  d.set_base    = (float)g_state.set_base;
+  d.set_cielo   = (float)g_state.set_cielo;
+  d.kp_base     = (float)g_state.kp_base;
+  d.ki_base     = (float)g_state.ki_base;
+  d.kd_base     = (float)g_state.kd_base;
+  d.kp_cielo    = (float)g_state.kp_cielo;
+  d.ki_cielo    = (float)g_state.ki_cielo;
+  d.kd_cielo    = (float)g_state.kd_cielo;
+  d.single_mode = (g_state.sensor_mode == SensorMode::SINGLE) ? 1 : 0;
+  d.pct_base    = g_state.pct_base;
+  d.pct_cielo   = g_state.pct_cielo;
+  d.gains_base  = g_state.gains_base;
+  d.gains_cielo = g_state.gains_cielo;
+  d.ff_k        = g_state.ff_k;
+  d.coupling    = g_state.coupling;
+  d.cycles_base  = g_state.relay_cycles_base;
+  d.cycles_cielo = g_state.relay_cycles_cielo;
+  g_state.nvs_dirty = false;
+  MUTEX_GIVE();
+  nvs->save(d);
+}
+
+// ================================================================
+//  control_init — oggetti hardware, NVS, PID, prima lettura
+// ================================================================
+void control_init() {
+  // ---- 6. Oggetti hardware (DOPO lcd.init) ----
+  tc_base  = new MAX6675(TC_SCK, TC_CS_BASE,  TC_MISO);
+  tc_cielo = new MAX6675(TC_SCK, TC_CS_CIELO, TC_MISO);
+  nvs      = new NVSStorage();
+  LOG_I(LOG_SYSTEM, "[SETUP] MAX6675 + NVS allocati\n");
+
+  // ── [SIM-D]: inizializza simulatore ──
+#if SIMULATOR_MODE
+  simulator_init();
+#endif
+
+  // ---- 7. NVS ----
+  nvs_load_to_state();
+
+  // ── [SIM-E]: forza SINGLE mode e setpoint valido per il test ──
+#if SIMULATOR_MODE
+  g_state.sensor_mode = SensorMode::SINGLE;
+  if (g_state.set_base  < 100.0 || g_state.set_base  > 450.0) g_state.set_base  = 250.0;
+  if (g_state.set_cielo < 100.0 || g_state.set_cielo > 450.0) g_state.set_cielo = 250.0;
+  // Un solo sensore (zona cielo) → un solo setpoint: con il modello a due
+  // zone un SP cielo diverso lascerebbe la resistenza base a inseguire
+  // un target che la sonda non vede
+  g_state.set_cielo = g_state.set_base;
+#endif
+
+  LOG_I(LOG_SYSTEM, "[SETUP] NVS: mode=%s set=%.0f/%.0f split=%d/%d\n",
+    g_state.sensor_mode == SensorMode::SINGLE ? "SINGLE" : "DUAL",
+    g_state.set_base, g_state.set_cielo,
+    g_state.pct_base, g_state.pct_cielo);
+
+  // ---- 8. PID — allocato DOPO nvs_load (usa Kp/Ki/Kd corretti) ----
+  pid_base  = new PIDController(&g_state.temp_base,  &g_state.pid_out_base,
+                                 &g_state.set_base,
+                                 g_state.kp_base,  g_state.ki_base,  g_state.kd_base);
+  pid_cielo = new PIDController(&g_state.temp_cielo, &g_state.pid_out_cielo,
+                                 &g_state.set_cielo,
+                                 g_state.kp_cielo, g_state.ki_cielo, g_state.kd_cielo);
+  pid_base->begin();
+  pid_cielo->begin();
+  pid_base->setGainTable(&g_state.gains_base);
+  pid_cielo->setGainTable(&g_state.gains_cielo);
+  // Nota: i PID partono in MANUAL. Vengono portati in AUTOMATIC
+  // da Task_PID quando base_enabled/cielo_enabled diventano true.
+  LOG_I(LOG_SYSTEM, "[SETUP] PID OK (Kp=%.2f Ki=%.3f Kd=%.2f) — modo MANUAL\n",
+        g_state.kp_base, g_state.ki_base, g_state.kd_base);
+
+  // ---- 9. Prima lettura sensori ----
+  delay(300);
+  float t2 = tc_cielo->readCelsius();
+  g_state.tc_cielo_err = isnan(t2) || t2 <= 0.0f;
+  if (!g_state.tc_cielo_err) g_state.temp_cielo = (double)t2;
+  if (g_state.sensor_mode == SensorMode::SINGLE) {
+    g_state.tc_base_err = false;
+    g_state.temp_base   = g_state.temp_cielo;
+  } else {
+    float t1 = tc_base->readCelsius();
+    g_state.tc_base_err = isnan(t1) || t1 <= 0.0f;
+    if (!g_state.tc_base_err) g_state.temp_base = (double)t1;
+  }
+  LOG_I(LOG_SYSTEM, "[SETUP] Temp: B=%.1f°C  C=%.1f°C%s\n",
+        g_state.temp_base, g_state.temp_cielo,
+        SIMULATOR_MODE ? " (simulata)" : "");
+}
+
+// ================================================================
+//  control_loop_begin — stato iniziale del ciclo PID
+// ================================================================
+void control_loop_begin() {
+  g_relays.begin(clock_ms());
+  s_ssr.off();
+#if !SIMULATOR_MODE
+  ssr_pwm_begin();
+#endif
+  s_cyc_nvs[(int)RelayZone::BASE]  = g_state.relay_cycles_base;
+  s_cyc_nvs[(int)RelayZone::CIELO] = g_state.relay_cycles_cielo;
+  s_cyc_save_ms = clock_ms();
+#if FEATURE_RELAY_WINDOW
+  s_rwin.begin(clock_ms());
+#endif
+  last_nvs_ms   = clock_ms();
+  last_tick_ms  = clock_ms();
+  last_graph_ms = clock_ms();
+  prev_base_enabled  = false;
+  prev_cielo_enabled = false;
+#if FEATURE_PREHEAT
+  preheat_abort_all();
+  s_preheat_sp[0] = s_preheat_sp[1] = 0.0;
+#endif
+#if FEATURE_FEEDFORWARD
+  s_ff.begin(HEATER_BASE_W + HEATER_CIELO_W, g_state.ff_k);
+  s_ff_rebase = false;
+#endif
+#if FEATURE_DECOUPLE
+  s_cid.begin(HEATER_BASE_W, HEATER_CIELO_W);
+  s_cid_solve_ms = clock_ms();
+  s_dc_on        = false;
+  s_dc_rev_seen  = s_dc_rev;
+#endif
+#if FEATURE_MPC
+  s_mpc.begin();
+  s_mpc_model = s_mpc.model();
+  s_mpc_zones = 0;
+#endif
+#if FEATURE_SAFETY
+  s_ru_ms       = 0;
+  s_ru_t0       = 0.0f;
+  s_rd_peak     = 0.0f;
+  s_rd_below_ms = 0;
+#if SIMULATOR_MODE
+  s_last_sim_reset_seq = 0;
+#endif
+#endif
+#if FEATURE_TRACE
+  control_trace_begin(clock_ms(), g_relays.windowMs());
+#endif
+#if FEATURE_PLANT_ID
+  s_plant_id.begin(HEATER_BASE_W + HEATER_CIELO_W);
+  s_plant_log_ms = clock_ms();
+#endif
+}
+
+// ================================================================
+//  control_step — un ciclo di Task_PID
+// ================================================================
+static uint32_t control_step_body(uint32_t now);
+
+uint32_t control_step(uint32_t now) {
+  uint32_t wait_ms = control_step_body(now);
+#if FEATURE_TRACE
+  control_trace_commit(now);
+#endif
+  return wait_ms;
+}
+
+static uint32_t control_step_body(uint32_t now) {
+  // FIX: heartbeat PRIMA di tutto
+  g_pid_heartbeat++;
+
+  // ── [SIM-F]: aggiorna modello termico PRIMA di leggere sensori ──
+#if SIMULATOR_MODE
+  {
+    uint32_t dt_ms = now - last_tick_ms;
+    if (dt_ms == 0) dt_ms = PID_SAMPLE_MS;
+    last_tick_ms = now;
+    simulator_tick(dt_ms);
+  }
+#endif
+
+  if (g_emergency_shutdown) {
+    g_relays.forceOff(RelayZone::BASE,  now);
+    g_relays.forceOff(RelayZone::CIELO, now);
+    heater_output(false, false);
+#if SIMULATOR_MODE
+    simulator_set_relay(false, false);
+    // Avanza la sequenza test anche durante shutdown (altrimenti le fasi restano bloccate)
+    simulator_test_tick(now);
+#endif
+    bool hot = (!g_state.tc_cielo_err && g_state.temp_cielo > FAN_OFF_TEMP);
+    if (g_state.sensor_mode == SensorMode::DUAL &&
+        !g_state.tc_base_err && g_state.temp_base > FAN_OFF_TEMP) {
+      hot = true;
+    }
+    if (hot != g_state.fan_on) {
+      g_state.fan_on = hot;
+      RELAY_WRITE(RELAY_FAN, RELAY_FAN_INV, hot);
+    }
+    return 1000;
+  }
+
+  // ── Lettura sensori ──
+  float t_cielo_raw = tc_cielo->readCelsius();
+  bool  err_cielo   = isnan(t_cielo_raw) || t_cielo_raw <= 0.0f;
+  float t_base_raw  = 0.0f;
+  bool  err_base    = false;
+
+  if (g_state.sensor_mode == SensorMode::SINGLE) {
+    t_base_raw = t_cielo_raw;
+  } else {
+    t_base_raw = tc_base->readCelsius();
+    err_base   = isnan(t_base_raw) || t_base_raw <= 0.0f;
+  }
+
+  LOG_D(LOG_PID, "[PID] raw B=%.1f C=%.1f errB=%d errC=%d\n",
+        t_base_raw, t_cielo_raw, err_base, err_cielo);
+
+#if FEATURE_TRACE
+  control_trace_inputs(t_base_raw, t_cielo_raw);
+#endif
+
+  // ── Gestione errore TC ──
+  if (err_cielo) {
+#if FEATURE_SAFETY
+    if (g_state.sensor_mode == SensorMode::DUAL) {
+      emergency_shutdown(SafetyReason::TC_ERROR);
+      return 0;
+    }
+#endif
+    static uint32_t last_warn = 0;
+    if (now - last_warn > 5000) {
+      LOG_W(LOG_PID, "[PID] TC_CIELO ERR — open-loop\n");
+      last_warn = now;
+    }
+    err_cielo = false;
+  }
+
+  if (err_base && g_state.sensor_mode == SensorMode::DUAL) {
+#if FEATURE_SAFETY
+    emergency_shutdown(SafetyReason::TC_ERROR);
+    return 0;
+#endif
+  }
+
+  // ── Aggiorna stato ──
+  if (MUTEX_TAKE()) {
+    if (!err_cielo) g_state.temp_cielo = (double)t_cielo_raw;
+    if (!err_base)  g_state.temp_base  = (double)t_base_raw;
+    g_state.tc_cielo_err = err_cielo;
+    g_state.tc_base_err  = err_base;
+    MUTEX_GIVE();
+  }
+
+  // ── Overtemp ──
+#if FEATURE_SAFETY
+  if (g_state.temp_cielo > TEMP_MAX_SAFE || g_state.temp_base > TEMP_MAX_SAFE) {
+    emergency_shutdown(SafetyReason::OVERTEMP);
+    return 0;
+  }
+#endif
+
+  // ── [FIX-1]: gestione transizioni ON/OFF del PID ──────────────
+  // Il PID deve essere in AUTOMATIC per calcolare l'output.
+  // Viene portato in AUTOMATIC quando enabled diventa true,
+  // in MANUAL quando diventa false o in emergenza.
+  bool base_started  = false;
+  bool cielo_started = false;
+  if (g_state.base_enabled != prev_base_enabled) {
+    pid_base->setEnabled(g_state.base_enabled);
+    base_started = g_state.base_enabled;
+    if (g_state.base_enabled) {
+      g_relays.restart(RelayZone::BASE, now);   // resetta finestra relay
+      LOG_I(LOG_PID, "[PID] BASE: AUTOMATIC (setpoint=%.0f°C)\n", g_state.set_base);
+    } else {
+      LOG_I(LOG_PID, "[PID] BASE: MANUAL\n");
+    }
+    prev_base_enabled = g_state.base_enabled;
+  }
+  if (g_state.cielo_enabled != prev_cielo_enabled) {
+    pid_cielo->setEnabled(g_state.cielo_enabled);
+    cielo_started = g_state.cielo_enabled;
+    if (g_state.cielo_enabled) {
+      g_relays.restart(RelayZone::CIELO, now);
+      LOG_I(LOG_PID, "[PID] CIELO: AUTOMATIC (setpoint=%.0f°C)\n", g_state.set_cielo);
+    } else {
+      LOG_I(LOG_PID, "[PID] CIELO: MANUAL\n");
+    }
+    prev_cielo_enabled = g_state.cielo_enabled;
+  }
+
+#if FEATURE_FEEDFORWARD
+  // ── [FF] duty di modello al setpoint corrente (ricette, MQTT, UI) ──
+#if FEATURE_DECOUPLE
+  s_ff_rebase = decouple_update(t_base_raw, t_cielo_raw) || s_ff_rebase;
+#endif
+  ff_apply(RelayZone::BASE,  pid_base,  s_ff_rebase);
+  ff_apply(RelayZone::CIELO, pid_cielo, s_ff_rebase);
+  s_ff_rebase = false;
+#endif
+
+#if FEATURE_MPC
+  mpc_update(now);
+  const bool mpc_on = s_mpc_zones != 0;
+#else
+  const bool mpc_on = false;
+#endif
+
+#if FEATURE_PREHEAT
+  // ── Preriscaldo: prima del PID, che all'hand-off calcola già da qui ──
+  preheat_zone(RelayZone::BASE,  pid_base,  g_state.base_enabled && !mpc_on,  base_started,
+               t_base_raw,  g_state.set_base,  &g_state.pid_out_base,  now);
+  preheat_zone(RelayZone::CIELO, pid_cielo, g_state.cielo_enabled && !mpc_on, cielo_started,
+               t_cielo_raw, g_state.set_cielo, &g_state.pid_out_cielo, now);
+#else
+  (void)base_started; (void)cielo_started;
+#endif
+
+  // ── PID + relay duty cycle ──
+  // Guadagni piatti da AppState (UI, autotune): il controller li passa
+  // al motore solo se cambiano, e solo se la tabella a fasce è vuota
+  pid_base->setTunings(g_state.kp_base,   g_state.ki_base,  g_state.kd_base);
+  pid_cielo->setTunings(g_state.kp_cielo, g_state.ki_cielo, g_state.kd_cielo);
+  pid_base->setDutyScale(g_state.pct_base);
+  pid_cielo->setDutyScale(g_state.pct_cielo);
+  float duty_base  = 0.0f;
+  float duty_cielo = 0.0f;
+
+#if FEATURE_AUTOTUNE
+  if (autotune_is_running()) {
+    // L'autotune comanda i relay e pubblica il suo duty in pid_out_*: i
+    // PID lo seguono, a fine taratura ripartono da lì senza integrale carico
+    pid_track_autotune();
+  } else
+#endif
+  if (mpc_on) {
+#if FEATURE_MPC
+    mpc_step(now, &duty_base, &duty_cielo);
+#endif
+  } else {
+    if (g_state.base_enabled) {
+      pid_base->compute();
+      duty_base = pid_base->duty(g_state.pct_base);
+    }
+    if (g_state.cielo_enabled) {
+      pid_cielo->compute();
+      duty_cielo = pid_cielo->duty(g_state.pct_cielo);
+    }
+  }
+
+#if FEATURE_RELAY_WINDOW
+#if FEATURE_MPC
+  const uint32_t mpc_win_ms = mpc_on ? s_mpc_win_ms : 0;
+#else
+  const uint32_t mpc_win_ms = 0;
+#endif
+#if FEATURE_AUTOTUNE
+  relay_window_tick(now, t_base_raw, t_cielo_raw, mpc_on || autotune_is_running(), mpc_win_ms);
+#else
+  relay_window_tick(now, t_base_raw, t_cielo_raw, mpc_on, mpc_win_ms);
+#endif
+#endif
+
+  // Durante l'autotune i relay li chiede autotune_run()
+  bool base_on  = false;
+  bool cielo_on = false;
+#if FEATURE_AUTOTUNE
+  if (!autotune_is_running()) {
+#endif
+  // Sonda non rilevata: relay spento subito, senza tempi minimi
+  if (g_state.tc_base_err) g_relays.forceOff(RelayZone::BASE, now);
+  else                     base_on = g_relays.request(RelayZone::BASE, duty_base, now);
+  if (g_state.tc_cielo_err) g_relays.forceOff(RelayZone::CIELO, now);
+  else                      cielo_on = g_relays.request(RelayZone::CIELO, duty_cielo, now);
+
+  LOG_D(LOG_PID, "[PID] base out=%.1f on=%lu/%lums base_on=%d\n",
+        g_state.pid_out_base, (unsigned long)g_relays.onMs(RelayZone::BASE),
+        (unsigned long)g_relays.windowMs(RelayZone::BASE), base_on);
+
+  heater_output(base_on, cielo_on);
+#if FEATURE_AUTOTUNE
+  }
+#endif
+
+#if FEATURE_FEEDFORWARD
+  {
+    float lb = base_on  ? g_relays.level(RelayZone::BASE)  : 0.0f;
+    float lc = cielo_on ? g_relays.level(RelayZone::CIELO) : 0.0f;
+#if FEATURE_AUTOTUNE
+    ff_learn(!autotune_is_running(), t_base_raw, t_cielo_raw, lb, lc, now);
+#else
+    ff_learn(true, t_base_raw, t_cielo_raw, lb, lc, now);
+#endif
+  }
+#endif
+
+#if FEATURE_AUTOTUNE
+  if (autotune_is_running()) {
+    float pv_at = t_cielo_raw;
+    if (g_state.sensor_mode == SensorMode::DUAL) {
+      if (!err_base && !err_cielo) {
+        pv_at = (t_base_raw + t_cielo_raw) * 0.5f;
+      } else if (!err_cielo) {
+        pv_at = t_cielo_raw;
+      } else if (!err_base) {
+        pv_at = t_base_raw;
+      }
+    }
+    autotune_run(pv_at, err_base ? NAN : t_base_raw, err_cielo ? NAN : t_cielo_raw, now);
+  }
+#endif
+
+  if (MUTEX_TAKE()) {
+#if FEATURE_AUTOTUNE
+    if (!autotune_is_running()) {
+      if (!autotune_consume_just_completed()) {
+        g_state.relay_base  = base_on;
+        g_state.relay_cielo = cielo_on;
+      }
+    }
+#else
+    g_state.relay_base  = base_on;
+    g_state.relay_cielo = cielo_on;
+#endif
+#if FEATURE_PREHEAT
+    g_state.preheat_base      = s_preheat[(int)RelayZone::BASE].active();
+    g_state.preheat_cielo     = s_preheat[(int)RelayZone::CIELO].active();
+    g_state.preheat_eta_base  = s_preheat[(int)RelayZone::BASE].etaS();
+    g_state.preheat_eta_cielo = s_preheat[(int)RelayZone::CIELO].etaS();
+#endif
+#if FEATURE_FEEDFORWARD
+    g_state.ff_k = s_ff.k();
+    if (s_ff.takeSave()) {
+      g_state.nvs_dirty = true;
+      LOG_I(LOG_PID, "[FF] k=%.2f W/°C salvato\n", g_state.ff_k);
+    }
+#endif
+    // [RELAY] Vita dei contattori: totale in NVS ogni RELAY_WEAR_SAVE_MS
+    {
+      uint32_t cb = s_cyc_nvs[(int)RelayZone::BASE]  + g_relays.cycles(RelayZone::BASE);
+      uint32_t cc = s_cyc_nvs[(int)RelayZone::CIELO] + g_relays.cycles(RelayZone::CIELO);
+      if ((cb != g_state.relay_cycles_base || cc != g_state.relay_cycles_cielo) &&
+          now - s_cyc_save_ms >= RELAY_WEAR_SAVE_MS) {
+        s_cyc_save_ms     = now;
+        g_state.nvs_dirty = true;
+        LOG_I(LOG_PID, "[RELAY] chiusure B=%lu C=%lu, finestre %lu/%lu s\n",
+              (unsigned long)cb, (unsigned long)cc,
+              (unsigned long)(g_relays.windowMs(RelayZone::BASE) / 1000),
+              (unsigned long)(g_relays.windowMs(RelayZone::CIELO) / 1000));
+      }
+      if (g_state.nvs_dirty) {
+        g_state.relay_cycles_base  = cb;
+        g_state.relay_cycles_cielo = cc;
+      }
+    }
+
+    bool res_on = g_state.relay_base || g_state.relay_cielo;
+    bool hot = (!g_state.tc_cielo_err && g_state.temp_cielo > FAN_OFF_TEMP);
+    if (g_state.sensor_mode == SensorMode::DUAL &&
+        !g_state.tc_base_err && g_state.temp_base > FAN_OFF_TEMP) {
+      hot = true;
+    }
+    bool fan = res_on || hot;
+    if (fan != g_state.fan_on) {
+      g_state.fan_on = fan;
+      RELAY_WRITE(RELAY_FAN, RELAY_FAN_INV, fan);
+    }
+    MUTEX_GIVE();
+  }
+
+#if SIMULATOR_MODE
+  simulator_set_level(g_state.relay_base  ? g_relays.level(RelayZone::BASE)  : 0.0f,
+                      g_state.relay_cielo ? g_relays.level(RelayZone::CIELO) : 0.0f);
+#endif
+
+#if FEATURE_PLANT_ID
+  plant_id_tick(now, t_base_raw, err_base, t_cielo_raw, err_cielo,
+                g_state.relay_base, g_state.relay_cielo);
+#endif
+#if FEATURE_DECOUPLE
+  decouple_tick(now, t_base_raw, err_base, t_cielo_raw, err_cielo,
+                g_state.relay_base, g_state.relay_cielo);
+#endif
+
+#if FEATURE_SAFETY
+  {
+#if FEATURE_AUTOTUNE
+    const bool at_run = autotune_is_running();
+#else
+    const bool at_run = false;
+#endif
+#if SIMULATOR_MODE
+    if (g_sim.thermal_reset_seq != s_last_sim_reset_seq) {
+      s_last_sim_reset_seq = g_sim.thermal_reset_seq;
+      s_ru_ms       = 0;
+      s_ru_t0       = 0.0f;
+      s_rd_peak     = 0.0f;
+      s_rd_below_ms = 0;
+#if FEATURE_TRACE
+      control_trace_reset();
+#endif
+#if FEATURE_PLANT_ID
+      s_plant_id.restart();
+#endif
+#if FEATURE_DECOUPLE
+      s_cid.restart();
+#endif
+    }
+#endif
+    float tb, tc;
+    double sb, sc;
+    bool rb, rc, en_b, en_c;
+    if (MUTEX_TAKE()) {
+      tb   = (float)g_state.temp_base;
+      tc   = (float)g_state.temp_cielo;
+      sb   = g_state.set_base;
+      sc   = g_state.set_cielo;
+      rb   = g_state.relay_base;
+      rc   = g_state.relay_cielo;
+      en_b = g_state.base_enabled;
+      en_c = g_state.cielo_enabled;
+      MUTEX_GIVE();
+
+      bool res_on = rb || rc;
+      uint32_t rwd_ms = RUNAWAY_DOWN_MS;
+#if SIMULATOR_MODE
+      if (g_runaway_down_ms_override != 0) rwd_ms = g_runaway_down_ms_override;
+#endif
+#if RUNAWAY_UP_ENABLED
+      if (!at_run) {
+        float tmax = (tb > tc) ? tb : tc;
+        if (!res_on && !en_b && !en_c) {
+          if (s_ru_ms == 0) {
+            s_ru_ms = now;
+            s_ru_t0 = tmax;
+          } else if ((now - s_ru_ms) >= (uint32_t)RUNAWAY_RISE_MS) {
+            if (tmax - s_ru_t0 > RUNAWAY_RISE_DEG) {
+              emergency_shutdown(SafetyReason::RUNAWAY_UP);
+              return 0;
+            }
+            s_ru_ms = now;
+            s_ru_t0 = tmax;
+          }
+        } else {
+          s_ru_ms = 0;
+        }
+      }
+#endif
+#if RUNAWAY_DOWN_ENABLED
+      if (!at_run) {
+        float tmax  = (tb > tc) ? tb : tc;
+        float spmax = (float)((sb > sc) ? sb : sc);
+        if (res_on && (en_b || en_c)) {
+          if (tmax > s_rd_peak) {
+            s_rd_peak     = tmax;
+            s_rd_below_ms = 0;
+          }
+          if (s_rd_peak >= spmax - 20.0f) {
+            if (s_rd_peak - tmax >= RUNAWAY_MIN_DROP) {
+              if (s_rd_below_ms == 0) s_rd_below_ms = now;
+              else if ((now - s_rd_below_ms) >= rwd_ms) {
+                emergency_shutdown(SafetyReason::RUNAWAY_DOWN);
+                return 0;
+              }
+            } else {
+              s_rd_below_ms = 0;
+            }
+          }
+        } else {
+          s_rd_peak     = 0.0f;
+          s_rd_below_ms = 0;
+        }
+      }
+#endif
+    }
+  }
+#endif
+
+  // ── [FIX-2]: campionamento grafico ogni GRAPH_SAMPLE_S secondi ──
+  // I puntatori base/cielo del GraphBuffer sono allocati in PSRAM da
+  // graph_alloc_psram() in setup(). Qui ci scriviamo i dati effettivi.
+  if (now - last_graph_ms >= (uint32_t)(GRAPH_SAMPLE_S * 1000UL)) {
+    last_graph_ms = now;
+    if (g_graph.base && g_graph.cielo) {
+      uint16_t idx = g_graph.head;
+      g_graph.base[idx]  = (float)g_state.temp_base;
+      g_graph.cielo[idx] = (float)g_state.temp_cielo;
+      g_graph.head = (idx + 1) % GRAPH_BUF_SIZE;
+      if (g_graph.count < GRAPH_BUF_SIZE) g_graph.count++;
+      LOG_D(LOG_PID, "[GRAPH] push idx=%d B=%.1f C=%.1f count=%d\n",
+            idx, g_state.temp_base, g_state.temp_cielo, g_graph.count);
+    }
+  }
+
+  // ── NVS save periodico ──
+  if (g_state.nvs_dirty && (now - last_nvs_ms > 5000)) {
+    last_nvs_ms = now;
+    nvs_save_from_state();
+  }
+
+  // ── Log PID periodico ──
+  LOG_I(LOG_PID, "[C1 %5.1fs] %s B:%5.1f/%.0f %3.0f%%%c C:%5.1f/%.0f %3.0f%%%c\n",
+    now / 1000.0f,
+    g_state.sensor_mode == SensorMode::SINGLE ? "SGL" : "DUA",
+    g_state.temp_base,  g_state.set_base,  g_state.pid_out_base,
+    g_state.relay_base  ? '*' : '.',
+    g_state.temp_cielo, g_state.set_cielo, g_state.pid_out_cielo,
+    g_state.relay_cielo ? '*' : '.');
+
+  // ── [SIM-G]: avanza macchina a stati del test ──
+#if SIMULATOR_MODE
+  simulator_test_tick(now);
+#endif
+
+  return PID_SAMPLE_MS;
+}
+
+// ================================================================
+//  TASK_PID
+// ================================================================
+#if TASK_PID_ENABLE
+void Task_PID(void* param) {
+  LOG_I(LOG_PID, "[Core %d] Task_PID avviato%s\n",
+        xPortGetCoreID(),
+        SIMULATOR_MODE ? " [SIMULATORE]" : "");
+
+  control_loop_begin();
+
+  for (;;) {
+    uint32_t wait_ms = control_step(clock_ms());
+#if SIM_VIRTUAL_CLOCK
+    // Tick discreto: il clock avanza di un ciclo, la CPU cede 1 tick RTOS
+    clock_advance(wait_ms);
+    vTaskDelay(1);
+#else
+    if (wait_ms) vTaskDelay(pdMS_TO_TICKS(wait_ms));
+#endif
+  }
+}
+#endif // TASK_PID_ENABLE
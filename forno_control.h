@@ -0,0 +1,39 @@
+/**
+ * forno_control.h — Forno Pizza S3 — Core di controllo
+ * ================================================================
+ * Logica real-time estratta da FornoPizza_S3.ino:
+ *   - oggetti hardware (MAX6675, NVS, PIDController)
+ *   - emergency_shutdown()
+ *   - ciclo Task_PID (lettura sensori, PID, relay, safety, grafico, NVS)
+ *
+ * Nessuna dipendenza da LVGL/display: lo stesso file è compilato
+ * sul device (Arduino IDE) e dalla build host Linux (host/Makefile)
+ * contro gli shim di Arduino/FreeRTOS.
+ * ================================================================
+ */
+#pragma once
+#include <stdint.h>
+#include "debug_config.h"
+
+/** Passi 6-9 di setup(): sensori, NVS→g_state, PID, prima lettura. Richiede g_mutex. */
+void control_init();
+
+/** Azzera lo stato persistente del loop (finestre relay, timer, transizioni ON/OFF). */
+void control_loop_begin();
+
+/**
+ * Un ciclo di Task_PID.
+ * Ritorna i ms da attendere prima del ciclo successivo
+ * (0 = ripeti subito, es. appena scattato emergency_shutdown).
+ */
+uint32_t control_step(uint32_t now);
+
+/**
+ * Uscite Base/Cielo con lo stato deciso da g_relays: RELAY_WRITE per i
+ * contattori, livello del periodo PWM per le zone SSR (ssr_pwm.h).
+ */
+void heater_output(bool base_on, bool cielo_on);
+
+#if TASK_PID_ENABLE
+void Task_PID(void* param);
+#endif
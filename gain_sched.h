@@ -0,0 +1,81 @@
+/**
+ * gain_sched.h — Forno Pizza S3 — Guadagni PID a fasce di temperatura
+ * ================================================================
+ * Le dispersioni del forno non sono lineari: a 400+ °C l'irraggiamento
+ * (∝ T⁴) fa crescere la perdita per grado, il guadagno del processo
+ * cala e la costante di tempo si accorcia. Una taratura sola va bene a
+ * una temperatura: lenta sulle rampe basse o troppo molle in alto.
+ *
+ * GainTable: fino a GAIN_SCHED_POINTS punti (T, Kp, Ki, Kd) ordinati
+ * per T. at(pv) interpola linearmente tra i due punti vicini, fuori
+ * dall'intervallo tiene il punto estremo. Vuota (n = 0) = si usano i
+ * guadagni piatti kp_ / ki_ / kd_ di AppState.
+ *
+ * put() sostituisce un punto entro GAIN_SCHED_MERGE_DEG (ritaratura
+ * della stessa fascia), altrimenti aggiunge; a tabella piena sostituisce
+ * il più vicino. rev cambia a ogni modifica: PIDControllerT reinterpola
+ * solo quando cambia la tabella o il PV si sposta di GAIN_SCHED_HYST_DEG.
+ *
+ * POD senza costruttori: sta in AppState (= {}) e in NVS come blob
+ * (nvs_storage.h). Riempita da autotune_start_schedule() (autotune.h).
+ * ================================================================
+ */
+#pragma once
+#include <stdint.h>
+
+#define GAIN_SCHED_POINTS     4
+#define GAIN_SCHED_MERGE_DEG  25.0f   // stessa fascia: il punto viene sostituito
+#define GAIN_SCHED_HYST_DEG   1.0f    // passo di PV che fa reinterpolare
+
+struct GainPoint {
+  float t_c;
+  float kp, ki, kd;
+};
+
+struct GainTable {
+  uint8_t   n;
+  uint8_t   rev;
+  GainPoint pt[GAIN_SCHED_POINTS];
+
+  bool empty() const { return n == 0; }
+  void clear()       { n = 0; rev++; }
+  /** Copia i punti di o: rev avanza comunque, chi interpola se ne accorge. */
+  void assign(const GainTable& o) { uint8_t r = rev; *this = o; rev = (uint8_t)(r + 1); }
+
+  void put(const GainPoint& p) {
+    int k = -1;
+    for (int i = 0; i < n; i++)
+      if (k < 0 || _dist(i, p.t_c) < _dist(k, p.t_c)) k = i;
+    if (k < 0 || (_dist(k, p.t_c) > GAIN_SCHED_MERGE_DEG && n < GAIN_SCHED_POINTS)) k = n++;
+    pt[k] = p;
+    // Riordina per T (inserimento, al più 4 punti)
+    for (int i = 1; i < n; i++) {
+      GainPoint x = pt[i];
+      int j = i - 1;
+      while (j >= 0 && pt[j].t_c > x.t_c) { pt[j + 1] = pt[j]; j--; }
+      pt[j + 1] = x;
+    }
+    rev++;
+  }
+
+  /** Guadagni interpolati al PV; tabella vuota → punto nullo. */
+  GainPoint at(float pv) const {
+    if (n == 0) return GainPoint{ pv, 0.0f, 0.0f, 0.0f };
+    if (pv <= pt[0].t_c)     return pt[0];
+    if (pv >= pt[n - 1].t_c) return pt[n - 1];
+    int i = 1;
+    while (pv > pt[i].t_c) i++;
+    const GainPoint& a = pt[i - 1];
+    const GainPoint& b = pt[i];
+    float w = (pv - a.t_c) / (b.t_c - a.t_c);
+    return GainPoint{ pv, a.kp + w * (b.kp - a.kp),
+                          a.ki + w * (b.ki - a.ki),
+                          a.kd + w * (b.kd - a.kd) };
+  }
+
+private:
+  float _dist(int i, float t) const {
+    float d = pt[i].t_c - t;
+    return d < 0 ? -d : d;
+  }
+};
@@ -147,8 +147,51 @@ extern SemaphoreHandle_t g_mutex;
 // ================================================================
 #define RELAY_DUTY_MIN_PCT   10
 #define RELAY_DUTY_MAX_PCT   90
+// Tempi minimi tra due commutazioni dello stesso relay (relay_sched.h);
+// 0 = solo la finestra time-proportional decide
+#define RELAY_MIN_ON_MS      0
+#define RELAY_MIN_OFF_MS     0
+// Potenza massima assorbita insieme da Base + Cielo [W] (relay_sched.h):
+// sotto HEATER_BASE_W + HEATER_CIELO_W le finestre si sfasano e le
+// resistenze non sono mai accese insieme. 0 = nessun limite
+#define RELAY_POWER_BUDGET_W 0
+// Finestra adattiva (relay_window.h, FEATURE_RELAY_WINDOW): corta entro
+// NEAR gradi dal setpoint (deve coprire il ripple a regime, ~±10 °C con
+// la finestra di 30 s), lunga oltre FAR
+#define RELAY_WINDOW_MIN_MS   10000UL
+#define RELAY_WINDOW_MAX_MS   60000UL
+#define RELAY_WINDOW_NEAR_DEG 10.0f
+#define RELAY_WINDOW_FAR_DEG  30.0f
+// Budget di usura: chiusure di targa del contattore sulle ore di servizio
+// volute (1e6 / 5000 h = 200/h, una chiusura ogni 18 s a regime),
+// con un credito di RELAY_WEAR_BURST chiusure
+#define RELAY_LIFE_OPS        1000000UL
+#define RELAY_LIFE_HOURS      5000UL
+#define RELAY_WEAR_BURST      60
+// Chiusure totali per relay in NVS al più ogni RELAY_WEAR_SAVE_MS
+#define RELAY_WEAR_SAVE_MS    900000UL
+// Tipo di relè per zona (relay_sched.h): il contattore lavora a finestre
+// di RELAY_WINDOW_MS, l'SSR (zero-crossing) con un PWM lento di
+// SSR_PWM_PERIOD_MS a semionde di rete (ssr_pwm.h). Un periodo per ciclo
+// PID: ogni uscita del PID dura esattamente un periodo
+#define RELAY_TYPE_CONTACTOR  0
+#define RELAY_TYPE_SSR        1
+#define RELAY_TYPE_BASE       RELAY_TYPE_CONTACTOR
+#define RELAY_TYPE_CIELO      RELAY_TYPE_CONTACTOR
+#define MAINS_HZ              50
+#define SSR_PWM_PERIOD_MS     500UL   // = PID_SAMPLE_MS: 50 semionde, 2 %
 #define PREHEAT_MARGIN_DEG   10.0f
 
+// Potenza di targa delle resistenze [W]. Non è solo documentazione:
+// converte duty ↔ watt nell'identificazione del modello (plant_id.h, che
+// dalle temperature ricava solo P/C e k/C), nel feedforward
+// (feedforward.h), nella matrice di accoppiamento e nel disaccoppiamento
+// (zone_coupling.h), nel budget di potenza (relay_sched.h), nel modello
+// dell'MPC e nel passaggio autotune → PID in SINGLE. Va tenuta uguale
+// alla targa reale: un valore sbagliato sposta tutti questi duty
+#define HEATER_BASE_W      1200.0f
+#define HEATER_CIELO_W     1000.0f
+
 // ================================================================
 //  PARAMETRI SICUREZZA
 // ================================================================
@@ -0,0 +1,99 @@
+/**
+ * host/atune_check.cpp — Forno Pizza S3 — Verifica lookback di PID_ATune
+ * ================================================================
+ * isMax/isMin di PID_ATune::lookback() (ring + deque monotone) contro la
+ * scansione diretta della finestra: refVal strettamente oltre tutti gli
+ * ultimi nLookBack campioni, storia iniziale = un solo campione a 0 °C.
+ *
+ * Per ogni lookback di --secs (fino a ATUNE_LOOKBACK_MAX campioni e
+ * oltre, dove SetLookbackSec() satura la finestra) passano --n campioni
+ * di tre segnali: rumore uniforme, rampa con rumore e oscillazione lenta
+ * quantizzata a 0.25 °C (passo MAX31855, tanti pari merito). Esce con 1
+ * alla prima discrepanza.
+ *
+ * USO:
+ *   make -C host atunecheck
+ *   host/build/atune_check [--n 100000] [--seed 1]
+ * ================================================================
+ */
+#include <Arduino.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <PID_AutoTune_v0.h>
+#include "control_clock.h"
+
+// Solo PID_AutoTune_v0.o: il clock virtuale del core vive qui
+volatile uint32_t g_clock_virtual_ms = 0;
+
+struct ATuneLookbackCheck {
+  static int  window(PID_ATune& at)                { return at.nLookBack; }
+  static void step(PID_ATune& at, float v, bool& mx, bool& mn) {
+    at.lookback(v);
+    mx = at.isMax;
+    mn = at.isMin;
+  }
+};
+
+static uint32_t s_rng = 1;
+static float urand() {                      // xorshift32, [0, 1)
+  s_rng ^= s_rng << 13; s_rng ^= s_rng >> 17; s_rng ^= s_rng << 5;
+  return (s_rng >> 8) * (1.0f / 16777216.0f);
+}
+
+static float signal(int kind, uint32_t i) {
+  switch (kind) {
+    case 0:  return 200.0f + 20.0f * urand();
+    case 1:  return 0.01f * (float)(i % 5000) + 2.0f * urand();
+    default: return roundf((250.0f + 8.0f * sinf(i * 0.013f) + urand()) * 4) / 4;
+  }
+}
+
+static const char* const KIND_NAME[] = { "rumore", "rampa", "sinusoide" };
+
+int main(int argc, char** argv) {
+  uint32_t n = 100000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--n") && i + 1 < argc)         n     = (uint32_t)atol(argv[++i]);
+    else if (!strcmp(argv[i], "--seed") && i + 1 < argc) s_rng = (uint32_t)atol(argv[++i]) | 1;
+    else { fprintf(stderr, "uso: %s [--n N] [--seed S]\n", argv[0]); return 2; }
+  }
+
+  static const int secs[] = { 2, 20, 59, 60, 61, 120, 600 };
+  int fail = 0;
+  for (int s : secs) {
+    for (int kind = 0; kind < 3; kind++) {
+      float in = 0, out = 0;
+      PID_ATune at(&in, &out);
+      at.SetLookbackSec(s);
+      const int nlb = ATuneLookbackCheck::window(at);
+
+      std::vector<float> hist(1, 0.0f);     // storia iniziale a 0 °C
+      uint32_t bad = 0, first = 0;
+      for (uint32_t i = 0; i < n; i++) {
+        float v = signal(kind, i);
+        size_t from = hist.size() > (size_t)nlb ? hist.size() - nlb : 0;
+        bool refMax = true, refMin = true;
+        for (size_t k = from; k < hist.size(); k++) {
+          if (!(v > hist[k])) refMax = false;
+          if (!(v < hist[k])) refMin = false;
+        }
+        hist.push_back(v);
+
+        bool mx, mn;
+        ATuneLookbackCheck::step(at, v, mx, mn);
+        if (mx != refMax || mn != refMin) { if (!bad++) first = i; }
+      }
+      printf("lookback %4d s  finestra %3d  %-9s  discrepanze %u",
+             s, nlb, KIND_NAME[kind], bad);
+      if (bad) printf("  (prima al campione %u)", first);
+      printf("\n");
+      if (bad) fail = 1;
+    }
+  }
+  printf(fail ? "LOOKBACK: DISCREPANZE\n" : "LOOKBACK: identico alla scansione diretta\n");
+  return fail;
+}
@@ -0,0 +1,390 @@
+/**
+ * host/fault_campaign.cpp — Forno Pizza S3 — Campagna Monte Carlo guasti
+ * ================================================================
+ * Migliaia di corse del core di controllo reale (control_step) sul
+ * simulatore a due zone, ciascuna in un processo figlio (fork_pool.h).
+ * Per ogni corsa si estraggono a caso:
+ *   guasto      NONE | OVERTEMP | TC_ERROR | RUNAWAY_UP | RUNAWAY_DOWN
+ *   magnitudine lettura spuria [°C] / letture NAN / calore fantasma [W] /
+ *               moltiplicatore dispersione (g_sim.rwd_loss_k)
+ *   NONE        disturbo benigno: regime, raffica pizze, spegnimento
+ *               a caldo, setpoint abbassato
+ *   istante     onset dopo il preriscaldo (stabile ±5 °C per 5 s)
+ *   rumore      σ sonda (g_sim.noise_deg), setpoint, SINGLE/DUAL
+ *
+ * Ragione attesa per corsa: OVERTEMP solo se la lettura supera
+ * TEMP_MAX_SAFE, TC_ERROR solo in DUAL (SINGLE va in open-loop),
+ * RUNAWAY_* sempre, NONE mai. Uno shutdown con ragione diversa da
+ * quella attesa, o prima dell'onset, è un falso positivo di quella
+ * ragione; nessuno shutdown entro --window è un mancato rilevamento.
+ *
+ * REPORT per SafetyReason: attese / rilevate / mancate, tasso falsi
+ * positivi sulle corse che non la attendevano, latenza onset→shutdown
+ * (p50/p90/p99/max + istogramma), rilevamento per fascia di magnitudine.
+ * Tempi in secondi di clock di controllo (le soglie RUNAWAY_*_MS sono
+ * su quel clock); --scale 1 = forno in tempo reale.
+ *
+ * USO:
+ *   make -C host campaign
+ *   host/build/fault_campaign [--runs 2000] [--seed 1] [--jobs N]
+ *                             [--window 420] [--scale 1] [--out runs.csv]
+ * ================================================================
+ */
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "debug_config.h"
+#include "hardware.h"
+#include "app_state.h"
+#include "control_clock.h"
+#include "forno_control.h"
+#include "simulator.h"
+#include "fork_pool.h"
+
+#if !SIMULATOR_MODE
+  #error "La build host richiede SIMULATOR_MODE=1 (nessun hardware reale)"
+#endif
+
+static float s_graph_base[GRAPH_BUF_SIZE];
+static float s_graph_cielo[GRAPH_BUF_SIZE];
+GraphBuffer g_graph = { s_graph_base, s_graph_cielo, 0, 0 };
+
+// ================================================================
+//  CORSA
+// ================================================================
+enum class Fault : uint8_t { NONE = 0, OVERTEMP, TC_ERROR, RUNAWAY_UP, RUNAWAY_DOWN, COUNT };
+enum class Benign : uint8_t { HOLD = 0, PIZZAS, SWITCH_OFF, SP_DOWN, COUNT };
+
+static const char* const k_fault_names[]  = { "NONE", "OVERTEMP", "TC_ERROR", "RUNAWAY_UP", "RUNAWAY_DOWN" };
+static const char* const k_benign_names[] = { "hold", "pizzas", "switch_off", "sp_down" };
+static const char* const k_reason_names[] = { "NONE", "TC_ERROR", "OVERTEMP", "RUNAWAY_DOWN",
+                                              "RUNAWAY_UP", "WDG_TIMEOUT" };
+#define N_REASONS  6
+
+// Intervallo di magnitudine per guasto (NONE: parametro del disturbo benigno)
+struct MagRange { float lo, hi; const char* unit; };
+static const MagRange k_mag[(int)Fault::COUNT] = {
+  { 0.0f,                  1.0f,                  ""     },
+  { TEMP_MAX_SAFE - 30.0f, TEMP_MAX_SAFE + 60.0f, "°C"   },
+  { 1.0f,                  20.0f,                 "NAN"  },
+  { 100.0f,                SIM_POWER_W,           "W"    },
+  { 2.0f,                  40.0f,                 "×k"   },
+};
+
+struct RunSpec {
+  Fault    fault;
+  Benign   benign;
+  bool     dual;
+  float    sp;
+  float    noise;
+  float    onset_s;
+  float    magnitude;
+  uint32_t seed;
+};
+
+struct RunResult {
+  int   reason;        // SafetyReason dello shutdown (0 = nessuno)
+  float latency_s;     // onset → shutdown, clock
+  bool  pre_onset;     // shutdown prima dell'iniezione
+  bool  preheated;     // preriscaldo riuscito entro il limite
+};
+
+struct CampaignConfig {
+  int      runs     = 2000;
+  uint32_t seed     = 1;
+  unsigned jobs     = 0;
+  float    window_s = 420.0f;   // > RUNAWAY_DOWN_MS
+  float    scale    = 1.0f;
+  const char* out   = nullptr;
+};
+
+static SafetyReason expected_reason(const RunSpec& r) {
+  switch (r.fault) {
+    case Fault::OVERTEMP:     return r.magnitude > TEMP_MAX_SAFE ? SafetyReason::OVERTEMP : SafetyReason::NONE;
+    case Fault::TC_ERROR:     return r.dual ? SafetyReason::TC_ERROR : SafetyReason::NONE;
+    case Fault::RUNAWAY_UP:   return SafetyReason::RUNAWAY_UP;
+    case Fault::RUNAWAY_DOWN: return SafetyReason::RUNAWAY_DOWN;
+    default:                  return SafetyReason::NONE;
+  }
+}
+
+static std::vector<RunSpec> make_specs(const CampaignConfig& cfg) {
+  std::mt19937 rng(cfg.seed);
+  auto uni = [&](float lo, float hi) { return std::uniform_real_distribution<float>(lo, hi)(rng); };
+  auto pick = [&](int n) { return std::uniform_int_distribution<int>(0, n - 1)(rng); };
+
+  std::vector<RunSpec> v(cfg.runs);
+  for (auto& r : v) {
+    r.fault     = (Fault)pick((int)Fault::COUNT);
+    r.benign    = (Benign)pick((int)Benign::COUNT);
+    r.dual      = pick(2) == 1;
+    r.sp        = uni(150.0f, 350.0f);
+    r.noise     = uni(0.0f, 1.5f);
+    r.onset_s   = uni(0.0f, 120.0f);
+    r.magnitude = uni(k_mag[(int)r.fault].lo, k_mag[(int)r.fault].hi);
+    r.seed      = (uint32_t)rng();
+    if (r.fault == Fault::NONE) {
+      r.magnitude = r.benign == Benign::PIZZAS  ? (float)(1 + pick(6))
+                  : r.benign == Benign::SP_DOWN ? uni(20.0f, 150.0f) : 0.0f;
+    }
+  }
+  return v;
+}
+
+static void inject(const RunSpec& r) {
+  switch (r.fault) {
+    case Fault::OVERTEMP:
+      g_sim.overtemp_c     = r.magnitude;
+      g_sim.force_overtemp = true;
+      break;
+    case Fault::TC_ERROR:
+      g_sim.tc_error_count = (int)r.magnitude;
+      g_sim.force_tc_error = true;
+      break;
+    case Fault::RUNAWAY_UP:
+      // SSR incollato scoperto a forno spento dall'utente
+      g_state.base_enabled  = false;
+      g_state.cielo_enabled = false;
+      g_sim.ghost_power_w   = r.magnitude;
+      g_sim.ghost_heat      = true;
+      break;
+    case Fault::RUNAWAY_DOWN:
+      g_sim.rwd_loss_k = r.magnitude;
+      g_sim.rwd_inject = true;
+      break;
+    default:
+      switch (r.benign) {
+        case Benign::PIZZAS:     simulator_load_burst((int)r.magnitude, 120.0f); break;
+        case Benign::SWITCH_OFF: g_state.base_enabled = g_state.cielo_enabled = false; break;
+        case Benign::SP_DOWN:    g_state.set_base = g_state.set_cielo = r.sp - r.magnitude; break;
+        default: break;
+      }
+      break;
+  }
+}
+
+// Nel processo figlio: stato globale pulito
+static RunResult run_one(const RunSpec& r, const CampaignConfig& cfg) {
+  RunResult res{ 0, -1.0f, false, false };
+
+  randomSeed(r.seed);
+  host_serial_set_quiet(true);
+  g_mutex = xSemaphoreCreateMutex();
+  control_init();
+  scenario_load(nullptr);
+  g_sim.time_scale = cfg.scale;
+  g_sim.noise_deg  = r.noise;
+  g_state.sensor_mode   = r.dual ? SensorMode::DUAL : SensorMode::SINGLE;
+  g_state.set_base      = r.sp;
+  g_state.set_cielo     = r.sp;
+  g_state.base_enabled  = true;
+  g_state.cielo_enabled = true;
+  control_loop_begin();
+
+  const uint32_t preheat_max_ms = 3600UL * 1000UL;
+  uint32_t stable_ms = 0, onset_ms = 0, inject_ms = 0;
+  bool     injected = false;
+
+  for (;;) {
+    uint32_t now = clock_ms();
+    if (g_emergency_shutdown) {
+      res.reason    = (int)g_state.safety_reason;
+      res.pre_onset = !injected;
+      if (injected) res.latency_s = (now - inject_ms) / 1000.0f;
+      break;
+    }
+    if (!res.preheated) {
+      if (fabsf(g_sim.zone_temp_c[SIM_ZONE_BASE] - r.sp) < SIM_RECOVERY_BAND_DEG) {
+        if (stable_ms == 0) stable_ms = now ? now : 1;
+        else if (now - stable_ms >= 5000) {
+          res.preheated = true;
+          onset_ms = now + (uint32_t)(r.onset_s * 1000.0f);
+        }
+      } else {
+        stable_ms = 0;
+      }
+      if (now >= preheat_max_ms) break;
+    } else if (!injected) {
+      if (now >= onset_ms) {
+        inject(r);
+        injected  = true;
+        inject_ms = now;
+      }
+    } else if (now - inject_ms >= (uint32_t)(cfg.window_s * 1000.0f)) {
+      break;
+    }
+    clock_advance(control_step(now));
+  }
+  return res;
+}
+
+// ================================================================
+//  REPORT
+// ================================================================
+static float percentile(std::vector<float> v, float p) {
+  if (v.empty()) return NAN;
+  std::sort(v.begin(), v.end());
+  size_t i = (size_t)(p * (v.size() - 1) + 0.5f);
+  return v[std::min(i, v.size() - 1)];
+}
+
+static void print_histogram(const std::vector<float>& lat, float window_s) {
+  static const float k_edges[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500 };
+  const int nb = sizeof(k_edges) / sizeof(k_edges[0]);
+  int count[nb + 1] = {};
+  for (float x : lat) {
+    int b = 0;
+    while (b < nb && x >= k_edges[b]) b++;
+    count[b]++;
+  }
+  int peak = *std::max_element(count, count + nb + 1);
+  for (int b = 0; b <= nb; b++) {
+    if (!count[b]) continue;
+    float lo = b == 0 ? 0.0f : k_edges[b - 1];
+    float hi = b == nb ? window_s : k_edges[b];
+    int   w  = peak ? (count[b] * 40 + peak - 1) / peak : 0;
+    printf("    %5.0f–%-5.0fs %5d  %.*s\n", lo, hi, count[b], w,
+           "########################################");
+  }
+}
+
+static void report(const std::vector<RunSpec>& specs, const std::vector<RunResult>& res,
+                   const std::vector<bool>& got, const CampaignConfig& cfg) {
+  int n_ok = 0, n_nopre = 0;
+  for (size_t k = 0; k < specs.size(); k++) {
+    if (!got[k]) continue;
+    n_ok++;
+    if (!res[k].preheated) n_nopre++;
+  }
+
+  printf("\n==================== CAMPAGNA GUASTI ====================\n");
+  printf("corse %d (completate %d, senza preriscaldo %d)  seed %u  finestra %.0fs  scale %.1fx\n",
+         (int)specs.size(), n_ok, n_nopre, cfg.seed, cfg.window_s, cfg.scale);
+  printf("soglie: TEMP_MAX_SAFE %.0f°C  RUNAWAY_RISE %.0f°C/%dms  "
+         "RUNAWAY_DOWN %.0f°C/%dms\n",
+         TEMP_MAX_SAFE, RUNAWAY_RISE_DEG, RUNAWAY_RISE_MS, RUNAWAY_MIN_DROP, RUNAWAY_DOWN_MS);
+
+  for (int reason = 1; reason < N_REASONS; reason++) {
+    int expected = 0, detected = 0, missed = 0, fp = 0, not_expected = 0;
+    std::vector<float> lat;
+    for (size_t k = 0; k < specs.size(); k++) {
+      if (!got[k] || !res[k].preheated) continue;
+      bool exp = (int)expected_reason(specs[k]) == reason;
+      bool hit = res[k].reason == reason;
+      if (exp) {
+        expected++;
+        if (hit && !res[k].pre_onset) { detected++; lat.push_back(res[k].latency_s); }
+        else missed++;
+      } else {
+        not_expected++;
+        if (hit) fp++;
+      }
+    }
+    if (expected == 0 && fp == 0) continue;
+    printf("\n[%s]\n", k_reason_names[reason]);
+    printf("  attese %d  rilevate %d  mancate %d  (%.1f%%)\n", expected, detected, missed,
+           expected ? 100.0 * detected / expected : 0.0);
+    printf("  falsi positivi %d / %d corse non attese  (%.2f%%)\n", fp, not_expected,
+           not_expected ? 100.0 * fp / not_expected : 0.0);
+    if (!lat.empty()) {
+      printf("  latenza [s]  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+             percentile(lat, 0.50f), percentile(lat, 0.90f), percentile(lat, 0.99f),
+             *std::max_element(lat.begin(), lat.end()));
+      print_histogram(lat, cfg.window_s);
+    }
+  }
+
+  // Rilevamento per fascia di magnitudine (guasti con ragione attesa)
+  printf("\nrilevamento per magnitudine (5 fasce)\n");
+  for (int f = 1; f < (int)Fault::COUNT; f++) {
+    const MagRange& m = k_mag[f];
+    int tot[5] = {}, hit[5] = {};
+    for (size_t k = 0; k < specs.size(); k++) {
+      const RunSpec& r = specs[k];
+      if ((int)r.fault != f || !got[k] || !res[k].preheated) continue;
+      SafetyReason exp = expected_reason(r);
+      if (exp == SafetyReason::NONE) continue;
+      int b = (int)((r.magnitude - m.lo) / (m.hi - m.lo) * 5.0f);
+      b = std::max(0, std::min(4, b));
+      tot[b]++;
+      if (res[k].reason == (int)exp && !res[k].pre_onset) hit[b]++;
+    }
+    printf("  %-13s", k_fault_names[f]);
+    for (int b = 0; b < 5; b++) {
+      float lo = m.lo + (m.hi - m.lo) * b / 5.0f;
+      if (tot[b]) printf("  ≥%.0f%s %3.0f%%", lo, m.unit, 100.0f * hit[b] / tot[b]);
+      else        printf("  ≥%.0f%s    -", lo, m.unit);
+    }
+    printf("\n");
+  }
+  printf("==========================================================\n");
+}
+
+static void write_csv(const char* path, const std::vector<RunSpec>& specs,
+                      const std::vector<RunResult>& res, const std::vector<bool>& got) {
+  FILE* f = fopen(path, "w");
+  if (!f) { perror(path); return; }
+  fprintf(f, "run,fault,benign,mode,sp,noise,onset_s,magnitude,expected,reason,"
+             "latency_s,pre_onset,preheated\n");
+  for (size_t k = 0; k < specs.size(); k++) {
+    const RunSpec& r = specs[k];
+    fprintf(f, "%zu,%s,%s,%s,%.1f,%.2f,%.1f,%.2f,%s,%s,%.2f,%d,%d\n",
+            k, k_fault_names[(int)r.fault],
+            r.fault == Fault::NONE ? k_benign_names[(int)r.benign] : "",
+            r.dual ? "DUAL" : "SINGLE", r.sp, r.noise, r.onset_s, r.magnitude,
+            k_reason_names[(int)expected_reason(r)],
+            got[k] ? k_reason_names[res[k].reason % N_REASONS] : "CRASH",
+            res[k].latency_s, res[k].pre_onset ? 1 : 0, res[k].preheated ? 1 : 0);
+  }
+  fclose(f);
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+    "uso: %s [--runs N] [--seed N] [--jobs N] [--window S] [--scale X] [--out F.csv]\n",
+    argv0);
+}
+
+int main(int argc, char** argv) {
+  CampaignConfig cfg;
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if (!v) { usage(argv[0]); return 2; }
+    i++;
+    if      (!strcmp(a, "--runs"))   cfg.runs     = atoi(v);
+    else if (!strcmp(a, "--seed"))   cfg.seed     = (uint32_t)strtoul(v, nullptr, 10);
+    else if (!strcmp(a, "--jobs"))   cfg.jobs     = (unsigned)atoi(v);
+    else if (!strcmp(a, "--window")) cfg.window_s = (float)atof(v);
+    else if (!strcmp(a, "--scale"))  cfg.scale    = (float)atof(v);
+    else if (!strcmp(a, "--out"))    cfg.out      = v;
+    else { usage(argv[0]); return 2; }
+  }
+  if (cfg.runs <= 0) { usage(argv[0]); return 2; }
+
+  std::vector<RunSpec>   specs = make_specs(cfg);
+  std::vector<RunResult> res(specs.size());
+  std::vector<bool>      got(specs.size(), false);
+
+  auto t0 = std::chrono::steady_clock::now();
+  size_t n_done = 0;
+  bool ran = fork_pool_run<RunResult>(specs.size(), cfg.jobs,
+    [&](size_t k) { return run_one(specs[k], cfg); },
+    [&](size_t k, const RunResult& r, bool ok) {
+      res[k] = r;
+      got[k] = ok;
+      if (++n_done % 500 == 0) fprintf(stderr, "[CAMPAGNA] %zu/%zu\n", n_done, specs.size());
+    });
+  double cpu_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  if (!ran) return 2;
+
+  report(specs, res, got, cfg);
+  printf("tempo %.1f s\n", cpu_s);
+  if (cfg.out) write_csv(cfg.out, specs, res, got);
+  return 0;
+}
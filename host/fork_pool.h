@@ -0,0 +1,70 @@
+/**
+ * host/fork_pool.h — Forno Pizza S3 — Job in processi figli (solo host)
+ * ================================================================
+ * Il core di controllo vive su globali (g_state, g_sim, statici di
+ * Task_PID): una corsa non si può ripetere nello stesso processo.
+ * fork_pool_run() esegue ogni job k in un figlio appena forkato
+ * (stato pulito per costruzione), al più max_par insieme; il figlio
+ * rimanda un risultato R (trivially copyable) su una pipe.
+ *
+ *   run(k)              → R        nel figlio, stdout su /dev/null
+ *   done(k, r, got)                nel padre, in ordine di arrivo;
+ *                                  got=false se il figlio è morto
+ *
+ * Header-only, POSIX: non usato dal firmware.
+ * ================================================================
+ */
+#pragma once
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+template <typename R, typename RunFn, typename DoneFn>
+bool fork_pool_run(size_t n, unsigned max_par, RunFn run, DoneFn done) {
+  static_assert(std::is_trivially_copyable<R>::value, "R passa su una pipe");
+  if (max_par == 0) max_par = std::thread::hardware_concurrency();
+  if (max_par == 0) max_par = 1;
+
+  struct Slot { pid_t pid; int fd; size_t k; };
+  std::vector<Slot> live;
+
+  auto reap = [&]() {
+    int   status = 0;
+    pid_t pid = wait(&status);
+    for (size_t i = 0; i < live.size(); i++) {
+      if (live[i].pid != pid) continue;
+      R    r{};
+      bool got = read(live[i].fd, &r, sizeof(r)) == (ssize_t)sizeof(r);
+      close(live[i].fd);
+      size_t k = live[i].k;
+      live.erase(live.begin() + i);
+      done(k, r, got);
+      return;
+    }
+  };
+
+  for (size_t k = 0; k < n; k++) {
+    while (live.size() >= max_par) reap();
+    int p[2];
+    if (pipe(p) != 0) { perror("pipe"); return false; }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) { perror("fork"); close(p[0]); close(p[1]); return false; }
+    if (pid == 0) {
+      close(p[0]);
+      int devnull = open("/dev/null", O_WRONLY);
+      if (devnull >= 0) dup2(devnull, STDOUT_FILENO);
+      R r = run(k);
+      ssize_t w = write(p[1], &r, sizeof(r));
+      _exit(w == (ssize_t)sizeof(r) ? 0 : 1);
+    }
+    close(p[1]);
+    live.push_back(Slot{ pid, p[0], k });
+  }
+  while (!live.empty()) reap();
+  return true;
+}
@@ -0,0 +1,266 @@
+/**
+ * host/forno_host.cpp — Forno Pizza S3 — Runner host Linux
+ * ================================================================
+ * Esegue il core di controllo (forno_control.cpp) + simulatore +
+ * autotune sulla workstation, a tempo virtuale, fino al termine
+ * dello scenario di test (o fino a --max-s secondi).
+ *
+ * USO:
+ *   make -C host run
+ *   host/build/forno_host [--quiet] [--max-s N] [--seed N] [--scale X] [--dual]
+ *                         [--pizzas N --every S [--bake S]]
+ *                         [--scenario F.scn ... [--jobs N]] [--emit-c F.scn]
+ *                         [--trace F.trc] [--budget W]
+ *
+ *   --max-s  limite in secondi di clock di controllo (default 4 h)
+ *   --scale  g_sim.time_scale (default SIM_TIME_SCALE; 1.0 = tempo reale)
+ *   --dual   SensorMode::DUAL (una sonda per zona) invece del SINGLE
+ *            forzato da [SIM-E]
+ *   --pizzas prova di carico al posto della sequenza test: preriscaldo,
+ *            60 s simulati stabili in banda, poi raffica di N pizze ogni
+ *            S secondi simulati (simulator_load_burst) e report recupero.
+ *            Exit code 0 se ogni pizza è stata recuperata.
+ *   --scenario scenario testuale (sim_scenario.h) al posto di k_scn_default.
+ *            Ripetuto = batch: ogni file gira in un processo figlio
+ *            (stato globale isolato), --jobs alla volta (default: core),
+ *            e si stampa una riga PASS/FAIL per file.
+ *   --emit-c traduce F.scn in una tabella SCN_* per il firmware (stdout).
+ *   --trace  registra la trace di Task_PID (control_trace.h) in F.trc,
+ *            da ripassare con host/build/trace_replay. Non in batch.
+ *   --budget budget di potenza Base + Cielo in W (RelayScheduler): sotto
+ *            la somma delle resistenze le finestre relay si sfasano.
+ *
+ * A fine corsa stampa, per zona, l'errore medio assoluto |T_zona - SP|
+ * nei test marcati track (FASE 1 e 7), pesato sul tempo simulato,
+ * picco/media della potenza assorbita dai relay e chiusure per relay
+ * (usura, relay_window.h).
+ *
+ * Exit code: 0 se tutti i test dello scenario passano, 1 altrimenti.
+ * ================================================================
+ */
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "debug_config.h"
+#include "hardware.h"
+#include "app_state.h"
+#include "control_clock.h"
+#include "forno_control.h"
+#include "relay_sched.h"
+#include "simulator.h"
+#include "scenario_parse.h"
+#include "trace_file.h"
+#include "fork_pool.h"
+
+#if !SIMULATOR_MODE
+  #error "La build host richiede SIMULATOR_MODE=1 (nessun hardware reale)"
+#endif
+
+// ── Buffer grafico: su device vive in PSRAM (ui.cpp / graph_alloc_psram) ──
+static float s_graph_base[GRAPH_BUF_SIZE];
+static float s_graph_cielo[GRAPH_BUF_SIZE];
+GraphBuffer g_graph = { s_graph_base, s_graph_cielo, 0, 0 };
+
+// ================================================================
+//  Prova di carico: preriscaldo → raffica pizze → report
+// ================================================================
+static int run_load(uint32_t max_s, int pizzas, float every_s, float bake_s) {
+  scenario_load(nullptr);   // nessuno scenario: solo il carico
+  g_state.base_enabled  = true;
+  g_state.cielo_enabled = true;
+
+  bool  burst = false;
+  float stable_since = -1.0f;
+  while (clock_ms() < max_s * 1000UL) {
+    clock_advance(control_step(clock_ms()));
+    if (g_emergency_shutdown) break;
+
+    if (!burst) {
+      float err = fabsf(g_sim.zone_temp_c[SIM_ZONE_BASE] - (float)g_state.set_base);
+      if (err > SIM_RECOVERY_BAND_DEG) stable_since = -1.0f;
+      else if (stable_since < 0.0f)    stable_since = g_sim.time_elapsed_s;
+      else if (g_sim.time_elapsed_s - stable_since >= 60.0f) {
+        Serial.printf("[HOST] Preriscaldo completato in %.0f s simulati\n", g_sim.time_elapsed_s);
+        simulator_load_burst(pizzas, every_s, bake_s);
+        burst = true;
+      }
+    } else if (simulator_load_done()) {
+      break;
+    }
+  }
+
+  host_serial_set_quiet(false);
+  simulator_load_report();
+  simulator_power_report();
+  bool ok = burst && simulator_load_done() && !g_emergency_shutdown &&
+            g_sim.load_unrecovered == 0 && g_sim.load_count == pizzas;
+  if (!ok) Serial.printf("[HOST] Prova di carico incompleta%s\n",
+                         g_emergency_shutdown ? " (shutdown di sicurezza)" : "");
+  return ok ? 0 : 1;
+}
+
+// ================================================================
+//  Scenario: esegue fino a scenario_done() o --max-s
+// ================================================================
+struct RunResult {
+  int   passed, total;
+  bool  done;
+  float sim_min;
+};
+
+static RunResult run_scenario(uint32_t max_s) {
+  auto t0 = std::chrono::steady_clock::now();
+  uint32_t steps = 0;
+  double   abs_err_s[SIM_ZONES] = {}, on_s[SIM_ZONES] = {};
+  while (!scenario_done() && clock_ms() < max_s * 1000UL) {
+    float    t_sim0  = g_sim.time_elapsed_s;
+    uint32_t wait_ms = control_step(clock_ms());
+    clock_advance(wait_ms);
+    steps++;
+
+    // Qualità di controllo per zona: pesata sul tempo simulato del ciclo
+    float dt = g_sim.time_elapsed_s - t_sim0;
+    if (!scenario_tracking() || g_emergency_shutdown || dt <= 0.0f) continue;
+    const bool   en[SIM_ZONES] = { g_state.base_enabled, g_state.cielo_enabled };
+    const double sp[SIM_ZONES] = { g_state.set_base,     g_state.set_cielo     };
+    for (int z = 0; z < SIM_ZONES; z++) {
+      if (!en[z]) continue;
+      abs_err_s[z] += fabs(g_sim.zone_temp_c[z] - sp[z]) * dt;
+      on_s[z]      += dt;
+    }
+  }
+  double cpu_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  host_serial_set_quiet(false);
+  Serial.printf("[HOST] %s dopo %lu cicli — clock %.1f min, simulato %.1f min, CPU %.3f s (%.0fx)\n",
+                scenario_done() ? "Sequenza completata" : "Timeout",
+                (unsigned long)steps, clock_ms() / 60000.0, g_sim.time_elapsed_s / 60.0, cpu_s,
+                cpu_s > 0.0 ? g_sim.time_elapsed_s / cpu_s : 0.0);
+  Serial.printf("[HOST] Test passati: %d/%d\n", scenario_tests_passed(), scenario_tests_total());
+  Serial.printf("[HOST] %s — errore medio |T-SP|: base %.1f °C, cielo %.1f °C\n",
+                g_state.sensor_mode == SensorMode::DUAL ? "DUAL" : "SINGLE",
+                on_s[SIM_ZONE_BASE]  > 0 ? abs_err_s[SIM_ZONE_BASE]  / on_s[SIM_ZONE_BASE]  : 0.0,
+                on_s[SIM_ZONE_CIELO] > 0 ? abs_err_s[SIM_ZONE_CIELO] / on_s[SIM_ZONE_CIELO] : 0.0);
+  Serial.printf("[HOST] Chiusure relay: base %lu, cielo %lu (finestra %s)\n",
+                (unsigned long)g_relays.cycles(RelayZone::BASE),
+                (unsigned long)g_relays.cycles(RelayZone::CIELO),
+                FEATURE_RELAY_WINDOW ? "adattiva" : "fissa");
+  simulator_power_report();
+
+  return RunResult{ scenario_tests_passed(), scenario_tests_total(), scenario_done(),
+                    g_sim.time_elapsed_s / 60.0f };
+}
+
+static bool run_ok(const RunResult& r) {
+  return r.done && r.total > 0 && r.passed == r.total;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "uso: %s [--quiet] [--max-s N] [--seed N] [--scale X] [--dual]\n"
+                  "          [--pizzas N --every S [--bake S]]\n"
+                  "          [--scenario F.scn ... [--jobs N]] [--emit-c F.scn]\n"
+                  "          [--trace F.trc] [--budget W]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  bool     quiet = false;
+  uint32_t max_s = 4 * 3600;
+  unsigned long seed = 1;
+  float    scale = SIM_TIME_SCALE;
+  bool     dual  = false;
+  int      pizzas = 0;
+  float    every_s = 300.0f, bake_s = SIM_PIZZA_BAKE_S;
+  std::vector<const char*> scenarios;
+  unsigned jobs = 0;
+  const char* emit_c = nullptr;
+  const char* trace  = nullptr;
+  float       budget = -1.0f;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--quiet"))                  quiet = true;
+    else if (!strcmp(argv[i], "--max-s") && i + 1 < argc) max_s = (uint32_t)atol(argv[++i]);
+    else if (!strcmp(argv[i], "--seed")  && i + 1 < argc) seed  = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--scale") && i + 1 < argc) scale = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "--dual"))                   dual  = true;
+    else if (!strcmp(argv[i], "--pizzas") && i + 1 < argc) pizzas  = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--every")  && i + 1 < argc) every_s = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "--bake")   && i + 1 < argc) bake_s  = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "--scenario") && i + 1 < argc) scenarios.push_back(argv[++i]);
+    else if (!strcmp(argv[i], "--jobs")   && i + 1 < argc) jobs    = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--emit-c") && i + 1 < argc) emit_c  = argv[++i];
+    else if (!strcmp(argv[i], "--trace")  && i + 1 < argc) trace   = argv[++i];
+    else if (!strcmp(argv[i], "--budget") && i + 1 < argc) budget  = (float)atof(argv[++i]);
+    else { usage(argv[0]); return 2; }
+  }
+
+  // Scenari analizzati prima di partire: un errore di sintassi non costa una corsa
+  std::vector<ScnScript> scripts(scenarios.size());
+  for (size_t k = 0; k < scenarios.size(); k++) {
+    std::string err;
+    if (!scenario_parse_file(scenarios[k], scripts[k], err)) {
+      fprintf(stderr, "%s\n", err.c_str());
+      return 2;
+    }
+  }
+  if (emit_c) {
+    ScnScript   s;
+    std::string err;
+    if (!scenario_parse_file(emit_c, s, err)) { fprintf(stderr, "%s\n", err.c_str()); return 2; }
+    scenario_emit_c(s, "k_scn_custom", stdout);
+    return 0;
+  }
+
+  // Avvio comune: ogni figlio del batch lo ripete nel proprio processo
+  auto boot = [&](const ScnStep* steps) {
+    randomSeed(seed);
+    g_mutex = xSemaphoreCreateMutex();
+    control_init();
+    g_sim.time_scale = scale;
+    if (dual) g_state.sensor_mode = SensorMode::DUAL;
+    if (steps) scenario_load(steps);
+    control_loop_begin();
+    if (budget >= 0.0f) g_relays.setPowerBudget(budget);
+  };
+
+  // Batch: un processo figlio per scenario (stato globale isolato)
+  if (scripts.size() > 1) {
+    int ok = 0;
+    bool ran = fork_pool_run<RunResult>(scripts.size(), jobs,
+      [&](size_t k) {
+        host_serial_set_quiet(true);
+        boot(scripts[k].steps.data());
+        return run_scenario(max_s);
+      },
+      [&](size_t k, const RunResult& r, bool got) {
+        bool pass = got && run_ok(r);
+        if (pass) ok++;
+        printf("[BATCH] %s  %-40s %d/%d  %.1f min simulati\n",
+               pass ? "PASS" : "FAIL", scripts[k].path.c_str(),
+               got ? r.passed : 0, got ? r.total : 0, got ? r.sim_min : 0.0f);
+        fflush(stdout);
+      });
+    printf("[BATCH] Scenari passati: %d/%zu\n", ok, scripts.size());
+    return (ran && ok == (int)scripts.size()) ? 0 : 1;
+  }
+
+  FILE* trace_f = nullptr;
+  if (trace) {
+    trace_f = trace_file_open(trace);
+    if (!trace_f) return 2;
+    control_trace_set_sink(trace_sink_file, trace_f);
+  }
+
+  host_serial_set_quiet(quiet);
+  boot(scripts.empty() ? nullptr : scripts[0].steps.data());
+
+  int rc = 0;
+  if (pizzas > 0) rc = run_load(max_s, pizzas, every_s, bake_s);
+  else            rc = run_ok(run_scenario(max_s)) ? 0 : 1;
+
+  if (trace_f) fclose(trace_f);
+  return rc;
+}
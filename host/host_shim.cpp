@@ -0,0 +1,62 @@
+/**
+ * host/host_shim.cpp — Implementazione degli shim Arduino/FreeRTOS
+ * ================================================================
+ * Tempo virtuale: millis() parte da 0 e avanza SOLO con delay() o
+ * vTaskDelay(). Non si dorme mai davvero: un'ora di forno simulato
+ * gira in pochi secondi di CPU.
+ * ================================================================
+ */
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <chrono>
+#include <mutex>
+
+HostSerial Serial;
+
+// ================================================================
+//  TEMPO VIRTUALE
+// ================================================================
+static uint32_t s_now_ms = 0;
+
+unsigned long millis()           { return s_now_ms; }
+void delay(uint32_t ms)          { s_now_ms += ms; }
+void vTaskDelay(TickType_t t)    { s_now_ms += t * portTICK_PERIOD_MS; }
+void host_set_millis(uint32_t ms) { s_now_ms = ms; }
+
+void host_serial_set_quiet(bool quiet) { Serial._quiet = quiet; }
+
+// ================================================================
+//  RANDOM — LCG deterministico (riproducibilità dei run host)
+// ================================================================
+static uint32_t s_rng = 1;
+
+void randomSeed(unsigned long seed) { s_rng = (uint32_t)seed ? (uint32_t)seed : 1; }
+
+long random(long lo, long hi) {
+  if (hi <= lo) return lo;
+  s_rng = s_rng * 1664525u + 1013904223u;
+  return lo + (long)((s_rng >> 8) % (uint32_t)(hi - lo));
+}
+
+// ================================================================
+//  MUTEX
+// ================================================================
+struct HostSemaphore {
+  std::timed_mutex m;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new HostSemaphore(); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+  if (!s) return pdFALSE;
+  if (ticks == portMAX_DELAY) { s->m.lock(); return pdTRUE; }
+  return s->m.try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+  if (!s) return pdFALSE;
+  s->m.unlock();
+  return pdTRUE;
+}
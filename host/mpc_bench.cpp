@@ -0,0 +1,312 @@
+/**
+ * host/mpc_bench.cpp — Forno Pizza S3 — MPC contro PID nel simulatore
+ * ================================================================
+ * Riscaldamento da ambiente al setpoint e tenuta, stesso forno per i
+ * due controlli:
+ *   PID   come Task_PID: preriscaldo a piena potenza (preheat.h), hand-off
+ *         a PIDController Base/Cielo con guadagni di default e feedforward
+ *         dal k del modello (feedforward.h)
+ *   MPC   MpcController (mpc_ctrl.h) dal freddo, stesso modello
+ * Relay da RelayScheduler (relay_sched.h) in entrambi i casi: finestra,
+ * duty min/max, tempi minimi, budget di potenza.
+ *
+ * Plant a nodo singolo come host/pid_sweep (sim_thermal_step, costanti
+ * totali di simulator.h, ritardo SIM_DEAD_TIME_S), ma la potenza è la
+ * somma delle resistenze accese: il budget deve contare. Il modello
+ * dato ai controlli è quello del plant, moltiplicato per --k-err e
+ * --c-err nel caso "modello errato". La rete a due zone si prova con
+ * make MPC=1 e gli scenari (scenarios/preheat.scn).
+ *
+ * CASI: libero, tempi minimi relay (--min-on), budget di potenza
+ * (--budget; con Base e Cielo mai accese insieme il forno arriva al più
+ * a T_amb + P_base/k, quindi il setpoint del caso è --budget-sp),
+ * modello errato.
+ *
+ * --trace F.csv scrive T̄ e duty di ogni finestra, per caso e controllo.
+ *
+ * METRICHE sulla temperatura media di ogni finestra relay (il ripple
+ * della finestra c'è con qualunque controllo e non dice niente della
+ * regolazione; il picco istantaneo è a parte):
+ *   over_C     max(T̄) - SP [°C]
+ *   peak_C     max(T) - SP, istantaneo
+ *   settle_s   fine della finestra con l'ultimo ingresso definitivo di T̄
+ *              in ±band attorno a SP (-1 = non stabilizzato)
+ *   rms_C      scarto quadratico medio di T̄ da SP nella seconda metà
+ *   energy_Wh  energia assorbita
+ *   switch     commutazioni relay Base + Cielo
+ *   solve      tempo medio e massimo di una decisione MPC (una ogni
+ *              RELAY_WINDOW_MS) e passi di modello valutati
+ *
+ * USO:
+ *   make -C host mpcbench
+ *   host/build/mpc_bench [--sp 250] [--duration 3600] [--band 3]
+ *                        [--min-on 5] [--budget 1500] [--budget-sp 180]
+ *                        [--k-err 1.3] [--c-err 0.7] [--trace F.csv]
+ * ================================================================
+ */
+#include <Arduino.h>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hardware.h"
+#include "nvs_storage.h"
+#include "pid_ctrl.h"
+#include "relay_sched.h"
+#include "preheat.h"
+#include "feedforward.h"
+#include "mpc_ctrl.h"
+#include "simulator.h"
+
+struct BenchConfig {
+  double   sp         = DEFAULT_SET_BASE;
+  uint32_t duration_s = 3600;
+  double   band       = 3.0;
+  uint32_t min_on_ms  = 5000;
+  float    budget_w   = 1500.0f;
+  double   budget_sp  = 180.0;
+  float    k_err      = 1.3f;
+  float    c_err      = 0.7f;
+};
+
+struct Case {
+  const char* name;
+  double      sp;
+  uint32_t    min_on_ms;     // = min_off
+  float       budget_w;
+  float       k_err, c_err;
+};
+
+struct Result {
+  float    over_c    = 0;
+  float    peak_c    = 0;
+  float    settle_s  = -1;
+  float    rms_c     = 0;
+  float    energy_wh = 0;
+  uint32_t switches  = 0;
+  // solo MPC
+  uint32_t solves    = 0;
+  double   solve_ns  = 0, solve_max_ns = 0;
+  uint32_t evals_max = 0;
+};
+
+// ================================================================
+//  Forno: plant, relay e metriche comuni ai due controlli
+// ================================================================
+struct Oven {
+  const BenchConfig& cfg;
+  const double   sp;
+  RelayScheduler relays;
+  SimDeadLine    dead;
+  FILE*       trace;
+  const char* name;
+  const char* tag;
+  float    t     = SIM_T_AMBIENT;
+  float    t_max = SIM_T_AMBIENT, m_max = SIM_T_AMBIENT;
+  double   joule = 0, sq = 0;
+  double   w_sum = 0, w_duty = 0;        // finestra corrente
+  uint32_t w_n   = 0, n_sq = 0, settle_ms = 0;
+  bool     in_band = false;
+
+  Oven(const BenchConfig& c, const Case& k, FILE* f, const char* ctrl)
+    : cfg(c), sp(k.sp), trace(f), name(k.name), tag(ctrl) {
+    relays.begin(0, RELAY_WINDOW_MS, k.min_on_ms, k.min_on_ms);
+    relays.setPowerBudget(k.budget_w, SIM_POWER_BASE_W, SIM_POWER_CIELO_W);
+    sim_dead_reset(dead, 0);
+  }
+
+  // Un ciclo di Task_PID: relay dai duty, plant avanti di PID_SAMPLE_MS
+  void step(uint32_t now, float duty_base, float duty_cielo) {
+    bool    nb   = relays.request(RelayZone::BASE,  duty_base,  now);
+    bool    nc   = relays.request(RelayZone::CIELO, duty_cielo, now);
+    uint8_t bits = sim_dead_step(dead, now / 1000.0f, (nb ? 1 : 0) | (nc ? 2 : 0), SIM_DEAD_TIME_S);
+    float   p_in = ((bits & 1) ? SIM_POWER_BASE_W : 0.0f) + ((bits & 2) ? SIM_POWER_CIELO_W : 0.0f);
+    float   dt_s = PID_SAMPLE_MS / 1000.0f;
+    t = sim_thermal_step(t, p_in, sim_heat_loss(t), dt_s);
+    joule += (double)p_in * dt_s;
+    if (t > t_max) t_max = t;
+
+    w_sum  += t;
+    w_duty += (duty_base + duty_cielo) * 0.5;
+    if (++w_n * PID_SAMPLE_MS < RELAY_WINDOW_MS) return;
+    uint32_t end_ms = now + PID_SAMPLE_MS;
+    float    m      = (float)(w_sum / w_n);
+    if (m > m_max) m_max = m;
+    bool ib = fabs(m - sp) <= cfg.band;
+    if (ib && !in_band) settle_ms = end_ms;
+    in_band = ib;
+    if (end_ms > cfg.duration_s * 500UL) { sq += (m - sp) * (m - sp); n_sq++; }
+    if (trace) fprintf(trace, "%s,%s,%.0f,%.2f,%.1f\n", name, tag, end_ms / 1000.0, m, w_duty / w_n);
+    w_sum = w_duty = 0;
+    w_n   = 0;
+  }
+
+  void report(Result& r) const {
+    r.over_c    = m_max > sp ? (float)(m_max - sp) : 0.0f;
+    r.peak_c    = t_max > sp ? (float)(t_max - sp) : 0.0f;
+    r.settle_s  = in_band ? settle_ms / 1000.0f : -1.0f;
+    r.rms_c     = n_sq ? (float)sqrt(sq / n_sq) : 0.0f;
+    r.energy_wh = (float)(joule / 3600.0);
+    r.switches  = relays.switches(RelayZone::BASE) + relays.switches(RelayZone::CIELO);
+  }
+};
+
+static PlantModel bench_model(const Case& k) {
+  PlantModel m = {};
+  m.power_w = SIM_POWER_W;
+  m.k_loss  = SIM_K_LOSS * k.k_err;
+  m.mass    = SIM_THERMAL_MASS * k.c_err;
+  m.t_amb   = SIM_T_AMBIENT;
+  m.dead_s  = SIM_DEAD_TIME_S;
+  m.tau_s   = m.mass / m.k_loss;
+  return m;
+}
+
+// ================================================================
+//  PID come Task_PID: preriscaldo, hand-off, feedforward
+// ================================================================
+static Result run_pid(const BenchConfig& cfg, const Case& k, FILE* trace) {
+  Oven   oven(cfg, k, trace, "PID");
+  double temp = oven.t, sp = k.sp, out_b = 0, out_c = 0;
+  PIDController pid_b(&temp, &out_b, &sp, DEFAULT_KP_BASE,  DEFAULT_KI_BASE,  DEFAULT_KD_BASE);
+  PIDController pid_c(&temp, &out_c, &sp, DEFAULT_KP_CIELO, DEFAULT_KI_CIELO, DEFAULT_KD_CIELO);
+  LossFeedforward ff;
+  Preheat         ph;
+  ff.begin(SIM_POWER_W, bench_model(k).k_loss);
+  pid_b.begin();  pid_c.begin();
+  pid_b.setFeedforward(ff.dutyPct((float)sp));
+  pid_c.setFeedforward(ff.dutyPct((float)sp));
+  pid_b.setEnabled(true);
+  pid_c.setEnabled(true);
+  if (ph.start(oven.t, (float)sp, 0)) { pid_b.setEnabled(false); pid_c.setEnabled(false); }
+
+  for (uint32_t now = 0; now < cfg.duration_s * 1000UL; now += PID_SAMPLE_MS) {
+    temp = oven.t;
+    if (ph.ramping()) out_b = out_c = 100.0;
+    if (ph.step(oven.t, (float)sp, now)) {
+      pid_b.startFrom(ph.preloadPct());
+      pid_c.startFrom(ph.preloadPct());
+    }
+    pid_b.compute(now);
+    pid_c.compute(now);
+    oven.step(now, pid_b.duty(100), pid_c.duty(100));
+  }
+  Result r;
+  oven.report(r);
+  return r;
+}
+
+// ================================================================
+//  MPC dal freddo
+// ================================================================
+static Result run_mpc(const BenchConfig& cfg, const Case& k, FILE* trace) {
+  Oven   oven(cfg, k, trace, "MPC");
+  Result r;
+  MpcController mpc;
+  const float pw[RELAY_ZONES]  = { SIM_POWER_BASE_W, SIM_POWER_CIELO_W };
+  const int   pct[RELAY_ZONES] = { 100, 100 };
+  mpc.begin();
+  mpc.setModel(bench_model(k));
+  mpc.setActuators(pw, pct, k.budget_w, k.min_on_ms, k.min_on_ms, RELAY_WINDOW_MS);
+  oven.relays.setStagger(true);            // come Task_PID con FEATURE_MPC
+  const float out0[RELAY_ZONES] = { 0.0f, 0.0f };
+  mpc.start(out0, false, 0);
+
+  for (uint32_t now = 0; now < cfg.duration_s * 1000UL; now += PID_SAMPLE_MS) {
+    auto t0     = std::chrono::steady_clock::now();
+    const float pv[RELAY_ZONES] = { oven.t, oven.t };
+    const float sp[RELAY_ZONES] = { (float)k.sp, (float)k.sp };
+    bool solved = mpc.step(pv, sp, now);
+    if (solved) {
+      double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+      r.solves++;
+      r.solve_ns += ns;
+      if (ns > r.solve_max_ns)       r.solve_max_ns = ns;
+      if (mpc.evals() > r.evals_max) r.evals_max = mpc.evals();
+    }
+    float out = mpc.outPct(0);
+    oven.step(now, out, out);
+  }
+  oven.report(r);
+  if (r.solves) r.solve_ns /= r.solves;
+  return r;
+}
+
+// ================================================================
+//  CLI
+// ================================================================
+static void usage(const char* argv0) {
+  fprintf(stderr,
+    "uso: %s [--sp C] [--duration S] [--band C] [--min-on S] [--budget W]\n"
+    "          [--budget-sp C] [--k-err X] [--c-err X] [--trace F.csv]\n", argv0);
+}
+
+static void print_row(const char* name, double sp, const char* ctrl, const Result& r) {
+  char spc[8] = "";
+  if (name[0]) snprintf(spc, sizeof spc, "%.0f", sp);
+  printf("  %-16s %4s  %-4s %7.1f %7.1f %9.0f %7.2f %10.1f %7u\n",
+         name, spc, ctrl, r.over_c, r.peak_c, r.settle_s, r.rms_c, r.energy_wh, r.switches);
+}
+
+int main(int argc, char** argv) {
+  BenchConfig cfg;
+  const char* trace_path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    bool ok = v != nullptr;
+    if      (!strcmp(a, "--sp")        && ok) cfg.sp = atof(v);
+    else if (!strcmp(a, "--duration")  && ok) cfg.duration_s = (uint32_t)atol(v);
+    else if (!strcmp(a, "--band")      && ok) cfg.band = atof(v);
+    else if (!strcmp(a, "--min-on")    && ok) cfg.min_on_ms = (uint32_t)(atof(v) * 1000.0);
+    else if (!strcmp(a, "--budget")    && ok) cfg.budget_w = (float)atof(v);
+    else if (!strcmp(a, "--budget-sp") && ok) cfg.budget_sp = atof(v);
+    else if (!strcmp(a, "--k-err")     && ok) cfg.k_err = (float)atof(v);
+    else if (!strcmp(a, "--c-err")     && ok) cfg.c_err = (float)atof(v);
+    else if (!strcmp(a, "--trace")     && ok) trace_path = v;
+    else ok = false;
+    if (!ok || cfg.duration_s == 0) { usage(argv[0]); return 2; }
+    i++;
+  }
+
+  FILE* trace = nullptr;
+  if (trace_path) {
+    trace = fopen(trace_path, "w");
+    if (!trace) { perror(trace_path); return 1; }
+    fprintf(trace, "caso,ctrl,t_s,temp_avg,duty\n");
+  }
+
+  char min_on_name[32], budget_name[32], err_name[32];
+  snprintf(min_on_name, sizeof min_on_name, "ON/OFF min %.0fs", cfg.min_on_ms / 1000.0);
+  snprintf(budget_name, sizeof budget_name, "budget %.0f W", cfg.budget_w);
+  snprintf(err_name,    sizeof err_name,    "k×%.1f C×%.1f", cfg.k_err, cfg.c_err);
+  const Case cases[] = {
+    { "libero",    cfg.sp,        0,             0.0f,         1.0f,      1.0f      },
+    { min_on_name, cfg.sp,        cfg.min_on_ms, 0.0f,         1.0f,      1.0f      },
+    { budget_name, cfg.budget_sp, 0,             cfg.budget_w, 1.0f,      1.0f      },
+    { err_name,    cfg.sp,        0,             0.0f,         cfg.k_err, cfg.c_err },
+  };
+
+  printf("[MPC-BENCH] %lu s, banda ±%.1f °C, nodo singolo %.0f W k=%.1f W/°C C=%.0f J/°C, finestra %lu s\n",
+         (unsigned long)cfg.duration_s, cfg.band, SIM_POWER_W, SIM_K_LOSS, SIM_THERMAL_MASS,
+         (unsigned long)(RELAY_WINDOW_MS / 1000));
+  printf("  caso               SP  ctrl  over_C  peak_C  settle_s   rms_C  energy_Wh  switch\n");
+  Result tot;
+  for (const Case& k : cases) {
+    Result p = run_pid(cfg, k, trace);
+    Result m = run_mpc(cfg, k, trace);
+    print_row(k.name, k.sp, "PID", p);
+    print_row("",     k.sp, "MPC", m);
+    tot.solves   += m.solves;
+    tot.solve_ns += m.solve_ns * m.solves;
+    if (m.solve_max_ns > tot.solve_max_ns) tot.solve_max_ns = m.solve_max_ns;
+    if (m.evals_max > tot.evals_max)       tot.evals_max = m.evals_max;
+  }
+  if (trace) { fclose(trace); printf("[MPC-BENCH] trace: %s\n", trace_path); }
+  if (tot.solves)
+    printf("[MPC-BENCH] solve(): %u decisioni, %.1f µs medi, %.1f µs max, al più %u passi di modello\n",
+           tot.solves, tot.solve_ns / tot.solves / 1000.0, tot.solve_max_ns / 1000.0, tot.evals_max);
+  return 0;
+}
@@ -0,0 +1,235 @@
+/**
+ * host/pid_bench.cpp — Forno Pizza S3 — Benchmark motore PID per tipo
+ * ================================================================
+ * Confronta PIDCoreT<double> (percorso storico PID_v1) con float e Q16
+ * (pid_core.h, fixed_q16.h):
+ *
+ *   costo      cicli TSC e ns per compute(), minimo su --reps ripetizioni
+ *              di --n chiamate: solo motore (PIDCoreT<T>) e percorso di
+ *              Task_PID (PIDControllerT<T>: copie da/verso AppState in
+ *              double + duty() + richiesta a RelayScheduler)
+ *   fedeltà    stessi ingressi per tutti i tipi: la traiettoria di
+ *              temperatura di un riscaldamento ad anello chiuso col PID
+ *              double (nodo singolo, sim_thermal_step). Si riportano
+ *              |Δout| massimo, i campioni con ms ON della finestra
+ *              (RelayScheduler::onTimeMs) diversi dal double di oltre
+ *              1 ms e lo scarto massimo (un valore vicino a una soglia
+ *              duty min/max può scattare)
+ *
+ * Nota: la workstation ha la FPU double in hardware, quindi qui double e
+ * float costano quasi uguale. Sull'S3 la FPU è solo single precision e
+ * ogni operazione double è una chiamata soft-float (__adddf3, __muldf3…):
+ * il rapporto da aspettarsi sul device è quello float/Q16 contro le
+ * routine soft-float, non quello misurato qui.
+ *
+ * USO:
+ *   make -C host bench
+ *   host/build/pid_bench [--n 2000000] [--reps 5] [--duration 3600]
+ *                        [--sp 250] [--kp 3] [--ki 0.02] [--kd 2]
+ * ================================================================
+ */
+#include <Arduino.h>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <type_traits>
+#include <vector>
+
+#include "hardware.h"
+#include "nvs_storage.h"
+#include "pid_ctrl.h"
+#include "relay_sched.h"
+#include "simulator.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+  static inline uint64_t bench_cycles() { return __rdtsc(); }
+  #define BENCH_HAVE_TSC 1
+#else
+  static inline uint64_t bench_cycles() { return 0; }
+  #define BENCH_HAVE_TSC 0
+#endif
+
+struct BenchConfig {
+  uint32_t n          = 2000000;
+  int      reps       = 5;
+  uint32_t duration_s = 3600;
+  double   sp         = 250.0;
+  double   kp = DEFAULT_KP_BASE, ki = DEFAULT_KI_BASE, kd = DEFAULT_KD_BASE;
+};
+
+struct Cost {
+  double cycles = 0, ns = 0;
+};
+
+struct Fidelity {
+  double   max_dout = 0;    // punti %
+  uint32_t on_diff  = 0;    // campioni con ms ON diversi dal double di > 1 ms
+  uint32_t on_max   = 0;    // max |Δ ms ON|
+};
+
+// ================================================================
+//  Traiettoria di riferimento: PID double ad anello chiuso
+// ================================================================
+static std::vector<double> reference_run(const BenchConfig& cfg) {
+  double temp = SIM_T_AMBIENT, out = 0, sp = cfg.sp;
+  PIDControllerT<double> pid(&temp, &out, &sp, cfg.kp, cfg.ki, cfg.kd);
+  RelayScheduler relays;
+  pid.begin();
+  pid.setEnabled(true);
+  relays.begin(0);
+
+  std::vector<double> temps;
+  float t = SIM_T_AMBIENT;
+  float dt_s = PID_SAMPLE_MS / 1000.0f;
+  for (uint32_t now = 0; now < cfg.duration_s * 1000UL; now += PID_SAMPLE_MS) {
+    temp = t;
+    temps.push_back(temp);
+    pid.compute(now);
+    float p_in = relays.request(RelayZone::BASE, pid.duty(100), now) ? SIM_POWER_W : 0.0f;
+    t = sim_thermal_step(t, p_in, sim_heat_loss(t), dt_s);
+  }
+  return temps;
+}
+
+template <typename T>
+static Fidelity fidelity(const BenchConfig& cfg, const std::vector<double>& temps) {
+  double temp = 0, out = 0, sp = cfg.sp;
+  PIDControllerT<T>      pid(&temp, &out, &sp, cfg.kp, cfg.ki, cfg.kd);
+  double                 t_ref = 0, o_ref = 0;
+  PIDControllerT<double> ref(&t_ref, &o_ref, &sp, cfg.kp, cfg.ki, cfg.kd);
+  pid.begin();  pid.setEnabled(true);
+  ref.begin();  ref.setEnabled(true);
+
+  Fidelity f;
+  uint32_t now = 0;
+  for (size_t i = 0; i < temps.size(); i++, now += PID_SAMPLE_MS) {
+    temp = t_ref = temps[i];
+    pid.compute(now);
+    ref.compute(now);
+    double d = fabs(out - o_ref);
+    if (d > f.max_dout) f.max_dout = d;
+    uint32_t a = RelayScheduler::onTimeMs(pid.duty(100), RELAY_WINDOW_MS);
+    uint32_t b = RelayScheduler::onTimeMs(ref.duty(100), RELAY_WINDOW_MS);
+    uint32_t dd = a > b ? a - b : b - a;
+    if (dd > 1) f.on_diff++;
+    if (dd > f.on_max) f.on_max = dd;
+  }
+  return f;
+}
+
+// ================================================================
+//  Costo per compute()
+// ================================================================
+template <typename F>
+static Cost measure(const BenchConfig& cfg, F&& body) {
+  Cost best;
+  for (int r = 0; r < cfg.reps; r++) {
+    auto     t0 = std::chrono::steady_clock::now();
+    uint64_t c0 = bench_cycles();
+    body();
+    uint64_t c1 = bench_cycles();
+    double   ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    Cost c{ (double)(c1 - c0) / cfg.n, ns / cfg.n };
+    if (r == 0 || c.ns < best.ns) best = c;
+  }
+  return best;
+}
+
+template <typename T>
+static Cost cost_core(const BenchConfig& cfg, const std::vector<double>& temps) {
+  std::vector<T> in(temps.size());
+  for (size_t i = 0; i < temps.size(); i++) in[i] = T(temps[i]);
+  T temp = T(0), out = T(0), sp = T(cfg.sp);
+  PIDCoreT<T> pid(&temp, &out, &sp, cfg.kp, cfg.ki, cfg.kd);
+  pid.setOutputLimits(0, 100);
+  pid.setSampleTime(PID_SAMPLE_MS);
+  pid.setMode(true);
+
+  volatile double sink = 0;
+  uint32_t now = 0;
+  Cost c = measure(cfg, [&] {
+    size_t k = 0;
+    for (uint32_t i = 0; i < cfg.n; i++) {
+      temp = in[k];
+      if (++k == in.size()) k = 0;
+      pid.compute(now += PID_SAMPLE_MS);
+    }
+    sink = sink + (double)out;
+  });
+  (void)sink;
+  return c;
+}
+
+template <typename T>
+static Cost cost_task(const BenchConfig& cfg, const std::vector<double>& temps) {
+  double temp = 0, out = 0, sp = cfg.sp;
+  PIDControllerT<T> pid(&temp, &out, &sp, cfg.kp, cfg.ki, cfg.kd);
+  RelayScheduler    relays;
+  pid.begin();
+  pid.setEnabled(true);
+  relays.begin(0);
+
+  volatile uint32_t sink = 0;
+  uint32_t now = 0;
+  Cost c = measure(cfg, [&] {
+    size_t   k = 0;
+    uint32_t on = 0;
+    for (uint32_t i = 0; i < cfg.n; i++) {
+      temp = temps[k];
+      if (++k == temps.size()) k = 0;
+      pid.compute(now += PID_SAMPLE_MS);
+      on += relays.request(RelayZone::BASE, pid.duty(100), now);
+    }
+    sink = sink + on;
+  });
+  (void)sink;
+  return c;
+}
+
+template <typename T>
+static void row(const char* name, const BenchConfig& cfg, const std::vector<double>& temps,
+                const Cost& base) {
+  Cost     core = cost_core<T>(cfg, temps);
+  Cost     task = std::is_same<T, double>::value ? base : cost_task<T>(cfg, temps);
+  Fidelity f    = fidelity<T>(cfg, temps);
+  printf("%-7s %9.1f %8.2f %9.1f %8.2f %6.2fx   %9.5f %6u %6u\n",
+         name, core.cycles, core.ns, task.cycles, task.ns,
+         task.ns > 0 ? base.ns / task.ns : 0.0, f.max_dout, f.on_diff, f.on_max);
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "uso: %s [--n N] [--reps R] [--duration S] [--sp C]\n"
+                  "          [--kp X] [--ki X] [--kd X]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  BenchConfig cfg;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--n") && i + 1 < argc)             cfg.n          = (uint32_t)atol(argv[++i]);
+    else if (!strcmp(argv[i], "--reps") && i + 1 < argc)     cfg.reps       = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--duration") && i + 1 < argc) cfg.duration_s = (uint32_t)atol(argv[++i]);
+    else if (!strcmp(argv[i], "--sp") && i + 1 < argc)       cfg.sp         = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--kp") && i + 1 < argc)       cfg.kp         = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--ki") && i + 1 < argc)       cfg.ki         = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--kd") && i + 1 < argc)       cfg.kd         = atof(argv[++i]);
+    else { usage(argv[0]); return 2; }
+  }
+  if (cfg.n == 0 || cfg.reps < 1 || cfg.duration_s * 1000UL < PID_SAMPLE_MS) { usage(argv[0]); return 2; }
+
+  std::vector<double> temps = reference_run(cfg);
+  Cost base = cost_task<double>(cfg, temps);
+
+  printf("PID %.2f/%.4f/%.2f, SP %.0f °C, %zu campioni di riferimento, %u compute × %d\n",
+         cfg.kp, cfg.ki, cfg.kd, cfg.sp, temps.size(), (unsigned)cfg.n, cfg.reps);
+  printf("%s\n", BENCH_HAVE_TSC ? "cicli = TSC della workstation"
+                                : "cicli non disponibili su questa architettura (solo ns)");
+  printf("                motore          Task_PID        vs      fedeltà vs double\n");
+  printf("tipo       cicli       ns     cicli       ns  double   |Δout|max  ON≠   max ms\n");
+  row<double>("double", cfg, temps, base);
+  row<float> ("float",  cfg, temps, base);
+  row<Q16>   ("Q16",    cfg, temps, base);
+  return 0;
+}
@@ -0,0 +1,330 @@
+/**
+ * host/pid_sweep.cpp — Forno Pizza S3 — Sweep parallelo guadagni PID
+ * ================================================================
+ * Percorre una griglia Kp × Ki × Kd × pct_base × pct_cielo e, per ogni
+ * candidato, simula un riscaldamento da ambiente ai setpoint Base/Cielo:
+ *   - plant: sim_batch_step() (host/sim_batch.h), SoA/SIMD su blocchi di
+ *     SWEEP_BLOCK candidati, rete a due zone di simulator_tick (potenza,
+ *     massa e dispersione per zona, conduzione SIM_K_COUPLING), senza
+ *     iniezioni di guasto; bit-compatibile con sim_batch_ref_step()
+ *   - controllo: PIDController reale (pid_ctrl.h) per Base e Cielo,
+ *     stessi guadagni, ciascuno sulla propria zona; relay da
+ *     RelayScheduler (relay_sched.h) come in Task_PID: finestra, duty
+ *     min/max, tempi minimi, budget di potenza
+ *   - pct_base/pct_cielo scalano il duty della sola zona (PIDController::
+ *     duty), quindi la potenza media della sua resistenza
+ *
+ * Ogni candidato ha il proprio tempo (compute(now)/request(now)):
+ * nessuno stato globale, i blocchi girano in parallelo su WorkPool.
+ *
+ * --verify affianca a ogni forno un'ombra scalare (sim_batch_ref_step) e
+ * confronta bit a bit le temperature di zona a ogni passo: exit 1 se diverge.
+ *
+ * METRICHE per candidato:
+ *   settle_s    ultimo ingresso definitivo di entrambe le zone nella banda
+ *               ±band attorno al proprio SP (-1 = non stabilizzato entro --duration)
+ *   overshoot   max su zone di max(T_i) - SP_i  [°C], 0 se mai sopra SP
+ *   switches    commutazioni relay (Base + Cielo, usura contatti)
+ *   energy_wh   energia elettrica assorbita [Wh]
+ *
+ * USO:
+ *   host/build/pid_sweep [--kp a:b:n] [--ki a:b:n] [--kd a:b:n]
+ *                        [--pct-base 100,80] [--pct-cielo 100,60]
+ *                        [--sp 250] [--sp-cielo C] [--duration 3600] [--scale 1]
+ *                        [--band 5] [--max-overshoot 10]
+ *                        [--threads N] [--out sweep.csv] [--top 10]
+ *                        [--verify]
+ *
+ *   Griglia di default: 20 × 20 × 25 = 10.000 punti attorno a
+ *   DEFAULT_KP/KI/KD_BASE (nvs_storage.h).
+ * ================================================================
+ */
+#include <Arduino.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "hardware.h"
+#include "nvs_storage.h"
+#include "pid_ctrl.h"
+#include "relay_sched.h"
+#include "simulator.h"
+#include "sim_batch.h"
+#include "work_pool.h"
+
+// ================================================================
+//  GRIGLIA
+// ================================================================
+struct Range {
+  double lo, hi;
+  int    n;
+  double at(int i) const { return n <= 1 ? lo : lo + (hi - lo) * i / (n - 1); }
+};
+
+struct SweepConfig {
+  Range    kp = { 0.5, 10.0, 20 };
+  Range    ki = { 0.0, 0.10, 20 };
+  Range    kd = { 0.0, 12.0, 25 };
+  std::vector<int> pct_base  = { 100 };
+  std::vector<int> pct_cielo = { 100 };
+  double   sp         = DEFAULT_SET_BASE;
+  double   sp_cielo   = -1;   // < 0: uguale a sp (rete di default: 40 W/°C tra le zone)
+  uint32_t duration_s = 3600;
+  float    scale      = 1.0f;
+  double   band       = 5.0;
+  double   max_over   = 10.0;
+};
+
+struct Candidate {
+  double kp, ki, kd;
+  int    pct_base, pct_cielo;
+};
+
+struct Result {
+  Candidate c;
+  float    settle_s;
+  float    overshoot;
+  uint32_t switches;
+  float    energy_wh;
+};
+
+// ================================================================
+//  SIMULAZIONE DI UN BLOCCO DI CANDIDATI
+//  Controllo scalare per candidato (PIDController), plant avanzato
+//  in un colpo solo con sim_batch_step() (SoA, SIMD).
+// ================================================================
+#define SWEEP_BLOCK  64   // candidati per job del WorkPool
+
+struct Lane {
+  double temp_b = SIM_T_AMBIENT, temp_c = SIM_T_AMBIENT;
+  double sp_b = 0, sp_c = 0, out_b = 0, out_c = 0;
+  PIDController pid_b{ &temp_b, &out_b, &sp_b, 0, 0, 0 };
+  PIDController pid_c{ &temp_c, &out_c, &sp_c, 0, 0, 0 };
+  RelayScheduler relays;
+  float    over = 0;                // max su zone di T_i - SP_i
+  float    ref_b = SIM_T_AMBIENT;   // --verify: ombra su sim_batch_ref_step()
+  float    ref_c = SIM_T_AMBIENT;
+  double   joule = 0;
+  uint32_t enter_ms = 0;
+  bool     in_band = false;
+  SimDeadLine dead;                 // SIM_DEAD_TIME_S del plant
+
+  Lane() { sim_dead_reset(dead, 0); }
+  Lane(const Lane&) = delete;   // i PID puntano ai membri: niente copie
+};
+
+// Ritorna il numero di passi in cui il lotto SIMD diverge dal percorso scalare
+static uint64_t run_block(const Candidate* c, Result* out, size_t n,
+                          const SweepConfig& cfg, bool verify) {
+  std::vector<Lane> lane(n);
+  SimBatch plant;
+  sim_batch_init(plant, n);
+
+  for (size_t i = 0; i < n; i++) {
+    Lane& L = lane[i];
+    L.sp_b = cfg.sp;
+    L.sp_c = cfg.sp_cielo;
+    L.pid_b.begin();  L.pid_b.setTunings(c[i].kp, c[i].ki, c[i].kd);
+    L.pid_c.begin();  L.pid_c.setTunings(c[i].kp, c[i].ki, c[i].kd);
+    L.pid_b.setDutyScale(c[i].pct_base);
+    L.pid_c.setDutyScale(c[i].pct_cielo);
+    L.pid_b.setEnabled(true);
+    L.pid_c.setEnabled(true);
+    L.relays.begin(0);
+  }
+
+  float    dt_s = (float)PID_SAMPLE_MS / 1000.0f * cfg.scale;
+  uint64_t mismatch = 0;
+
+  for (uint32_t now = 0; now < cfg.duration_s * 1000UL; now += PID_SAMPLE_MS) {
+    for (size_t i = 0; i < n; i++) {
+      Lane& L = lane[i];
+      L.temp_b = plant.temp_c[SIM_ZONE_BASE][i];
+      L.temp_c = plant.temp_c[SIM_ZONE_CIELO][i];
+      L.pid_b.compute(now);
+      L.pid_c.compute(now);
+      bool nb = L.relays.request(RelayZone::BASE,  L.pid_b.duty(c[i].pct_base),  now);
+      bool nc = L.relays.request(RelayZone::CIELO, L.pid_c.duty(c[i].pct_cielo), now);
+      // un bit per zona, visti dal plant dopo SIM_DEAD_TIME_S
+      uint16_t on = sim_dead_step(L.dead, now / 1000.0f * cfg.scale,
+                                  (uint16_t)((nb ? 1 : 0) | (nc ? 2 : 0)), SIM_DEAD_TIME_S);
+      plant.relay_on[SIM_ZONE_BASE][i]  = on & 1;
+      plant.relay_on[SIM_ZONE_CIELO][i] = (on >> 1) & 1;
+    }
+
+    sim_batch_step(plant, dt_s);
+
+    for (size_t i = 0; i < n; i++) {
+      Lane& L = lane[i];
+      float tb = plant.temp_c[SIM_ZONE_BASE][i];
+      float tc = plant.temp_c[SIM_ZONE_CIELO][i];
+      L.joule += plant.power_in[i] * dt_s;
+      float ob = tb - (float)cfg.sp, oc = tc - (float)cfg.sp_cielo;
+      if (ob > L.over) L.over = ob;
+      if (oc > L.over) L.over = oc;
+
+      bool ib = fabs(tb - cfg.sp) <= cfg.band && fabs(tc - cfg.sp_cielo) <= cfg.band;
+      if (ib && !L.in_band) L.enter_ms = now + PID_SAMPLE_MS;
+      L.in_band = ib;
+
+      if (verify) {
+        sim_batch_ref_step(L.ref_b, L.ref_c, plant.relay_on[SIM_ZONE_BASE][i] != 0,
+                           plant.relay_on[SIM_ZONE_CIELO][i] != 0, dt_s);
+        if (memcmp(&L.ref_b, &tb, sizeof tb) != 0 || memcmp(&L.ref_c, &tc, sizeof tc) != 0) {
+          mismatch++;
+          L.ref_b = tb;
+          L.ref_c = tc;
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    const Lane& L = lane[i];
+    Result& r   = out[i];
+    r.c         = c[i];
+    r.settle_s  = L.in_band ? L.enter_ms * cfg.scale / 1000.0f : -1.0f;
+    r.overshoot = L.over;
+    r.switches  = L.relays.switches(RelayZone::BASE) + L.relays.switches(RelayZone::CIELO);
+    r.energy_wh = (float)(L.joule / 3600.0);
+  }
+  return mismatch;
+}
+
+// Ordinamento: stabilizzati entro max_overshoot prima, poi settle, poi usura relay
+static bool better(const Result& a, const Result& b, double max_over) {
+  bool oka = a.settle_s >= 0 && a.overshoot <= max_over;
+  bool okb = b.settle_s >= 0 && b.overshoot <= max_over;
+  if (oka != okb) return oka;
+  if (!oka)       return a.overshoot < b.overshoot;
+  if (a.settle_s != b.settle_s) return a.settle_s < b.settle_s;
+  return a.switches < b.switches;
+}
+
+// ================================================================
+//  CLI
+// ================================================================
+static bool parse_range(const char* s, Range& r) {
+  return sscanf(s, "%lf:%lf:%d", &r.lo, &r.hi, &r.n) == 3 && r.n >= 1;
+}
+
+static bool parse_list(const char* s, std::vector<int>& v) {
+  v.clear();
+  for (const char* p = s; *p; ) {
+    char* end;
+    long x = strtol(p, &end, 10);
+    if (end == p || x < 0 || x > 100) return false;
+    v.push_back((int)x);
+    p = (*end == ',') ? end + 1 : end;
+    if (*end && *end != ',') return false;
+  }
+  return !v.empty();
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+    "uso: %s [--kp a:b:n] [--ki a:b:n] [--kd a:b:n]\n"
+    "          [--pct-base L] [--pct-cielo L] [--sp C] [--sp-cielo C]\n"
+    "          [--duration S] [--scale X]\n"
+    "          [--band C] [--max-overshoot C] [--threads N] [--out F.csv] [--top N]\n"
+    "          [--verify]\n",
+    argv0);
+}
+
+int main(int argc, char** argv) {
+  SweepConfig cfg;
+  unsigned    threads = 0;
+  const char* out_path = nullptr;
+  int         top = 10;
+  bool        verify = false;
+
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    if (!strcmp(a, "--verify")) { verify = true; continue; }
+    const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    bool ok = v != nullptr;
+    if      (!strcmp(a, "--kp")            && ok) ok = parse_range(v, cfg.kp);
+    else if (!strcmp(a, "--ki")            && ok) ok = parse_range(v, cfg.ki);
+    else if (!strcmp(a, "--kd")            && ok) ok = parse_range(v, cfg.kd);
+    else if (!strcmp(a, "--pct-base")      && ok) ok = parse_list(v, cfg.pct_base);
+    else if (!strcmp(a, "--pct-cielo")     && ok) ok = parse_list(v, cfg.pct_cielo);
+    else if (!strcmp(a, "--sp")            && ok) cfg.sp = atof(v);
+    else if (!strcmp(a, "--sp-cielo")      && ok) cfg.sp_cielo = atof(v);
+    else if (!strcmp(a, "--duration")      && ok) cfg.duration_s = (uint32_t)atol(v);
+    else if (!strcmp(a, "--scale")         && ok) cfg.scale = (float)atof(v);
+    else if (!strcmp(a, "--band")          && ok) cfg.band = atof(v);
+    else if (!strcmp(a, "--max-overshoot") && ok) cfg.max_over = atof(v);
+    else if (!strcmp(a, "--threads")       && ok) threads = (unsigned)atoi(v);
+    else if (!strcmp(a, "--out")           && ok) out_path = v;
+    else if (!strcmp(a, "--top")           && ok) top = atoi(v);
+    else ok = false;
+    if (!ok) { usage(argv[0]); return 2; }
+    i++;
+  }
+
+  if (cfg.sp_cielo < 0) cfg.sp_cielo = cfg.sp;
+
+  std::vector<Candidate> grid;
+  for (int ib = 0; ib < (int)cfg.pct_base.size(); ib++)
+    for (int ic = 0; ic < (int)cfg.pct_cielo.size(); ic++)
+      for (int p = 0; p < cfg.kp.n; p++)
+        for (int q = 0; q < cfg.ki.n; q++)
+          for (int d = 0; d < cfg.kd.n; d++)
+            grid.push_back({ cfg.kp.at(p), cfg.ki.at(q), cfg.kd.at(d),
+                             cfg.pct_base[ib], cfg.pct_cielo[ic] });
+
+  WorkPool pool(threads);
+  std::vector<Result> res(grid.size());
+
+  printf("[SWEEP] %zu candidati, SP %.0f/%.0f °C, %lu s, scala %.1fx, %u thread\n",
+         grid.size(), cfg.sp, cfg.sp_cielo, (unsigned long)cfg.duration_s, cfg.scale,
+         pool.threads());
+
+  auto t0 = std::chrono::steady_clock::now();
+  size_t blocks = (grid.size() + SWEEP_BLOCK - 1) / SWEEP_BLOCK;
+  std::atomic<uint64_t> mismatch{0};
+  pool.run(blocks, [&](size_t k) {
+    size_t first = k * SWEEP_BLOCK;
+    size_t n     = std::min<size_t>(SWEEP_BLOCK, grid.size() - first);
+    mismatch += run_block(&grid[first], &res[first], n, cfg, verify);
+  });
+  double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  printf("[SWEEP] completato in %.2f s (%zu blocchi, %zu rubati, plant %s)\n",
+         wall_s, blocks, pool.steals(), SIM_BATCH_SIMD);
+  if (verify) {
+    printf("[SWEEP] verifica SIMD/scalare: %s (%llu passi divergenti)\n",
+           mismatch ? "FAIL" : "PASS", (unsigned long long)mismatch.load());
+    if (mismatch) return 1;
+  }
+
+  if (out_path) {
+    FILE* f = fopen(out_path, "w");
+    if (!f) { perror(out_path); return 1; }
+    fprintf(f, "kp,ki,kd,pct_base,pct_cielo,settle_s,overshoot_c,switches,energy_wh\n");
+    for (const Result& r : res)
+      fprintf(f, "%.4f,%.5f,%.4f,%d,%d,%.1f,%.2f,%u,%.1f\n",
+              r.c.kp, r.c.ki, r.c.kd, r.c.pct_base, r.c.pct_cielo,
+              r.settle_s, r.overshoot, r.switches, r.energy_wh);
+    fclose(f);
+    printf("[SWEEP] CSV: %s\n", out_path);
+  }
+
+  std::sort(res.begin(), res.end(),
+            [&](const Result& a, const Result& b) { return better(a, b, cfg.max_over); });
+
+  int n = std::min<int>(top, (int)res.size());
+  printf("[SWEEP] Migliori %d (overshoot <= %.1f °C, banda ±%.1f °C):\n", n, cfg.max_over, cfg.band);
+  printf("    Kp       Ki       Kd    %%B  %%C   settle_s  over_C  switch  energy_Wh\n");
+  for (int i = 0; i < n; i++) {
+    const Result& r = res[i];
+    printf("  %6.3f  %7.4f  %6.3f  %3d %3d  %9.1f  %6.2f  %6u  %9.1f\n",
+           r.c.kp, r.c.ki, r.c.kd, r.c.pct_base, r.c.pct_cielo,
+           r.settle_s, r.overshoot, r.switches, r.energy_wh);
+  }
+  return 0;
+}
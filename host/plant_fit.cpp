@@ -0,0 +1,176 @@
+/**
+ * host/plant_fit.cpp — Forno Pizza S3 — Stima modello termico da trace
+ * ================================================================
+ * Ricava dai dati relay/temperatura di una o più trace (control_trace.h:
+ * log seriale [TRC] del forno vero o forno_host --trace) i parametri
+ * del modello a nodo singolo del simulatore — potenza, dispersione,
+ * massa termica, ambiente — più il ritardo puro resistenza → sonda,
+ * con PlantIdentifier (plant_id.h, lo stesso della stima sul device).
+ *
+ * Ingressi per tick:
+ *   T  sonda cielo in SINGLE, media delle sonde valide in DUAL
+ *   u  (P_base·relay_base + P_cielo·relay_cielo) / (P_base + P_cielo)
+ * La serie si spezza su shutdown, reset termico, sonda in errore,
+ * tick persi e tra un segmento (boot) e l'altro.
+ *
+ * Dalle temperature si ricavano solo P/C e k/C: la potenza totale è
+ * quella di targa (--power-*, default HEATER_*_W di hardware.h), k e C
+ * ne seguono. --out scrive un header da passare al simulatore
+ * (make PLANT=...): totali stimati e zone ripartite come nel modello
+ * di default, accoppiamento base↔cielo invariato.
+ *
+ * USO:
+ *   make -C host plantfit                      # stima sul simulatore stesso
+ *   host/build/plant_fit forno.log ... [--block S] [--scale X]
+ *                        [--power-base W] [--power-cielo W] [--out plant.h]
+ *
+ *   --block  durata dei blocchi in s (default 10, almeno 4 campioni)
+ *   --scale  secondi di processo per secondo di clock della trace:
+ *            g_sim.time_scale della corsa registrata (forno vero: 1)
+ *
+ * Exit code: 0 stima valida, 1 dati insufficienti, 2 errore.
+ * ================================================================
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "hardware.h"
+#include "simulator.h"
+#include "plant_id.h"
+#include "trace_file.h"
+
+struct FitConfig {
+  float block_s     = PLANT_ID_BLOCK_MS / 1000.0f;
+  float scale       = 1.0f;
+  float power_base  = HEATER_BASE_W;
+  float power_cielo = HEATER_CIELO_W;
+};
+
+struct FitStats {
+  size_t segments = 0, ticks = 0, used = 0, breaks = 0;
+};
+
+static void feed_segment(PlantIdentifier& id, const TraceSegment& s,
+                         const FitConfig& cfg, FitStats& st) {
+  const float p_tot = cfg.power_base + cfg.power_cielo;
+  id.restart();
+  st.segments++;
+  uint8_t seq = 0;
+  for (size_t k = 0; k < s.ticks.size(); k++) {
+    const TraceTick& t = s.ticks[k];
+    st.ticks++;
+    if ((k > 0 && (uint8_t)(t.seq - seq) != 1) || (t.flags & TRC_F_RESET)) {
+      id.restart();
+      st.breaks++;
+    }
+    seq = t.seq;
+
+    bool  ok_c = !isnan(t.raw_cielo) && t.raw_cielo > 0.0f;
+    bool  ok_b = !isnan(t.raw_base)  && t.raw_base  > 0.0f;
+    float temp = t.raw_cielo;
+    bool  valid = ok_c && !(t.flags & TRC_F_SHUTDOWN);
+    if (t.flags & TRC_F_DUAL) {
+      if (ok_b) temp = ok_c ? 0.5f * (t.raw_base + t.raw_cielo) : t.raw_base;
+      valid = (ok_b || ok_c) && !(t.flags & TRC_F_SHUTDOWN);
+    }
+    float u = ((t.flags & TRC_F_RELAY_BASE)  ? cfg.power_base  : 0.0f) +
+              ((t.flags & TRC_F_RELAY_CIELO) ? cfg.power_cielo : 0.0f);
+
+    id.feed((uint32_t)(t.now_ms * (double)cfg.scale), temp, u / p_tot, valid);
+    if (valid) st.used++;
+  }
+}
+
+static bool write_header(const char* path, const PlantModel& m, const FitConfig& cfg,
+                         const std::vector<const char*>& inputs) {
+  FILE* f = fopen(path, "w");
+  if (!f) { perror(path); return false; }
+
+  // Zone: potenze di targa, massa e dispersione nelle proporzioni del default
+  const float mb = SIM_MASS_BASE   / (SIM_MASS_BASE   + SIM_MASS_CIELO);
+  const float kb = SIM_K_LOSS_BASE / (SIM_K_LOSS_BASE + SIM_K_LOSS_CIELO);
+
+  fprintf(f, "/**\n * %s — modello termico stimato da host/plant_fit\n", path);
+  fprintf(f, " * ================================================================\n");
+  for (const char* in : inputs) fprintf(f, " * trace: %s\n", in);
+  fprintf(f, " * %u blocchi da %.0f s, residuo %.2f °C, tau %.0f s\n",
+          (unsigned)m.blocks, cfg.block_s, m.rmse, m.tau_s);
+  fprintf(f, " * ================================================================\n */\n");
+  fprintf(f, "#pragma once\n\n");
+  fprintf(f, "#define SIM_POWER_W        %8.1ff\n", m.power_w);
+  fprintf(f, "#define SIM_K_LOSS         %8.3ff\n", m.k_loss);
+  fprintf(f, "#define SIM_THERMAL_MASS   %8.1ff\n", m.mass);
+  fprintf(f, "#define SIM_T_AMBIENT      %8.1ff\n", m.t_amb);
+  fprintf(f, "#define SIM_DEAD_TIME_S    %8.1ff\n\n", m.dead_s);
+  fprintf(f, "#define SIM_POWER_BASE_W   %8.1ff\n", cfg.power_base);
+  fprintf(f, "#define SIM_POWER_CIELO_W  %8.1ff\n", cfg.power_cielo);
+  fprintf(f, "#define SIM_MASS_BASE      %8.1ff\n", m.mass * mb);
+  fprintf(f, "#define SIM_MASS_CIELO     %8.1ff\n", m.mass * (1.0f - mb));
+  fprintf(f, "#define SIM_K_LOSS_BASE    %8.3ff\n", m.k_loss * kb);
+  fprintf(f, "#define SIM_K_LOSS_CIELO   %8.3ff\n", m.k_loss * (1.0f - kb));
+  fclose(f);
+  return true;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "uso: %s trace... [--block S] [--scale X]\n"
+                  "          [--power-base W] [--power-cielo W] [--out plant.h]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  FitConfig cfg;
+  std::vector<const char*> inputs;
+  const char* out = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--block") && i + 1 < argc)            cfg.block_s     = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "--scale") && i + 1 < argc)       cfg.scale       = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "--power-base") && i + 1 < argc)  cfg.power_base  = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "--power-cielo") && i + 1 < argc) cfg.power_cielo = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "--out") && i + 1 < argc)         out = argv[++i];
+    else if (argv[i][0] == '-') { usage(argv[0]); return 2; }
+    else inputs.push_back(argv[i]);
+  }
+  if (inputs.empty() || cfg.block_s < 1.0f || cfg.scale <= 0.0f ||
+      cfg.power_base + cfg.power_cielo <= 0.0f) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  PlantIdentifier id;
+  id.begin(cfg.power_base + cfg.power_cielo, (uint32_t)(cfg.block_s * 1000.0f));
+  FitStats st;
+  for (const char* path : inputs) {
+    TraceLog    log;
+    std::string err;
+    if (!trace_load(path, log, err)) { fprintf(stderr, "%s\n", err.c_str()); return 2; }
+    if (log.bad_lines) printf("[FIT] %s: %zu righe [TRC] malformate ignorate\n", path, log.bad_lines);
+    for (const TraceSegment& s : log.segments) feed_segment(id, s, cfg, st);
+  }
+  printf("[FIT] %zu segmenti, %zu tick (%zu validi, %zu interruzioni), %u blocchi da %.0f s\n",
+         st.segments, st.ticks, st.used, st.breaks, (unsigned)id.blocks(), cfg.block_s);
+
+  PlantModel m;
+  if (!id.solve(m)) {
+    printf("[FIT] Stima impossibile: servono almeno %d blocchi con il forno che scalda e si raffredda\n",
+           PLANT_ID_MIN_BLOCKS);
+    return 1;
+  }
+  printf("[FIT] potenza   P     = %7.1f W    (targa)\n", m.power_w);
+  printf("[FIT] perdite   k     = %7.3f W/°C (sim %.3f)\n", m.k_loss, SIM_K_LOSS);
+  printf("[FIT] massa     C     = %7.1f J/°C (sim %.1f)\n", m.mass, SIM_THERMAL_MASS);
+  printf("[FIT] ambiente  T_amb = %7.1f °C   (sim %.1f)\n", m.t_amb, SIM_T_AMBIENT);
+  printf("[FIT] ritardo   θ     = %7.1f s    (sim %.1f)\n", m.dead_s, SIM_DEAD_TIME_S);
+  printf("[FIT] tau = C/k %.0f s, regime a piena potenza %.0f °C, residuo a un passo %.2f °C\n",
+         m.tau_s, m.t_amb + m.power_w / m.k_loss, m.rmse);
+
+  if (out) {
+    if (!write_header(out, m, cfg, inputs)) return 2;
+    printf("[FIT] Modello scritto in %s (make -C host clean all PLANT=%s)\n", out, out);
+  }
+  return 0;
+}
@@ -0,0 +1,337 @@
+/**
+ * host/scenario_parse.cpp — Forno Pizza S3 — Parser scenari .scn
+ * ================================================================
+ * Una riga = un passo. Token separati da spazi, stringhe tra
+ * virgolette ("..." con \" e \\), '#' fuori dalle virgolette apre un
+ * commento. Grammatica: vedi FORMATO TESTUALE in sim_scenario.h.
+ * ================================================================
+ */
+#include "scenario_parse.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+
+// ================================================================
+//  Tokenizer
+// ================================================================
+static bool tokenize(const std::string& line, std::vector<std::string>& tok,
+                     std::vector<bool>& quoted, std::string& err) {
+  size_t i = 0, n = line.size();
+  while (i < n) {
+    char c = line[i];
+    if (isspace((unsigned char)c)) { i++; continue; }
+    if (c == '#') break;
+    if (c == '"') {
+      std::string s;
+      i++;
+      while (i < n && line[i] != '"') {
+        if (line[i] == '\\' && i + 1 < n) i++;
+        s += line[i++];
+      }
+      if (i >= n) { err = "stringa non chiusa"; return false; }
+      i++;
+      tok.push_back(s);
+      quoted.push_back(true);
+      continue;
+    }
+    size_t j = i;
+    while (j < n && !isspace((unsigned char)line[j]) && line[j] != '#') j++;
+    tok.push_back(line.substr(i, j - i));
+    quoted.push_back(false);
+    i = j;
+  }
+  return true;
+}
+
+// ================================================================
+//  Parser di una riga
+// ================================================================
+struct Cursor {
+  const std::vector<std::string>& tok;
+  const std::vector<bool>&        quoted;
+  size_t                          i;
+  std::string&                    err;
+
+  bool   more() const { return i < tok.size(); }
+  bool   peek(const char* s) const { return more() && !quoted[i] && tok[i] == s; }
+  bool   accept(const char* s) { if (peek(s)) { i++; return true; } return false; }
+
+  bool word(std::string& out, const char* what) {
+    if (!more() || quoted[i]) { err = std::string("atteso ") + what; return false; }
+    out = tok[i++];
+    return true;
+  }
+
+  bool number(float& out, const char* what) {
+    std::string w;
+    if (!word(w, what)) return false;
+    char* end = nullptr;
+    out = strtof(w.c_str(), &end);
+    if (end == w.c_str() || *end) { err = std::string(what) + " non numerico: " + w; return false; }
+    return true;
+  }
+
+  bool text(std::string& out, const char* what) {
+    if (!more() || !quoted[i]) { err = std::string("atteso ") + what + " tra virgolette"; return false; }
+    out = tok[i++];
+    return true;
+  }
+};
+
+static bool parse_cmp(const std::string& s, ScnCmp& out) {
+  static const struct { const char* s; ScnCmp c; } k[] = {
+    { "<", ScnCmp::LT }, { "<=", ScnCmp::LE }, { ">", ScnCmp::GT },
+    { ">=", ScnCmp::GE }, { "==", ScnCmp::EQ }, { "!=", ScnCmp::NE },
+  };
+  for (auto& e : k) if (s == e.s) { out = e.c; return true; }
+  return false;
+}
+
+static bool parse_cond(Cursor& c, ScnCond& out) {
+  std::string var, op;
+  if (!c.word(var, "variabile")) return false;
+  if (!scn_var_from_name(var.c_str(), &out.var)) { c.err = "variabile sconosciuta: " + var; return false; }
+  if (!c.word(op, "operatore")) return false;
+  if (!parse_cmp(op, out.cmp)) { c.err = "operatore sconosciuto: " + op; return false; }
+  // safety_reason accetta anche i nomi (safety_reason == RUNAWAY_UP)
+  int reason;
+  if (out.var == SimVar::SAFETY_REASON && c.more() && !c.quoted[c.i] &&
+      scn_reason_from_name(c.tok[c.i].c_str(), &reason)) {
+    c.i++;
+    out.value = (float)reason;
+    return true;
+  }
+  return c.number(out.value, "valore");
+}
+
+static ScnStep blank(ScnOp op) {
+  return ScnStep{ op, 0, 0, SCN_NOC, SCN_NOC, 0, 0, 0, nullptr };
+}
+
+static bool parse_step(Cursor& c, ScnScript& s, ScnStep& st) {
+  std::string kw;
+  if (!c.word(kw, "comando")) return false;
+
+  if (kw == "when") {
+    ScnCond g;
+    if (!parse_cond(c, g)) return false;
+    if (c.peek("when")) { c.err = "when annidati non supportati"; return false; }
+    if (!parse_step(c, s, st)) return false;
+    st.flags |= SCN_F_GUARD;
+    st.guard  = g;
+    return true;
+  }
+
+  if (kw == "test") {
+    std::string name;
+    st = blank(ScnOp::TEST);
+    if (!c.text(name, "nome del test")) return false;
+    if (c.accept("track")) st.flags |= SCN_F_TRACK;
+    s.text.push_back(name);
+    st.text = s.text.back().c_str();
+  } else if (kw == "log") {
+    std::string msg;
+    st = blank(ScnOp::LOG);
+    if (!c.text(msg, "testo")) return false;
+    s.text.push_back(msg);
+    st.text = s.text.back().c_str();
+  } else if (kw == "enable") {
+    std::string w;
+    st = blank(ScnOp::ENABLE);
+    if (!c.word(w, "base|cielo|both|none")) return false;
+    if      (w == "none")  st.arg = SCN_EN_NONE;
+    else if (w == "base")  st.arg = SCN_EN_BASE;
+    else if (w == "cielo") st.arg = SCN_EN_CIELO;
+    else if (w == "both")  st.arg = SCN_EN_BOTH;
+    else { c.err = "enable: " + w; return false; }
+  } else if (kw == "set") {
+    std::string var;
+    SimVar v;
+    st = blank(ScnOp::SET);
+    if (!c.word(var, "variabile")) return false;
+    if (!scn_var_from_name(var.c_str(), &v) || !scn_var_writable(v)) {
+      c.err = "variabile non scrivibile: " + var;
+      return false;
+    }
+    st.arg = (uint8_t)v;
+    if (!c.number(st.value, "valore")) return false;
+  } else if (kw == "fault") {
+    static const struct { const char* s; ScnFault f; } k[] = {
+      { "tc_error", ScnFault::TC_ERROR }, { "overtemp", ScnFault::OVERTEMP },
+      { "ghost_heat", ScnFault::GHOST_HEAT }, { "rwd", ScnFault::RWD },
+      { "rwd_window_ms", ScnFault::RWD_WINDOW_MS },
+    };
+    std::string w;
+    st = blank(ScnOp::FAULT);
+    if (!c.word(w, "guasto")) return false;
+    bool found = false;
+    for (auto& e : k) if (w == e.s) { st.arg = (uint8_t)e.f; found = true; }
+    if (!found) { c.err = "guasto sconosciuto: " + w; return false; }
+    if (!c.number(st.value, "valore")) return false;
+  } else if (kw == "reset") {
+    st = blank(ScnOp::RESET);
+  } else if (kw == "autotune") {
+    st = blank(ScnOp::AUTOTUNE);
+    if      (c.accept("start")) st.arg = 1;
+    else if (c.accept("stop"))  st.arg = 0;
+    else if (c.accept("schedule")) st.arg = 2;
+    else if (c.accept("step"))     st.arg = 3;
+    else if (c.accept("accept"))   st.arg = 4;
+    else { c.err = "autotune start|stop|schedule|step|accept"; return false; }
+  } else if (kw == "load") {
+    st = blank(ScnOp::LOAD);
+    if (!c.number(st.value, "n pizze") || !c.number(st.hold_s, "intervallo") ||
+        !c.number(st.timeout_s, "cottura")) return false;
+  } else if (kw == "wait") {
+    if (c.more() && !c.quoted[c.i] && isdigit((unsigned char)c.tok[c.i][0])) {
+      st = blank(ScnOp::WAIT_TIME);
+      if (!c.number(st.value, "secondi")) return false;
+    } else {
+      st = blank(ScnOp::WAIT_COND);
+      if (!parse_cond(c, st.cond)) return false;
+      for (;;) {
+        if      (c.accept("hold"))     { if (!c.number(st.hold_s, "hold")) return false; }
+        else if (c.accept("timeout"))  { if (!c.number(st.timeout_s, "timeout")) return false; }
+        else if (c.accept("optional")) st.flags |= SCN_F_OPTIONAL;
+        else break;
+      }
+    }
+  } else if (kw == "expect") {
+    st = blank(ScnOp::EXPECT);
+    if (!parse_cond(c, st.cond)) return false;
+  } else if (kw == "ever") {
+    st = blank(ScnOp::EVER);
+    if (!parse_cond(c, st.cond)) return false;
+    if (c.accept("after") && !c.number(st.hold_s, "after")) return false;
+  } else if (kw == "expect_shutdown") {
+    std::string w;
+    int reason;
+    st = blank(ScnOp::EXPECT_SHUTDOWN);
+    if (!c.word(w, "ragione")) return false;
+    if (!scn_reason_from_name(w.c_str(), &reason) || reason == 0) {
+      c.err = "ragione sconosciuta: " + w;
+      return false;
+    }
+    st.arg = (uint8_t)reason;
+    if (c.accept("timeout") && !c.number(st.timeout_s, "timeout")) return false;
+  } else if (kw == "expect_no_shutdown") {
+    st = blank(ScnOp::EXPECT_NO_SHUTDOWN);
+  } else if (kw == "report") {
+    st = blank(ScnOp::REPORT);
+  } else {
+    c.err = "comando sconosciuto: " + kw;
+    return false;
+  }
+  return true;
+}
+
+// ================================================================
+//  API
+// ================================================================
+bool scenario_parse(const std::string& src, const char* path, ScnScript& out, std::string& err) {
+  out.path = path ? path : "";
+  out.steps.clear();
+  out.text.clear();
+
+  std::istringstream in(src);
+  std::string line;
+  int lineno = 0;
+  while (std::getline(in, line)) {
+    lineno++;
+    std::vector<std::string> tok;
+    std::vector<bool>        quoted;
+    std::string              e;
+    if (tokenize(line, tok, quoted, e) && !tok.empty()) {
+      Cursor  c{ tok, quoted, 0, e };
+      ScnStep st;
+      if (parse_step(c, out, st)) {
+        if (c.more()) e = "testo in eccesso: " + tok[c.i];
+        else          out.steps.push_back(st);
+      }
+    }
+    if (!e.empty()) {
+      err = out.path + ":" + std::to_string(lineno) + ": " + e;
+      return false;
+    }
+  }
+  out.steps.push_back(blank(ScnOp::END));
+  return true;
+}
+
+bool scenario_parse_file(const char* path, ScnScript& out, std::string& err) {
+  std::ifstream f(path);
+  if (!f) { err = std::string(path) + ": impossibile aprire il file"; return false; }
+  std::stringstream ss;
+  ss << f.rdbuf();
+  return scenario_parse(ss.str(), path, out, err);
+}
+
+// ================================================================
+//  --emit-c
+// ================================================================
+static std::string upper(const char* s) {
+  std::string r(s);
+  for (auto& ch : r) ch = (char)toupper((unsigned char)ch);
+  return r;
+}
+
+static std::string c_string(const char* s) {
+  std::string r = "\"";
+  for (; s && *s; s++) {
+    if (*s == '"' || *s == '\\') r += '\\';
+    r += *s;
+  }
+  return r + "\"";
+}
+
+static std::string num(float x) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.9g", x);
+  return buf;
+}
+
+static std::string cond_c(const ScnCond& c) {
+  static const char* k_cmp[] = { "LT", "LE", "GT", "GE", "EQ", "NE" };
+  return "SCN_C(" + upper(scn_var_name(c.var)) + ", " + k_cmp[(int)c.cmp] + ", " + num(c.value) + ")";
+}
+
+static std::string step_c(const ScnStep& st) {
+  static const char* k_en[]    = { "NONE", "BASE", "CIELO", "BOTH" };
+  static const char* k_fault[] = { "TC_ERROR", "OVERTEMP", "GHOST_HEAT", "RWD", "RWD_WINDOW_MS" };
+  switch (st.op) {
+    case ScnOp::END:       return "SCN_END()";
+    case ScnOp::TEST:      return std::string(st.flags & SCN_F_TRACK ? "SCN_TEST_TRACK(" : "SCN_TEST(")
+                                  + c_string(st.text) + ")";
+    case ScnOp::LOG:       return "SCN_LOG(" + c_string(st.text) + ")";
+    case ScnOp::ENABLE:    return std::string("SCN_ENABLE(") + k_en[st.arg & 3] + ")";
+    case ScnOp::SET:       return "SCN_SET(" + upper(scn_var_name((SimVar)st.arg)) + ", " + num(st.value) + ")";
+    case ScnOp::FAULT:     return std::string("SCN_FAULT(") + k_fault[st.arg] + ", " + num(st.value) + ")";
+    case ScnOp::RESET:     return "SCN_RESET()";
+    case ScnOp::AUTOTUNE:  return "SCN_AUTOTUNE(" + std::to_string(st.arg) + ")";
+    case ScnOp::LOAD:      return "SCN_LOAD(" + num(st.value) + ", " + num(st.hold_s) + ", " + num(st.timeout_s) + ")";
+    case ScnOp::WAIT_TIME: return "SCN_WAIT(" + num(st.value) + ")";
+    case ScnOp::WAIT_COND: return std::string(st.flags & SCN_F_OPTIONAL ? "SCN_WAIT_OPT(" : "SCN_WAIT_UNTIL(")
+                                  + cond_c(st.cond) + ", " + num(st.hold_s) + ", " + num(st.timeout_s) + ")";
+    case ScnOp::EXPECT:    return "SCN_EXPECT(" + cond_c(st.cond) + ")";
+    case ScnOp::EVER:      return "SCN_EVER(" + cond_c(st.cond) + ", " + num(st.hold_s) + ")";
+    case ScnOp::EXPECT_SHUTDOWN:
+      return std::string("SCN_EXPECT_SHUTDOWN(") + scn_reason_name(st.arg) + ", " + num(st.timeout_s) + ")";
+    case ScnOp::EXPECT_NO_SHUTDOWN: return "SCN_EXPECT_NO_SHUTDOWN()";
+    case ScnOp::REPORT:    return "SCN_REPORT()";
+  }
+  return "SCN_END()";
+}
+
+void scenario_emit_c(const ScnScript& s, const char* ident, FILE* f) {
+  fprintf(f, "// Generato da forno_host --emit-c %s\n", s.path.c_str());
+  fprintf(f, "const ScnStep %s[] = {\n", ident);
+  for (const ScnStep& st : s.steps) {
+    std::string c = step_c(st);
+    if (st.flags & SCN_F_GUARD) c = "SCN_WHEN(" + cond_c(st.guard) + ", " + c + ")";
+    fprintf(f, "    %s%s\n", c.c_str(), st.op == ScnOp::END ? "" : ",");
+  }
+  fprintf(f, "};\n");
+}
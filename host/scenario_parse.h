@@ -0,0 +1,30 @@
+/**
+ * host/scenario_parse.h — Forno Pizza S3 — Scenari testuali (solo host)
+ * ================================================================
+ * Carica un file .scn (formato in sim_scenario.h) in una tabella
+ * ScnStep eseguibile da scenario_load(), oppure la traduce in C con
+ * le macro SCN_* da incollare nel firmware (tabella const in flash).
+ *
+ * C++17 + STL: non usato dal firmware.
+ * ================================================================
+ */
+#pragma once
+#include <stdio.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "sim_scenario.h"
+
+struct ScnScript {
+  std::string             path;
+  std::vector<ScnStep>    steps;   // terminata da ScnOp::END
+  std::deque<std::string> text;    // memoria di ScnStep::text (indirizzi stabili)
+};
+
+/** Analizza il testo di uno scenario. false + err ("file:riga: ...") se non valido. */
+bool scenario_parse(const std::string& src, const char* path, ScnScript& out, std::string& err);
+bool scenario_parse_file(const char* path, ScnScript& out, std::string& err);
+
+/** Scrive `const ScnStep <ident>[] = { SCN_..., SCN_END() };` */
+void scenario_emit_c(const ScnScript& s, const char* ident, FILE* f);
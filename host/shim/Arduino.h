@@ -0,0 +1,59 @@
+/**
+ * host/shim/Arduino.h — Shim minimale Arduino per la build host Linux
+ * ================================================================
+ * Copre solo ciò che usa il core di controllo:
+ *   millis/delay (tempo virtuale, vedi host_shim.cpp), Serial.printf,
+ *   random/randomSeed deterministici, pinMode/digitalWrite no-op.
+ * ================================================================
+ */
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdarg.h>
+
+#define HIGH    1
+#define LOW     0
+#define OUTPUT  1
+#define INPUT   0
+
+#define IRAM_ATTR
+
+// ── Tempo virtuale: avanza solo con delay()/vTaskDelay() ──
+unsigned long millis();
+void          delay(uint32_t ms);
+
+// ── Shim host: controllo del tempo e dell'output ──
+void host_set_millis(uint32_t ms);
+void host_serial_set_quiet(bool quiet);
+
+inline void pinMode(int, int) {}
+inline void digitalWrite(int, int) {}
+
+long random(long lo, long hi);
+void randomSeed(unsigned long seed);
+
+class HostSerial {
+public:
+  void begin(unsigned long) {}
+  void flush() { if (!_quiet) fflush(stdout); }
+  explicit operator bool() const { return true; }
+
+  int printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    if (_quiet) return 0;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vprintf(fmt, ap);
+    va_end(ap);
+    return n;
+  }
+  void print(const char* s)  { if (!_quiet) fputs(s, stdout); }
+  void print(char c)         { if (!_quiet) fputc(c, stdout); }
+  void println()             { if (!_quiet) fputc('\n', stdout); }
+  void println(const char* s){ if (!_quiet) { fputs(s, stdout); fputc('\n', stdout); } }
+
+  bool _quiet = false;
+};
+extern HostSerial Serial;
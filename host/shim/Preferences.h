@@ -0,0 +1,70 @@
+/**
+ * host/shim/Preferences.h — NVS in memoria per la build host.
+ * Un solo namespace alla volta, valori persi a fine processo.
+ */
+#pragma once
+#include <map>
+#include <string>
+#include <stdint.h>
+#include <string.h>
+
+class Preferences {
+public:
+  bool begin(const char* ns, bool readOnly = false) {
+    (void)readOnly;
+    _ns = ns;
+    return true;
+  }
+  void end() {}
+  bool clear() { _store()[_ns].clear(); _blobs()[_ns].clear(); return true; }
+  bool remove(const char* key) {
+    return (_store()[_ns].erase(key) + _blobs()[_ns].erase(key)) > 0;
+  }
+
+  float getFloat(const char* key, float def = 0.0f) {
+    auto& m = _store()[_ns];
+    auto it = m.find(key);
+    return it == m.end() ? def : it->second;
+  }
+  int getInt(const char* key, int def = 0) {
+    auto& m = _store()[_ns];
+    auto it = m.find(key);
+    return it == m.end() ? def : (int)it->second;
+  }
+  uint32_t getUInt(const char* key, uint32_t def = 0) {
+    auto& m = _store()[_ns];
+    auto it = m.find(key);
+    return it == m.end() ? def : (uint32_t)it->second;
+  }
+  size_t putFloat(const char* key, float v) { _store()[_ns][key] = v; return sizeof(v); }
+  size_t putInt(const char* key, int v)     { _store()[_ns][key] = (double)v; return sizeof(v); }
+  size_t putUInt(const char* key, uint32_t v) { _store()[_ns][key] = (double)v; return sizeof(v); }
+
+  size_t putBytes(const char* key, const void* buf, size_t len) {
+    _blobs()[_ns][key].assign((const char*)buf, len);
+    return len;
+  }
+  size_t getBytesLength(const char* key) {
+    auto& m = _blobs()[_ns];
+    auto it = m.find(key);
+    return it == m.end() ? 0 : it->second.size();
+  }
+  size_t getBytes(const char* key, void* buf, size_t maxLen) {
+    auto& m = _blobs()[_ns];
+    auto it = m.find(key);
+    if (it == m.end() || it->second.size() > maxLen) return 0;
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+  }
+
+private:
+  std::string _ns;
+  static std::map<std::string, std::map<std::string, double>>& _store() {
+    static std::map<std::string, std::map<std::string, double>> s;
+    return s;
+  }
+  static std::map<std::string, std::map<std::string, std::string>>& _blobs() {
+    static std::map<std::string, std::map<std::string, std::string>> s;
+    return s;
+  }
+};
@@ -0,0 +1,17 @@
+/**
+ * host/shim/freertos/FreeRTOS.h — Shim FreeRTOS per la build host
+ * Tick a 1 kHz: 1 tick = 1 ms di tempo virtuale.
+ */
+#pragma once
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int      BaseType_t;
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define portTICK_PERIOD_MS  1
+#define portMAX_DELAY       0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+
+inline BaseType_t xPortGetCoreID() { return 1; }
@@ -0,0 +1,13 @@
+/**
+ * host/shim/freertos/semphr.h — Mutex FreeRTOS su std::timed_mutex.
+ * Stessa semantica del device: non ricorsivo, take con timeout.
+ */
+#pragma once
+#include "FreeRTOS.h"
+
+struct HostSemaphore;
+typedef HostSemaphore* SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t        xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks);
+BaseType_t        xSemaphoreGive(SemaphoreHandle_t s);
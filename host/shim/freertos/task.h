@@ -0,0 +1,7 @@
+/**
+ * host/shim/freertos/task.h — vTaskDelay avanza il tempo virtuale.
+ */
+#pragma once
+#include "FreeRTOS.h"
+
+void vTaskDelay(TickType_t ticks);
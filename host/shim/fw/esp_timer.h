@@ -0,0 +1,19 @@
+/**
+ * host/shim/fw/esp_timer.h — Solo per make fwcheck: le chiamate esp_timer
+ * del PWM a semionda SSR (ssr_pwm_begin) con SIMULATOR_MODE=0.
+ */
+#pragma once
+#include <stdint.h>
+
+typedef struct esp_timer* esp_timer_handle_t;
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef struct {
+  void (*callback)(void* arg);
+  void*       arg;
+  const char* name;
+} esp_timer_create_args_t;
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t*, esp_timer_handle_t*) { return ESP_OK; }
+inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t, uint64_t)              { return ESP_OK; }
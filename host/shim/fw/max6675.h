@@ -0,0 +1,11 @@
+/**
+ * host/shim/fw/max6675.h — Solo per make fwcheck: l'interfaccia della
+ * libreria MAX6675 che forno_control.cpp usa con SIMULATOR_MODE=0.
+ */
+#pragma once
+
+class MAX6675 {
+public:
+  MAX6675(int sclk, int cs, int miso) { (void)sclk; (void)cs; (void)miso; }
+  float readCelsius() { return 0.0f; }
+};
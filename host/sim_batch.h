@@ -0,0 +1,165 @@
+/**
+ * host/sim_batch.h — Forno Pizza S3 — Modello termico a lotti (SoA, SIMD)
+ * ================================================================
+ * N forni indipendenti in structure-of-arrays: temperature e stato relay
+ * per zona, potenza e dispersione in array contigui. sim_batch_step()
+ * avanza tutti i forni di dt_s con la rete a due zone di simulator_tick()
+ * (simulator.h: SIM_POWER_*_W, SIM_MASS_*, SIM_K_LOSS_*, SIM_K_COUPLING),
+ * senza iniezioni di guasto né carichi:
+ *
+ *   p_in_i   = relay_i ? SIM_POWER_i_W : 0        (ogni relay la sua resistenza)
+ *   p_loss_i = SIM_K_LOSS_i * (T_i - SIM_T_AMBIENT)
+ *   p_cond_i = SIM_K_COUPLING * (T_i - T_j)        (T_j del passo precedente)
+ *   T_i     += dt_s * (p_in_i - p_loss_i - p_cond_i) / SIM_MASS_i → clamp [amb, max]
+ *
+ * BIT-COMPATIBILITÀ con il percorso scalare (sim_batch_ref_step):
+ *   - stesse operazioni IEEE nello stesso ordine di sim_zone_step()
+ *     (sub, sub, mul, div, add), nessuna FMA: il Makefile compila con
+ *     -ffp-contract=off così anche il percorso scalare non viene fuso
+ *   - clamp con max/min: identico agli if di sim_zone_step() per T finita
+ *   - verifica: host/build/pid_sweep --verify (confronto bit a bit per passo)
+ *
+ * Percorsi: AVX2 (8 forni/istruzione), NEON AArch64 (4), scalare (coda e fallback).
+ * Solo host: il firmware usa simulator_tick() su g_sim.
+ * ================================================================
+ */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+  #define SIM_BATCH_SIMD "AVX2"
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  #include <arm_neon.h>
+  #define SIM_BATCH_SIMD "NEON"
+#else
+  #define SIM_BATCH_SIMD "scalare"
+#endif
+
+#include "simulator.h"
+
+// ================================================================
+//  STATO LOTTO
+// ================================================================
+struct SimBatch {
+  size_t               n = 0;
+  std::vector<float>   temp_c[SIM_ZONES];     // per SimZone
+  std::vector<uint8_t> relay_on[SIM_ZONES];   // 0/1, scritto dal controllo prima di step
+  std::vector<float>   power_in;    // [W] ultimo passo, somma zone (come g_sim.power_in)
+  std::vector<float>   heat_loss;   // [W] ultimo passo, somma zone (come g_sim.heat_loss)
+};
+
+inline void sim_batch_init(SimBatch& b, size_t n, float t0 = SIM_T_AMBIENT) {
+  b.n = n;
+  for (int z = 0; z < SIM_ZONES; z++) {
+    b.temp_c[z].assign(n, t0);
+    b.relay_on[z].assign(n, 0);
+  }
+  b.power_in.assign(n, 0.0f);
+  b.heat_loss.assign(n, 0.0f);
+}
+
+// ================================================================
+//  PASSO
+// ================================================================
+
+/** Percorso scalare di riferimento per un forno; ritorna p_in, p_loss totali. */
+inline void sim_batch_ref_step(float& t_base, float& t_cielo, bool r_base, bool r_cielo,
+                               float dt_s, float* p_in = nullptr, float* p_loss = nullptr) {
+  float tb = t_base, tc = t_cielo;
+  float pb = r_base  ? SIM_POWER_BASE_W  : 0.0f;
+  float pc = r_cielo ? SIM_POWER_CIELO_W : 0.0f;
+  float lb = SIM_K_LOSS_BASE  * (tb - SIM_T_AMBIENT);
+  float lc = SIM_K_LOSS_CIELO * (tc - SIM_T_AMBIENT);
+  t_base  = sim_zone_step(tb, pb, lb, SIM_K_COUPLING * (tb - tc), SIM_MASS_BASE,  dt_s);
+  t_cielo = sim_zone_step(tc, pc, lc, SIM_K_COUPLING * (tc - tb), SIM_MASS_CIELO, dt_s);
+  if (p_in)   *p_in   = pb + pc;
+  if (p_loss) *p_loss = lb + lc;
+}
+
+inline void sim_batch_step(SimBatch& b, float dt_s) {
+  float*         Tb   = b.temp_c[SIM_ZONE_BASE].data();
+  float*         Tc   = b.temp_c[SIM_ZONE_CIELO].data();
+  const uint8_t* Rb   = b.relay_on[SIM_ZONE_BASE].data();
+  const uint8_t* Rc   = b.relay_on[SIM_ZONE_CIELO].data();
+  float*         Pin  = b.power_in.data();
+  float*         Loss = b.heat_loss.data();
+  size_t i = 0;
+
+#if defined(__AVX2__)
+  const __m256 v_pow_b  = _mm256_set1_ps(SIM_POWER_BASE_W);
+  const __m256 v_pow_c  = _mm256_set1_ps(SIM_POWER_CIELO_W);
+  const __m256 v_k_b    = _mm256_set1_ps(SIM_K_LOSS_BASE);
+  const __m256 v_k_c    = _mm256_set1_ps(SIM_K_LOSS_CIELO);
+  const __m256 v_mass_b = _mm256_set1_ps(SIM_MASS_BASE);
+  const __m256 v_mass_c = _mm256_set1_ps(SIM_MASS_CIELO);
+  const __m256 v_g      = _mm256_set1_ps(SIM_K_COUPLING);
+  const __m256 v_amb    = _mm256_set1_ps(SIM_T_AMBIENT);
+  const __m256 v_max    = _mm256_set1_ps(SIM_T_MAX);
+  const __m256 v_dt     = _mm256_set1_ps(dt_s);
+  const __m256i v_zero  = _mm256_setzero_si256();
+  for (; i + 8 <= b.n; i += 8) {
+    __m256i rb   = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(Rb + i)));
+    __m256i rc   = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(Rc + i)));
+    __m256  p_b  = _mm256_and_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(rb, v_zero)), v_pow_b);
+    __m256  p_c  = _mm256_and_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(rc, v_zero)), v_pow_c);
+
+    __m256 tb  = _mm256_loadu_ps(Tb + i);
+    __m256 tc  = _mm256_loadu_ps(Tc + i);
+    __m256 l_b = _mm256_mul_ps(v_k_b, _mm256_sub_ps(tb, v_amb));
+    __m256 l_c = _mm256_mul_ps(v_k_c, _mm256_sub_ps(tc, v_amb));
+    __m256 c_b = _mm256_mul_ps(v_g, _mm256_sub_ps(tb, tc));
+    __m256 c_c = _mm256_mul_ps(v_g, _mm256_sub_ps(tc, tb));
+    __m256 d_b = _mm256_div_ps(_mm256_mul_ps(v_dt, _mm256_sub_ps(_mm256_sub_ps(p_b, l_b), c_b)), v_mass_b);
+    __m256 d_c = _mm256_div_ps(_mm256_mul_ps(v_dt, _mm256_sub_ps(_mm256_sub_ps(p_c, l_c), c_c)), v_mass_c);
+    tb = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(tb, d_b), v_amb), v_max);
+    tc = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(tc, d_c), v_amb), v_max);
+
+    _mm256_storeu_ps(Tb + i, tb);
+    _mm256_storeu_ps(Tc + i, tc);
+    _mm256_storeu_ps(Pin + i, _mm256_add_ps(p_b, p_c));
+    _mm256_storeu_ps(Loss + i, _mm256_add_ps(l_b, l_c));
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const float32x4_t v_pow_b  = vdupq_n_f32(SIM_POWER_BASE_W);
+  const float32x4_t v_pow_c  = vdupq_n_f32(SIM_POWER_CIELO_W);
+  const float32x4_t v_k_b    = vdupq_n_f32(SIM_K_LOSS_BASE);
+  const float32x4_t v_k_c    = vdupq_n_f32(SIM_K_LOSS_CIELO);
+  const float32x4_t v_mass_b = vdupq_n_f32(SIM_MASS_BASE);
+  const float32x4_t v_mass_c = vdupq_n_f32(SIM_MASS_CIELO);
+  const float32x4_t v_g      = vdupq_n_f32(SIM_K_COUPLING);
+  const float32x4_t v_amb    = vdupq_n_f32(SIM_T_AMBIENT);
+  const float32x4_t v_max    = vdupq_n_f32(SIM_T_MAX);
+  const float32x4_t v_dt     = vdupq_n_f32(dt_s);
+  for (; i + 4 <= b.n; i += 4) {
+    uint32x4_t  rb  = { Rb[i], Rb[i + 1], Rb[i + 2], Rb[i + 3] };
+    uint32x4_t  rc  = { Rc[i], Rc[i + 1], Rc[i + 2], Rc[i + 3] };
+    float32x4_t p_b = vreinterpretq_f32_u32(vandq_u32(vcgtq_u32(rb, vdupq_n_u32(0)),
+                                                      vreinterpretq_u32_f32(v_pow_b)));
+    float32x4_t p_c = vreinterpretq_f32_u32(vandq_u32(vcgtq_u32(rc, vdupq_n_u32(0)),
+                                                      vreinterpretq_u32_f32(v_pow_c)));
+
+    float32x4_t tb  = vld1q_f32(Tb + i);
+    float32x4_t tc  = vld1q_f32(Tc + i);
+    float32x4_t l_b = vmulq_f32(v_k_b, vsubq_f32(tb, v_amb));
+    float32x4_t l_c = vmulq_f32(v_k_c, vsubq_f32(tc, v_amb));
+    float32x4_t c_b = vmulq_f32(v_g, vsubq_f32(tb, tc));
+    float32x4_t c_c = vmulq_f32(v_g, vsubq_f32(tc, tb));
+    float32x4_t d_b = vdivq_f32(vmulq_f32(v_dt, vsubq_f32(vsubq_f32(p_b, l_b), c_b)), v_mass_b);
+    float32x4_t d_c = vdivq_f32(vmulq_f32(v_dt, vsubq_f32(vsubq_f32(p_c, l_c), c_c)), v_mass_c);
+    tb = vminq_f32(vmaxq_f32(vaddq_f32(tb, d_b), v_amb), v_max);
+    tc = vminq_f32(vmaxq_f32(vaddq_f32(tc, d_c), v_amb), v_max);
+
+    vst1q_f32(Tb + i, tb);
+    vst1q_f32(Tc + i, tc);
+    vst1q_f32(Pin + i, vaddq_f32(p_b, p_c));
+    vst1q_f32(Loss + i, vaddq_f32(l_b, l_c));
+  }
+#endif
+
+  // Coda (o tutto il lotto senza SIMD): percorso scalare di riferimento
+  for (; i < b.n; i++)
+    sim_batch_ref_step(Tb[i], Tc[i], Rb[i] != 0, Rc[i] != 0, dt_s, &Pin[i], &Loss[i]);
+}
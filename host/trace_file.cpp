@@ -0,0 +1,101 @@
+/**
+ * host/trace_file.cpp — Forno Pizza S3 — Lettura/scrittura trace
+ * ================================================================
+ */
+#include "trace_file.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <fstream>
+#include <iterator>
+
+static size_t record_size(uint8_t kind) {
+  switch (kind) {
+    case TRACE_KIND_CONFIG: return sizeof(TraceConfig);
+    case TRACE_KIND_TICK:   return sizeof(TraceTick);
+    default:                return 0;
+  }
+}
+
+static void append(TraceLog& log, const uint8_t* rec) {
+  if (rec[0] == TRACE_KIND_CONFIG) {
+    TraceSegment s;
+    s.has_config = true;
+    memcpy(&s.config, rec, sizeof(TraceConfig));
+    log.segments.push_back(std::move(s));
+    return;
+  }
+  if (log.segments.empty()) log.segments.emplace_back();
+  TraceSegment& s = log.segments.back();
+  TraceTick t;
+  memcpy(&t, rec, sizeof(t));
+  if (!s.ticks.empty()) s.lost += (uint8_t)(t.seq - s.ticks.back().seq - 1);
+  s.ticks.push_back(t);
+}
+
+static int hex_val(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  c = (char)tolower((unsigned char)c);
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+static void parse_text(const std::string& data, TraceLog& log) {
+  size_t pos = 0;
+  while (pos < data.size()) {
+    size_t eol = data.find('\n', pos);
+    if (eol == std::string::npos) eol = data.size();
+    size_t tag = data.find("[TRC] ", pos);
+    if (tag != std::string::npos && tag < eol) {
+      uint8_t rec[sizeof(TraceConfig)];
+      size_t  n = 0, i = tag + 6;
+      bool    ok = true;
+      for (; i + 1 < eol && hex_val(data[i]) >= 0; i += 2) {
+        int hi = hex_val(data[i]), lo = hex_val(data[i + 1]);
+        if (lo < 0 || n >= sizeof(rec)) { ok = false; break; }
+        rec[n++] = (uint8_t)(hi << 4 | lo);
+      }
+      if (ok && n > 0 && n == record_size(rec[0])) append(log, rec);
+      else log.bad_lines++;
+    }
+    pos = eol + 1;
+  }
+}
+
+bool trace_load(const char* path, TraceLog& out, std::string& err) {
+  std::ifstream f(path, std::ios::binary);
+  if (!f) { err = std::string(path) + ": impossibile aprire"; return false; }
+  std::string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+  out = TraceLog{};
+  const size_t magic = strlen(TRACE_FILE_MAGIC);
+  if (data.compare(0, magic, TRACE_FILE_MAGIC) == 0) {
+    const uint8_t* p   = (const uint8_t*)data.data() + magic;
+    const uint8_t* end = (const uint8_t*)data.data() + data.size();
+    while (p < end) {
+      size_t n = record_size(p[0]);
+      if (n == 0 || p + n > end) {
+        err = std::string(path) + ": record non valido all'offset " +
+              std::to_string(p - (const uint8_t*)data.data());
+        return false;
+      }
+      append(out, p);
+      p += n;
+    }
+  } else {
+    parse_text(data, out);
+  }
+  if (out.segments.empty()) { err = std::string(path) + ": nessun record di trace"; return false; }
+  return true;
+}
+
+FILE* trace_file_open(const char* path) {
+  FILE* f = fopen(path, "wb");
+  if (!f) { perror(path); return nullptr; }
+  fwrite(TRACE_FILE_MAGIC, 1, strlen(TRACE_FILE_MAGIC), f);
+  return f;
+}
+
+void trace_sink_file(const uint8_t* rec, size_t len, void* ctx) {
+  fwrite(rec, 1, len, (FILE*)ctx);
+}
@@ -0,0 +1,40 @@
+/**
+ * host/trace_file.h — Forno Pizza S3 — Lettura/scrittura trace (solo host)
+ * ================================================================
+ * Due sorgenti per la stessa trace (control_trace.h):
+ *   binario   "FTRC" + record concatenati (forno_host --trace)
+ *   testo     log seriale catturato dal device: si usano solo le
+ *             righe "[TRC] <hex>", il resto del log è ignorato
+ *
+ * Ogni TraceConfig apre un segmento (un boot / control_loop_begin);
+ * i tick prima del primo TraceConfig finiscono in un segmento senza
+ * config (cattura iniziata a forno già acceso).
+ *
+ * C++17 + STL: non usato dal firmware.
+ * ================================================================
+ */
+#pragma once
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "control_trace.h"
+
+struct TraceSegment {
+  bool                   has_config = false;
+  TraceConfig            config     = {};
+  std::vector<TraceTick> ticks;
+  size_t                 lost       = 0;   // tick mancanti secondo TraceTick::seq
+};
+
+struct TraceLog {
+  std::vector<TraceSegment> segments;
+  size_t                    bad_lines = 0;  // righe [TRC] malformate (log seriale)
+};
+
+/** false + err se il file non si apre o non contiene record. */
+bool trace_load(const char* path, TraceLog& out, std::string& err);
+
+/** Apre path, scrive l'intestazione: passare a control_trace_set_sink(trace_sink_file, f). */
+FILE* trace_file_open(const char* path);
+void  trace_sink_file(const uint8_t* rec, size_t len, void* ctx);
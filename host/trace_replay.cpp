@@ -0,0 +1,289 @@
+/**
+ * host/trace_replay.cpp — Forno Pizza S3 — Replay trace di Task_PID
+ * ================================================================
+ * Rilegge una trace (control_trace.h) registrata da un forno reale
+ * (log seriale con righe [TRC]) o da forno_host --trace, ripassa gli
+ * ingressi di ogni ciclo nel core di controllo compilato adesso e
+ * confronta le decisioni con quelle registrate:
+ *   relay base/cielo, uscita PID (tolleranza --tol %), shutdown+ragione.
+ *
+ * Ingressi per ciclo: letture grezze delle sonde (g_sim.replay_c al
+ * posto del modello termico), setpoint, enable, split, SINGLE/DUAL,
+ * istante now. Uno shutdown senza riscontro nella trace viene
+ * annullato prima del ciclo successivo (la trace prosegue: sul forno
+ * non è scattato), così le divergenze successive restano confrontabili.
+ * L'avvio/arresto dell'autotune (dalla UI) si ricava dal flag
+ * TRC_F_AUTOTUNE; la finestra RUNAWAY_DOWN si forza solo se la trace
+ * ne registra una diversa da quella nominale (override degli scenari).
+ *
+ * Ogni segmento (un boot) gira in un processo figlio con stato pulito;
+ * i guadagni vengono dal TraceConfig del segmento, o da --gains-* per
+ * provare una modifica di taratura sugli stessi dati.
+ *
+ * USO:
+ *   make -C host replay                        # autoverifica su k_scn_default
+ *   host/build/trace_replay forno.log [--tol 0.05] [--show 8]
+ *                           [--gains-base kp,ki,kd] [--gains-cielo kp,ki,kd]
+ *
+ * Exit code: 0 nessuna divergenza, 1 divergenze, 2 errore.
+ * ================================================================
+ */
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <chrono>
+#include <string>
+
+#include "debug_config.h"
+#include "hardware.h"
+#include "app_state.h"
+#include "control_clock.h"
+#include "forno_control.h"
+#include "nvs_storage.h"
+#include "simulator.h"
+#include "autotune.h"
+#include "trace_file.h"
+#include "fork_pool.h"
+
+#if !SIMULATOR_MODE || !FEATURE_TRACE
+  #error "trace_replay richiede SIMULATOR_MODE=1 e FEATURE_TRACE=1 (host/Makefile)"
+#endif
+
+extern uint32_t g_runaway_down_ms_override;
+
+static float s_graph_base[GRAPH_BUF_SIZE];
+static float s_graph_cielo[GRAPH_BUF_SIZE];
+GraphBuffer g_graph = { s_graph_base, s_graph_cielo, 0, 0 };
+
+static const char* const k_reason_names[] = { "NONE", "TC_ERROR", "OVERTEMP", "RUNAWAY_DOWN",
+                                              "RUNAWAY_UP", "WDG_TIMEOUT" };
+
+// ================================================================
+//  Risultato di un segmento (passa dal figlio al padre su pipe)
+// ================================================================
+enum class DiffKind : uint8_t { RELAY_B, RELAY_C, OUT_B, OUT_C, SHUTDOWN };
+static const char* const k_diff_names[] = { "relay base", "relay cielo", "out base",
+                                            "out cielo", "shutdown" };
+
+#define REPLAY_SHOW_MAX  16
+
+struct ReplayDiff {
+  uint32_t now_ms;
+  DiffKind kind;
+  float    rec, got;
+};
+
+struct ReplayResult {
+  uint32_t   ticks, autotune;
+  uint32_t   diff[5];                 // per DiffKind
+  float      out_max_err[2];          // |Δ pid_out| massimo, punti %
+  double     on_s_rec[2], on_s_got[2];
+  uint32_t   span_ms;
+  uint8_t    n_show;
+  ReplayDiff show[REPLAY_SHOW_MAX];
+};
+
+struct ReplayConfig {
+  float tol      = 0.05f;   // % di uscita PID
+  int   show     = 8;
+  bool  gains_base  = false, gains_cielo = false;
+  float gb[3] = {}, gc[3] = {};
+};
+
+static void note(ReplayResult& r, int show, uint32_t now, DiffKind k, float rec, float got) {
+  r.diff[(int)k]++;
+  if (r.n_show < show && r.n_show < REPLAY_SHOW_MAX) r.show[r.n_show++] = ReplayDiff{ now, k, rec, got };
+}
+
+// Nel processo figlio
+static ReplayResult replay_segment(const TraceSegment& seg, const ReplayConfig& cfg) {
+  ReplayResult r = {};
+  if (seg.ticks.empty()) return r;
+
+  host_serial_set_quiet(true);
+  randomSeed(1);
+
+  // Guadagni come nella NVS del forno: i PID si costruiscono in control_init()
+  NVSStorage nvs;
+  NVSData    d;
+  nvs.load(d);
+  if (seg.has_config) {
+    d.kp_base  = seg.config.gains[0]; d.ki_base  = seg.config.gains[1]; d.kd_base  = seg.config.gains[2];
+    d.kp_cielo = seg.config.gains[3]; d.ki_cielo = seg.config.gains[4]; d.kd_cielo = seg.config.gains[5];
+  }
+  if (cfg.gains_base)  { d.kp_base  = cfg.gb[0]; d.ki_base  = cfg.gb[1]; d.kd_base  = cfg.gb[2]; }
+  if (cfg.gains_cielo) { d.kp_cielo = cfg.gc[0]; d.ki_cielo = cfg.gc[1]; d.kd_cielo = cfg.gc[2]; }
+  nvs.save(d);
+
+  g_mutex = xSemaphoreCreateMutex();
+  control_init();
+  scenario_load(nullptr);
+  g_sim.replay = true;
+  g_clock_virtual_ms = seg.has_config ? seg.config.now_ms : seg.ticks.front().now_ms;
+  control_loop_begin();
+
+  for (size_t i = 0; i < seg.ticks.size(); i++) {
+    const TraceTick& t = seg.ticks[i];
+
+    // Sul forno questo ciclo è partito senza shutdown attivo
+    if (g_emergency_shutdown) {
+      g_emergency_shutdown    = false;
+      g_state.safety_shutdown = false;
+      g_state.safety_reason   = SafetyReason::NONE;
+    }
+    if (t.flags & TRC_F_RESET) g_sim.thermal_reset_seq++;
+    g_runaway_down_ms_override =
+        (seg.has_config && t.rwd_ms != seg.config.rwd_ms) ? t.rwd_ms : 0;
+
+    g_state.base_enabled  = (t.flags & TRC_F_EN_BASE)  != 0;
+    g_state.cielo_enabled = (t.flags & TRC_F_EN_CIELO) != 0;
+    g_state.sensor_mode   = (t.flags & TRC_F_DUAL) ? SensorMode::DUAL : SensorMode::SINGLE;
+    g_state.set_base      = t.set_base_q  / 4.0;
+    g_state.set_cielo     = t.set_cielo_q / 4.0;
+    g_state.pct_base      = t.pct_base;
+    g_state.pct_cielo     = t.pct_cielo;
+    g_sim.replay_c[SIM_ZONE_BASE]  = t.raw_base;
+    g_sim.replay_c[SIM_ZONE_CIELO] = t.raw_cielo;
+
+    // Autotune avviato/fermato dalla UI tra due cicli (clock del ciclo prima)
+    const bool at_rec = (t.flags & TRC_F_AUTOTUNE) != 0;
+    if (at_rec && !autotune_is_running()) {
+      g_state.autotune_split = t.at_split;
+      autotune_start();
+    } else if (!at_rec && autotune_is_running()) {
+      autotune_stop();
+    }
+
+    g_clock_virtual_ms = t.now_ms;
+    control_step(t.now_ms);
+    r.ticks++;
+
+    const bool rec_relay[2] = { (t.flags & TRC_F_RELAY_BASE) != 0, (t.flags & TRC_F_RELAY_CIELO) != 0 };
+    const bool got_relay[2] = { g_state.relay_base, g_state.relay_cielo };
+    uint32_t dt = (i + 1 < seg.ticks.size()) ? seg.ticks[i + 1].now_ms - t.now_ms : 0;
+    for (int z = 0; z < 2; z++) {
+      if (rec_relay[z]) r.on_s_rec[z] += dt / 1000.0;
+      if (got_relay[z]) r.on_s_got[z] += dt / 1000.0;
+    }
+
+    if (at_rec) r.autotune++;
+
+    for (int z = 0; z < 2; z++) {
+      if (rec_relay[z] != got_relay[z])
+        note(r, cfg.show, t.now_ms, (DiffKind)((int)DiffKind::RELAY_B + z), rec_relay[z], got_relay[z]);
+    }
+    const float rec_out[2] = { t.out_base_q / 100.0f, t.out_cielo_q / 100.0f };
+    const float got_out[2] = { trace_q_out(g_state.pid_out_base)  / 100.0f,
+                               trace_q_out(g_state.pid_out_cielo) / 100.0f };
+    for (int z = 0; z < 2; z++) {
+      float e = fabsf(rec_out[z] - got_out[z]);
+      if (e > r.out_max_err[z]) r.out_max_err[z] = e;
+      if (e > cfg.tol)
+        note(r, cfg.show, t.now_ms, (DiffKind)((int)DiffKind::OUT_B + z), rec_out[z], got_out[z]);
+    }
+    const int rec_sd = (t.flags & TRC_F_SHUTDOWN) ? t.reason : 0;
+    const int got_sd = g_emergency_shutdown ? (int)g_state.safety_reason : 0;
+    if (rec_sd != got_sd) note(r, cfg.show, t.now_ms, DiffKind::SHUTDOWN, rec_sd, got_sd);
+  }
+  r.span_ms = seg.ticks.back().now_ms - seg.ticks.front().now_ms;
+  return r;
+}
+
+// ================================================================
+//  Report
+// ================================================================
+static uint32_t total_diffs(const ReplayResult& r) {
+  uint32_t n = 0;
+  for (uint32_t d : r.diff) n += d;
+  return n;
+}
+
+static void print_value(DiffKind k, float v) {
+  switch (k) {
+    case DiffKind::RELAY_B:
+    case DiffKind::RELAY_C: printf("%-12s", v != 0.0f ? "ON" : "OFF"); break;
+    case DiffKind::SHUTDOWN:    printf("%-12s", k_reason_names[(int)v % 6]); break;
+    default:                    printf("%-12.2f", v); break;
+  }
+}
+
+static void print_segment(size_t k, const TraceSegment& seg, const ReplayResult& r, bool got) {
+  printf("\n[REPLAY] segmento %zu: %zu cicli, %.1f min%s", k, seg.ticks.size(),
+         r.span_ms / 60000.0, seg.has_config ? "" : " (senza config: guadagni NVS di default)");
+  if (seg.lost) printf(", %zu cicli persi nel log", seg.lost);
+  printf("\n");
+  if (!got) { printf("  replay fallito (processo figlio terminato)\n"); return; }
+
+  printf("  di cui in autotune %u\n", r.autotune);
+  printf("  divergenze: relay base %u, relay cielo %u, out base %u, out cielo %u, shutdown %u\n",
+         r.diff[0], r.diff[1], r.diff[2], r.diff[3], r.diff[4]);
+  printf("  |Δout| max: base %.2f, cielo %.2f punti %%\n", r.out_max_err[0], r.out_max_err[1]);
+  printf("  relay ON registrato/replay: base %.0f/%.0f s, cielo %.0f/%.0f s\n",
+         r.on_s_rec[0], r.on_s_got[0], r.on_s_rec[1], r.on_s_got[1]);
+  for (int i = 0; i < r.n_show; i++) {
+    const ReplayDiff& d = r.show[i];
+    printf("    t=%9.1fs  %-12s trace ", d.now_ms / 1000.0, k_diff_names[(int)d.kind]);
+    print_value(d.kind, d.rec);
+    printf(" replay ");
+    print_value(d.kind, d.got);
+    printf("\n");
+  }
+}
+
+static bool parse_gains(const char* s, float g[3]) {
+  return sscanf(s, "%f,%f,%f", &g[0], &g[1], &g[2]) == 3;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "uso: %s TRACE [--tol PCT] [--show N] [--jobs N]\n"
+                  "          [--gains-base kp,ki,kd] [--gains-cielo kp,ki,kd]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  ReplayConfig cfg;
+  const char*  path = nullptr;
+  unsigned     jobs = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--tol") && i + 1 < argc)       cfg.tol  = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "--show") && i + 1 < argc) cfg.show = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--jobs") && i + 1 < argc) jobs     = (unsigned)atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--gains-base") && i + 1 < argc) {
+      if (!parse_gains(argv[++i], cfg.gb)) { usage(argv[0]); return 2; }
+      cfg.gains_base = true;
+    } else if (!strcmp(argv[i], "--gains-cielo") && i + 1 < argc) {
+      if (!parse_gains(argv[++i], cfg.gc)) { usage(argv[0]); return 2; }
+      cfg.gains_cielo = true;
+    } else if (argv[i][0] != '-' && !path) path = argv[i];
+    else { usage(argv[0]); return 2; }
+  }
+  if (!path) { usage(argv[0]); return 2; }
+
+  TraceLog    log;
+  std::string err;
+  if (!trace_load(path, log, err)) { fprintf(stderr, "%s\n", err.c_str()); return 2; }
+  if (log.bad_lines) printf("[REPLAY] %zu righe [TRC] malformate ignorate\n", log.bad_lines);
+
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<ReplayResult> res(log.segments.size());
+  std::vector<bool>         got(log.segments.size(), false);
+  bool ran = fork_pool_run<ReplayResult>(log.segments.size(), jobs,
+    [&](size_t k) { return replay_segment(log.segments[k], cfg); },
+    [&](size_t k, const ReplayResult& r, bool ok) { res[k] = r; got[k] = ok; });
+  double cpu_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  if (!ran) return 2;
+
+  uint32_t ticks = 0, diffs = 0;
+  double   span_s = 0.0;
+  bool     all_ok = true;
+  for (size_t k = 0; k < log.segments.size(); k++) {
+    print_segment(k, log.segments[k], res[k], got[k]);
+    all_ok  = all_ok && got[k];
+    ticks  += res[k].ticks;
+    diffs  += total_diffs(res[k]);
+    span_s += res[k].span_ms / 1000.0;
+  }
+  printf("\n[REPLAY] %u cicli (%.1f h di forno) in %.2f s: %s\n", ticks, span_s / 3600.0, cpu_s,
+         diffs == 0 && all_ok ? "decisioni identiche" : "DIVERGENZE");
+  return (diffs == 0 && all_ok) ? 0 : 1;
+}
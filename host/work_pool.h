@@ -0,0 +1,91 @@
+/**
+ * host/work_pool.h — Forno Pizza S3 — Pool work-stealing (solo host)
+ * ================================================================
+ * Distribuisce N job indipendenti (indici 0..N-1) su tutti i core:
+ *   - ogni worker ha una deque propria, riempita a blocchi contigui
+ *   - il proprietario estrae dal fondo (LIFO, località di cache)
+ *   - un worker a secco ruba dalla testa di un'altra deque (FIFO)
+ * I job del sweep hanno durate molto diverse (un candidato instabile
+ * vale quanto uno lento a salire), lo stealing bilancia il carico
+ * senza una coda globale contesa.
+ *
+ * Header-only, C++17 + std::thread: non usato dal firmware.
+ * ================================================================
+ */
+#pragma once
+#include <stddef.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkPool {
+public:
+  explicit WorkPool(unsigned threads = 0) {
+    _n = threads ? threads : std::thread::hardware_concurrency();
+    if (_n == 0) _n = 1;
+  }
+
+  unsigned threads() const { return _n; }
+
+  /** Esegue fn(i) per i in [0, count). Ritorna quando tutti i job sono finiti. */
+  void run(size_t count, const std::function<void(size_t)>& fn) {
+    _steals = 0;
+    std::vector<Queue> q(_n);
+    size_t per = (count + _n - 1) / _n;
+    for (unsigned w = 0; w < _n; w++) {
+      size_t lo = w * per, hi = lo + per < count ? lo + per : count;
+      for (size_t i = lo; i < hi; i++) q[w].jobs.push_back(i);
+    }
+
+    std::vector<std::thread> th;
+    for (unsigned w = 0; w < _n; w++)
+      th.emplace_back([&, w] { _worker(q, w, fn); });
+    for (auto& t : th) t.join();
+  }
+
+  /** Job rubati nell'ultimo run() (diagnostica bilanciamento). */
+  size_t steals() const { return _steals.load(); }
+
+private:
+  struct Queue {
+    std::mutex         mtx;
+    std::deque<size_t> jobs;
+  };
+
+  void _worker(std::vector<Queue>& q, unsigned self,
+               const std::function<void(size_t)>& fn) {
+    size_t job;
+    for (;;) {
+      if (_pop(q[self], job)) { fn(job); continue; }
+      bool stolen = false;
+      for (unsigned k = 1; k < _n && !stolen; k++) {
+        if (_steal(q[(self + k) % _n], job)) stolen = true;
+      }
+      if (!stolen) return;   // nessun job rimasto: le deque si svuotano soltanto
+      _steals++;
+      fn(job);
+    }
+  }
+
+  static bool _pop(Queue& q, size_t& job) {
+    std::lock_guard<std::mutex> lk(q.mtx);
+    if (q.jobs.empty()) return false;
+    job = q.jobs.back();
+    q.jobs.pop_back();
+    return true;
+  }
+
+  static bool _steal(Queue& q, size_t& job) {
+    std::lock_guard<std::mutex> lk(q.mtx);
+    if (q.jobs.empty()) return false;
+    job = q.jobs.front();
+    q.jobs.pop_front();
+    return true;
+  }
+
+  unsigned            _n;
+  std::atomic<size_t> _steals{0};
+};
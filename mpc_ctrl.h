@@ -0,0 +1,599 @@
+/**
+ * mpc_ctrl.h — Forno Pizza S3 — Controllo predittivo a finestre relay
+ * ================================================================
+ * Alternativa a PIDControllerT per Task_PID (FEATURE_MPC). A ogni
+ * finestra relay sceglie le uscite delle zone [0-100, unità PID: duty =
+ * uscita · pct/100 come duty()] che minimizzano sulle prossime
+ * MPC_HORIZON finestre
+ *
+ *   J = Σ s_z·w·e_z² + MPC_W_MOVE·Σ Δp_z²/(P_z·P) + MPC_W_ENERGY·Σ p_z/P
+ *   e_z = x̂_z - SP_z     w = MPC_W_OVER sopra il setpoint, 1 sotto
+ *
+ * con s_z la quota di capacità termica della zona, P_z la sua potenza
+ * piena e P = Σ P_z: con le due zone che si muovono insieme i pesi sono
+ * quelli del nodo singolo.
+ *
+ * MODELLO, scelto a start() dalle sonde:
+ *   SINGLE  il nodo singolo di plant_id.h, un'uscita per le due zone,
+ *           x = PV medio, SP medio delle zone abilitate
+ *   DUAL    due nodi, Base e Cielo, ciascuno con la sua perdita verso
+ *           l'ambiente e la conduttanza MPC_K_COUPLING fra loro, e
+ *           un'uscita per zona:
+ *             C_z·ẋ_z = p_z + d_z - k_z·(x_z - T_amb) - G·(x_z - x_altra)
+ *           k_z e C_z sono quote fisse (MPC_*_SHARE_BASE, il resto al
+ *           Cielo) di k e C del nodo singolo, così plant_id e il
+ *           feedforward aggiornano anche questo modello
+ * Discretizzazione esatta sulla finestra Δ (esponenziale di matrice):
+ *
+ *   x[n+1] = Φ·x[n] + Γ·(p_eff + d + k·T_amb)     (SINGLE: Φ = e^(-Δ·k/C))
+ *
+ * x = PV medio della finestra: il ripple della finestra non entra nel
+ * costo. L'energia di una finestra non è uniforme: RelayScheduler
+ * accende Base dall'inizio e Cielo fino alla fine (finestre sfasate,
+ * setStagger(), che chi usa l'MPC deve chiedere; col budget lo sono
+ * comunque), quindi il suo baricentro c·Δ dipende dal livello. Con
+ * θ = ritardo + c·Δ = (r + f)·Δ la finestra m entra in x[m+1+r] per
+ * (1-f) e in x[m+2+r] per f, come
+ * β₀/β₁ in plant_id.h con un θ per finestra: p_eff è la somma di queste
+ * quote, zona per zona. Con c fisso a ½ un taglio di potenza (ON ancora
+ * tutti in testa alla finestra) arriva in previsione più tardi del vero
+ * e l'arrivo al setpoint sfora.
+ * d [W] è il disturbo di ciascun nodo: a ogni finestra lo scarto fra x
+ * misurato e previsto, riportato in potenza con Γ⁻¹, lo corregge di
+ * MPC_DIST_GAIN, così k o C sbagliati, porta aperta e pizze non lasciano
+ * errore a regime (fa da integrale).
+ *
+ * FINESTRA: il modello vede solo la media di finestra, il ripple dentro
+ * la finestra cresce con Δ/τ. windowMs() dà la finestra relay da usare,
+ * MPC_WINDOW_TAU·τ del modello entro RELAY_WINDOW_MIN_MS…RELAY_WINDOW_MS:
+ * sul forno vero (τ di decine di minuti) resta RELAY_WINDOW_MS, sul
+ * simulatore accelerato ×4 (τ ~46 s di clock) con 30 s il ripple era
+ * ±25 °C attorno a una media giusta. Con le finestre sfasate le due
+ * resistenze si sovrappongono solo per la parte in comune e il ripple
+ * scende ancora. Una finestra nuova (setActuators()) vale come in
+ * RelayScheduler: più lunga dalla prossima, più corta già da questa.
+ *
+ * VINCOLI: stanno nelle tabelle dei livelli (setActuators), MPC_LEVELS
+ * uscite da 0 a 100 per zona. Per ciascuna la potenza che i relay daranno
+ * davvero, con le regole di RelayScheduler (relay_sched.h): duty
+ * min/max, zona più potente del budget spenta. I livelli con un ON o un
+ * OFF più corto di min_on / min_off sono scartati: lo scheduler non deve
+ * mai rimandare una commutazione. Col budget le due zone si spartiscono
+ * la finestra: sono ammesse solo le coppie con on_base + on_cielo entro
+ * la finestra, quelle che lo scheduler ridurrebbe in proporzione danno
+ * potenze che ci sono già fra le ammesse. Il PID questi limiti li scopre
+ * dopo, come potenza che non arriva; qui sono nel modello.
+ *
+ * RICERCA: move blocking a due mosse, p[0] per la finestra che parte e
+ * p[1] tenuta fino a fine orizzonte. p[0] sui MPC_LEVELS livelli (passo
+ * di un ciclo di Task_PID, la risoluzione del relay: più grosso lascia
+ * un errore a regime di mezzo passo di potenza), p[1] è solo il piano e
+ * basta un livello ogni MPC_TAIL_STEP, sulla griglia che passa per p[0]:
+ * tenere p[0] deve restare un piano possibile, altrimenti a regime il
+ * passo grosso della coda si compensa su p[0] e l'uscita cicla di ±5 %.
+ *   SINGLE  enumerazione esaustiva delle coppie (p[0], p[1]): con le
+ *           uscite quantizzate è l'ottimo esatto
+ *   DUAL    le coppie di zone sono 61² per p[0] e 21² per p[1], tutte
+ *           insieme troppe: a blocchi, ciascuno esaustivo sulle coppie
+ *           Base/Cielo ammesse dal budget. p[0] tenuto per l'orizzonte,
+ *           poi p[1] sulla griglia di p[0], poi p[0] con quel p[1], poi
+ *           di nuovo p[1]; ogni blocco parte dal migliore del precedente
+ * Senza QP né iterazioni di durata variabile; i piani il cui costo
+ * parziale supera già il migliore si fermano prima.
+ *
+ * Orizzonte corto di proposito: oltre ~τ la previsione sbaglia più di
+ * quanto l'orizzonte aiuti.
+ *
+ * COSTO CPU (orizzonte 4): SINGLE al più 61 × 21 × 4 ≈ 5.100 passi di
+ * modello, DUAL al più 2 × (61² × 4 + 21² × 3) ≈ 32.000, ~40 operazioni
+ * float ciascuno (p_eff somma le quote di 5 finestre per zona) → ~1,3
+ * Mflop una volta per finestra relay, qualche ms sull'S3 (FPU single a
+ * 240 MHz); host/mpc_bench misura solve() sull'host, evals() conta i
+ * passi dell'ultima. Negli altri cicli step() somma solo i PV. Memoria
+ * ~2 KB (tabelle dei livelli), header-only, nessuna allocazione: una
+ * istanza in Task_PID.
+ * ================================================================
+ */
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include "hardware.h"
+#include "plant_id.h"
+#include "relay_sched.h"
+
+#define MPC_LEVELS        61       // passo 1/60: un ciclo di Task_PID su 30 s di finestra
+#define MPC_TAIL_STEP     3        // p[1] su un livello ogni 3 (20-21 livelli)
+#ifndef MPC_HORIZON
+#define MPC_HORIZON       4        // finestre (2 min con 30 s, ~0,7 τ del forno)
+#endif
+#define MPC_DELAY_MAX     4        // θ massimo nel modello [finestre]
+#ifndef MPC_W_OVER
+#define MPC_W_OVER        2.0f     // peso dell'errore sopra il setpoint
+#endif
+#ifndef MPC_W_MOVE
+#define MPC_W_MOVE        100.0f   // [°C²] per un salto da 0 a piena potenza
+#endif
+#ifndef MPC_W_ENERGY
+#define MPC_W_ENERGY      0.5f     // [°C²] per finestra a piena potenza (spareggio)
+#endif
+#ifndef MPC_DIST_GAIN
+#define MPC_DIST_GAIN     0.5f
+#endif
+#ifndef MPC_WINDOW_TAU
+#define MPC_WINDOW_TAU    0.2f     // finestra relay massima in τ del modello
+#endif
+
+// Modello di partenza (forno di riferimento, come simulator.h): k lo
+// sostituisce il feedforward imparato, tutto il modello FEATURE_PLANT_ID
+// o i valori di host/plant_fit
+#ifndef MPC_K_LOSS
+#define MPC_K_LOSS        6.0f     // [W/°C]
+#endif
+#ifndef MPC_MASS
+#define MPC_MASS          1100.0f  // [J/°C]
+#endif
+#ifndef MPC_T_AMB
+#define MPC_T_AMB         20.0f
+#endif
+#ifndef MPC_DEAD_S
+#define MPC_DEAD_S        0.0f
+#endif
+// DUAL: quote della Base in k e C, conduttanza Base↔Cielo
+#ifndef MPC_K_SHARE_BASE
+#define MPC_K_SHARE_BASE    0.42f  // 2.5 su 6 W/°C
+#endif
+#ifndef MPC_MASS_SHARE_BASE
+#define MPC_MASS_SHARE_BASE 0.64f  // 700 su 1100 J/°C
+#endif
+#ifndef MPC_K_COUPLING
+#define MPC_K_COUPLING    40.0f    // [W/°C]
+#endif
+
+class MpcController {
+public:
+  void begin() {
+    PlantModel m = {};
+    m.k_loss = MPC_K_LOSS;
+    m.mass   = MPC_MASS;
+    m.t_amb  = MPC_T_AMB;
+    m.dead_s = MPC_DEAD_S;
+    m.tau_s  = MPC_MASS / MPC_K_LOSS;
+    _model   = PlantModel{};
+    _act     = _act_next = Act{};
+    _window_ms = _window_next = RELAY_WINDOW_MS;
+    _dual    = false;
+    _run     = false;
+    _evals   = 0;
+    for (float& o : _out) o = 0.0f;
+    setModel(m);
+  }
+
+  /** k_loss, mass, t_amb e dead_s del nodo singolo; power_w non serve (la danno gli attuatori). */
+  void setModel(const PlantModel& m) {
+    if (m.k_loss == _model.k_loss && m.mass == _model.mass &&
+        m.t_amb == _model.t_amb && m.dead_s == _model.dead_s) return;
+    if (!(m.k_loss > 0.0f) || !(m.mass > 0.0f)) return;
+    _model = m;
+    _discretize();
+  }
+  const PlantModel& model() const { return _model; }
+
+  /**
+   * Finestra relay [ms] per questo modello: MPC_WINDOW_TAU·τ entro
+   * RELAY_WINDOW_MIN_MS…RELAY_WINDOW_MS, a secondi interi. Il chiamante
+   * la dà a RelayScheduler::setWindowMs() e a setActuators().
+   */
+  uint32_t windowMs() const {
+    float ms = MPC_WINDOW_TAU * _model.mass / _model.k_loss * 1000.0f;
+    if (ms >= (float)RELAY_WINDOW_MS)     return RELAY_WINDOW_MS;
+    if (ms <= (float)RELAY_WINDOW_MIN_MS) return RELAY_WINDOW_MIN_MS;
+    return (uint32_t)(ms / 1000.0f) * 1000UL;
+  }
+
+  /**
+   * Potenza delle zone [W] (0 = zona spenta o sonda in errore), pct_*,
+   * budget e tempi minimi di RelayScheduler, finestra. Da Task_PID a ogni
+   * ciclo: le tabelle dei livelli si ricalcolano solo se qualcosa cambia,
+   * in corsa alla decisione successiva.
+   */
+  void setActuators(const float power_w[RELAY_ZONES], const int pct[RELAY_ZONES],
+                    float budget_w, uint32_t min_on_ms, uint32_t min_off_ms,
+                    uint32_t window_ms) {
+    Act a;
+    for (int z = 0; z < RELAY_ZONES; z++) { a.power_w[z] = power_w[z]; a.pct[z] = pct[z]; }
+    a.budget_w = budget_w;  a.min_on = min_on_ms;  a.min_off = min_off_ms;
+    _act_next    = a;
+    _window_next = window_ms;
+    if (!_run) _apply_actuators();
+  }
+
+  /**
+   * Riparte da ora (zona abilitata, fine autotune, sonde cambiate):
+   * nuova finestra, storia della potenza alle uscite out_pct[] di chi
+   * comandava prima, disturbo azzerato (quello stimato vale alla
+   * temperatura di prima). dual: un nodo e un'uscita per zona.
+   */
+  void start(const float out_pct[RELAY_ZONES], bool dual, uint32_t now) {
+    if (dual != _dual) { _dual = dual; _discretize(); }
+    _apply_actuators();
+    for (int z = 0; z < RELAY_ZONES; z++) {
+      float    w, c;
+      uint32_t on;
+      _level_power(z, out_pct[z], w, c, on);
+      for (float& h : _hist_w[z]) h = w;
+      for (float& h : _hist_c[z]) h = c;
+      _out[z]    = out_pct[z];
+      _dist_w[z] = 0.0f;
+      _sum[z]    = 0.0;
+    }
+    _run    = true;
+    _first  = true;
+    _win_ms = now;
+    _n      = 0;
+  }
+  void stop() { _run = false; }
+  bool running() const { return _run; }
+  bool dual()    const { return _dual; }
+
+  /**
+   * Un ciclo: PV e setpoint correnti delle zone. Ritorna true quando
+   * decide nuove uscite (inizio finestra: la prima dopo start() e poi
+   * ogni finestra), allineate alla finestra che il chiamante fa ripartire
+   * con RelayScheduler::restart().
+   */
+  bool step(const float pv[RELAY_ZONES], const float sp[RELAY_ZONES], uint32_t now) {
+    if (!_run || isnan(pv[0]) || isnan(pv[1])) return false;
+    uint32_t len = _window_next < _window_ms ? _window_next : _window_ms;
+    if (!_first && now - _win_ms < len) {   // come RelayScheduler: più corta vale subito
+      for (int z = 0; z < RELAY_ZONES; z++) _sum[z] += pv[z];
+      _n++;
+      return false;
+    }
+    float x[RELAY_ZONES];                       // media della finestra chiusa
+    for (int z = 0; z < RELAY_ZONES; z++) x[z] = _n ? (float)(_sum[z] / _n) : pv[z];
+    float xs[RELAY_ZONES], ss[RELAY_ZONES];
+    _state(x, sp, xs, ss);
+    if (!_first) _update_dist(xs);
+    _apply_actuators();
+    _first  = false;
+    _win_ms = now;
+    for (int z = 0; z < RELAY_ZONES; z++) _sum[z] = pv[z];
+    _n      = 1;
+    _solve(xs, ss);
+    return true;
+  }
+
+  float    outPct(int z)       const { return _out[z]; }
+  float    predicted(int z)    const { return _x_pred[_dual ? z : 0]; }   // PV medio previsto della finestra
+  float    disturbanceW(int z) const { return _dist_w[_dual ? z : 0]; }
+  uint32_t evals()             const { return _evals; }   // passi di modello dell'ultima solve
+
+private:
+  struct Act {
+    float    power_w[RELAY_ZONES] = {};
+    int      pct[RELAY_ZONES]     = {};
+    float    budget_w = 0.0f;
+    uint32_t min_on = 0, min_off = 0;
+    bool operator==(const Act& o) const {
+      for (int z = 0; z < RELAY_ZONES; z++)
+        if (power_w[z] != o.power_w[z] || pct[z] != o.pct[z]) return false;
+      return budget_w == o.budget_w && min_on == o.min_on && min_off == o.min_off;
+    }
+  };
+
+  PlantModel _model = {};
+  Act        _act, _act_next;
+  uint32_t   _window_ms = RELAY_WINDOW_MS, _window_next = RELAY_WINDOW_MS;
+  bool       _dual = false;
+  // Modello discreto: x' = Φ·x + Γ·p + _u (SINGLE: solo [0][0], p somma le zone)
+  float _phi[RELAY_ZONES][RELAY_ZONES] = {};
+  float _gam[RELAY_ZONES][RELAY_ZONES] = {};
+  float _k[RELAY_ZONES]    = {};           // perdita verso l'ambiente [W/°C]
+  float _s[RELAY_ZONES]    = {};           // quota di capacità
+  float _we[RELAY_ZONES]   = {};           // peso dell'errore: _s sulle zone alimentate
+  float _u[RELAY_ZONES]    = {};           // Γ·(d + k·T_amb)
+  float _dead = 0.0f;                      // ritardo [finestre]
+  // Livelli per zona
+  float    _lvl_w[RELAY_ZONES][MPC_LEVELS]  = {};
+  float    _lvl_c[RELAY_ZONES][MPC_LEVELS]  = {};   // baricentro dell'energia [finestre]
+  uint32_t _lvl_on[RELAY_ZONES][MPC_LEVELS] = {};   // ms ON
+  bool     _lvl_ok[RELAY_ZONES][MPC_LEVELS] = {};
+  float    _p_full[RELAY_ZONES] = {};               // potenza massima ammessa [W]
+  float    _w_move[RELAY_ZONES] = {};               // MPC_W_MOVE/(P_z·P)
+  float    _w_energy = 0.0f;                        // MPC_W_ENERGY/P
+  bool     _shared   = false;                       // budget: coppie da on_b + on_c ≤ finestra
+  // Stato: finestre passate per zona, [0] = ultima
+  float    _hist_w[RELAY_ZONES][MPC_DELAY_MAX + 1] = {};
+  float    _hist_c[RELAY_ZONES][MPC_DELAY_MAX + 1] = {};
+  float    _out[RELAY_ZONES]    = {};
+  float    _x_pred[RELAY_ZONES] = {};
+  float    _dist_w[RELAY_ZONES] = {};
+  double   _sum[RELAY_ZONES]    = {};
+  uint32_t _win_ms = 0, _n = 0, _evals = 0;
+  bool     _run = false, _first = true;
+  // Ricerca in corso
+  float _x0[RELAY_ZONES] = {}, _sp[RELAY_ZONES] = {};
+  float _best = 0.0f;
+  int   _b0[RELAY_ZONES] = {}, _b1[RELAY_ZONES] = {};
+
+  static float _level_out(int i) { return 100.0f * i / (MPC_LEVELS - 1); }
+  bool _powered(int z) const { return _act.power_w[z] > 0.0f; }
+
+  // exp(Z) in place, Z n×n per righe (n ≤ 4): Taylor all'8° ordine su
+  // Z/2^s con norma ≤ ½, poi s quadrati
+  static void _expm(float* z, int n) {
+    float norm = 0.0f;
+    for (int r = 0; r < n; r++) {
+      float s = 0.0f;
+      for (int c = 0; c < n; c++) s += fabsf(z[r * n + c]);
+      if (s > norm) norm = s;
+    }
+    int sq = 0;
+    while (norm > 0.5f && sq < 30) { norm *= 0.5f; sq++; }
+    float a[16], term[16], res[16], tmp[16];
+    for (int i = 0; i < n * n; i++) {
+      a[i]    = ldexpf(z[i], -sq);
+      term[i] = res[i] = (i / n == i % n) ? 1.0f : 0.0f;
+    }
+    for (int k = 1; k <= 8; k++) {
+      for (int r = 0; r < n; r++)
+        for (int c = 0; c < n; c++) {
+          float s = 0.0f;
+          for (int j = 0; j < n; j++) s += term[r * n + j] * a[j * n + c];
+          tmp[r * n + c] = s / k;
+        }
+      for (int i = 0; i < n * n; i++) { term[i] = tmp[i]; res[i] += tmp[i]; }
+    }
+    for (int q = 0; q < sq; q++) {
+      for (int r = 0; r < n; r++)
+        for (int c = 0; c < n; c++) {
+          float s = 0.0f;
+          for (int j = 0; j < n; j++) s += res[r * n + j] * res[j * n + c];
+          tmp[r * n + c] = s;
+        }
+      for (int i = 0; i < n * n; i++) res[i] = tmp[i];
+    }
+    for (int i = 0; i < n * n; i++) z[i] = res[i];
+  }
+
+  void _discretize() {
+    float dt_s = _window_ms / 1000.0f;
+    _dead      = (_model.dead_s > 0.0f ? _model.dead_s : 0.0f) / dt_s;
+    if (_dead > MPC_DELAY_MAX - 1) _dead = MPC_DELAY_MAX - 1;
+    for (int i = 0; i < RELAY_ZONES; i++)
+      for (int j = 0; j < RELAY_ZONES; j++) _phi[i][j] = _gam[i][j] = 0.0f;
+    if (!_dual) {
+      float a    = expf(-dt_s * _model.k_loss / _model.mass);
+      _phi[0][0] = a;
+      _gam[0][0] = (1.0f - a) / _model.k_loss;
+      _k[0] = _model.k_loss;  _k[1] = 0.0f;
+      _s[0] = 1.0f;           _s[1] = 0.0f;
+      return;
+    }
+    // [A·Δ  Δ·C⁻¹; 0  0] → [Φ  Γ; 0  I]
+    const float g    = MPC_K_COUPLING;
+    const float k[2] = { _model.k_loss * MPC_K_SHARE_BASE, _model.k_loss * (1.0f - MPC_K_SHARE_BASE) };
+    const float m[2] = { _model.mass * MPC_MASS_SHARE_BASE, _model.mass * (1.0f - MPC_MASS_SHARE_BASE) };
+    float z[16] = {};
+    for (int i = 0; i < 2; i++) {
+      z[i * 4 + i]       = -(k[i] + g) / m[i] * dt_s;
+      z[i * 4 + 1 - i]   = g / m[i] * dt_s;
+      z[i * 4 + 2 + i]   = dt_s / m[i];
+      _k[i] = k[i];
+      _s[i] = m[i] / _model.mass;
+    }
+    _expm(z, 4);
+    for (int i = 0; i < 2; i++)
+      for (int j = 0; j < 2; j++) { _phi[i][j] = z[i * 4 + j]; _gam[i][j] = z[i * 4 + 2 + j]; }
+  }
+
+  // Attuatori e finestra chiesti con setActuators(): tabelle dei livelli
+  void _apply_actuators() {
+    if (_act_next == _act && _window_next == _window_ms) return;
+    bool win = _window_next != _window_ms;
+    _act       = _act_next;
+    _window_ms = _window_next;
+    if (win) _discretize();
+    float p = 0.0f;
+    for (int z = 0; z < RELAY_ZONES; z++) {
+      _p_full[z] = 0.0f;
+      for (int i = 0; i < MPC_LEVELS; i++) {
+        _lvl_ok[z][i] = _level_power(z, _level_out(i), _lvl_w[z][i], _lvl_c[z][i], _lvl_on[z][i]);
+        if (_lvl_ok[z][i] && _lvl_w[z][i] > _p_full[z]) _p_full[z] = _lvl_w[z][i];
+      }
+      p += _p_full[z];
+    }
+    for (int z = 0; z < RELAY_ZONES; z++)
+      _w_move[z] = _p_full[z] > 0.0f ? MPC_W_MOVE / (_p_full[z] * p) : 0.0f;
+    _w_energy = p > 0.0f ? MPC_W_ENERGY / p : 0.0f;
+    const float* pw = _act.power_w;
+    _shared = _act.budget_w > 0.0f && pw[0] > 0.0f && pw[1] > 0.0f &&
+              pw[0] <= _act.budget_w && pw[1] <= _act.budget_w && pw[0] + pw[1] > _act.budget_w;
+  }
+
+  // Potenza media [W] che il relay della zona dà all'uscita out, baricentro
+  // c dell'energia nella finestra [0-1] e ms ON; false se l'ON o l'OFF
+  // violerebbe i tempi minimi
+  bool _level_power(int z, float out, float& w, float& c, uint32_t& on) const {
+    float pw = _act.power_w[z];
+    on = pw > 0.0f && !(_act.budget_w > 0.0f && pw > _act.budget_w)
+           ? RelayScheduler::onTimeMs(out * _act.pct[z] / 100.0f, _window_ms) : 0;
+    bool  ok  = !(on > 0 && on < _act.min_on) &&
+                !(on < _window_ms && _window_ms - on < _act.min_off);
+    float mid = 0.5f * on / _window_ms;
+    w = pw * on / _window_ms;
+    c = w > 0.0f ? (z == (int)RelayZone::CIELO ? 1.0f - mid : mid) : 0.5f;   // Cielo a fine finestra
+    return ok;
+  }
+
+  bool _pair_ok(int ib, int ic) const {
+    return _lvl_ok[0][ib] && _lvl_ok[1][ic] &&
+           (!_shared || _lvl_on[0][ib] + _lvl_on[1][ic] <= _window_ms);
+  }
+
+  // Stato del modello dalle medie di finestra: SINGLE un nodo, PV e SP
+  // medi delle zone abilitate
+  void _state(const float x[RELAY_ZONES], const float sp[RELAY_ZONES],
+              float xs[RELAY_ZONES], float ss[RELAY_ZONES]) const {
+    for (int z = 0; z < RELAY_ZONES; z++) { xs[z] = x[z]; ss[z] = sp[z]; }
+    if (_dual) return;
+    int   n  = 0;
+    float xm = 0.0f, sm = 0.0f;
+    for (int z = 0; z < RELAY_ZONES; z++)
+      if (_powered(z)) { xm += x[z]; sm += sp[z]; n++; }
+    if (!n) { xm = 0.5f * (x[0] + x[1]); sm = 0.5f * (sp[0] + sp[1]); n = 1; }
+    xs[0] = xs[1] = xm / n;
+    ss[0] = ss[1] = sm / n;
+  }
+
+  // Quota della finestra (p, c) in x d passi dopo (d = 0: la sua media)
+  float _share(int d, float p, float c) const {
+    float theta = _dead + c;
+    int   r     = (int)theta;
+    float f     = theta - r;
+    return d == r ? (1.0f - f) * p : (d == r + 1 ? f * p : 0.0f);
+  }
+
+  // Potenza della zona che muove x nel passo j (j = 0: finestra che parte)
+  float _p_eff(int z, int j, int i0, int i1) const {
+    float p = 0.0f;
+    for (int d = 0; d <= MPC_DELAY_MAX; d++) {
+      int m = j - d;
+      if (m < 0)       p += _share(d, _hist_w[z][-m - 1], _hist_c[z][-m - 1]);
+      else if (m == 0) p += _share(d, _lvl_w[z][i0], _lvl_c[z][i0]);
+      else             p += _share(d, _lvl_w[z][i1], _lvl_c[z][i1]);
+    }
+    return p;
+  }
+
+  void _next(const float x[RELAY_ZONES], const float p[RELAY_ZONES], float y[RELAY_ZONES]) const {
+    if (!_dual) {
+      y[0] = y[1] = _phi[0][0] * x[0] + _gam[0][0] * (p[0] + p[1]) + _u[0];
+      return;
+    }
+    for (int i = 0; i < RELAY_ZONES; i++)
+      y[i] = _phi[i][0] * x[0] + _phi[i][1] * x[1] + _gam[i][0] * p[0] + _gam[i][1] * p[1] + _u[i];
+  }
+
+  float _err_cost(const float x[RELAY_ZONES]) const {
+    float c = 0.0f;
+    for (int z = 0; z < (_dual ? RELAY_ZONES : 1); z++) {
+      float e = x[z] - _sp[z];
+      c += _we[z] * (e > 0.0f ? MPC_W_OVER : 1.0f) * e * e;
+    }
+    return c;
+  }
+
+  void _update_dist(const float x[RELAY_ZONES]) {
+    float e0 = x[0] - _x_pred[0], e1 = x[1] - _x_pred[1];
+    if (!_dual) {
+      if (_gam[0][0] > 0.0f) _dist_w[0] += MPC_DIST_GAIN * e0 / _gam[0][0];
+    } else {
+      float det = _gam[0][0] * _gam[1][1] - _gam[0][1] * _gam[1][0];
+      if (det != 0.0f) {
+        _dist_w[0] += MPC_DIST_GAIN * ( _gam[1][1] * e0 - _gam[0][1] * e1) / det;
+        _dist_w[1] += MPC_DIST_GAIN * (-_gam[1][0] * e0 + _gam[0][0] * e1) / det;
+      }
+    }
+    float lim = _p_full[0] + _p_full[1];
+    if (lim <= 0.0f) lim = _act.power_w[0] + _act.power_w[1];
+    for (float& d : _dist_w) {
+      if (d >  lim) d =  lim;
+      if (d < -lim) d = -lim;
+    }
+  }
+
+  // Piano i0 nella finestra che parte, i1 fino a fine orizzonte: se costa
+  // meno del migliore lo prende (si ferma appena lo supera)
+  void _try(const int i0[RELAY_ZONES], const int i1[RELAY_ZONES]) {
+    float c = 0.0f;
+    for (int z = 0; z < RELAY_ZONES; z++) {
+      float p0 = _lvl_w[z][i0[z]], p1 = _lvl_w[z][i1[z]];
+      float d0 = p0 - _hist_w[z][0], d1 = p1 - p0;
+      c += _w_move[z] * (d0 * d0 + d1 * d1) + _w_energy * (p0 + p1 * (MPC_HORIZON - 1));
+    }
+    float x[RELAY_ZONES] = { _x0[0], _x0[1] };
+    for (int j = 0; j < MPC_HORIZON && c < _best; j++) {
+      const float p[RELAY_ZONES] = { _p_eff(0, j, i0[0], i1[0]), _p_eff(1, j, i0[1], i1[1]) };
+      float y[RELAY_ZONES];
+      _next(x, p, y);
+      c += _err_cost(y);
+      x[0] = y[0];  x[1] = y[1];
+      _evals++;
+    }
+    if (c >= _best) return;
+    _best = c;
+    for (int z = 0; z < RELAY_ZONES; z++) { _b0[z] = i0[z]; _b1[z] = i1[z]; }
+  }
+
+  // DUAL: blocchi p[0] (i1 < 0: tenuto per l'orizzonte) o p[1] sulla
+  // griglia del p[0] migliore, su tutte le coppie ammesse
+  void _sweep_head(bool hold) {
+    const int n0 = _powered(0) ? MPC_LEVELS : 1, n1 = _powered(1) ? MPC_LEVELS : 1;
+    const int t1[RELAY_ZONES] = { _b1[0], _b1[1] };
+    for (int ib = 0; ib < n0; ib++)
+      for (int ic = 0; ic < n1; ic++) {
+        if (!_pair_ok(ib, ic)) continue;
+        const int i0[RELAY_ZONES] = { ib, ic };
+        _try(i0, hold ? i0 : t1);
+      }
+  }
+  void _sweep_tail() {
+    const int i0[RELAY_ZONES] = { _b0[0], _b0[1] };
+    const int s0 = _powered(0) ? MPC_TAIL_STEP : MPC_LEVELS;
+    const int s1 = _powered(1) ? MPC_TAIL_STEP : MPC_LEVELS;
+    for (int kb = i0[0] % s0; kb < MPC_LEVELS; kb += s0)
+      for (int kc = i0[1] % s1; kc < MPC_LEVELS; kc += s1) {
+        if (!_pair_ok(kb, kc)) continue;
+        const int i1[RELAY_ZONES] = { kb, kc };
+        _try(i0, i1);
+      }
+  }
+
+  void _solve(const float x0[RELAY_ZONES], const float sp[RELAY_ZONES]) {
+    float s = 0.0f;
+    for (int z = 0; z < RELAY_ZONES; z++) s += _powered(z) ? _s[z] : 0.0f;
+    for (int i = 0; i < RELAY_ZONES; i++) {
+      _we[i] = !_dual ? _s[i] : (s > 0.0f ? (_powered(i) ? _s[i] / s : 0.0f) : _s[i]);
+      _x0[i] = x0[i];
+      _sp[i] = sp[i];
+      _u[i]  = 0.0f;
+      for (int j = 0; j < RELAY_ZONES; j++)
+        _u[i] += _gam[i][j] * (_dist_w[j] + _k[j] * _model.t_amb);
+    }
+    _best  = INFINITY;
+    _evals = 0;
+    for (int z = 0; z < RELAY_ZONES; z++) _b0[z] = _b1[z] = 0;
+    if (!_dual) {
+      // Uscita comune: tutte le coppie (p[0], p[1])
+      for (int i = 0; i < MPC_LEVELS; i++) {
+        if (!_pair_ok(i, i)) continue;
+        const int i0[RELAY_ZONES] = { i, i };
+        for (int k = i % MPC_TAIL_STEP; k < MPC_LEVELS; k += MPC_TAIL_STEP) {
+          if (!_pair_ok(k, k)) continue;
+          const int i1[RELAY_ZONES] = { k, k };
+          _try(i0, i1);
+        }
+      }
+    } else {
+      _sweep_head(true);
+      _sweep_tail();
+      _sweep_head(false);
+      _sweep_tail();
+    }
+    float p[RELAY_ZONES];
+    for (int z = 0; z < RELAY_ZONES; z++) {
+      _out[z] = _level_out(_b0[z]);
+      p[z]    = _p_eff(z, 0, _b0[z], _b1[z]);
+    }
+    _next(x0, p, _x_pred);
+    for (int z = 0; z < RELAY_ZONES; z++) {
+      for (int j = MPC_DELAY_MAX; j > 0; j--) {
+        _hist_w[z][j] = _hist_w[z][j - 1];
+        _hist_c[z][j] = _hist_c[z][j - 1];
+      }
+      _hist_w[z][0] = _lvl_w[z][_b0[z]];
+      _hist_c[z][0] = _lvl_c[z][_b0[z]];
+    }
+  }
+};
@@ -7,11 +7,25 @@
  *   - Modalità SINGLE/DUAL sensore
  *   - Percentuale potenza indipendente per Base (0-100%)
  *   - Percentuale potenza indipendente per Cielo (0-100%)
+ *   - Tabelle guadagni a fasce Base/Cielo (gain_sched.h), un blob per
+ *     zona: versione, n, poi per punto T [°C] uint16 + Kp/Ki/Kd float
+ *     (≤ 58 byte). Blob assente o non valido = tabella vuota.
+ *   - Coefficiente di perdita del forno [W/°C] per il feedforward
+ *     (feedforward.h): 0 = nessun modello, i guadagni PID correggono
+ *     lo scarto dal duty di modello
+ *   - Accoppiamento Base/Cielo (zone_coupling.h), blob: versione, poi
+ *     K_ii, K_ij, P0 per zona in float (25 byte). Assente o non fisico
+ *     = nessuna stima, feedforward a k unico
+ *   - Chiusure totali dei relay Base e Cielo (relay_window.h): la vita
+ *     consumata dei contattori, ogni RELAY_WEAR_SAVE_MS
  * ================================================================
  */
 
 #pragma once
 #include <Preferences.h>
+#include <string.h>
+#include "gain_sched.h"
+#include "zone_coupling.h"
 
 #define NVS_NAMESPACE   "forno"
 
@@ -26,6 +40,18 @@
 #define NVS_SINGLE_MODE "single_mode"   // 0=DUAL, 1=SINGLE
 #define NVS_PCT_BASE    "pct_base"      // % potenza Base  (0..100)
 #define NVS_PCT_CIELO   "pct_cielo"     // % potenza Cielo (0..100)
+#define NVS_GAINS_BASE  "gains_base"    // blob GainTable
+#define NVS_GAINS_CIELO "gains_cielo"
+#define NVS_FF_K        "ff_k"          // W/°C
+#define NVS_COUPLING    "coupling"      // blob ZoneCoupling
+#define NVS_CYC_BASE    "cyc_base"      // chiusure relay Base
+#define NVS_CYC_CIELO   "cyc_cielo"
+
+#define NVS_GAINS_VER     1
+#define NVS_GAINS_PT_LEN  (2 + 3 * 4)
+#define NVS_GAINS_LEN     (2 + GAIN_SCHED_POINTS * NVS_GAINS_PT_LEN)
+#define NVS_COUPLING_VER  1
+#define NVS_COUPLING_LEN  (1 + 3 * DECOUPLE_ZONES * 4)
 
 #define DEFAULT_SET_BASE    250.0f
 #define DEFAULT_SET_CIELO   300.0f
@@ -36,8 +62,14 @@
 #define DEFAULT_KI_CIELO    0.03f
 #define DEFAULT_KD_CIELO    1.5f
 #define DEFAULT_SINGLE_MODE 1     // SINGLE di default
+// Intervalli accettati al caricamento: anche l'autotune li rispetta,
+// così i guadagni in uso sono quelli che sopravvivono a un riavvio
+#define NVS_KP_MAX          20.0f
+#define NVS_KI_MAX           1.0f
+#define NVS_KD_MAX          20.0f
 #define DEFAULT_PCT_BASE    100   // 100% = nessuna riduzione
 #define DEFAULT_PCT_CIELO   100
+#define NVS_FF_K_MAX       100.0f // = FF_K_MAX
 
 struct NVSData {
   float set_base, set_cielo;
@@ -46,6 +78,10 @@ struct NVSData {
   int   single_mode;
   int   pct_base;    // % scala output PID resistenza BASE  (0..100)
   int   pct_cielo;   // % scala output PID resistenza CIELO (0..100)
+  GainTable gains_base, gains_cielo;
+  float ff_k;
+  ZoneCoupling coupling;
+  uint32_t cycles_base, cycles_cielo;
 };
 
 class NVSStorage {
@@ -66,11 +102,19 @@ public:
     d.single_mode = _prefs.getInt  (NVS_SINGLE_MODE, DEFAULT_SINGLE_MODE);
     d.pct_base    = _prefs.getInt  (NVS_PCT_BASE,    DEFAULT_PCT_BASE);
     d.pct_cielo   = _prefs.getInt  (NVS_PCT_CIELO,   DEFAULT_PCT_CIELO);
+    _getGains(NVS_GAINS_BASE,  d.gains_base);
+    _getGains(NVS_GAINS_CIELO, d.gains_cielo);
+    d.ff_k        = _prefs.getFloat(NVS_FF_K,        0.0f);
+    _getCoupling(d.coupling);
+    d.cycles_base  = _prefs.getUInt(NVS_CYC_BASE,  0);
+    d.cycles_cielo = _prefs.getUInt(NVS_CYC_CIELO, 0);
     _prefs.end();
     _validate(d);
-    Serial.printf("[NVS] Caricato: mode=%s set=%.0f/%.0f pct=%d%%/%d%%\n",
+    Serial.printf("[NVS] Caricato: mode=%s set=%.0f/%.0f pct=%d%%/%d%% fasce=%d/%d ff_k=%.2f chiusure=%lu/%lu\n",
       d.single_mode ? "SINGLE" : "DUAL",
-      d.set_base, d.set_cielo, d.pct_base, d.pct_cielo);
+      d.set_base, d.set_cielo, d.pct_base, d.pct_cielo,
+      d.gains_base.n, d.gains_cielo.n, d.ff_k,
+      (unsigned long)d.cycles_base, (unsigned long)d.cycles_cielo);
     return true;
   }
 
@@ -89,6 +133,12 @@ public:
     _prefs.putInt  (NVS_SINGLE_MODE, d.single_mode);
     _prefs.putInt  (NVS_PCT_BASE,    d.pct_base);
     _prefs.putInt  (NVS_PCT_CIELO,   d.pct_cielo);
+    _putGains(NVS_GAINS_BASE,  d.gains_base);
+    _putGains(NVS_GAINS_CIELO, d.gains_cielo);
+    _prefs.putFloat(NVS_FF_K,        d.ff_k);
+    _putCoupling(d.coupling);
+    _prefs.putUInt(NVS_CYC_BASE,  d.cycles_base);
+    _prefs.putUInt(NVS_CYC_CIELO, d.cycles_cielo);
     _prefs.end();
     Serial.printf("[NVS] Salvato: mode=%s set=%.0f/%.0f pct=%d%%/%d%%\n",
       d.single_mode ? "SINGLE" : "DUAL",
@@ -110,19 +160,105 @@ private:
     d.single_mode = DEFAULT_SINGLE_MODE;
     d.pct_base    = DEFAULT_PCT_BASE;
     d.pct_cielo   = DEFAULT_PCT_CIELO;
+    d.gains_base.clear();
+    d.gains_cielo.clear();
+    d.ff_k        = 0.0f;
+    d.coupling    = ZoneCoupling{};
+    d.cycles_base = d.cycles_cielo = 0;
+  }
+
+  void _putGains(const char* key, const GainTable& g) {
+    uint8_t buf[NVS_GAINS_LEN];
+    buf[0] = NVS_GAINS_VER;
+    buf[1] = g.n;
+    uint8_t* p = buf + 2;
+    for (int i = 0; i < g.n; i++, p += NVS_GAINS_PT_LEN) {
+      uint16_t t = (uint16_t)(g.pt[i].t_c + 0.5f);
+      memcpy(p,      &t,          2);
+      memcpy(p + 2,  &g.pt[i].kp, 4);
+      memcpy(p + 6,  &g.pt[i].ki, 4);
+      memcpy(p + 10, &g.pt[i].kd, 4);
+    }
+    _prefs.putBytes(key, buf, p - buf);
+  }
+
+  void _getGains(const char* key, GainTable& g) {
+    uint8_t buf[NVS_GAINS_LEN];
+    g.clear();
+    size_t len = _prefs.getBytesLength(key);
+    if (len < 2 || len > sizeof(buf) || _prefs.getBytes(key, buf, sizeof(buf)) != len) return;
+    if (buf[0] != NVS_GAINS_VER || buf[1] > GAIN_SCHED_POINTS ||
+        len != 2 + (size_t)buf[1] * NVS_GAINS_PT_LEN) return;
+    const uint8_t* p = buf + 2;
+    for (int i = 0; i < buf[1]; i++, p += NVS_GAINS_PT_LEN) {
+      uint16_t  t;
+      GainPoint gp;
+      memcpy(&t,     p,      2);
+      memcpy(&gp.kp, p + 2,  4);
+      memcpy(&gp.ki, p + 6,  4);
+      memcpy(&gp.kd, p + 10, 4);
+      gp.t_c = t;
+      g.pt[i] = gp;
+    }
+    g.n = buf[1];
+  }
+
+  void _putCoupling(const ZoneCoupling& c) {
+    if (!c.valid) { _prefs.remove(NVS_COUPLING); return; }
+    uint8_t buf[NVS_COUPLING_LEN];
+    buf[0] = NVS_COUPLING_VER;
+    memcpy(buf + 1,                      c.kii, sizeof(c.kii));
+    memcpy(buf + 1 + sizeof(c.kii),      c.kij, sizeof(c.kij));
+    memcpy(buf + 1 + 2 * sizeof(c.kii),  c.p0,  sizeof(c.p0));
+    _prefs.putBytes(NVS_COUPLING, buf, sizeof(buf));
+  }
+
+  void _getCoupling(ZoneCoupling& c) {
+    uint8_t buf[NVS_COUPLING_LEN];
+    c = ZoneCoupling{};
+    if (_prefs.getBytesLength(NVS_COUPLING) != sizeof(buf) ||
+        _prefs.getBytes(NVS_COUPLING, buf, sizeof(buf)) != sizeof(buf) ||
+        buf[0] != NVS_COUPLING_VER) return;
+    memcpy(c.kii, buf + 1,                     sizeof(c.kii));
+    memcpy(c.kij, buf + 1 + sizeof(c.kii),     sizeof(c.kij));
+    memcpy(c.p0,  buf + 1 + 2 * sizeof(c.kii), sizeof(c.p0));
+    c.valid = 1;
+  }
+
+  // Stessi vincoli fisici di CouplingIdentifier::solve()
+  static bool _couplingValid(const ZoneCoupling& c) {
+    for (int z = 0; z < DECOUPLE_ZONES; z++)
+      if (!(c.kij[z] <= 0.0f) || !(c.kii[z] + c.kij[z] > 0.0f) || !(c.kii[z] < NVS_FF_K_MAX * 10) ||
+          !(fabsf(c.p0[z]) < 1e5f)) return false;
+    return true;
+  }
+
+  // Tabella intera o niente: un punto fuori range la svuota
+  static bool _gainsValid(const GainTable& g) {
+    for (int i = 0; i < g.n; i++) {
+      const GainPoint& p = g.pt[i];
+      if (p.t_c < 50 || p.t_c > 500 || (i > 0 && p.t_c <= g.pt[i - 1].t_c)) return false;
+      if (!(p.kp >= 0 && p.kp <= NVS_KP_MAX) || !(p.ki >= 0 && p.ki <= NVS_KI_MAX) ||
+          !(p.kd >= 0 && p.kd <= NVS_KD_MAX)) return false;
+    }
+    return true;
   }
 
   void _validate(NVSData& d) {
     if (d.set_base  < 50 || d.set_base  > 500) d.set_base  = DEFAULT_SET_BASE;
     if (d.set_cielo < 50 || d.set_cielo > 500) d.set_cielo = DEFAULT_SET_CIELO;
-    if (d.kp_base   < 0  || d.kp_base   > 20)  d.kp_base   = DEFAULT_KP_BASE;
-    if (d.kp_cielo  < 0  || d.kp_cielo  > 20)  d.kp_cielo  = DEFAULT_KP_CIELO;
-    if (d.ki_base   < 0  || d.ki_base   > 1)   d.ki_base   = DEFAULT_KI_BASE;
-    if (d.ki_cielo  < 0  || d.ki_cielo  > 1)   d.ki_cielo  = DEFAULT_KI_CIELO;
-    if (d.kd_base   < 0  || d.kd_base   > 20)  d.kd_base   = DEFAULT_KD_BASE;
-    if (d.kd_cielo  < 0  || d.kd_cielo  > 20)  d.kd_cielo  = DEFAULT_KD_CIELO;
+    if (d.kp_base   < 0  || d.kp_base   > NVS_KP_MAX)  d.kp_base   = DEFAULT_KP_BASE;
+    if (d.kp_cielo  < 0  || d.kp_cielo  > NVS_KP_MAX)  d.kp_cielo  = DEFAULT_KP_CIELO;
+    if (d.ki_base   < 0  || d.ki_base   > NVS_KI_MAX)  d.ki_base   = DEFAULT_KI_BASE;
+    if (d.ki_cielo  < 0  || d.ki_cielo  > NVS_KI_MAX)  d.ki_cielo  = DEFAULT_KI_CIELO;
+    if (d.kd_base   < 0  || d.kd_base   > NVS_KD_MAX)  d.kd_base   = DEFAULT_KD_BASE;
+    if (d.kd_cielo  < 0  || d.kd_cielo  > NVS_KD_MAX)  d.kd_cielo  = DEFAULT_KD_CIELO;
     if (d.single_mode < 0 || d.single_mode > 1) d.single_mode = DEFAULT_SINGLE_MODE;
     if (d.pct_base  < 0 || d.pct_base  > 100)   d.pct_base  = DEFAULT_PCT_BASE;
     if (d.pct_cielo < 0 || d.pct_cielo > 100)   d.pct_cielo = DEFAULT_PCT_CIELO;
+    if (!_gainsValid(d.gains_base))  d.gains_base.clear();
+    if (!_gainsValid(d.gains_cielo)) d.gains_cielo.clear();
+    if (!(d.ff_k >= 0 && d.ff_k <= NVS_FF_K_MAX)) d.ff_k = 0.0f;
+    if (d.coupling.valid && !_couplingValid(d.coupling)) d.coupling = ZoneCoupling{};
   }
 };
@@ -0,0 +1,162 @@
+/**
+ * pid_core.h — Forno Pizza S3 — Motore PID in-tree
+ * ================================================================
+ * Stessa matematica di PID_v1 (Brett Beauregard) nella configurazione
+ * usata dal forno (DIRECT, proporzionale sull'errore):
+ *   - ki/kd scalati sul sample time, integrale clampato ai limiti
+ *   - compute() rifiuta chiamate più ravvicinate di sampleTime
+ *
+ * Integratore gestito (trasferimento bumpless, anti-windup):
+ *   - MANUAL → AUTOMATIC: come PID_v1 integrale = output corrente (un
+ *     preload di regime, il proporzionale si somma); con bumpless
+ *     integrale = output - Kp·errore e il primo compute() riparte
+ *     dall'output che c'era (uscita comandata da altri fino a ora); se
+ *     il proporzionale da solo satura, integrale a 0
+ *   - holdIntegral(): integrale congelato finché chi chiama non lo
+ *     rilascia (gradino in discesa col feedforward, pid_ctrl.h)
+ *   - setIntegralLimits(): limiti dell'integrale più stretti dell'output,
+ *     dove l'attuatore satura prima (clamp duty dei relay)
+ *
+ * Differenza: il tempo NON è letto da millis() ma passato a compute(),
+ * così PIDController può usare control_clock.h (tempo virtuale in
+ * simulazione) e i runner host possono istanziarne molti in parallelo.
+ *
+ * Tipo numerico T come parametro: double (PID_v1, default storico),
+ * float (FPU single precision dell'S3: su double ogni operazione è una
+ * chiamata soft-float) o Q16 (fixed_q16.h, solo interi). Guadagni e
+ * limiti arrivano sempre come double e si convertono una volta in
+ * setTunings()/setOutputLimits(), fuori dal ciclo.
+ * ================================================================
+ */
+#pragma once
+#include <stdint.h>
+#include "fixed_q16.h"
+
+template <typename T>
+class PIDCoreT {
+public:
+  PIDCoreT(T* in, T* out, T* sp, double kp, double ki, double kd)
+    : _in(in), _out(out), _sp(sp) {
+    setTunings(kp, ki, kd);
+  }
+
+  bool compute(uint32_t now) {
+    if (!_auto) return false;
+    if (_hasRun && (now - _lastTime) < _sampleMs) return false;
+
+    T input  = *_in;
+    T error  = *_sp - input;
+    T dInput = input - _lastInput;
+
+    if (!_iHold) _iTerm += _ki * error;
+    _clampI();
+
+    T output = _kp * error + _iTerm - _kd * dInput;
+    if (output > _outMax)      output = _outMax;
+    else if (output < _outMin) output = _outMin;
+    *_out = output;
+
+    _lastInput = input;
+    _lastTime  = now;
+    _hasRun    = true;
+    return true;
+  }
+
+  void setMode(bool automatic, bool bumpless = false) {
+    if (automatic && !_auto) _initialize(bumpless);
+    _auto = automatic;
+  }
+  bool isAutomatic() const { return _auto; }
+
+  void setOutputLimits(double lo, double hi) {
+    if (lo >= hi) return;
+    _outMin = T(lo);
+    _outMax = T(hi);
+    if (_auto) {
+      if (*_out > _outMax)      *_out = _outMax;
+      else if (*_out < _outMin) *_out = _outMin;
+      _clampI();
+    }
+  }
+
+  /** Integrale entro [lo, hi] oltre ai limiti dell'output (lo >= hi: solo output). */
+  void setIntegralLimits(double lo, double hi) {
+    _iMin = T(lo);
+    _iMax = T(hi);
+    _iLim = lo < hi;
+    if (_auto) _clampI();
+  }
+
+  /** Integrale fermo, proporzionale e derivativo lavorano: chi chiama sa che l'errore è transitorio. */
+  void holdIntegral(bool hold) { _iHold = hold; }
+
+  /** Sposta integrale e uscita di d (feedforward ricalcolato: il totale non salta). */
+  void shiftOutput(double d) {
+    if (!_auto) return;
+    _iTerm += T(d);
+    *_out  += T(d);
+  }
+
+  void setTunings(double kp, double ki, double kd) {
+    if (kp < 0 || ki < 0 || kd < 0) return;
+    double st = (double)_sampleMs / 1000.0;
+    _kid = ki * st;
+    _kdd = kd / st;
+    _kp = T(kp);
+    _ki = T(_kid);
+    _kd = T(_kdd);
+  }
+
+  void setSampleTime(uint32_t ms) {
+    if (ms == 0) return;
+    double ratio = (double)ms / (double)_sampleMs;
+    _kid *= ratio;
+    _kdd /= ratio;
+    _ki = T(_kid);
+    _kd = T(_kdd);
+    _sampleMs = ms;
+  }
+
+private:
+  void _initialize(bool bumpless) {
+    _lastInput = *_in;
+    T p        = _kp * (*_sp - *_in);
+    T span     = _outMax - _outMin;
+    _iTerm     = *_out;
+    // Il proporzionale da solo satura l'uscita: il salto c'è comunque,
+    // l'integrale non parte carico
+    if (bumpless) _iTerm = (p >= span || p <= -span) ? T(0) : *_out - p;
+    _clampI();
+  }
+
+  void _clampI() {
+    T lo = _outMin, hi = _outMax;
+    if (_iLim) {
+      if (_iMin > lo) lo = _iMin;
+      if (_iMax < hi) hi = _iMax;
+      if (lo > hi) lo = hi;              // limiti fuori dall'output: vince l'alto
+    }
+    if (_iTerm > hi)      _iTerm = hi;
+    else if (_iTerm < lo) _iTerm = lo;
+  }
+
+  T*       _in;
+  T*       _out;
+  T*       _sp;
+  T        _kp = T(0), _ki = T(0), _kd = T(0);
+  T        _iTerm = T(0), _lastInput = T(0);
+  T        _outMin = T(0), _outMax = T(255);
+  T        _iMin = T(0), _iMax = T(0);
+  bool     _iLim = false;
+  bool     _iHold = false;
+  // Guadagni scalati in double: setSampleTime() li riscala senza
+  // accumulare l'arrotondamento di T
+  double   _kid = 0, _kdd = 0;
+  uint32_t _sampleMs = 100;
+  uint32_t _lastTime = 0;
+  bool     _hasRun = false;
+  bool     _auto = false;
+};
+
+using PIDCore = PIDCoreT<double>;
+
@@ -1,66 +1,219 @@
 #pragma once
-#include <PID_v1.h>
 #include <Arduino.h>
 #include "hardware.h"
+#include "pid_core.h"
+#include "gain_sched.h"
+#include "control_clock.h"
 
-#define PID_WINDOW_MS 30000   // Periodo finestra relay: 30 secondi
 #define PID_SAMPLE_MS 500
+// Gradino di setpoint in discesa col feedforward: integrale fermo finché
+// il PV non rientra entro questi gradi sopra il nuovo setpoint
+#define PID_FF_HOLD_DEG 5.0
 
-class PIDController {
+// Tipo numerico del motore PID (pid_core.h). AppState resta in double
+// (UI, NVS, autotune): il controller lavora su copie in T e riscrive
+// l'uscita solo quando compute() la aggiorna.
+//   float  → FPU single dell'S3 (default)
+//   double → PID_v1 storico (soft-float su S3)
+//   Q16    → virgola fissa Q16.16, solo interi
+#ifndef PID_NUM
+#define PID_NUM float
+#endif
+
+// ----------------------------------------------------------------
+//  compute() senza `now` legge control_clock.h; compute(now) serve ai
+//  runner host che simulano molti forni in parallelo, ciascuno col
+//  proprio tempo (host/pid_sweep.cpp).
+//
+//  Guadagni: quelli piatti di setTunings(), oppure la GainTable di
+//  setGainTable() (gain_sched.h) interpolata al PV quando non è vuota.
+//  Il motore li riceve solo quando cambiano: con PID_v1 l'integrale è
+//  già in unità di uscita, quindi un cambio di Ki non dà salti.
+//
+//  Feedforward (feedforward.h): uscita = ff + PID, il motore limitato a
+//  [-ff, 100-ff]. Guadagni e integrale correggono solo lo scarto dal
+//  modello; setEnabled(true) riparte dal duty del modello, non da zero.
+//  Setpoint in discesa: il ff scende subito al duty del nuovo setpoint e
+//  il forno si raffredda a relay spenti. L'integrale ha già lo scarto
+//  dal modello; integrando i gradi di troppo della discesa arrivava al
+//  setpoint scarico, il forno ci passava sotto e risaliva col solo Ki
+//  (300 → 240 °C su SSR: 198 s col ff, 163 s senza). Resta fermo finché
+//  il PV non è entro PID_FF_HOLD_DEG dal setpoint. In salita no: sotto
+//  il setpoint il ff e il preriscaldo coprono già il grosso.
+//
+//  Transizioni (integratore gestito in pid_core.h):
+//    setEnabled(true)  integrale al ff, startFrom() al preload del
+//                      preriscaldo: stime di regime, il proporzionale si
+//                      somma subito
+//    track(out)        un altro comanda i relay (autotune): il motore
+//                      resta in MANUAL e il primo compute() dopo
+//                      l'ultimo track() riparte esattamente da out
+//    setDutyScale()    pct_* della zona: l'integrale resta dove il duty
+//                      è proporzionale, tra RELAY_DUTY_MIN_PCT e
+//                      RELAY_DUTY_MAX_PCT (fuori il relay è già spento o
+//                      sempre acceso e l'integrale caricherebbe a vuoto)
+// ----------------------------------------------------------------
+template <typename T>
+class PIDControllerT {
 public:
-  PIDController(double* in, double* out, double* sp, double kp, double ki, double kd)
-    : _pid(in, out, sp, kp, ki, kd, DIRECT), _output(out), _win(0) {}
+  PIDControllerT(double* in, double* out, double* sp, double kp, double ki, double kd)
+    : _pid(&_in, &_out, &_sp, kp, ki, kd), _input(in), _output(out), _setp(sp),
+      _kp(kp), _ki(ki), _kd(kd) {}
+  PIDControllerT(const PIDControllerT&) = delete;   // _pid punta ai membri
 
   void begin() {
-    _pid.SetOutputLimits(0, 100);
-    _pid.SetSampleTime(PID_SAMPLE_MS);
-    _pid.SetMode(MANUAL);
+    _ff = 0;
+    _tracking = false;
+    _sync();
+    _limits();
+    _pid.setSampleTime(PID_SAMPLE_MS);
+    _pid.setMode(false);
     *_output = 0;
-    _win = millis();
+    _out = T(0);
   }
 
   void setEnabled(bool en) {
-    if (en) { _pid.SetMode(AUTOMATIC); _win = millis(); }
-    else    { _pid.SetMode(MANUAL);    *_output = 0; }
+    if (en) { if (!_pid.isAutomatic() && !_tracking) startFrom(_ff); }
+    else    { _pid.setMode(false); _tracking = false; *_output = 0; _out = T(0); }
+  }
+
+  /** AUTOMATIC da un'uscita totale data (hand-off del preriscaldo): l'integrale prende lo scarto dal ff. */
+  void startFrom(double out) {
+    _tracking = false;
+    *_output = out;
+    _sync();
+    _pid.setMode(true);
+  }
+
+  /** Un ciclo con l'uscita comandata da fuori [0-100, unità PID]: *_output resta di chi comanda. */
+  void track(double out) {
+    _pid.setMode(false);
+    _tracking  = true;
+    _track_out = out < 0 ? 0 : (out > 100 ? 100 : out);
+  }
+  bool tracking() const { return _tracking; }
+
+  /** pct_* della zona (duty = uscita · pct/100): limiti dell'integrale. */
+  void setDutyScale(int pct) {
+    if (pct == _pct) return;
+    _pct = pct;
+    _limits();
+  }
+
+  /**
+   * Duty di modello [0-100] sommato all'uscita; il motore si sposta solo
+   * se cambia. Nuovo setpoint: l'uscita salta col ff. rebase (modello
+   * aggiornato, stesso setpoint): uscita totale invariata, la differenza
+   * passa nell'integrale.
+   */
+  void setFeedforward(double ff, bool rebase = false) {
+    ff = ff < 0 ? 0 : (ff > 100 ? 100 : ff);
+    if (ff == _ff) return;
+    if (rebase) _pid.shiftOutput(_ff - ff);   // prima del clamp ai nuovi limiti
+    _ff = ff;
+    _limits();
   }
+  double feedforward() const { return _ff; }
 
-  void setTunings(double kp, double ki, double kd) { _pid.SetTunings(kp, ki, kd); }
-  void compute() { _pid.Compute(); }
+  /** Guadagni piatti; da Task_PID a ogni ciclo, il motore si aggiorna solo se cambiano. */
+  void setTunings(double kp, double ki, double kd) {
+    if (kp == _kp && ki == _ki && kd == _kd) return;
+    _kp = kp;  _ki = ki;  _kd = kd;
+    _dirty = true;
+  }
+
+  /** Tabella a fasce (nullptr o vuota = guadagni piatti); resta di chi chiama. */
+  void setGainTable(const GainTable* gt) { _gt = gt; _dirty = true; }
+
+  void compute() { compute(clock_ms()); }
+  void compute(uint32_t now) {
+    if (_tracking) _resume();
+    _in = T(*_input);
+    _sp = T(*_setp);
+    _schedule();
+    _downHold();
+    if (_pid.compute(now)) *_output = (double)_out + _ff;
+  }
 
   // ----------------------------------------------------------------
-  //  updateRelay — applica duty cycle con:
-  //    pct       : 0-100, scala il PID output (100% = nessuna riduzione)
-  //    duty_min  : sotto questa soglia il relay non scatta (protegge relay)
-  //    duty_max  : sopra questa soglia resta sempre ON
+  //  duty — richiesta per RelayScheduler (relay_sched.h):
+  //    pct : 0-100, scala il PID output (100% = nessuna riduzione)
+  //  Clamp min/max e finestra li applica lo scheduler.
   // ----------------------------------------------------------------
-  void updateRelay(bool en, int pin, bool inv, bool& st, int pct = 100) {
-    if (!en) {
-      if (st) { st = false; _writeRelay(pin, inv, false); }
+  float duty(int pct) const {
+    return (float)(T(*_output) * T(pct) / T(100));
+  }
+
+private:
+  T             _in = T(0), _out = T(0), _sp = T(0);   // copie in T di AppState
+  PIDCoreT<T>   _pid;
+  double*       _input;
+  double*       _output;
+  double*       _setp;
+  double        _kp, _ki, _kd;                          // guadagni piatti
+  double        _ff = 0;                                // feedforward [% uscita]
+  double        _track_out = 0;                         // ultima uscita di track()
+  int           _pct = 100;                             // setDutyScale()
+  bool          _tracking = false;
+  bool          _dirty = false;                         // guadagni o tabella cambiati
+  bool          _scheduled = false;                     // il motore ha guadagni della tabella
+  double        _sp_last = 0;                           // setpoint dell'ultimo compute()
+  bool          _hold = false;                          // gradino in discesa col ff
+  const GainTable* _gt = nullptr;
+  uint8_t       _gt_rev = 0;
+  float         _gt_pv  = 0.0f;
+
+  void _schedule() {
+    if (!_gt || _gt->empty()) {
+      if (_dirty || _scheduled) _pid.setTunings(_kp, _ki, _kd);
+      _dirty = _scheduled = false;
       return;
     }
-    unsigned long now = millis();
-    if (now - _win >= PID_WINDOW_MS) _win = now;
-
-    // Scala: output_scaled = pid_out * pct/100
-    double scaled = (*_output) * pct / 100.0;
+    float pv = (float)*_input;
+    float d  = pv - _gt_pv;
+    if (_scheduled && !_dirty && _gt->rev == _gt_rev &&
+        d < GAIN_SCHED_HYST_DEG && d > -GAIN_SCHED_HYST_DEG) return;
+    GainPoint g = _gt->at(pv);
+    _pid.setTunings(g.kp, g.ki, g.kd);
+    _gt_rev    = _gt->rev;
+    _gt_pv     = pv;
+    _dirty     = false;
+    _scheduled = true;
+  }
 
-    // Clamp con duty min/max
-    double duty_pct;
-    if (scaled < RELAY_DUTY_MIN_PCT)       duty_pct = 0.0;   // troppo basso → spento
-    else if (scaled > RELAY_DUTY_MAX_PCT)  duty_pct = 100.0; // quasi pieno → sempre ON
-    else                                   duty_pct = scaled;
+  // Setpoint sceso col ff attivo: integrale fermo fino a PV ≤ SP + banda.
+  // Senza ff l'integrale non ha un modello da preservare
+  void _downHold() {
+    double sp = *_setp;
+    if (_ff > 0 && _pid.isAutomatic() && sp < _sp_last) _hold = true;
+    if (_hold && (!(_ff > 0) || *_input <= sp + PID_FF_HOLD_DEG)) _hold = false;
+    _sp_last = sp;
+    _pid.holdIntegral(_hold);
+  }
 
-    unsigned long on_ms = (unsigned long)(duty_pct / 100.0 * PID_WINDOW_MS);
-    bool s = (now - _win < on_ms);
-    if (s != st) { st = s; _writeRelay(pin, inv, s); }
+  // Fine di track(): stessa uscita di prima, integrale = uscita - Kp·e
+  void _resume() {
+    _tracking = false;
+    *_output  = _track_out;
+    _sync();
+    _pid.setMode(true, true);
   }
 
-private:
-  PID _pid;
-  double* _output;
-  unsigned long _win;
+  // Motore in unità "scarto dal ff"; integrale dove il relay è proporzionale
+  void _limits() {
+    _pid.setOutputLimits(-_ff, 100 - _ff);
+    if (_pct <= 0) { _pid.setIntegralLimits(0, 0); return; }
+    _pid.setIntegralLimits(RELAY_DUTY_MIN_PCT * 100.0 / _pct - _ff,
+                           RELAY_DUTY_MAX_PCT * 100.0 / _pct - _ff);
+  }
 
-  static void _writeRelay(int pin, bool inv, bool state) {
-    digitalWrite(pin, (state ^ inv) ? HIGH : LOW);
+  // AppState → copie: setMode(true) parte da ingresso e uscita correnti
+  // (uscita del motore = totale - feedforward)
+  void _sync() {
+    _in  = T(*_input);
+    _sp  = T(*_setp);
+    _out = T(*_output - _ff);
   }
 };
+
+using PIDController = PIDControllerT<PID_NUM>;
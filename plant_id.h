@@ -0,0 +1,199 @@
+/**
+ * plant_id.h — Forno Pizza S3 — Identificazione del modello termico
+ * ================================================================
+ * Stima dai dati relay/temperatura del forno il modello a nodo singolo
+ * del simulatore (simulator.h) con un ritardo puro θ:
+ *
+ *   C dT/dt = P·u(t-θ) - k·(T - T_amb)        u ∈ [0,1] potenza relativa
+ *
+ * Campioni decimati a blocchi di block_ms: T letta al bordo del blocco,
+ * u = duty medio dei relay nel blocco. Con θ = (d + f)·Δ, 0 ≤ f < 1, il
+ * modello discreto a tenuta divide la potenza ritardata fra due blocchi:
+ *
+ *   T[n+1] = α·T[n] + β₀·u[n-d] + β₁·u[n-d-1] + γ     α = e^(-Δ/τ), τ = C/k
+ *
+ * Una regressione per ritardo intero d = 0..PLANT_ID_LAGS-2, tutte
+ * accumulate in parallelo sugli stessi campioni (equazioni normali 4×4,
+ * O(1) memoria per blocco); vince la d fisicamente ammissibile
+ * (0 < α < 1, β₀ + β₁ > 0) con residuo minore.
+ * Dai coefficienti, β = β₀ + β₁:
+ *   K = β/(1-α) = P/k   T_amb = γ/(1-α)   θ = (d + β₁/β)·Δ
+ * Dalla temperatura si ricavano solo i rapporti P/C e k/C: serve la
+ * potenza nominale P delle resistenze (targa) per avere k e C assoluti.
+ *
+ * Header-only, nessuna allocazione: usato da host/plant_fit e, con
+ * FEATURE_PLANT_ID, da Task_PID sul device.
+ * ================================================================
+ */
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PLANT_ID_LAGS        16      // storia di u (× block_ms): θ fino a 15·Δ
+#define PLANT_ID_BLOCK_MS    10000   // decimazione di default
+#define PLANT_ID_MIN_BLOCKS  60      // sotto: nessuna stima
+
+struct PlantModel {
+  float    power_w;     // P (nominale, non stimata)
+  float    k_loss;      // [W/°C]
+  float    mass;        // [J/°C]
+  float    t_amb;       // [°C]
+  float    dead_s;      // θ
+  float    tau_s;       // C/k
+  float    rmse;        // residuo a un passo [°C]
+  uint32_t blocks;
+};
+
+class PlantIdentifier {
+public:
+  void begin(float power_w, uint32_t block_ms = PLANT_ID_BLOCK_MS) {
+    memset(this, 0, sizeof(*this));
+    _power_w  = power_w;
+    _block_ms = block_ms;
+  }
+
+  /**
+   * Un campione: temp_c letta a now_ms, u applicata da now_ms al campione
+   * successivo. valid=false (sonda in errore, reset, shutdown) spezza la serie.
+   */
+  void feed(uint32_t now_ms, float temp_c, float u, bool valid = true) {
+    if (!valid || isnan(temp_c)) { _break(); return; }
+    if (_n > 0 && now_ms - _last_ms > _block_ms / 2) _break();   // buco nei dati
+    if (_n > 0 && now_ms - _blk_start >= _block_ms) _close_block(temp_c);
+    if (_n == 0) { _blk_start = now_ms; _t_start = temp_c; }
+    _u_sum += u;
+    _n++;
+    _last_ms = now_ms;
+  }
+
+  /** Serie interrotta (riaccensione, reset termico): niente regressione a cavallo. */
+  void restart() { _break(); }
+
+  uint32_t blocks() const { return _blocks; }
+
+  bool solve(PlantModel& m) const {
+    memset(&m, 0, sizeof(m));
+    m.power_w = _power_w;
+    int    best = -1;
+    double best_mse = 0, best_th[NP] = {};
+    for (int d = 0; d < NLAG; d++) {
+      const Acc& a = _acc[d];
+      if (a.n < PLANT_ID_MIN_BLOCKS) continue;
+      double th[NP];
+      if (!_solve(a, th)) continue;
+      double beta = th[1] + th[2];
+      if (!(th[0] > 0.0 && th[0] < 1.0) || beta <= 0.0) continue;
+      double sse = a.yy;
+      for (int i = 0; i < NP; i++) {
+        sse -= 2.0 * th[i] * a.xy[i];
+        for (int j = 0; j < NP; j++) sse += th[i] * a.xx[_ix(i, j)] * th[j];
+      }
+      double mse = sse / a.n;
+      if (best < 0 || mse < best_mse) { best = d; best_mse = mse; memcpy(best_th, th, sizeof th); }
+    }
+    if (best < 0) return false;
+
+    double alpha = best_th[0], beta = best_th[1] + best_th[2], gamma = best_th[3];
+    double frac  = best_th[2] / beta;            // fuori da [0,1]: dinamica non a un polo
+    frac = frac < 0.0 ? 0.0 : (frac > 1.0 ? 1.0 : frac);
+    double dt_s = _block_ms / 1000.0;
+    double tau  = -dt_s / log(alpha);
+    double gain = beta / (1.0 - alpha);          // °C a u=1
+    m.k_loss = (float)(_power_w / gain);
+    m.mass   = (float)(m.k_loss * tau);
+    m.t_amb  = (float)(gamma / (1.0 - alpha));
+    m.tau_s  = (float)tau;
+    m.dead_s = (float)((best + frac) * dt_s);
+    m.rmse   = (float)sqrt(best_mse > 0 ? best_mse : 0);
+    m.blocks = _acc[best].n;
+    return true;
+  }
+
+private:
+  // Equazioni normali di x = [T[n], u[n-d], u[n-d-1], 1], y = T[n+1]
+  static constexpr int NP   = 4;
+  static constexpr int NLAG = PLANT_ID_LAGS - 1;
+
+  struct Acc {
+    double   xx[NP * (NP + 1) / 2];   // triangolo superiore di Σ x·xᵀ
+    double   xy[NP];
+    double   yy;
+    uint32_t n;
+  };
+
+  Acc      _acc[NLAG];
+  float    _u_hist[PLANT_ID_LAGS];   // u dei blocchi chiusi, [0] = più recente
+  uint32_t _hist_n;                  // blocchi consecutivi in _u_hist
+  float    _t_start;                 // T al bordo d'inizio del blocco aperto
+  uint32_t _blocks;
+  float    _power_w;
+  uint32_t _block_ms;
+  uint32_t _blk_start, _last_ms;
+  double   _u_sum;
+  uint32_t _n;
+
+  static int _ix(int i, int j) {
+    if (i > j) { int t = i; i = j; j = t; }
+    return i * NP - i * (i - 1) / 2 + (j - i);
+  }
+
+  void _break() {
+    _hist_n = 0;
+    _n      = 0;
+    _u_sum  = 0;
+  }
+
+  // t_end = T al bordo tra il blocco n (che si chiude) e il successivo
+  void _close_block(float t_end) {
+    memmove(&_u_hist[1], &_u_hist[0], (PLANT_ID_LAGS - 1) * sizeof(float));
+    _u_hist[0] = (float)(_u_sum / _n);
+    if (_hist_n < PLANT_ID_LAGS) _hist_n++;
+    _n = 0; _u_sum = 0;
+
+    // T[n+1] da T[n], u[n-d] = _u_hist[d], u[n-d-1]. Solo a storia piena:
+    // ogni d vede gli stessi campioni, residui confrontabili
+    if (_hist_n == PLANT_ID_LAGS) {
+      for (int d = 0; d < NLAG; d++) {
+        const double x[NP] = { _t_start, _u_hist[d], _u_hist[d + 1], 1.0 };
+        Acc& a = _acc[d];
+        for (int i = 0; i < NP; i++) {
+          for (int j = i; j < NP; j++) a.xx[_ix(i, j)] += x[i] * x[j];
+          a.xy[i] += x[i] * t_end;
+        }
+        a.yy += (double)t_end * t_end;
+        a.n++;
+      }
+      _blocks++;
+    }
+  }
+
+  // Cholesky su Σ x·xᵀ
+  static bool _solve(const Acc& a, double th[NP]) {
+    double L[NP][NP] = {};
+    for (int i = 0; i < NP; i++) {
+      for (int j = 0; j <= i; j++) {
+        double s = a.xx[_ix(i, j)];
+        for (int k = 0; k < j; k++) s -= L[i][k] * L[j][k];
+        if (i == j) {
+          if (s <= 1e-9 * (a.xx[_ix(i, i)] + 1.0)) return false;
+          L[i][i] = sqrt(s);
+        } else {
+          L[i][j] = s / L[j][j];
+        }
+      }
+    }
+    double z[NP];
+    for (int i = 0; i < NP; i++) {
+      double s = a.xy[i];
+      for (int k = 0; k < i; k++) s -= L[i][k] * z[k];
+      z[i] = s / L[i][i];
+    }
+    for (int i = NP - 1; i >= 0; i--) {
+      double s = z[i];
+      for (int k = i + 1; k < NP; k++) s -= L[k][i] * th[k];
+      th[i] = s / L[i][i];
+    }
+    return true;
+  }
+};
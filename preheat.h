@@ -0,0 +1,206 @@
+/**
+ * preheat.h — Forno Pizza S3 — Preriscaldo a piena potenza
+ * ================================================================
+ * Una zona parte da fredda (o il setpoint sale di molto): invece di
+ * lasciare al PID un errore di centinaia di gradi — integrale che si
+ * carica, overshoot all'arrivo — la zona va a piena potenza fino a
+ * SP - PREHEAT_MARGIN_DEG, poi passa al PID con l'integrale già al duty
+ * di regime.
+ *
+ *   RAMP    PID in MANUAL, uscita 100 %. Campioni a blocchi di
+ *           PREHEAT_BLOCK_MS, regressione del primo ordine a potenza
+ *           costante:  T[n+1] = α·T[n] + β
+ *           da cui T∞ = β/(1-α) (regime a piena potenza) e τ = -Δ/ln α
+ *   SETTLE  PID in AUTOMATIC dall'uscita precaricata
+ *             u_ss = (SP - T_amb) / (T∞ - T_amb)
+ *           finché la zona entra in ±PREHEAT_READY_DEG dal setpoint
+ *   OFF     pronto: preheat_* = false
+ *
+ * Stima del tempo al pronto (eta_s): in RAMP dall'esponenziale del
+ * modello fino a SP - margine più il tratto finale alla pendenza
+ * dell'hand-off, -1 finché il modello non c'è; in SETTLE dal passo
+ * dell'ultimo blocco.
+ *
+ * I primi PREHEAT_SKIP_DEG di salita non entrano nella regressione:
+ * ritardo resistenza → sonda e inerzia iniziale non sono un primo ordine.
+ * Il tempo che ci mettono, confrontato con l'esponenziale del modello,
+ * dà il ritardo puro θ del primo ordine (deadS(), taratura a gradino
+ * in autotune.h).
+ * T_amb è PREHEAT_T_AMB_C: pesa poco su u_ss finché T∞ ≫ T_amb.
+ *
+ * Header-only, nessuna allocazione: una istanza per zona in Task_PID.
+ * ================================================================
+ */
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include "hardware.h"
+
+#ifndef PREHEAT_BLOCK_MS
+#define PREHEAT_BLOCK_MS     2000    // decimazione della regressione
+#endif
+#ifndef PREHEAT_READY_DEG
+#define PREHEAT_READY_DEG    3.0f    // banda attorno a SP che chiude il preriscaldo
+#endif
+#define PREHEAT_MIN_BLOCKS   5       // sotto: nessuna stima del modello
+#define PREHEAT_SKIP_DEG     5.0f    // salita iniziale esclusa dalla regressione
+#define PREHEAT_T_AMB_C      25.0f
+
+enum class PreheatPhase : uint8_t { OFF = 0, RAMP, SETTLE };
+
+class Preheat {
+public:
+  /**
+   * Zona appena abilitata o setpoint cambiato: RAMP se la zona è più di
+   * PREHEAT_MARGIN_DEG sotto SP. Ritorna true se il preriscaldo parte.
+   */
+  bool start(float temp, float sp, uint32_t now) {
+    _phase = PreheatPhase::OFF;
+    _eta_s = 0;
+    if (isnan(temp) || temp >= sp - PREHEAT_MARGIN_DEG) return false;
+    _phase    = PreheatPhase::RAMP;
+    _t0       = temp;
+    _start_ms = now;
+    _blk_ms   = now;
+    _blk_t    = temp;
+    _fitting  = false;
+    _skip_ms  = now;
+    _skip_t   = temp;
+    _n = 0;  _sx = _sy = _sxx = _sxy = 0.0;
+    _rate     = 0.0f;
+    _eta_s    = -1;
+    return true;
+  }
+
+  void abort() { _phase = PreheatPhase::OFF; _eta_s = 0; }
+
+  /**
+   * Un ciclo. Ritorna true nel ciclo del passaggio RAMP → SETTLE: il
+   * chiamante precarica l'uscita con preloadPct() e porta il PID in
+   * AUTOMATIC.
+   */
+  bool step(float temp, float sp, uint32_t now) {
+    if (_phase == PreheatPhase::OFF || isnan(temp)) return false;
+
+    if (now - _blk_ms >= PREHEAT_BLOCK_MS) _close_block(temp, now);
+
+    if (_phase == PreheatPhase::RAMP) {
+      if (temp >= sp - PREHEAT_MARGIN_DEG) {
+        _u_ss  = _estimate_u_ss(sp);
+        _phase = PreheatPhase::SETTLE;
+        _eta_s = _eta_linear(temp, sp - PREHEAT_READY_DEG);
+        return true;
+      }
+      _eta_s = _eta_ramp(temp, sp);
+      return false;
+    }
+
+    // SETTLE
+    if (fabsf(temp - sp) <= PREHEAT_READY_DEG) { _phase = PreheatPhase::OFF; _eta_s = 0; }
+    else _eta_s = _eta_linear(temp, sp - PREHEAT_READY_DEG);
+    return false;
+  }
+
+  PreheatPhase phase() const { return _phase; }
+  bool    active()     const { return _phase != PreheatPhase::OFF; }
+  bool    ramping()    const { return _phase == PreheatPhase::RAMP; }
+  int32_t etaS()       const { return _eta_s; }
+  uint32_t elapsedS(uint32_t now) const { return (now - _start_ms) / 1000; }
+  float   startC()     const { return _t0; }   // temperatura a inizio rampa
+
+  /** Uscita PID (0-100) da cui ripartire: duty di regime stimato al setpoint. */
+  float preloadPct() const { return _u_ss * 100.0f; }
+
+  /** Modello della rampa: false se i blocchi sono troppo pochi o la salita non è un primo ordine. */
+  bool model(float& t_inf, float& tau_s) const {
+    double a, b;
+    if (!_fit(a, b)) return false;
+    t_inf = (float)(b / (1.0 - a));
+    tau_s = (float)(-(PREHEAT_BLOCK_MS / 1000.0) / log(a));
+    return true;
+  }
+
+  /**
+   * Ritardo puro della rampa [s]: l'istante in cui la salita ha passato
+   * PREHEAT_SKIP_DEG, meno quello in cui il primo ordine del modello
+   * partito da T0 senza ritardo li avrebbe passati. false senza modello.
+   */
+  bool deadS(float& dead_s) const {
+    float t_inf, tau;
+    if (!_fitting || !model(t_inf, tau) || t_inf <= _skip_t) return false;
+    float ideal = tau * logf((t_inf - _t0) / (t_inf - _skip_t));
+    dead_s = (_skip_ms - _start_ms) / 1000.0f - ideal;
+    if (dead_s < 0.0f) dead_s = 0.0f;
+    return true;
+  }
+
+private:
+  PreheatPhase _phase = PreheatPhase::OFF;
+  int32_t  _eta_s   = 0;
+  float    _t0      = 0.0f;
+  float    _u_ss    = 0.0f;     // ultimo duty di regime stimato (0..1)
+  float    _rate    = 0.0f;     // °C/s dell'ultimo blocco
+  uint32_t _start_ms = 0;
+  uint32_t _blk_ms  = 0;
+  float    _blk_t   = 0.0f;
+  bool     _fitting = false;
+  uint32_t _skip_ms = 0;        // bordo di blocco in cui la salita ha passato SKIP_DEG
+  float    _skip_t  = 0.0f;
+  // Σ per T[n+1] = a·T[n] + b
+  uint32_t _n = 0;
+  double   _sx = 0, _sy = 0, _sxx = 0, _sxy = 0;
+
+  void _close_block(float temp, uint32_t now) {
+    float dt_s = (now - _blk_ms) / 1000.0f;
+    _rate = (temp - _blk_t) / dt_s;
+    // Solo a piena potenza e a blocchi regolari; la rampa si apre dopo SKIP_DEG
+    if (_phase == PreheatPhase::RAMP && now - _blk_ms < 2 * PREHEAT_BLOCK_MS) {
+      if (_fitting) {
+        _n++;
+        _sx  += _blk_t;           _sy  += temp;
+        _sxx += (double)_blk_t * _blk_t;
+        _sxy += (double)_blk_t * temp;
+      } else if (_blk_t - _t0 >= PREHEAT_SKIP_DEG) {
+        _fitting = true;
+        _skip_ms = _blk_ms;
+        _skip_t  = _blk_t;
+      }
+    }
+    _blk_ms = now;
+    _blk_t  = temp;
+  }
+
+  bool _fit(double& a, double& b) const {
+    if (_n < PREHEAT_MIN_BLOCKS) return false;
+    double den = _n * _sxx - _sx * _sx;
+    if (fabs(den) < 1e-9) return false;
+    a = (_n * _sxy - _sx * _sy) / den;
+    b = (_sy - a * _sx) / _n;
+    return a > 0.0 && a < 1.0 && b / (1.0 - a) > PREHEAT_T_AMB_C;
+  }
+
+  float _estimate_u_ss(float sp) const {
+    float t_inf, tau;
+    if (!model(t_inf, tau)) return _u_ss;    // niente stima: resta l'ultima
+    float u = (sp - PREHEAT_T_AMB_C) / (t_inf - PREHEAT_T_AMB_C);
+    return u < 0.0f ? 0.0f : (u > 1.0f ? 1.0f : u);
+  }
+
+  int32_t _eta_linear(float temp, float target) const {
+    if (temp >= target) return 0;
+    if (_rate <= 0.0f) return -1;
+    return (int32_t)((target - temp) / _rate);
+  }
+
+  // Esponenziale del modello fino all'hand-off, poi il margine al passo finale
+  int32_t _eta_ramp(float temp, float sp) const {
+    float t_inf, tau;
+    float t1 = sp - PREHEAT_MARGIN_DEG;
+    if (!model(t_inf, tau)) return -1;       // il passo iniziale sottostima molto
+    if (t_inf <= t1) return -1;              // setpoint fuori portata a piena potenza
+    float ramp_s = tau * logf((t_inf - temp) / (t_inf - t1));
+    float rate1  = (t_inf - t1) / tau;       // °C/s all'hand-off
+    float tail_s = (PREHEAT_MARGIN_DEG - PREHEAT_READY_DEG) / rate1;
+    return (int32_t)(ramp_s + tail_s);
+  }
+};
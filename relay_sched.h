@@ -0,0 +1,331 @@
+/**
+ * relay_sched.h — Forno Pizza S3 — Scheduler relay time-proportional
+ * ================================================================
+ * Unico punto che trasforma un duty richiesto (0-100 %) nello stato
+ * ON/OFF di un relay, per Task_PID, autotune e i runner host:
+ *   - finestra di RELAY_WINDOW_MS, riallineata a restart() (PID →
+ *     AUTOMATIC) e al suo scadere; setWindowMs() ne cambia la lunghezza
+ *     per zona (relay_window.h)
+ *   - clamp: sotto RELAY_DUTY_MIN_PCT (o NaN) spento, sopra
+ *     RELAY_DUTY_MAX_PCT sempre acceso
+ *   - tempi minimi ON/OFF (RELAY_MIN_ON_MS / RELAY_MIN_OFF_MS, 0 = solo
+ *     finestra): una commutazione troppo ravvicinata viene rimandata
+ *   - conteggio commutazioni e chiusure per relay (usura contatti)
+ *   - interleaving a budget di potenza (RELAY_POWER_BUDGET_W, 0 = off)
+ *     o, senza budget, finestre sfasate a richiesta (setStagger())
+ *   - tipo di relè per zona (RELAY_TYPE_*, setType()): le zone SSR non
+ *     hanno finestra, vedi SSR più sotto
+ *
+ * INTERLEAVING: più forni sulla stessa linea fanno scattare il
+ * magnetotermico se Base e Cielo assorbono insieme. Con un budget
+ * minore di P_base + P_cielo le due zone condividono una finestra
+ * sfasata: Base è ON dall'inizio, Cielo fino alla fine, così finché
+ * on_base + on_cielo ≤ finestra i due intervalli non si toccano e ogni
+ * zona riceve tutto il duty chiesto. Oltre, i due ON sono ridotti in
+ * proporzione fino a riempire la finestra. In ogni caso una zona non si
+ * accende se l'altra resta accesa e la somma supera il budget (cambi di
+ * duty a metà finestra, tempi minimi); una zona più potente del budget
+ * da sola resta spenta.
+ * setStagger() dà la stessa finestra sfasata senza budget: le due
+ * resistenze possono stare accese insieme ma si sovrappongono solo per
+ * la parte in comune, e il ripple della finestra scende (al 63 % di duty
+ * il picco-picco dell'energia netta accumulata nella finestra è ~0.4
+ * volte quello con le due accese dall'inizio). La chiede l'MPC
+ * (mpc_ctrl.h), che lo ha nel modello.
+ *
+ * SSR: un relè statico commuta a ogni passaggio per lo zero, senza usura.
+ * La zona SSR riceve un livello 0-1 per ciclo PID (level()), quantizzato
+ * a semionde di rete su SSR_PWM_PERIOD_MS, senza clamp min/max né tempi
+ * minimi: ssr_pwm.h lo esegue come PWM lento. Col budget due SSR si
+ * spartiscono il periodo come due contattori la finestra (Base
+ * dall'inizio, Cielo fino alla fine); SSR e contattore insieme: l'SSR
+ * cede, resta spento mentre il contattore è acceso.
+ *
+ * I ms ON si ricalcolano solo quando il duty cambia. forceOff() scavalca
+ * i tempi minimi: serve a sicurezza e sonda in errore.
+ *
+ * Solo logica, nessun GPIO: chi chiama scrive il relay con lo stato
+ * restituito (heater_output(), forno_control.h). Header-only, nessuna allocazione.
+ * ================================================================
+ */
+#pragma once
+#include <stdint.h>
+#include "hardware.h"
+
+#ifndef RELAY_WINDOW_MS
+#define RELAY_WINDOW_MS  30000UL   // Periodo finestra relay: 30 secondi
+#endif
+
+// Zona comandata (non RELAY_BASE/RELAY_CIELO: sono i pin di hardware.h)
+enum class RelayZone : uint8_t { BASE = 0, CIELO = 1 };
+#define RELAY_ZONES  2
+
+enum class RelayType : uint8_t { CONTACTOR = RELAY_TYPE_CONTACTOR, SSR = RELAY_TYPE_SSR };
+
+// Semionde di rete in un periodo PWM SSR: risoluzione del livello
+#define SSR_PWM_STEPS  (SSR_PWM_PERIOD_MS * 2UL * MAINS_HZ / 1000UL)
+
+class RelayScheduler {
+public:
+  void begin(uint32_t now, uint32_t window_ms = RELAY_WINDOW_MS,
+             uint32_t min_on_ms = RELAY_MIN_ON_MS, uint32_t min_off_ms = RELAY_MIN_OFF_MS) {
+    _window_ms  = window_ms;
+    _min_on_ms  = min_on_ms;
+    _min_off_ms = min_off_ms;
+    for (Chan& c : _ch) {
+      c = Chan{};
+      c.win    = now;
+      c.win_ms = c.next_ms = window_ms;
+    }
+    _ch[0].type = (RelayType)RELAY_TYPE_BASE;
+    _ch[1].type = (RelayType)RELAY_TYPE_CIELO;
+    _stagger    = false;
+    setPowerBudget(RELAY_POWER_BUDGET_W);
+  }
+
+  /** Budget di potenza combinata [W], 0 = nessun limite (finestre indipendenti). */
+  void setPowerBudget(float budget_w, float base_w = HEATER_BASE_W, float cielo_w = HEATER_CIELO_W) {
+    _budget_w          = budget_w > 0.0f ? budget_w : 0.0f;
+    _ch[0].power_w     = base_w;
+    _ch[1].power_w     = cielo_w;
+    _mode();
+  }
+  float powerBudget() const { return _budget_w; }
+
+  /** Finestra comune sfasata anche senza budget (Cielo allineata alla fine). */
+  void setStagger(bool on) {
+    if (on == _stagger) return;
+    _stagger = on;
+    _mode();
+  }
+  bool stagger() const { return _stagger; }
+
+  /** Tipo di relè della zona (default RELAY_TYPE_BASE/CIELO); la zona riparte spenta. */
+  void setType(RelayZone z, RelayType t, uint32_t now) {
+    Chan& c = _ch[(int)z];
+    if (c.type == t) return;
+    _set(c, false, now);
+    c.type  = t;
+    c.duty  = 0.0f;
+    c.on_ms = 0;
+    c.level = 0.0f;
+  }
+  RelayType type(RelayZone z) const { return _ch[(int)z].type; }
+
+  /**
+   * Nuova finestra da now (zona appena abilitata). Con l'interleaving la
+   * finestra è comune: si riallinea solo se l'altra zona non sta chiedendo
+   * potenza, altrimenti la nuova zona entra nella fase corrente.
+   */
+  void restart(RelayZone z, uint32_t now) {
+    if (!_interleave) { _roll(_ch[(int)z], now); return; }
+    if (_ch[1 - (int)z].on_ms == 0) { _roll(_ch[0], now); _ch[1].win = now; }
+  }
+  /** Nuova finestra da now per le due zone insieme (chi le prende entrambe, l'MPC). */
+  void restartAll(uint32_t now) {
+    _roll(_ch[0], now);
+    if (_interleave) _ch[1].win = now;
+    else             _roll(_ch[1], now);
+  }
+
+  /**
+   * Lunghezza [ms] delle prossime finestre della zona, 0 = quella di
+   * begin(). Più lunga: dalla finestra successiva; più corta: la finestra
+   * in corso finisce già a quella lunghezza (errore che cala dopo una
+   * rampa). Con l'interleaving la finestra è comune e vale la più corta
+   * delle due.
+   */
+  void setWindowMs(RelayZone z, uint32_t window_ms) {
+    _ch[(int)z].next_ms = window_ms > 0 ? window_ms : _window_ms;
+  }
+
+  /** Duty richiesto per la zona (già scalato per la split), ritorna lo stato deciso. */
+  bool request(RelayZone z, float duty_pct, uint32_t now) {
+    Chan& c = _ch[(int)z];
+    if (c.type == RelayType::SSR) return _requestSsr(z, duty_pct, now);
+    Chan& w = _interleave ? _ch[0] : c;
+    if (!(duty_pct == c.duty)) {                 // NaN != NaN: ricalcola, resta 0
+      c.duty  = duty_pct;
+      c.on_ms = onTimeMs(duty_pct, w.win_ms);
+    }
+    uint32_t len = _nextMs(w);
+    if (now - w.win >= (len < w.win_ms ? len : w.win_ms)) _roll(w, now);
+    if (_interleave) _ch[1].win = _ch[0].win;
+
+    // Budget: mai ON insieme all'altra zona. Se è già stata decisa in
+    // questo ciclo conta il suo stato, altrimenti quello che avrà (una
+    // Cielo che chiude la finestra non costa a Base un ciclo di ritardo).
+    // Un SSR conta solo se ha già il suo periodo: dal ciclo dopo cede lui
+    bool want = _next(z, now);
+    if (want && !_overlap_ok) {
+      const Chan& o = _ch[1 - (int)z];
+      bool decided  = o.asked && o.last_req == now;
+      bool o_on     = o.type == RelayType::SSR
+                        ? decided && o.on
+                        : o.on && (decided || _next((RelayZone)(1 - (int)z), now));
+      if (o_on) want = false;
+    }
+    c.last_req = now;
+    c.asked    = true;
+    _set(c, want, now);
+    return c.on;
+  }
+
+  /** Spegne subito, senza tempi minimi (shutdown, sonda in errore, fine autotune). */
+  void forceOff(RelayZone z, uint32_t now) {
+    _ch[(int)z].level = 0.0f;
+    _set(_ch[(int)z], false, now);
+  }
+
+  bool     state(RelayZone z)    const { return _ch[(int)z].on; }
+  /** Potenza media nel ciclo, 0-1: livello PWM per un SSR, 0/1 per un contattore. */
+  float    level(RelayZone z)    const {
+    const Chan& c = _ch[(int)z];
+    return c.type == RelayType::SSR ? c.level : (c.on ? 1.0f : 0.0f);
+  }
+  uint32_t onMs(RelayZone z)     const { return _ch[(int)z].on_ms; }
+  uint32_t switches(RelayZone z) const { return _ch[(int)z].switches; }
+  /** Chiusure (OFF → ON): le operazioni su cui si misura la vita di un contattore. */
+  uint32_t cycles(RelayZone z)   const { return _ch[(int)z].cycles; }
+  /** Finestra di begin() (RELAY_WINDOW_MS). */
+  uint32_t windowMs()            const { return _window_ms; }
+  /** Finestra in corso della zona. */
+  uint32_t windowMs(RelayZone z) const { return (_interleave ? _ch[0] : _ch[(int)z]).win_ms; }
+  /** ms ON concessi nella finestra dopo l'interleaving (= onMs senza budget). */
+  uint32_t grantedMs(RelayZone z) const { return _grant(z); }
+
+  /** ms ON in una finestra per un duty in percento, con il clamp min/max. */
+  static uint32_t onTimeMs(float duty_pct, uint32_t window_ms) {
+    if (!(duty_pct >= (float)RELAY_DUTY_MIN_PCT)) return 0;       // troppo basso (o NaN) → spento
+    if (duty_pct > (float)RELAY_DUTY_MAX_PCT) return window_ms;   // quasi pieno → sempre ON
+    uint32_t on_ms = (uint32_t)(duty_pct / 100.0f * (float)window_ms);
+    return on_ms > window_ms ? window_ms : on_ms;
+  }
+
+  /** Semionde ON in un periodo SSR per un duty in percento (NaN = 0). */
+  static uint32_t ssrSteps(float duty_pct) {
+    if (!(duty_pct > 0.0f)) return 0;
+    if (duty_pct >= 100.0f) return SSR_PWM_STEPS;
+    return (uint32_t)(duty_pct / 100.0f * (float)SSR_PWM_STEPS + 0.5f);
+  }
+
+private:
+  struct Chan {
+    uint32_t win      = 0;   // inizio finestra corrente
+    uint32_t win_ms   = RELAY_WINDOW_MS;   // lunghezza della finestra corrente
+    uint32_t next_ms  = RELAY_WINDOW_MS;   // setWindowMs(): dalla prossima
+    uint32_t on_ms    = 0;
+    uint32_t last_sw  = 0;
+    uint32_t switches = 0;
+    uint32_t cycles   = 0;
+    uint32_t last_req = 0;       // ultimo request(): stesso ciclo dell'altra zona?
+    float    duty     = 0.0f;
+    float    power_w  = 0.0f;
+    float    level    = 0.0f;    // SSR: potenza nel periodo PWM
+    RelayType type    = RelayType::CONTACTOR;
+    bool     on       = false;
+    bool     switched = false;   // last_sw valido
+    bool     asked    = false;   // last_req valido
+  };
+
+  Chan     _ch[RELAY_ZONES];
+  uint32_t _window_ms  = RELAY_WINDOW_MS;
+  uint32_t _min_on_ms  = RELAY_MIN_ON_MS;
+  uint32_t _min_off_ms = RELAY_MIN_OFF_MS;
+  float    _budget_w   = 0.0f;
+  bool     _stagger    = false;
+  bool     _interleave = false;
+  bool     _overlap_ok = true;
+
+  void _mode() {
+    _interleave = _budget_w > 0.0f || _stagger;
+    _overlap_ok = _budget_w <= 0.0f || _ch[0].power_w + _ch[1].power_w <= _budget_w;
+    _ch[1].win  = _ch[0].win;   // finestra comune da subito
+  }
+
+  uint32_t _nextMs(const Chan& w) const {
+    if (_interleave && _ch[1].next_ms < w.next_ms) return _ch[1].next_ms;
+    return w.next_ms;
+  }
+
+  // Nuova finestra da now; la lunghezza chiesta con setWindowMs() entra
+  // qui, e i ms ON delle zone che la usano si riscalano
+  void _roll(Chan& w, uint32_t now) {
+    w.win = now;
+    uint32_t len = _nextMs(w);
+    if (len == w.win_ms) return;
+    w.win_ms = len;
+    for (Chan& c : _ch)
+      if (&c == &w || _interleave) c.on_ms = onTimeMs(c.duty, len);
+  }
+
+  // ON concessi: senza overlap ammesso le due zone si spartiscono la finestra
+  uint32_t _grant(RelayZone z) const {
+    const Chan& c = _ch[(int)z];
+    if (_overlap_ok) return c.on_ms;
+    if (c.power_w > _budget_w) return 0;
+    const Chan& o   = _ch[1 - (int)z];
+    uint32_t    win = _ch[0].win_ms;   // interleaving: finestra comune
+    uint32_t    oth = o.power_w > _budget_w ? 0 : o.on_ms;
+    uint32_t    sum = c.on_ms + oth;
+    if (sum <= win) return c.on_ms;
+    return (uint32_t)((uint64_t)c.on_ms * win / sum);
+  }
+
+  // Stato voluto a now: posizione nella finestra + tempi minimi, senza effetti
+  bool _next(RelayZone z, uint32_t now) const {
+    const Chan& c   = _ch[(int)z];
+    const Chan& w   = _interleave ? _ch[0] : c;
+    uint32_t    pos = now - w.win;
+    if (pos >= w.win_ms) pos = 0;                   // finestra che riparte ora
+    uint32_t grant = _grant(z);
+    bool want = (_interleave && z == RelayZone::CIELO)
+                  ? grant > 0 && pos >= w.win_ms - grant     // allineato a fine finestra
+                  : pos < grant;
+    if (want != c.on && c.switched) {
+      uint32_t held = now - c.last_sw;
+      if (held < (c.on ? _min_on_ms : _min_off_ms)) want = c.on;
+    }
+    return want;
+  }
+
+  // Zona SSR: livello del periodo PWM che parte ora. Col budget cede al
+  // contattore acceso (o che si accende in questo ciclo), con un altro SSR
+  // le semionde si riducono in proporzione fino a riempire il periodo
+  bool _requestSsr(RelayZone z, float duty_pct, uint32_t now) {
+    Chan&    c = _ch[(int)z];
+    uint32_t n = c.power_w > _budget_w && !_overlap_ok ? 0 : ssrSteps(duty_pct);
+    if (n > 0 && !_overlap_ok) {
+      const Chan& o  = _ch[1 - (int)z];
+      RelayZone   oz = (RelayZone)(1 - (int)z);
+      bool decided   = o.asked && o.last_req == now;
+      if (o.type == RelayType::CONTACTOR) {
+        if (decided ? o.on : _next(oz, now)) n = 0;
+      } else if (o.power_w <= _budget_w) {
+        uint32_t m = ssrSteps(o.duty);
+        if (n + m > SSR_PWM_STEPS) n = n * SSR_PWM_STEPS / (n + m);
+        // L'altra ha già il suo periodo: resta solo il resto
+        uint32_t used = (uint32_t)(o.level * (float)SSR_PWM_STEPS + 0.5f);
+        if (decided && n > SSR_PWM_STEPS - used) n = SSR_PWM_STEPS - used;
+      }
+    }
+    c.duty     = duty_pct;
+    c.level    = (float)n / (float)SSR_PWM_STEPS;
+    c.last_req = now;
+    c.asked    = true;
+    _set(c, n > 0, now);
+    return c.on;
+  }
+
+  static void _set(Chan& c, bool on, uint32_t now) {
+    if (on == c.on) return;
+    c.on       = on;
+    c.last_sw  = now;
+    c.switched = true;
+    c.switches++;
+    if (on) c.cycles++;
+  }
+};
+
+/** Relay Base/Cielo del forno: Task_PID e autotune (forno_control.cpp). */
+extern RelayScheduler g_relays;
@@ -0,0 +1,88 @@
+/**
+ * relay_window.h — Forno Pizza S3 — Finestra relay adattiva e usura
+ * ================================================================
+ * Con la finestra fissa di RELAY_WINDOW_MS il ripple a regime è di
+ * qualche grado (la zona scalda per on_ms e si raffredda per il resto),
+ * mentre lontano dal setpoint il duty è 0 o 100 % e la finestra non
+ * conta. Per ogni zona, all'inizio di ogni finestra:
+ *
+ *   |PV - SP| ≤ RELAY_WINDOW_NEAR_DEG   → RELAY_WINDOW_MIN_MS (ripple)
+ *   |PV - SP| ≥ RELAY_WINDOW_FAR_DEG    → RELAY_WINDOW_MAX_MS (rampe)
+ *   in mezzo                            → interpolazione lineare
+ *
+ * Ogni finestra con duty tra min e max costa una chiusura del relay: la
+ * finestra corta costa contatti. Budget di usura in chiusure/ora per
+ * relay, dalla vita del contattore e dalle ore di servizio volute:
+ *
+ *   budget = RELAY_LIFE_OPS / RELAY_LIFE_HOURS
+ *
+ * Credito a secchiello: cresce col tempo al ritmo del budget fino a
+ * RELAY_WEAR_BURST chiusure, ogni chiusura vera (RelayScheduler::cycles(),
+ * anche i ribattimenti quando il duty attraversa la posizione nella
+ * finestra) ne consuma una. Finché c'è credito vale la finestra
+ * dell'errore, a credito esaurito la finestra non scende sotto
+ * 3600 s / budget: con un impulso per finestra è esattamente il budget, e
+ * dopo un'attesa (rampa, forno fermo) si riparte con finestre corte.
+ *
+ * Le chiusure totali per relay stanno in NVS (nvs_storage.h): la vita
+ * consumata si legge sui numeri veri del forno.
+ *
+ * Header-only, nessuna allocazione: una istanza in Task_PID.
+ * ================================================================
+ */
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include "relay_sched.h"
+
+class RelayWindowPolicy {
+public:
+  void begin(uint32_t now, uint32_t ops_per_h = RELAY_LIFE_OPS / RELAY_LIFE_HOURS) {
+    _budget_h = (float)ops_per_h;
+    for (Zone& z : _z) z = Zone{ (float)RELAY_WEAR_BURST, 0, now, false };
+  }
+
+  /** ms della finestra che tiene il budget a regime (0 = nessun budget). */
+  uint32_t sustainMs() const {
+    return _budget_h > 0.0f ? (uint32_t)(3600000.0f / _budget_h) : 0;
+  }
+
+  float credit(RelayZone z) const { return _z[(int)z].credit; }
+
+  /**
+   * Finestra [ms] per la zona, da passare a RelayScheduler::setWindowMs().
+   * err = |PV - SP| (NaN = sonda in errore: finestra lunga), cycles =
+   * RelayScheduler::cycles() della zona.
+   */
+  uint32_t choose(RelayZone z, float err, uint32_t cycles, uint32_t now) {
+    Zone& s = _z[(int)z];
+    if (s.seen) {
+      s.credit += (float)(now - s.last_ms) * _budget_h / 3600000.0f - (float)(cycles - s.cycles);
+      if (s.credit > (float)RELAY_WEAR_BURST) s.credit = (float)RELAY_WEAR_BURST;
+    }
+    s.cycles  = cycles;
+    s.last_ms = now;
+    s.seen    = true;
+
+    float w;
+    if (!(err > RELAY_WINDOW_NEAR_DEG))    w = isnan(err) ? (float)RELAY_WINDOW_MAX_MS
+                                                          : (float)RELAY_WINDOW_MIN_MS;
+    else if (err >= RELAY_WINDOW_FAR_DEG)  w = (float)RELAY_WINDOW_MAX_MS;
+    else w = (float)RELAY_WINDOW_MIN_MS + (err - RELAY_WINDOW_NEAR_DEG) /
+             (RELAY_WINDOW_FAR_DEG - RELAY_WINDOW_NEAR_DEG) *
+             (float)(RELAY_WINDOW_MAX_MS - RELAY_WINDOW_MIN_MS);
+    uint32_t ms = (uint32_t)(w / 1000.0f + 0.5f) * 1000UL;   // secondi interi
+    if (_budget_h > 0.0f && s.credit < 1.0f && ms < sustainMs()) ms = sustainMs();
+    return ms;
+  }
+
+private:
+  struct Zone {
+    float    credit;    // chiusure disponibili oltre il budget
+    uint32_t cycles;    // ultimo cycles() visto
+    uint32_t last_ms;
+    bool     seen;
+  };
+  Zone  _z[RELAY_ZONES];
+  float _budget_h = 0.0f;   // chiusure/ora per relay
+};
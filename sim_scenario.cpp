@@ -0,0 +1,767 @@
+/**
+ * sim_scenario.cpp — Forno Pizza S3 — Motore scenari del simulatore
+ * ================================================================
+ * Esegue una tabella ScnStep (sim_scenario.h) un passo alla volta:
+ * i passi istantanei (SET, FAULT, EXPECT, ...) si consumano nello
+ * stesso ciclo, i passi bloccanti (WAIT_*, EXPECT_SHUTDOWN con
+ * timeout) tengono il program counter finché non si risolvono.
+ *
+ * Esito per test (TEST ... TEST/REPORT): fallisce se una WAIT non
+ * opzionale va in timeout, se un EXPECT è falso, se un EVER non si
+ * è mai verificato o se lo shutdown atteso non arriva.
+ * ================================================================
+ */
+
+#include "sim_scenario.h"
+#include "simulator.h"
+#include "app_state.h"      // g_state, SafetyReason, AutotuneStatus
+#include "hardware.h"       // MUTEX_TAKE_MS, MUTEX_GIVE, FAN_OFF_TEMP
+#include "autotune.h"
+#include "control_clock.h"
+#include "relay_sched.h"    // g_relays (power_budget_w)
+#include <Arduino.h>
+#include <stdarg.h>
+#include <string.h>
+
+extern uint32_t g_runaway_down_ms_override;
+
+// ================================================================
+//  SCENARIO DI DEFAULT — la sequenza storica FASE 1-7
+// ================================================================
+const ScnStep k_scn_default[] = {
+    SCN_TEST_TRACK("FASE 1 — PID + relay/ventola"),
+    // Auto-avvio dopo SIM_AUTOSTART_MS, salvo BASE ON prima o spegnimento utente
+    SCN_WAIT_OPT(SCN_C(BASE_ENABLED, EQ, 1), 0, SIM_AUTOSTART_MS / 1000.0f),
+    SCN_WAIT_UNTIL(SCN_C(AUTOSTART_OK, EQ, 1), 0, 0),
+    SCN_ENABLE(BOTH),
+    SCN_EVER(SCN_C(DUTY_AVG, GT, 0.03f), 35),
+    SCN_EVER(SCN_C(FAN_OK, EQ, 1), 0),
+    SCN_WAIT_UNTIL(SCN_C(ERR_BASE, LT, 5), 5, 900),
+
+    SCN_TEST("FASE 2 — OVERTEMP safety"),
+    SCN_LOG("Forzo la lettura a 495°C, atteso emergency_shutdown(OVERTEMP)"),
+    SCN_FAULT(OVERTEMP, 1),
+    SCN_EXPECT_SHUTDOWN(OVERTEMP, 3),
+    SCN_FAULT(OVERTEMP, 0),
+    SCN_RESET(),
+
+    SCN_TEST("FASE 3 — TC_ERROR safety"),
+    SCN_LOG("readCelsius() → NAN per 5 letture (SINGLE: warn, DUAL: shutdown)"),
+    SCN_ENABLE(BOTH),
+    SCN_FAULT(TC_ERROR, 5),
+    SCN_WAIT_UNTIL(SCN_C(TC_ERROR_ACTIVE, EQ, 0), 0, 30),
+    SCN_WAIT_UNTIL(SCN_C(TEST_S, GE, 3), 0, 0),
+    SCN_WHEN(SCN_C(SENSOR_MODE, EQ, 0), SCN_EXPECT_NO_SHUTDOWN()),
+    SCN_WHEN(SCN_C(SENSOR_MODE, EQ, 1), SCN_EXPECT_SHUTDOWN(TC_ERROR, 0)),
+    SCN_RESET(),
+
+    SCN_TEST("FASE 4 — RUNAWAY_UP"),
+    SCN_LOG("Calore fantasma con relay logicamente OFF (sim. SSR incollato)"),
+    SCN_ENABLE(NONE),
+    SCN_FAULT(GHOST_HEAT, SIM_POWER_W),
+    SCN_EXPECT_SHUTDOWN(RUNAWAY_UP, 45),
+    SCN_FAULT(GHOST_HEAT, 0),
+    SCN_RESET(),
+
+    SCN_TEST("FASE 5 — RUNAWAY_DOWN"),
+    SCN_LOG("Riscaldamento fino a SP-10, poi calo forzato (sim. elemento rotto)"),
+    SCN_FAULT(RWD_WINDOW_MS, SIM_RUNAWAY_DOWN_MS_TEST),
+    SCN_ENABLE(BOTH),
+    // Picco vicino al setpoint: RUNAWAY_DOWN si arma solo sopra SP-20
+    SCN_WAIT_UNTIL(SCN_C(DT_SPMAX, GE, -10), 0, 150),
+    SCN_FAULT(RWD, 1),
+    SCN_EXPECT_SHUTDOWN(RUNAWAY_DOWN, 150),
+    SCN_FAULT(RWD, 0),
+    SCN_RESET(),
+
+    SCN_TEST("FASE 6 — Autotune PID"),
+    SCN_ENABLE(BOTH),
+    // Relay attorno al punto di lavoro: a T ambiente il forno non può
+    // scendere sotto PV e l'oscillazione dipende dal rumore
+    SCN_WAIT_UNTIL(SCN_C(DT_SPMAX, GE, -30), 0, 300),
+    SCN_AUTOTUNE(1),
+    SCN_WAIT_UNTIL(SCN_C(AUTOTUNE_DONE, EQ, 1), 0, 1200),
+    SCN_AUTOTUNE(0),
+    SCN_EXPECT(SCN_C(KP_BASE, GT, 0.1f)),
+    SCN_EXPECT(SCN_C(KP_BASE, LT, 50)),
+    SCN_EXPECT(SCN_C(KI_BASE, GE, 0)),
+    SCN_EXPECT(SCN_C(KI_BASE, LT, 5)),
+
+    SCN_TEST_TRACK("FASE 7 — Riscaldamento finale"),
+    SCN_ENABLE(BOTH),   // l'autotune le ha spente
+    SCN_WAIT_UNTIL(SCN_C(ERR_BASE, LT, 5), 5, 900),
+
+    SCN_REPORT(),
+    SCN_END()
+};
+
+// ================================================================
+//  NOMI
+// ================================================================
+static const char* const k_var_names[(int)SimVar::COUNT] = {
+    "temp", "temp_base_zone", "temp_cielo_zone", "temp_base", "temp_cielo",
+    "set_base", "set_cielo", "err_base", "dt_spmax",
+    "pid_out_base", "pid_out_cielo", "pct_base", "pct_cielo",
+    "duty_avg", "fan_on", "fan_ok", "relay_on_base", "relay_on_cielo",
+    "base_enabled", "cielo_enabled", "sensor_mode",
+    "safety_shutdown", "safety_reason", "tc_error_active", "autostart_ok",
+    "autotune_running", "autotune_done", "kp_base", "ki_base", "kd_base",
+    "autotune_band", "gain_points", "ff_k",
+    "load_done", "load_unrecovered", "power_w", "power_peak_w", "power_budget_w",
+    "preheat", "preheat_eta_s", "overshoot", "out_step", "test_s",
+    "err_base_zone", "err_cielo_zone", "coupling_w", "coupling_valid",
+    "relay_cycles", "relay_window_s", "err_rms", "err_sd", "ssr_base", "ssr_cielo",
+    "kp_cielo", "ki_cielo", "kd_cielo", "ff_off", "err_avg",
+    "dev_base", "dev_cielo", "decouple_off", "autotune_cycles", "autotune_ku", "autotune_pu",
+    "autotune_converged", "autotune_early_stop", "autotune_ku_base", "autotune_pu_base",
+    "autotune_per_zone", "autotune_offered", "autotune_kp_base", "autotune_kp_cielo",
+    "decouple_on", "coupling_rga", "dev_mark", "dev_base_rel", "dev_cielo_rel"
+};
+
+static const char* const k_reason_names[] = {
+    "NONE", "TC_ERROR", "OVERTEMP", "RUNAWAY_DOWN", "RUNAWAY_UP", "WDG_TIMEOUT"
+};
+#define SCN_REASONS  (int)(sizeof(k_reason_names) / sizeof(k_reason_names[0]))
+
+const char* scn_var_name(SimVar v) {
+    int i = (int)v;
+    return (i >= 0 && i < (int)SimVar::COUNT) ? k_var_names[i] : "?";
+}
+
+bool scn_var_from_name(const char* name, SimVar* out) {
+    for (int i = 0; i < (int)SimVar::COUNT; i++) {
+        if (!strcmp(name, k_var_names[i])) { *out = (SimVar)i; return true; }
+    }
+    return false;
+}
+
+bool scn_var_writable(SimVar v) {
+    return v == SimVar::SET_BASE || v == SimVar::SET_CIELO ||
+           v == SimVar::PCT_BASE || v == SimVar::PCT_CIELO ||
+           v == SimVar::SENSOR_MODE || v == SimVar::POWER_BUDGET_W ||
+           v == SimVar::COUPLING_W || v == SimVar::SSR_BASE || v == SimVar::SSR_CIELO ||
+           v == SimVar::FF_OFF || v == SimVar::DECOUPLE_OFF || v == SimVar::AUTOTUNE_EARLY_STOP ||
+           v == SimVar::DEV_MARK;
+}
+
+const char* scn_reason_name(int reason) {
+    return (reason >= 0 && reason < SCN_REASONS) ? k_reason_names[reason] : "?";
+}
+
+bool scn_reason_from_name(const char* name, int* out) {
+    for (int i = 0; i < SCN_REASONS; i++) {
+        if (!strcmp(name, k_reason_names[i])) { *out = i; return true; }
+    }
+    return false;
+}
+
+// ================================================================
+//  STATO MOTORE
+// ================================================================
+struct ScnTestResult {
+    const char* name;
+    bool        ok;
+    bool        track;
+    float       dur_s;      // secondi di clock
+};
+
+struct ScnEver {
+    ScnCond cond;
+    float   after_s;
+    bool    hit;
+};
+
+static const ScnStep* s_steps        = nullptr;
+static int            s_pc           = 0;
+static bool           s_done         = true;
+static bool           s_step_entered = false;
+static uint32_t       s_step_ms      = 0;    // ingresso nel passo corrente
+static bool           s_holding      = false;
+static uint32_t       s_hold_ms      = 0;
+
+static ScnTestResult  s_tests[SCN_MAX_TESTS];
+static int            s_ntests       = 0;    // test aperti finora (il corrente è l'ultimo)
+static bool           s_test_open    = false;
+static uint32_t       s_test_ms      = 0;
+static float          s_overshoot    = 0.0f; // SimVar::OVERSHOOT del test corrente
+static float          s_out_step     = 0.0f; // SimVar::OUT_STEP del test corrente
+static uint32_t       s_cycles0      = 0;    // chiusure relay all'inizio del test
+static double         s_err_sq       = 0.0;  // Σ (temp - set_base)² del test corrente
+static double         s_err_sum      = 0.0;  // Σ (temp - set_base)
+static uint32_t       s_err_n        = 0;
+struct ScnOutBlock {
+    double sum;
+    int    n;
+    bool   en;          // forno acceso in tutto il blocco
+    double prev;        // media del blocco precedente
+    bool   prev_ok;     // blocco precedente valido
+};
+static ScnOutBlock    s_out_blk;
+// Media mobile della sonda Base su una finestra relay (SimVar::ERR_AVG), continua
+// fra i test: all'apertura di un test vale il regime del precedente
+struct ScnWinMean {
+    float  v[SCN_OUT_BLOCK];
+    int    i, n;
+    double sum;
+};
+static ScnWinMean     s_win_t;
+static ScnWinMean     s_win_c;               // idem sonda Cielo (DEV_CIELO)
+static float          s_dev[2];              // max |media - setpoint| per sonda nel test corrente
+static float          s_dev_mark[2];         // s_dev al dev_mark (DEV_*_REL), 0 = nessuno
+static bool           s_atune_early_stop = true;  // SimVar::AUTOTUNE_EARLY_STOP
+static ScnEver        s_ever[SCN_MAX_EVER];
+static int            s_never        = 0;
+static int            s_shutdown     = 0;    // SafetyReason del primo shutdown nel test (0 = nessuno)
+static int            s_passed       = 0;
+static int            s_total        = 0;
+
+static uint32_t       s_now_ms       = 0;
+
+// ================================================================
+//  Log helpers
+// ================================================================
+static void log_separator(char c = '-') {
+    for (int i = 0; i < 60; i++) Serial.print(c);
+    Serial.println();
+}
+
+static ScnTestResult* cur_test() {
+    return s_test_open ? &s_tests[s_ntests - 1] : nullptr;
+}
+
+static void test_fail(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+static void test_fail(const char* fmt, ...) {
+    char buf[160];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    Serial.printf("[TEST] ✗ FAIL: %s\n", buf);
+    if (ScnTestResult* t = cur_test()) t->ok = false;
+}
+
+static void test_pass(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+static void test_pass(const char* fmt, ...) {
+    char buf[160];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    Serial.printf("[TEST] ✓ PASS: %s\n", buf);
+}
+
+static const char* cmp_str(ScnCmp c) {
+    switch (c) {
+        case ScnCmp::LT: return "<";
+        case ScnCmp::LE: return "<=";
+        case ScnCmp::GT: return ">";
+        case ScnCmp::GE: return ">=";
+        case ScnCmp::EQ: return "==";
+        case ScnCmp::NE: return "!=";
+    }
+    return "?";
+}
+
+// ================================================================
+//  Variabili e condizioni
+// ================================================================
+static float test_s() {
+    return (s_now_ms - s_test_ms) / 1000.0f;
+}
+
+static uint32_t relay_cycles() {
+    return g_relays.cycles(RelayZone::BASE) + g_relays.cycles(RelayZone::CIELO);
+}
+
+static void win_add(ScnWinMean& w, float x) {
+    if (w.n == SCN_OUT_BLOCK) w.sum -= w.v[w.i];
+    else                      w.n++;
+    w.v[w.i] = x;
+    w.sum   += x;
+    w.i      = (w.i + 1) % SCN_OUT_BLOCK;
+}
+
+static float win_mean(const ScnWinMean& w) {
+    return w.n ? (float)(w.sum / w.n) : 0.0f;
+}
+
+// Ripple: deviazione standard dell'errore, senza l'offset di err_rms
+static float err_sd() {
+    if (!s_err_n) return 0.0f;
+    double m = s_err_sum / s_err_n, v = s_err_sq / s_err_n - m * m;
+    return v > 0.0 ? (float)sqrt(v) : 0.0f;
+}
+
+// La zona più lontana decide quando il forno è pronto
+static float preheat_eta() {
+    int eta = 0;
+    if (g_state.preheat_base) eta = g_state.preheat_eta_base;
+    if (g_state.preheat_cielo && eta >= 0) {
+        int c = g_state.preheat_eta_cielo;
+        eta = (c < 0 || c > eta) ? c : eta;
+    }
+    return (float)eta;
+}
+
+static float var_read(SimVar v) {
+    switch (v) {
+        case SimVar::TEMP:             return g_sim.temp_c;
+        case SimVar::TEMP_BASE_ZONE:   return g_sim.zone_temp_c[SIM_ZONE_BASE];
+        case SimVar::TEMP_CIELO_ZONE:  return g_sim.zone_temp_c[SIM_ZONE_CIELO];
+        case SimVar::TEMP_BASE:        return (float)g_state.temp_base;
+        case SimVar::TEMP_CIELO:       return (float)g_state.temp_cielo;
+        case SimVar::SET_BASE:         return (float)g_state.set_base;
+        case SimVar::SET_CIELO:        return (float)g_state.set_cielo;
+        case SimVar::ERR_BASE:         return fabsf(g_sim.temp_c - (float)g_state.set_base);
+        case SimVar::DT_SPMAX:         return g_sim.temp_c - (float)fmax(g_state.set_base, g_state.set_cielo);
+        case SimVar::PID_OUT_BASE:     return (float)g_state.pid_out_base;
+        case SimVar::PID_OUT_CIELO:    return (float)g_state.pid_out_cielo;
+        case SimVar::PCT_BASE:         return (float)g_state.pct_base;
+        case SimVar::PCT_CIELO:        return (float)g_state.pct_cielo;
+        case SimVar::DUTY_AVG:         return g_sim.duty_avg;
+        case SimVar::FAN_ON:           return g_state.fan_on ? 1.0f : 0.0f;
+        case SimVar::FAN_OK:           return (g_state.fan_on && g_sim.temp_c > FAN_OFF_TEMP + 5.0f) ? 1.0f : 0.0f;
+        case SimVar::RELAY_ON_BASE:    return g_state.relay_base  ? 1.0f : 0.0f;
+        case SimVar::RELAY_ON_CIELO:   return g_state.relay_cielo ? 1.0f : 0.0f;
+        case SimVar::BASE_ENABLED:     return g_state.base_enabled  ? 1.0f : 0.0f;
+        case SimVar::CIELO_ENABLED:    return g_state.cielo_enabled ? 1.0f : 0.0f;
+        case SimVar::SENSOR_MODE:      return g_state.sensor_mode == SensorMode::DUAL ? 1.0f : 0.0f;
+        case SimVar::SAFETY_SHUTDOWN:  return g_state.safety_shutdown ? 1.0f : 0.0f;
+        case SimVar::SAFETY_REASON:    return (float)(int)g_state.safety_reason;
+        case SimVar::TC_ERROR_ACTIVE:  return g_sim.force_tc_error ? 1.0f : 0.0f;
+        case SimVar::AUTOSTART_OK:     return (g_state.base_enabled || !g_sim.user_abort_autostart) ? 1.0f : 0.0f;
+        case SimVar::AUTOTUNE_RUNNING: return autotune_is_running() ? 1.0f : 0.0f;
+        case SimVar::AUTOTUNE_DONE:    return (g_state.autotune_status == AutotuneStatus::DONE &&
+                                               !autotune_is_running()) ? 1.0f : 0.0f;
+        case SimVar::KP_BASE:          return (float)g_state.kp_base;
+        case SimVar::KI_BASE:          return (float)g_state.ki_base;
+        case SimVar::KD_BASE:          return (float)g_state.kd_base;
+        case SimVar::AUTOTUNE_BAND:    return (float)g_state.autotune_band;
+        case SimVar::GAIN_POINTS:      return (float)g_state.gains_base.n;
+        case SimVar::FF_K:             return g_state.ff_k;
+        case SimVar::LOAD_DONE:        return simulator_load_done() ? 1.0f : 0.0f;
+        case SimVar::LOAD_UNRECOVERED: return (float)g_sim.load_unrecovered;
+        case SimVar::POWER_W:          return g_sim.elec_w;
+        case SimVar::POWER_PEAK_W:     return g_sim.elec_peak_w;
+        case SimVar::POWER_BUDGET_W:   return g_relays.powerBudget();
+        case SimVar::PREHEAT:          return (g_state.preheat_base || g_state.preheat_cielo) ? 1.0f : 0.0f;
+        case SimVar::PREHEAT_ETA_S:    return preheat_eta();
+        case SimVar::OVERSHOOT:        return s_overshoot;
+        case SimVar::OUT_STEP:         return s_out_step;
+        case SimVar::TEST_S:           return s_test_open ? test_s() : 0.0f;
+        case SimVar::ERR_BASE_ZONE:    return fabsf(g_sim.zone_temp_c[SIM_ZONE_BASE]  - (float)g_state.set_base);
+        case SimVar::ERR_CIELO_ZONE:   return fabsf(g_sim.zone_temp_c[SIM_ZONE_CIELO] - (float)g_state.set_cielo);
+        case SimVar::COUPLING_W:       return g_sim.k_coupling;
+        case SimVar::COUPLING_VALID:   return g_state.coupling.valid ? 1.0f : 0.0f;
+        case SimVar::RELAY_CYCLES:     return (float)(relay_cycles() - s_cycles0);
+        case SimVar::RELAY_WINDOW_S:   return g_relays.windowMs(RelayZone::BASE) / 1000.0f;
+        case SimVar::ERR_RMS:          return s_err_n ? (float)sqrt(s_err_sq / s_err_n) : 0.0f;
+        case SimVar::ERR_SD:           return err_sd();
+        case SimVar::SSR_BASE:         return g_relays.type(RelayZone::BASE)  == RelayType::SSR ? 1.0f : 0.0f;
+        case SimVar::SSR_CIELO:        return g_relays.type(RelayZone::CIELO) == RelayType::SSR ? 1.0f : 0.0f;
+        case SimVar::KP_CIELO:         return (float)g_state.kp_cielo;
+        case SimVar::KI_CIELO:         return (float)g_state.ki_cielo;
+        case SimVar::KD_CIELO:         return (float)g_state.kd_cielo;
+        case SimVar::FF_OFF:           return g_sim.ff_off ? 1.0f : 0.0f;
+        case SimVar::ERR_AVG:          return fabsf(win_mean(s_win_t) - (float)g_state.set_base);
+        case SimVar::DEV_BASE:         return s_dev[0];
+        case SimVar::DEV_CIELO:        return s_dev[1];
+        case SimVar::DECOUPLE_OFF:     return g_sim.decouple_off ? 1.0f : 0.0f;
+        case SimVar::DECOUPLE_ON:      return g_sim.decouple_on ? 1.0f : 0.0f;
+        case SimVar::COUPLING_RGA:     return g_state.coupling.valid ? g_state.coupling.rga() : 0.0f;
+        case SimVar::DEV_MARK:         return s_dev_mark[0] > 0.0f || s_dev_mark[1] > 0.0f ? 1.0f : 0.0f;
+        case SimVar::DEV_BASE_REL:     return s_dev_mark[0] > 0.0f ? s_dev[0] / s_dev_mark[0] : INFINITY;
+        case SimVar::DEV_CIELO_REL:    return s_dev_mark[1] > 0.0f ? s_dev[1] / s_dev_mark[1] : INFINITY;
+        case SimVar::AUTOTUNE_CYCLES:  return (float)g_state.autotune_cycles;
+        case SimVar::AUTOTUNE_KU:      return g_state.autotune_ku_cielo;
+        case SimVar::AUTOTUNE_PU:      return g_state.autotune_pu_cielo;
+        case SimVar::AUTOTUNE_CONVERGED: return g_state.autotune_converged ? 1.0f : 0.0f;
+        case SimVar::AUTOTUNE_KU_BASE: return g_state.autotune_ku_base;
+        case SimVar::AUTOTUNE_PU_BASE: return g_state.autotune_pu_base;
+        case SimVar::AUTOTUNE_PER_ZONE: return g_state.autotune_per_zone ? 1.0f : 0.0f;
+        case SimVar::AUTOTUNE_OFFERED: return g_state.autotune_status == AutotuneStatus::OFFERED ? 1.0f : 0.0f;
+        case SimVar::AUTOTUNE_KP_BASE: return g_state.autotune_kp_base;
+        case SimVar::AUTOTUNE_KP_CIELO: return g_state.autotune_kp_cielo;
+        case SimVar::AUTOTUNE_EARLY_STOP:  return s_atune_early_stop ? 1.0f : 0.0f;
+        default:                       return 0.0f;
+    }
+}
+
+static void var_write(SimVar v, float x) {
+    // Scheduler relay: stato di Task_PID, lo stesso task degli scenari
+    if (v == SimVar::POWER_BUDGET_W) {
+        g_relays.setPowerBudget(x);
+        simulator_power_reset();
+        return;
+    }
+    if (v == SimVar::SSR_BASE || v == SimVar::SSR_CIELO) {
+        g_relays.setType(v == SimVar::SSR_BASE ? RelayZone::BASE : RelayZone::CIELO,
+                         x != 0.0f ? RelayType::SSR : RelayType::CONTACTOR, s_now_ms);
+        return;
+    }
+    if (v == SimVar::COUPLING_W) {
+        g_sim.k_coupling = x < 0.0f ? 0.0f : x;
+        return;
+    }
+    if (v == SimVar::FF_OFF) {
+        g_sim.ff_off = x != 0.0f;
+        return;
+    }
+    if (v == SimVar::DECOUPLE_OFF) {
+        g_sim.decouple_off = x != 0.0f;
+        return;
+    }
+    if (v == SimVar::DEV_MARK) {
+        for (int i = 0; i < 2; i++) s_dev_mark[i] = x != 0.0f ? s_dev[i] : 0.0f;
+        return;
+    }
+    if (v == SimVar::AUTOTUNE_EARLY_STOP) {
+        s_atune_early_stop = x != 0.0f;
+        autotune_set_early_stop(s_atune_early_stop);
+        return;
+    }
+    if (!MUTEX_TAKE_MS(50)) return;
+    switch (v) {
+        case SimVar::SET_BASE:    g_state.set_base  = x; break;
+        case SimVar::SET_CIELO:   g_state.set_cielo = x; break;
+        case SimVar::PCT_BASE:    g_state.pct_base  = (int)x; break;
+        case SimVar::PCT_CIELO:   g_state.pct_cielo = (int)x; break;
+        case SimVar::SENSOR_MODE: g_state.sensor_mode = x != 0.0f ? SensorMode::DUAL : SensorMode::SINGLE; break;
+        default: break;
+    }
+    MUTEX_GIVE();
+}
+
+static bool cond_eval(const ScnCond& c) {
+    float v = var_read(c.var);
+    switch (c.cmp) {
+        case ScnCmp::LT: return v <  c.value;
+        case ScnCmp::LE: return v <= c.value;
+        case ScnCmp::GT: return v >  c.value;
+        case ScnCmp::GE: return v >= c.value;
+        case ScnCmp::EQ: return v == c.value;
+        case ScnCmp::NE: return v != c.value;
+    }
+    return false;
+}
+
+// ================================================================
+//  Apertura / chiusura test
+// ================================================================
+static void test_close() {
+    ScnTestResult* t = cur_test();
+    if (!t) return;
+    for (int i = 0; i < s_never; i++) {
+        if (!s_ever[i].hit) {
+            test_fail("ever %s %s %g mai verificato", scn_var_name(s_ever[i].cond.var),
+                      cmp_str(s_ever[i].cond.cmp), s_ever[i].cond.value);
+        }
+    }
+    t->dur_s = test_s();
+    if (t->ok) test_pass("%s (%.0fs)", t->name, t->dur_s);
+    s_test_open = false;
+    s_never     = 0;
+}
+
+static void test_open(const ScnStep& st) {
+    test_close();
+    if (s_ntests >= SCN_MAX_TESTS) {
+        Serial.printf("[SCN] WARN: più di %d test, \"%s\" non registrato\n",
+                      SCN_MAX_TESTS, st.text ? st.text : "");
+        return;
+    }
+    ScnTestResult* t = &s_tests[s_ntests++];
+    t->name  = st.text ? st.text : "";
+    t->ok    = true;
+    t->track = (st.flags & SCN_F_TRACK) != 0;
+    t->dur_s = 0.0f;
+    s_test_open = true;
+    s_test_ms   = s_now_ms;
+    s_overshoot = 0.0f;
+    s_dev[0] = s_dev[1] = 0.0f;
+    s_out_step  = 0.0f;
+    s_cycles0   = relay_cycles();
+    s_err_sq    = 0.0;
+    s_err_sum   = 0.0;
+    s_err_n     = 0;
+    s_shutdown  = 0;
+
+    Serial.println();
+    log_separator('=');
+    Serial.printf("[TEST] %d — %s\n", s_ntests, t->name);
+    log_separator('=');
+}
+
+// Potenza relay a blocchi (uscita fisica: in SINGLE la quota Base/Cielo
+// non conta). Accensione e spegnimento (forno spento nel blocco) no
+static void out_step_tick() {
+    ScnOutBlock& b = s_out_blk;
+    if (b.n == 0) b.en = true;
+    b.sum += g_sim.elec_w;
+    b.en   = b.en && (g_state.base_enabled || g_state.cielo_enabled);
+    if (++b.n < SCN_OUT_BLOCK) return;
+    double mean = b.sum / b.n * 100.0 / (HEATER_BASE_W + HEATER_CIELO_W);
+    float  step = (float)fabs(mean - b.prev);
+    if (s_test_open && b.en && b.prev_ok && step > s_out_step) s_out_step = step;
+    b.prev    = mean;
+    b.prev_ok = b.en;
+    b.sum     = 0.0;
+    b.n       = 0;
+}
+
+static void report() {
+    test_close();
+    s_total  = s_ntests;
+    s_passed = 0;
+    for (int i = 0; i < s_ntests; i++) if (s_tests[i].ok) s_passed++;
+
+    Serial.println();
+    log_separator('*');
+    Serial.println("[TEST] ===== REPORT FINALE =====");
+    log_separator('*');
+    Serial.printf("[TEST] Tempo totale simulato: %.0f s (%.1f min)\n",
+                  g_sim.time_elapsed_s, g_sim.time_elapsed_s / 60.0f);
+    Serial.println("[TEST]");
+    for (int i = 0; i < s_ntests; i++) {
+        Serial.printf("[TEST]  [%s] %s  (%.0fs)\n",
+                      s_tests[i].ok ? "PASS" : "FAIL", s_tests[i].name, s_tests[i].dur_s);
+    }
+    Serial.printf("[TEST]  PID base finale: Kp=%.3f Ki=%.4f Kd=%.3f\n",
+                  g_state.kp_base, g_state.ki_base, g_state.kd_base);
+    Serial.println("[TEST]");
+    log_separator('-');
+    Serial.printf("[TEST] RISULTATO: %d/%d TEST PASSATI  %s\n",
+                  s_passed, s_total, s_passed == s_total ? "✓ TUTTO OK" : "✗ ERRORI");
+    log_separator('*');
+    Serial.println();
+    Serial.println("[SIM] Sequenza test completata.");
+    Serial.println("[SIM] Il forno rimane attivo per test manuali dal display.");
+    Serial.println();
+    s_done = true;
+}
+
+// ================================================================
+//  Esecuzione di un passo — true = passo concluso, avanza il pc
+// ================================================================
+static void do_enable(uint8_t en) {
+    if (!MUTEX_TAKE_MS(50)) return;
+    g_state.base_enabled  = (en & SCN_EN_BASE)  != 0;
+    g_state.cielo_enabled = (en & SCN_EN_CIELO) != 0;
+    MUTEX_GIVE();
+}
+
+static void do_fault(ScnFault f, float x) {
+    switch (f) {
+        case ScnFault::TC_ERROR:
+            g_sim.tc_error_count = (int)x;
+            g_sim.force_tc_error = x > 0.0f;
+            break;
+        case ScnFault::OVERTEMP:
+            g_sim.force_overtemp = x != 0.0f;
+            break;
+        case ScnFault::GHOST_HEAT:
+            g_sim.ghost_heat    = x > 0.0f;
+            g_sim.ghost_power_w = x;
+            break;
+        case ScnFault::RWD:
+            g_sim.rwd_inject = x != 0.0f;
+            break;
+        case ScnFault::RWD_WINDOW_MS:
+            g_runaway_down_ms_override = (uint32_t)x;
+            break;
+    }
+}
+
+static bool step_exec(const ScnStep& st) {
+    uint32_t in_step_ms = s_now_ms - s_step_ms;
+
+    switch (st.op) {
+    case ScnOp::END:
+        if (!s_done) report();
+        return false;
+
+    case ScnOp::TEST:
+        test_open(st);
+        return true;
+
+    case ScnOp::LOG:
+        Serial.printf("[TEST] %s\n", st.text ? st.text : "");
+        return true;
+
+    case ScnOp::ENABLE:
+        do_enable(st.arg);
+        return true;
+
+    case ScnOp::SET:
+        var_write((SimVar)st.arg, st.value);
+        return true;
+
+    case ScnOp::FAULT:
+        do_fault((ScnFault)st.arg, st.value);
+        return true;
+
+    case ScnOp::RESET:
+        simulator_reset_thermal();
+        return true;
+
+    case ScnOp::AUTOTUNE:
+        if (st.arg == 4) {
+            autotune_accept_offer();
+        } else if (st.arg) {
+            autotune_apply_default_split();
+            if (st.arg == 2)      autotune_start_schedule();
+            else if (st.arg == 3) autotune_start_step();
+            else                  autotune_start();
+        } else {
+            autotune_stop();
+        }
+        return true;
+
+    case ScnOp::LOAD:
+        simulator_load_burst((int)st.value, st.hold_s,
+                             st.timeout_s > 0.0f ? st.timeout_s : SIM_PIZZA_BAKE_S);
+        return true;
+
+    case ScnOp::WAIT_TIME:
+        return in_step_ms >= (uint32_t)(st.value * 1000.0f);
+
+    case ScnOp::WAIT_COND:
+        if (cond_eval(st.cond)) {
+            if (!s_holding) { s_holding = true; s_hold_ms = s_now_ms; }
+            if (s_now_ms - s_hold_ms >= (uint32_t)(st.hold_s * 1000.0f)) return true;
+        } else {
+            s_holding = false;
+        }
+        if (st.timeout_s > 0.0f && in_step_ms >= (uint32_t)(st.timeout_s * 1000.0f)) {
+            if (st.flags & SCN_F_OPTIONAL) return true;
+            test_fail("wait %s %s %g: timeout %.0fs (%s=%.2f)",
+                      scn_var_name(st.cond.var), cmp_str(st.cond.cmp), st.cond.value,
+                      st.timeout_s, scn_var_name(st.cond.var), var_read(st.cond.var));
+            return true;
+        }
+        return false;
+
+    case ScnOp::EXPECT:
+        if (!cond_eval(st.cond)) {
+            test_fail("expect %s %s %g (%s=%.3f)",
+                      scn_var_name(st.cond.var), cmp_str(st.cond.cmp), st.cond.value,
+                      scn_var_name(st.cond.var), var_read(st.cond.var));
+        }
+        return true;
+
+    case ScnOp::EVER:
+        if (s_never >= SCN_MAX_EVER) {
+            Serial.printf("[SCN] WARN: più di %d ever nello stesso test\n", SCN_MAX_EVER);
+            return true;
+        }
+        s_ever[s_never++] = ScnEver{ st.cond, st.hold_s, false };
+        return true;
+
+    case ScnOp::EXPECT_SHUTDOWN:
+        if (s_shutdown != 0) {
+            if (s_shutdown == st.arg) {
+                test_pass("shutdown %s", scn_reason_name(st.arg));
+            } else {
+                test_fail("shutdown %s, atteso %s",
+                          scn_reason_name(s_shutdown), scn_reason_name(st.arg));
+            }
+            return true;
+        }
+        if (test_s() >= st.timeout_s) {
+            test_fail("shutdown %s non avvenuto entro %.0fs",
+                      scn_reason_name(st.arg), st.timeout_s);
+            return true;
+        }
+        return false;
+
+    case ScnOp::EXPECT_NO_SHUTDOWN:
+        if (s_shutdown != 0) {
+            test_fail("shutdown inatteso (%s)", scn_reason_name(s_shutdown));
+        }
+        return true;
+
+    case ScnOp::REPORT:
+        report();
+        return true;
+    }
+    return true;
+}
+
+// ================================================================
+//  API
+// ================================================================
+void scenario_load(const ScnStep* steps) {
+    s_steps        = steps;
+    s_pc           = 0;
+    s_done         = (steps == nullptr);
+    s_step_entered = false;
+    s_holding      = false;
+    s_ntests       = 0;
+    s_test_open    = false;
+    s_never        = 0;
+    s_shutdown     = 0;
+    s_passed       = 0;
+    s_total        = 0;
+    s_out_blk      = ScnOutBlock{};
+    s_win_t        = ScnWinMean{};
+    s_win_c        = ScnWinMean{};
+    s_dev_mark[0]  = s_dev_mark[1] = 0.0f;
+    s_atune_early_stop = true;
+    autotune_set_early_stop(true);
+}
+
+void scenario_tick(uint32_t now_ms) {
+    if (s_done || !s_steps) return;
+    s_now_ms = now_ms;
+
+    if (s_test_open) {
+        float over = g_sim.temp_c - (float)fmax(g_state.set_base, g_state.set_cielo);
+        if (over > s_overshoot) s_overshoot = over;
+        float e = g_sim.temp_c - (float)g_state.set_base;
+        s_err_sq  += (double)e * e;
+        s_err_sum += e;
+        s_err_n++;
+    }
+    out_step_tick();
+    win_add(s_win_t, (float)g_state.temp_base);
+    win_add(s_win_c, (float)g_state.temp_cielo);
+    if (s_test_open) {
+        float db = fabsf(win_mean(s_win_t) - (float)g_state.set_base);
+        float dc = fabsf(win_mean(s_win_c) - (float)g_state.set_cielo);
+        if (db > s_dev[0]) s_dev[0] = db;
+        if (dc > s_dev[1]) s_dev[1] = dc;
+    }
+    for (int i = 0; i < s_never; i++) {
+        ScnEver& e = s_ever[i];
+        if (!e.hit && test_s() >= e.after_s && cond_eval(e.cond)) e.hit = true;
+    }
+
+    // Consuma i passi istantanei; si ferma al primo passo bloccante
+    for (;;) {
+        const ScnStep& st = s_steps[s_pc];
+        if (!s_step_entered) {
+            s_step_entered = true;
+            s_step_ms      = now_ms;
+            s_holding      = false;
+        }
+        bool done = true;
+        if (!(st.flags & SCN_F_GUARD) || cond_eval(st.guard)) done = step_exec(st);
+        if (!done || s_done) return;
+        s_pc++;
+        s_step_entered = false;
+    }
+}
+
+bool scenario_done()          { return s_done; }
+bool scenario_tracking()      { return !s_done && cur_test() && cur_test()->track; }
+int  scenario_tests_passed()  { return s_passed; }
+int  scenario_tests_total()   { return s_total; }
+int  scenario_test_index()    { return s_ntests; }
+
+void scenario_on_shutdown(int reason_int) {
+    if (s_done || !s_test_open) {
+        Serial.printf("[SIM] WARN: shutdown fuori dai test reason=%s\n", scn_reason_name(reason_int));
+        return;
+    }
+    if (s_shutdown == 0) s_shutdown = reason_int;
+}
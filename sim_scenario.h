@@ -0,0 +1,244 @@
+/**
+ * sim_scenario.h — Forno Pizza S3 — Motore scenari del simulatore
+ * ================================================================
+ * Sostituisce lo switch a fasi di simulator_test_tick(): uno scenario è
+ * una tabella di passi (ScnStep) eseguita un passo alla volta a ogni
+ * ciclo PID. Sul device la tabella è const (flash), scritta con le
+ * macro SCN_* oppure generata dal formato testuale con
+ *   host/build/forno_host --emit-c file.scn
+ * Sulla build host i file .scn si caricano a runtime (host/scenario_parse.cpp).
+ *
+ * FORMATO TESTUALE (una riga per passo, '#' commento):
+ *   test "nome" [track]          apre un test (track: conta nelle metriche
+ *                                di regolazione di forno_host)
+ *   log "testo"
+ *   enable base|cielo|both|none
+ *   set <var> <valore>           set_base, set_cielo, pct_base, pct_cielo, sensor_mode,
+ *                                power_budget_w (0 = nessun limite), coupling_w,
+ *                                ssr_base, ssr_cielo, ff_off, decouple_off, autotune_early_stop,
+ *                                dev_mark (1: dev_* del test come riferimento per dev_*_rel)
+ *   fault tc_error <n letture>   fault overtemp 0|1   fault ghost_heat <W>
+ *   fault rwd 0|1                fault rwd_window_ms <ms> (0 = default firmware)
+ *   reset                        simulator_reset_thermal()
+ *   autotune start|stop|schedule|step|accept   (schedule: a fasce, step: a gradino,
+ *                                accept: guadagni offerti dal preriscaldo, autotune.h)
+ *   load <n> <ogni_s> <cottura_s>   raffica pizze (simulator_load_burst)
+ *   wait <s>                     attesa
+ *   wait <cond> [hold <s>] [timeout <s>] [optional]
+ *                                attende cond vera per hold secondi; al
+ *                                timeout il test fallisce (salvo optional)
+ *   expect <cond>                asserzione istantanea
+ *   ever <cond> [after <s>]      cond deve valere almeno una volta entro
+ *                                la fine del test (dopo <s> dall'inizio)
+ *   expect_shutdown <REASON> [timeout <s>]   shutdown con quella ragione
+ *                                dall'inizio del test
+ *   expect_no_shutdown           nessuno shutdown dall'inizio del test
+ *   report                       chiude i test e stampa il riepilogo
+ *
+ *   Qualsiasi passo può essere preceduto da una guardia:
+ *     when <cond> <passo>        (saltato se cond è falsa)
+ *   <cond> = <var> <|<=|>|>=|==|!= <numero>   (variabili: vedi SimVar)
+ *
+ * TEMPI: secondi di clock di controllo (come RUNAWAY_*_MS e le finestre
+ * firmware), non secondi simulati: a time_scale 4 hold 5 = 20 s di forno.
+ * ================================================================
+ */
+#pragma once
+#include <stdint.h>
+#include "app_state.h"   // SafetyReason (SCN_EXPECT_SHUTDOWN)
+
+// ================================================================
+//  VARIABILI LEGGIBILI / SCRIVIBILI DAGLI SCENARI
+// ================================================================
+enum class SimVar : uint8_t {
+    TEMP = 0,          // g_sim.temp_c (media pesata zone)
+    TEMP_BASE_ZONE,    // g_sim.zone_temp_c[BASE]
+    TEMP_CIELO_ZONE,
+    TEMP_BASE,         // g_state (sonda)
+    TEMP_CIELO,
+    SET_BASE,
+    SET_CIELO,
+    ERR_BASE,          // |temp - set_base|
+    DT_SPMAX,          // temp - max(set_base, set_cielo)
+    PID_OUT_BASE,
+    PID_OUT_CIELO,
+    PCT_BASE,
+    PCT_CIELO,
+    DUTY_AVG,          // duty relay medio 30 s (0..1)
+    FAN_ON,
+    FAN_OK,            // ventola accesa con T > FAN_OFF_TEMP + 5
+    RELAY_ON_BASE,
+    RELAY_ON_CIELO,
+    BASE_ENABLED,
+    CIELO_ENABLED,
+    SENSOR_MODE,       // 0 = SINGLE, 1 = DUAL
+    SAFETY_SHUTDOWN,
+    SAFETY_REASON,     // SafetyReason
+    TC_ERROR_ACTIVE,   // iniezione NAN ancora in corso
+    AUTOSTART_OK,      // base_enabled || !user_abort_autostart
+    AUTOTUNE_RUNNING,
+    AUTOTUNE_DONE,     // status DONE && !running
+    KP_BASE,
+    KI_BASE,
+    KD_BASE,
+    AUTOTUNE_BAND,     // fascia in taratura (1..n), 0 = taratura singola
+    GAIN_POINTS,       // punti della tabella guadagni Base (gain_sched.h)
+    FF_K,              // perdita del forno [W/°C] del feedforward (feedforward.h), 0 = nessun modello
+    LOAD_DONE,         // raffica pizze terminata (simulator_load_done)
+    LOAD_UNRECOVERED,
+    POWER_W,           // g_sim.elec_w: assorbimento relay ora
+    POWER_PEAK_W,      // picco da simulator_power_reset()
+    POWER_BUDGET_W,    // g_relays.powerBudget() (scrivibile, azzera il picco)
+    PREHEAT,           // preheat_base || preheat_cielo
+    PREHEAT_ETA_S,     // max preheat_eta_* delle zone in preriscaldo (-1 = nessuna stima)
+    OVERSHOOT,         // max(temp - max(set_base, set_cielo)) dall'inizio del test, ≥ 0
+    OUT_STEP,          // max salto [% di P_base + P_cielo] della potenza relay media tra due
+                       // blocchi consecutivi di SCN_OUT_BLOCK cicli con almeno una zona
+                       // abilitata, dall'inizio del test (salti alle transizioni, pid_ctrl.h)
+    TEST_S,            // secondi dall'inizio del test corrente
+    ERR_BASE_ZONE,     // |temp_base_zone - set_base|
+    ERR_CIELO_ZONE,    // |temp_cielo_zone - set_cielo|
+    COUPLING_W,        // g_sim.k_coupling, conduttanza base↔cielo [W/°C] (scrivibile)
+    COUPLING_VALID,    // g_state.coupling.valid: matrice di accoppiamento stimata (zone_coupling.h)
+    RELAY_CYCLES,      // chiusure Base + Cielo dall'inizio del test (g_relays.cycles)
+    RELAY_WINDOW_S,    // finestra relay in corso della Base [s] (relay_window.h)
+    ERR_RMS,           // rms di temp - set_base dall'inizio del test
+    ERR_SD,            // deviazione standard di temp - set_base (ripple)
+    SSR_BASE,          // 1 = relè Base statico (PWM a semionde), scrivibile
+    SSR_CIELO,         // idem Cielo
+    KP_CIELO,          // guadagni Cielo (autotune per zona in DUAL)
+    KI_CIELO,
+    KD_CIELO,
+    FF_OFF,            // 1 = Task_PID senza feedforward (g_sim.ff_off), scrivibile
+    ERR_AVG,           // |media di temp_base su una finestra relay (SCN_OUT_BLOCK cicli) - set_base|:
+                       // errore del PV senza il ripple della finestra, per i tempi di assestamento
+    DEV_BASE,          // max |media di temp_base su una finestra relay - set_base| dall'inizio del test
+    DEV_CIELO,         // idem sonda Cielo: quanto si sposta la zona ferma al gradino dell'altra
+    DECOUPLE_OFF,      // 1 = Task_PID senza la matrice di accoppiamento (g_sim.decouple_off), scrivibile
+    AUTOTUNE_CYCLES,   // g_state.autotune_cycles: cicli completi del relay test
+    AUTOTUNE_KU,       // g_state.autotune_ku_cielo/pu_cielo: Ku [%/°C] e Pu [s] dell'ultimo relay test
+    AUTOTUNE_PU,
+    AUTOTUNE_CONVERGED,// 1 = chiuso dalla convergenza Ku/Pu
+    AUTOTUNE_EARLY_STOP,// 0 = prossimi autotune fino a ATUNE_MAX_PEAKS, senza convergenza (scrivibile, 1 a ogni load)
+    AUTOTUNE_KU_BASE,  // g_state.autotune_ku_base/pu_base: relay test della Base (= Cielo fuori da per zona)
+    AUTOTUNE_PU_BASE,
+    AUTOTUNE_PER_ZONE, // 1 = ultima taratura con relay test e guadagni per zona
+    AUTOTUNE_OFFERED,  // 1 = guadagni SIMC dal preriscaldo offerti, non applicati (status OFFERED)
+    AUTOTUNE_KP_BASE,  // g_state.autotune_kp_base: risultato od offerta per la Base
+    AUTOTUNE_KP_CIELO,
+    DECOUPLE_ON,       // 1 = Task_PID usa ora la matrice di accoppiamento (g_sim.decouple_on)
+    COUPLING_RGA,      // g_state.coupling.rga() della matrice stimata, 0 se non valida
+    DEV_MARK,          // scrivendo 1 fissa DEV_BASE/DEV_CIELO del test corrente come riferimento
+                       // (stesso seed); letto: 1 se c'è un riferimento
+    DEV_BASE_REL,      // DEV_BASE / DEV_BASE al dev_mark (INFINITY senza riferimento)
+    DEV_CIELO_REL,
+    COUNT
+};
+
+enum class ScnCmp : uint8_t { LT, LE, GT, GE, EQ, NE };
+
+enum class ScnOp : uint8_t {
+    END = 0,
+    TEST, LOG, ENABLE, SET, FAULT, RESET, AUTOTUNE, LOAD,
+    WAIT_TIME, WAIT_COND, EXPECT, EVER,
+    EXPECT_SHUTDOWN, EXPECT_NO_SHUTDOWN, REPORT
+};
+
+enum class ScnFault : uint8_t { TC_ERROR, OVERTEMP, GHOST_HEAT, RWD, RWD_WINDOW_MS };
+
+#define SCN_F_OPTIONAL  0x01   // WAIT_COND: timeout non è un fallimento
+#define SCN_F_TRACK     0x02   // TEST: conta nelle metriche di regolazione
+#define SCN_F_GUARD     0x04   // passo eseguito solo se la guardia è vera
+
+// Argomenti di ENABLE
+#define SCN_EN_NONE   0
+#define SCN_EN_BASE   1
+#define SCN_EN_CIELO  2
+#define SCN_EN_BOTH   3
+
+struct ScnCond {
+    SimVar var;
+    ScnCmp cmp;
+    float  value;
+};
+
+struct ScnStep {
+    ScnOp       op;
+    uint8_t     flags;
+    uint8_t     arg;        // ENABLE: SCN_EN_*; FAULT: ScnFault; SET: SimVar;
+                            // AUTOTUNE: 1 start / 0 stop / 2 fasce / 3 gradino / 4 accept; EXPECT_SHUTDOWN: SafetyReason
+    ScnCond     cond;       // WAIT_COND / EXPECT / EVER
+    ScnCond     guard;      // con SCN_F_GUARD
+    float       value;      // SET/FAULT: valore; WAIT_TIME: s; LOAD: n pizze
+    float       hold_s;     // WAIT_COND: hold; EVER: after; LOAD: intervallo
+    float       timeout_s;  // WAIT_COND / EXPECT_SHUTDOWN (0 = nessuno); LOAD: cottura
+    const char* text;       // TEST / LOG
+};
+
+// ================================================================
+//  MACRO PER TABELLE IN FLASH
+// ================================================================
+#define SCN_C(v, c, x)   ScnCond{ SimVar::v, ScnCmp::c, (float)(x) }
+#define SCN_NOC          ScnCond{ SimVar::TEMP, ScnCmp::EQ, 0.0f }
+
+#define SCN_TEST(name)               { ScnOp::TEST, 0, 0, SCN_NOC, SCN_NOC, 0, 0, 0, name }
+#define SCN_TEST_TRACK(name)         { ScnOp::TEST, SCN_F_TRACK, 0, SCN_NOC, SCN_NOC, 0, 0, 0, name }
+#define SCN_LOG(txt)                 { ScnOp::LOG, 0, 0, SCN_NOC, SCN_NOC, 0, 0, 0, txt }
+#define SCN_ENABLE(en)               { ScnOp::ENABLE, 0, SCN_EN_##en, SCN_NOC, SCN_NOC, 0, 0, 0, nullptr }
+#define SCN_SET(v, x)                { ScnOp::SET, 0, (uint8_t)SimVar::v, SCN_NOC, SCN_NOC, (float)(x), 0, 0, nullptr }
+#define SCN_FAULT(f, x)              { ScnOp::FAULT, 0, (uint8_t)ScnFault::f, SCN_NOC, SCN_NOC, (float)(x), 0, 0, nullptr }
+#define SCN_RESET()                  { ScnOp::RESET, 0, 0, SCN_NOC, SCN_NOC, 0, 0, 0, nullptr }
+#define SCN_AUTOTUNE(on)             { ScnOp::AUTOTUNE, 0, (uint8_t)(on), SCN_NOC, SCN_NOC, 0, 0, 0, nullptr }
+#define SCN_LOAD(n, every, bake)     { ScnOp::LOAD, 0, 0, SCN_NOC, SCN_NOC, (float)(n), (float)(every), (float)(bake), nullptr }
+#define SCN_WAIT(s)                  { ScnOp::WAIT_TIME, 0, 0, SCN_NOC, SCN_NOC, (float)(s), 0, 0, nullptr }
+#define SCN_WAIT_UNTIL(c, hold, to)  { ScnOp::WAIT_COND, 0, 0, c, SCN_NOC, 0, (float)(hold), (float)(to), nullptr }
+#define SCN_WAIT_OPT(c, hold, to)    { ScnOp::WAIT_COND, SCN_F_OPTIONAL, 0, c, SCN_NOC, 0, (float)(hold), (float)(to), nullptr }
+#define SCN_EXPECT(c)                { ScnOp::EXPECT, 0, 0, c, SCN_NOC, 0, 0, 0, nullptr }
+#define SCN_EVER(c, after)           { ScnOp::EVER, 0, 0, c, SCN_NOC, 0, (float)(after), 0, nullptr }
+#define SCN_EXPECT_SHUTDOWN(r, to)   { ScnOp::EXPECT_SHUTDOWN, 0, (uint8_t)SafetyReason::r, SCN_NOC, SCN_NOC, 0, 0, (float)(to), nullptr }
+#define SCN_EXPECT_NO_SHUTDOWN()     { ScnOp::EXPECT_NO_SHUTDOWN, 0, 0, SCN_NOC, SCN_NOC, 0, 0, 0, nullptr }
+#define SCN_REPORT()                 { ScnOp::REPORT, 0, 0, SCN_NOC, SCN_NOC, 0, 0, 0, nullptr }
+#define SCN_END()                    { ScnOp::END, 0, 0, SCN_NOC, SCN_NOC, 0, 0, 0, nullptr }
+
+/** Guardia su un passo: SCN_WHEN(SCN_C(SENSOR_MODE, EQ, 1), SCN_EXPECT_SHUTDOWN(TC_ERROR, 3)).
+ *  constexpr: la tabella resta inizializzata a compile time (flash). */
+constexpr ScnStep scn_when(ScnCond guard, ScnStep step) {
+    return ScnStep{ step.op, (uint8_t)(step.flags | SCN_F_GUARD), step.arg, step.cond, guard,
+                    step.value, step.hold_s, step.timeout_s, step.text };
+}
+#define SCN_WHEN(g, step)            scn_when(g, ScnStep step)
+
+// ================================================================
+//  NOMI (parser host, --emit-c, log)
+// ================================================================
+const char* scn_var_name(SimVar v);
+bool        scn_var_from_name(const char* name, SimVar* out);
+bool        scn_var_writable(SimVar v);
+const char* scn_reason_name(int reason);            // SafetyReason → "OVERTEMP"
+bool        scn_reason_from_name(const char* name, int* out);
+
+// ================================================================
+//  ESECUZIONE
+// ================================================================
+#define SCN_MAX_TESTS    24
+#define SCN_OUT_BLOCK    60    // cicli PID per media di OUT_STEP: una finestra relay (30 s),
+                               // toglie il ripple time-proportional e il rumore del D
+#define SCN_MAX_EVER      4
+
+/** Scenario di default: la sequenza test storica (FASE 1-7). */
+extern const ScnStep k_scn_default[];
+
+/** Carica uno scenario (terminato da ScnOp::END). nullptr = nessuno scenario. */
+void  scenario_load(const ScnStep* steps);
+/** Un passo del motore; chiamato da simulator_test_tick(). */
+void  scenario_tick(uint32_t now_ms);
+bool  scenario_done();
+/** true se il test corrente è marcato track (metriche di regolazione). */
+bool  scenario_tracking();
+/** Esito dopo il report (REPORT / END): test passati e totali. */
+int   scenario_tests_passed();
+int   scenario_tests_total();
+/** Numero del test corrente (1..), 0 prima del primo TEST. */
+int   scenario_test_index();
+/** Chiamato da simulator_notify_shutdown(). */
+void  scenario_on_shutdown(int reason_int);
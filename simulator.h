@@ -1,8 +1,16 @@
 /**
  * simulator.h — Forno Pizza S3 — Simulatore Hardware + Test Sequencer v3.0
  * ================================================================
- * MODELLO TERMICO (first-order, Newton cooling):
- *   dT/dt = SIM_TIME_SCALE * (P_in - k_loss*(T-T_amb)) / thermal_mass
+ * MODELLO TERMICO (rete a SIM_ZONES nodi, Newton cooling + conduzione):
+ *   C_i dT_i/dt = time_scale * (P_i - k_i*(T_i-T_amb) - Σ_j G*(T_i-T_j))
+ *   Nodo BASE  = pietra (massa maggiore, resistenza sotto la pietra)
+ *   Nodo CIELO = cupola/aria (massa minore, disperde di più)
+ *   Ogni relay alimenta solo la propria resistenza (zone_level: 0/1 per un
+ *   contattore, media del periodo PWM per un SSR); ogni SimulatedMAX6675
+ *   legge la propria zona (CS → zona). Somme di potenza, dispersione e
+ *   capacità = SIM_POWER_W / SIM_K_LOSS / SIM_THERMAL_MASS: con entrambe
+ *   le resistenze in fase, g_sim.temp_c (media pesata sulle capacità)
+ *   segue il vecchio modello a nodo singolo.
  *
  * Riferimento fisico (forno pizza elettrico compatto):
  *   Camera interna indicativa ~35 × 35 × 10 cm (volume ~12 L).
@@ -13,72 +21,215 @@
  *     costante di tempo τ ≈ SIM_THERMAL_MASS/k_loss (~3–4 min in tempo reale a scala 1x).
  *
  *   SIM_TIME_SCALE = 4.0   → accelerazione tempo simulato (test più rapidi).
+ *     Default di g_sim.time_scale, modificabile a runtime dopo simulator_init().
  *
- * SEQUENZA TEST AUTOMATICA (simulator_test_tick):
+ * TEMPO VIRTUALE (SIM_VIRTUAL_CLOCK=1, vedi control_clock.h):
+ *   dt_ms passato a simulator_tick() è tempo del clock di controllo,
+ *   non più wall-clock: la sequenza gira alla velocità della CPU e
+ *   time_scale=1.0 dà un gemello fisicamente fedele (1 s firmware = 1 s forno).
+ *
+ * DISTURBI DI CARICO (simulator_load_*, tempi in secondi simulati):
+ *   pizza fredda  → nodo termico extra (SIM_PIZZA_MASS) appoggiato sulla
+ *                   pietra con conduttanza SIM_PIZZA_G, sfornato dopo bake_s
+ *   porta aperta  → dispersione aggiuntiva SIM_DOOR_K_LOSS per SIM_DOOR_OPEN_S
+ *                   (ripartita soprattutto sul cielo), a ogni infornata/sfornata
+ *   raffica       → N pizze ogni M secondi; per ciascuna si misura il
+ *                   recupero della pietra entro ±SIM_RECOVERY_BAND_DEG dal
+ *                   setpoint base → simulator_load_report() (pizze/ora)
+ *
+ * SEQUENZA TEST AUTOMATICA (simulator_test_tick → sim_scenario.h):
+ *   simulator_init() carica k_scn_default, la sequenza storica:
  *   FASE 1 — PID + verifica duty relay / ventola (T > soglia ventola)
  *   FASE 2 — OVERTEMP
  *   FASE 3 — TC_ERROR (SINGLE: nessuno shutdown)
  *   FASE 4 — RUNAWAY_UP (calore fantasma a relay OFF)
  *   FASE 5 — RUNAWAY_DOWN (calo forzato con richiesta calore; finestra MS ridotta in SIM)
  *   FASE 6 — AUTOTUNE (relay visti dal modello termico dopo fix Task_PID)
- *   FASE 7 — Riscaldamento finale
- *   FASE 8 — Report
+ *   FASE 7 — Riscaldamento finale + report
+ *   Altri scenari: scenario_load() con una tabella SCN_*, oppure file
+ *   .scn sulla build host (host/forno_host --scenario).
  * ================================================================
  */
 
 #pragma once
 #include <Arduino.h>
 #include <math.h>
+#include "sim_scenario.h"
 
 // ================================================================
 //  PARAMETRI MODELLO TERMICO (allineati a ~2200 W, camera ~35×35×10 cm)
+//  Un modello stimato su un forno reale (host/plant_fit --out) le
+//  ridefinisce: host → make -C host PLANT=plants/forno.h, device →
+//  #define SIM_PLANT_FILE "forno.h" in debug_config.h.
 // ================================================================
+#ifdef SIM_PLANT_FILE
+#include SIM_PLANT_FILE
+#endif
+
+#ifndef SIM_POWER_W
 #define SIM_POWER_W         2200.0f
+#endif
+#ifndef SIM_K_LOSS
 #define SIM_K_LOSS            6.0f
+#endif
+#ifndef SIM_THERMAL_MASS
 #define SIM_THERMAL_MASS    1100.0f
+#endif
+#ifndef SIM_T_AMBIENT
 #define SIM_T_AMBIENT         20.0f
+#endif
+#ifndef SIM_DEAD_TIME_S
+#define SIM_DEAD_TIME_S        0.0f     // ritardo puro resistenza → sonda [s simulati]
+#endif
 #define SIM_T_START           22.0f
 #define SIM_NOISE_DEG         0.25f
+#define SIM_OVERTEMP_READ_C  495.0f     // lettura forzata da force_overtemp
+#define SIM_RWD_LOSS_K        25.0f     // dispersione extra ×k_loss con rwd_inject
+#ifndef SIM_TIME_SCALE
 #define SIM_TIME_SCALE         4.0f
+#endif
 
 #define SIM_AUTOSTART_MS      8000
 
+// ── Rete a due zone: BASE (pietra) + CIELO (cupola) ──
+// Somme = costanti totali; un SIM_PLANT_FILE le ripartisce in proporzione
+#define SIM_ZONES                2
+#ifndef SIM_POWER_BASE_W
+#define SIM_POWER_BASE_W      1200.0f   // resistenza sotto la pietra
+#define SIM_POWER_CIELO_W     1000.0f   // resistenza cielo
+#define SIM_MASS_BASE          700.0f   // [J/°C] pietra refrattaria
+#define SIM_MASS_CIELO         400.0f   // [J/°C] cupola + aria
+#define SIM_K_LOSS_BASE          2.5f   // [W/°C] verso ambiente
+#define SIM_K_LOSS_CIELO         3.5f
+#endif
+#ifndef SIM_K_COUPLING
+#define SIM_K_COUPLING          40.0f   // [W/°C] conduzione/irraggiamento base↔cielo
+#endif
+
+enum SimZone { SIM_ZONE_BASE = 0, SIM_ZONE_CIELO = 1 };
+
+// ── Disturbi di carico ──
+#define SIM_PIZZA_MASS         250.0f   // [J/°C] pizza cruda (impasto + condimento)
+#define SIM_PIZZA_T0            20.0f   // [°C] pizza dal banco
+#define SIM_PIZZA_G              8.0f   // [W/°C] contatto pizza↔pietra
+#define SIM_PIZZA_BAKE_S        90.0f   // cottura di default
+#define SIM_DOOR_K_LOSS         30.0f   // [W/°C] dispersione extra a porta aperta
+#define SIM_DOOR_CIELO_FRAC      0.8f   // quota sul cielo (aria calda esce dall'alto)
+#define SIM_DOOR_OPEN_S          8.0f   // durata apertura per infornata/sfornata
+#define SIM_RECOVERY_BAND_DEG    5.0f
+#define SIM_LOAD_MAX            32      // pizze registrate nel report
+
 // Finestra RUNAWAY_DOWN nel solo test simulatore (ms reali; 0 = usa firmware default)
 #define SIM_RUNAWAY_DOWN_MS_TEST  20000UL
 
 // ================================================================
-//  FASI TEST
+//  MODELLO TERMICO — funzioni pure (rientranti)
+//  Modello a nodo singolo (costanti totali), usato dai bench host
+//  (host/pid_bench.cpp, host/mpc_bench.cpp). Passo di zona condiviso da
+//  simulator_tick() e dal plant a lotti di host/pid_sweep.cpp
+//  (host/sim_batch.h): stessa aritmetica float → stessa traiettoria bit a bit.
 // ================================================================
-enum class SimTestPhase {
-    WAIT_START   = 0,
-    PID_WARMUP   = 1,
-    OVERTEMP     = 2,
-    TC_ERROR     = 3,
-    RUNAWAY_UP   = 4,
-    RUNAWAY_DOWN = 5,
-    AUTOTUNE     = 6,
-    FINAL_WARMUP = 7,
-    REPORT       = 8,
-    DONE         = 9
+#define SIM_T_MAX            600.0f
+
+inline float sim_heat_loss(float temp_c) {
+    return SIM_K_LOSS * (temp_c - SIM_T_AMBIENT);
+}
+
+// ── Ritardo puro: coda dei cambi di stato relay ──
+// Stato = un bit per zona (runner host) o un livello 0-255 per zona in
+// 8 bit (simulator.cpp: contattore 0/255, SSR il livello PWM)
+#define SIM_DEAD_EVENTS  64
+
+struct SimDeadLine {
+    float    t_s[SIM_DEAD_EVENTS];
+    uint16_t bits[SIM_DEAD_EVENTS];
+    uint8_t  head, count;
+    uint16_t last;   // ultimo stato accodato
+    uint16_t out;    // stato visto dal plant (ritardato)
 };
 
+inline void sim_dead_reset(SimDeadLine& d, uint16_t bits) {
+    d.head = d.count = 0;
+    d.last = d.out = bits;
+}
+
+/** Accoda lo stato a now_s, ritorna quello di now_s - dead_s. */
+inline uint16_t sim_dead_step(SimDeadLine& d, float now_s, uint16_t bits, float dead_s) {
+    if (bits != d.last) {
+        if (d.count == SIM_DEAD_EVENTS) {       // coda piena: applica il più vecchio
+            d.out  = d.bits[d.head];
+            d.head = (d.head + 1) % SIM_DEAD_EVENTS;
+            d.count--;
+        }
+        int tail = (d.head + d.count) % SIM_DEAD_EVENTS;
+        d.t_s[tail]  = now_s;
+        d.bits[tail] = bits;
+        d.count++;
+        d.last = bits;
+    }
+    while (d.count > 0 && d.t_s[d.head] <= now_s - dead_s) {
+        d.out  = d.bits[d.head];
+        d.head = (d.head + 1) % SIM_DEAD_EVENTS;
+        d.count--;
+    }
+    return d.out;
+}
+
+/** Un passo di Newton cooling: nuova T dopo dt_s secondi simulati. */
+inline float sim_thermal_step(float temp_c, float p_in, float p_loss, float dt_s) {
+    float dT = dt_s * (p_in - p_loss) / SIM_THERMAL_MASS;
+    temp_c += dT;
+    if (temp_c < SIM_T_AMBIENT) temp_c = SIM_T_AMBIENT;
+    if (temp_c > SIM_T_MAX)     temp_c = SIM_T_MAX;
+    return temp_c;
+}
+
+/** Passo di una zona della rete: p_cond = Σ_j G*(T_i - T_j) (+ pizza sulla pietra). */
+inline float sim_zone_step(float temp_c, float p_in, float p_loss, float p_cond,
+                           float mass, float dt_s) {
+    float dT = dt_s * (p_in - p_loss - p_cond) / mass;
+    temp_c += dT;
+    if (temp_c < SIM_T_AMBIENT) temp_c = SIM_T_AMBIENT;
+    if (temp_c > SIM_T_MAX)     temp_c = SIM_T_MAX;
+    return temp_c;
+}
+
 // ================================================================
 //  STATO SIMULATORE
 // ================================================================
 struct SimulatorState {
-    float    temp_c;
-    bool     relay_on;
+    float    temp_c;         // media pesata sulle capacità delle zone
+    bool     relay_on;       // almeno un relay ON (log, duty)
     float    power_in;
     float    heat_loss;
+    float    zone_temp_c[SIM_ZONES];
+    bool     zone_relay[SIM_ZONES];
+    float    zone_level[SIM_ZONES];   // potenza media nel tick, 0-1 (SSR: livello PWM)
+    float    zone_power_in[SIM_ZONES];
     uint32_t ticks;
     float    time_elapsed_s;
+    float    time_scale;     // secondi simulati per secondo di clock (default SIM_TIME_SCALE)
+    float    dead_time_s;    // ritardo resistenza → sonda (default SIM_DEAD_TIME_S)
+    float    k_coupling;     // [W/°C] base↔cielo (default SIM_K_COUPLING, scenari: coupling_w)
+    bool     ff_off;         // scenari (ff_off): Task_PID senza feedforward, confronto col PID puro
+    bool     decouple_off;   // scenari (decouple_off): ff senza matrice, PID indipendenti per zona
+    bool     decouple_on;    // Task_PID: ff dalla matrice in uso (scenari: decouple_on)
+    SimDeadLine dead;
 
     float    duty_avg;
 
-    SimTestPhase phase;
-    uint32_t     phase_start_ms;
+    // Potenza elettrica assorbita dai relay (senza ritardo: è la linea,
+    // non la sonda). Picco azzerato da simulator_power_reset()
+    float    elec_w;
+    float    elec_peak_w;
+    double   elec_energy_j;
+    float    elec_time_s;
+
+    // Guasti iniettati dagli scenari (ScnOp::FAULT)
+    float        noise_deg;      // σ rumore sonda (default SIM_NOISE_DEG)
     bool         force_tc_error;
     bool         force_overtemp;
+    float        overtemp_c;     // lettura con force_overtemp (default SIM_OVERTEMP_READ_C)
     int          tc_error_count;
 
     // Test RUNAWAY_UP: potenza aggiunta con relay logicamente spenti (simula SSR incollato)
@@ -86,40 +237,52 @@ struct SimulatorState {
     float        ghost_power_w;
     // Test RUNAWAY_DOWN: inietta raffreddamento extra mentre relay ON
     bool         rwd_inject;
-    uint8_t      rwd_subphase;   // 0=riscaldamento 1=iniezione calo (RUNAWAY_DOWN)
+    float        rwd_loss_k;     // moltiplicatore dispersione (default SIM_RWD_LOSS_K)
 
     uint32_t     thermal_reset_seq;
 
-    bool    test_pid_ok;
-    bool    test_relay_duty_ok;
-    bool    test_fan_ok;
-    bool    test_overtemp_ok;
-    bool    test_tc_error_ok;
-    bool    test_runaway_up_ok;
-    bool    test_runaway_down_ok;
-    bool    test_autotune_ok;
-    bool    test_final_ok;
+    // Replay di una trace (host/trace_replay): le sonde leggono replay_c
+    bool         replay;
+    float        replay_c[SIM_ZONES];
+
+    // Disturbi di carico (tempi = time_elapsed_s)
+    bool         pizza_on_stone;
+    float        pizza_temp_c;
+    float        pizza_out_s;        // sfornata prevista
+    float        door_close_s;       // porta aperta finché time_elapsed_s < door_close_s
+    int          load_remaining;     // pizze ancora da infornare nella raffica
+    float        load_next_s;
+    float        load_interval_s;
+    float        load_bake_s;
+    // Misura recupero pietra (zona BASE vs g_state.set_base)
+    bool         load_recovering;
+    bool         load_left_band;
+    float        load_t0_s;
+    int          load_count;         // pizze infornate
+    int          load_unrecovered;   // nuova pizza prima del recupero
+    float        load_recovery_s[SIM_LOAD_MAX];
+
     /** Se true: non avviare la sequenza test col timer (utente ha spento manualmente). */
     bool    user_abort_autostart;
-    float   autotune_kp_result;
-    float   autotune_ki_result;
-    float   autotune_kd_result;
-    float   pid_settle_time_s;
-    int     tests_passed;
-    int     tests_total;
 };
 extern SimulatorState g_sim;
 
 // ================================================================
 //  SimulatedMAX6675
 // ================================================================
+int simulator_zone_for_cs(int cs);
+
 class SimulatedMAX6675 {
 public:
-    SimulatedMAX6675(int sck, int cs, int miso) {
-        (void)sck; (void)cs; (void)miso;
+    SimulatedMAX6675(int sck, int cs, int miso)
+        : _zone(simulator_zone_for_cs(cs)) {
+        (void)sck; (void)miso;
     }
 
     float readCelsius() {
+        if (g_sim.replay) {
+            return g_sim.replay_c[_zone];
+        }
         if (g_sim.force_tc_error) {
             g_sim.tc_error_count--;
             if (g_sim.tc_error_count <= 0) {
@@ -128,18 +291,21 @@ public:
             return NAN;
         }
         if (g_sim.force_overtemp) {
-            return 495.0f;
+            return g_sim.overtemp_c;
         }
         float noise = 0.0f;
-        if (SIM_NOISE_DEG > 0.0f) {
+        if (g_sim.noise_deg > 0.0f) {
             float u = ((float)random(1, 10000)) / 10000.0f;
             float v = ((float)random(1, 10000)) / 10000.0f;
-            noise = SIM_NOISE_DEG * sqrtf(-2.0f * logf(u)) * cosf(2.0f * M_PI * v);
+            noise = g_sim.noise_deg * sqrtf(-2.0f * logf(u)) * cosf(2.0f * M_PI * v);
         }
-        return g_sim.temp_c + noise;
+        return g_sim.zone_temp_c[_zone] + noise;
     }
 
     float readFahrenheit() { return readCelsius() * 9.0f / 5.0f + 32.0f; }
+
+private:
+    int _zone;
 };
 
 // ================================================================
@@ -148,11 +314,31 @@ public:
 void simulator_init();
 void simulator_tick(uint32_t dt_ms);
 void simulator_set_relay(bool base_on, bool cielo_on);
+/**
+ * Potenza per zona 0-1 (RelayScheduler::level()): un SSR a PWM lento è
+ * visto dal plant come la sua media sul periodo, che dura un tick.
+ */
+void simulator_set_level(float base, float cielo);
 void simulator_print_status();
+/** Azzera picco e media della potenza assorbita (nuovo budget, inizio misura). */
+void simulator_power_reset();
+/** [SIM-POWER] picco e media della potenza assorbita dai relay. */
+void simulator_power_report();
 void simulator_reset_thermal();
 /** Chiamare quando l'utente spegne BASE/CIELO (evita riaccensione da autostart 8s). */
 void simulator_user_turned_heat_off(void);
 
+/** Log di stato periodico + un passo dello scenario caricato (scenario_tick). */
 void simulator_test_tick(uint32_t now_ms);
 
+/** Inforna una pizza fredda ora (porta aperta SIM_DOOR_OPEN_S); sforna dopo bake_s. */
+void simulator_pizza_place(float bake_s = SIM_PIZZA_BAKE_S);
+/** Apre la porta per duration_s secondi simulati. */
+void simulator_door_open(float duration_s = SIM_DOOR_OPEN_S);
+/** Raffica: n pizze, una ogni interval_s secondi simulati, a partire da ora. */
+void simulator_load_burst(int n, float interval_s, float bake_s = SIM_PIZZA_BAKE_S);
+/** true quando la raffica è finita e l'ultima pizza è stata sfornata e recuperata. */
+bool simulator_load_done();
+void simulator_load_report();
+
 void simulator_notify_shutdown(int reason_int);
@@ -0,0 +1,56 @@
+/**
+ * ssr_pwm.h — Forno Pizza S3 — PWM lento per le zone SSR
+ * ================================================================
+ * Un SSR zero-crossing accende e spegne solo al passaggio per lo zero:
+ * la granularità naturale è la semionda (10 ms a 50 Hz). Il PWM gira a
+ * semionde su un periodo di SSR_PWM_PERIOD_MS = un ciclo PID, quindi
+ * ogni uscita del PID diventa esattamente un periodo con la potenza
+ * media chiesta, invece di un impulso di decine di secondi.
+ *
+ *   Base  : ON dalle prime semionde del periodo
+ *   Cielo : ON fino alle ultime
+ *
+ * così con il budget di potenza (RelayScheduler, somma ≤ periodo) le due
+ * zone non sono mai accese insieme. Il livello nuovo entra al periodo
+ * successivo, per entrambe le zone insieme.
+ *
+ * LEDC non scende a 2 Hz con una risoluzione utile dal clock APB, e il
+ * canale non sa della fase fra le zone: tick() lo chiama un esp_timer a
+ * semionda (forno_control.cpp) che scrive i pin delle zone SSR. Il timer
+ * non è agganciato alla rete: ogni fronte slitta al più di una semionda,
+ * l'errore resta ±1 semionda per periodo e non si accumula.
+ *
+ * Header-only, nessuna allocazione, nessun GPIO.
+ * ================================================================
+ */
+#pragma once
+#include <stdint.h>
+#include "relay_sched.h"
+
+#define SSR_PWM_TICK_US  (500000UL / MAINS_HZ)   // una semionda
+
+class SsrPwm {
+public:
+  /** Semionde ON del prossimo periodo per la zona (0 - SSR_PWM_STEPS). */
+  void set(RelayZone z, uint32_t steps) {
+    _want[(int)z] = steps > SSR_PWM_STEPS ? SSR_PWM_STEPS : steps;
+  }
+  /** Spegne subito (shutdown): non aspetta la fine del periodo. */
+  void off() {
+    for (int i = 0; i < RELAY_ZONES; i++) _want[i] = _cur[i] = 0;
+  }
+
+  /** Una semionda: stato delle uscite in out[], poi passo avanti. */
+  void tick(bool out[RELAY_ZONES]) {
+    if (_pos == 0)
+      for (int i = 0; i < RELAY_ZONES; i++) _cur[i] = _want[i];
+    out[(int)RelayZone::BASE]  = _pos < _cur[(int)RelayZone::BASE];
+    out[(int)RelayZone::CIELO] = _pos >= SSR_PWM_STEPS - _cur[(int)RelayZone::CIELO];
+    if (++_pos >= SSR_PWM_STEPS) _pos = 0;
+  }
+
+private:
+  volatile uint32_t _want[RELAY_ZONES] = {};   // scritto da Task_PID
+  uint32_t          _cur[RELAY_ZONES]  = {};   // periodo in corso
+  uint32_t          _pos               = 0;
+};
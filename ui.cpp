@@ -9,6 +9,7 @@
 #include "ui.h"
 #include "ui_wifi.h"
 #include "ui_animations.h"
+#include "autotune.h"   // ATUNE_MAX_PEAKS
 
 
 // ================================================================
@@ -244,7 +245,9 @@ extern void cb_pct_cielo_minus(lv_event_t*);
 extern void cb_pct_cielo_plus(lv_event_t*);
 extern void cb_pid_save(lv_event_t*);
 extern void cb_autotune_start(lv_event_t*);
+extern void cb_autotune_schedule(lv_event_t*);
 extern void cb_autotune_stop(lv_event_t*);
+extern void cb_autotune_accept(lv_event_t*);
 extern void cb_goto_temp(lv_event_t*);
 extern void cb_goto_main_from_temp(lv_event_t*);
 extern void cb_goto_pid_base(lv_event_t*);
@@ -1043,6 +1046,7 @@ static void build_autotune() {
     lv_obj_set_style_radius(bstart, 8, 0);
     lv_obj_set_style_shadow_width(bstart, 0, 0);
     lv_obj_add_event_cb(bstart, cb_autotune_start, LV_EVENT_CLICKED, NULL);
+    lv_obj_add_event_cb(bstart, cb_autotune_schedule, LV_EVENT_LONG_PRESSED, NULL);
     lv_obj_t* lst = lv_label_create(bstart);
     lv_label_set_text(lst, LV_SYMBOL_PLAY " AVVIO");
     lv_obj_set_style_text_font(lst, &lv_font_montserrat_14, 0);
@@ -1057,6 +1061,7 @@ static void build_autotune() {
     lv_obj_set_style_radius(bstop, 8, 0);
     lv_obj_set_style_shadow_width(bstop, 0, 0);
     lv_obj_add_event_cb(bstop, cb_autotune_stop, LV_EVENT_CLICKED, NULL);
+    lv_obj_add_event_cb(bstop, cb_autotune_accept, LV_EVENT_LONG_PRESSED, NULL);
     lv_obj_t* lstp = lv_label_create(bstop);
     lv_label_set_text(lstp, LV_SYMBOL_STOP " ARRESTO");
     lv_obj_set_style_text_font(lstp, &lv_font_montserrat_14, 0);
@@ -1513,7 +1518,19 @@ void ui_refresh(AppState* s) {
         lv_label_set_text(ui_LabelStatus, "Sistema pronto");
         lv_obj_set_style_text_color(ui_LabelStatus, UI_COL_GRAY, 0);
     } else if (s->preheat_base || s->preheat_cielo) {
-        lv_label_set_text(ui_LabelStatus, LV_SYMBOL_WARNING " Preriscaldo in corso...");
+        // Tempo al pronto: decide la zona più lontana, -1 = stima non ancora pronta
+        int eta = s->preheat_base ? s->preheat_eta_base : 0;
+        if (s->preheat_cielo && eta >= 0 &&
+            (s->preheat_eta_cielo < 0 || s->preheat_eta_cielo > eta))
+            eta = s->preheat_eta_cielo;
+        if (eta < 0) {
+            lv_label_set_text(ui_LabelStatus, LV_SYMBOL_WARNING " Preriscaldo in corso...");
+        } else {
+            char buf[48];
+            snprintf(buf, sizeof(buf), LV_SYMBOL_WARNING " Preriscaldo, pronto tra %d:%02d",
+                     eta / 60, eta % 60);
+            lv_label_set_text(ui_LabelStatus, buf);
+        }
         lv_obj_set_style_text_color(ui_LabelStatus, UI_COL_ACCENT2, 0);
     } else {
         char buf[56];
@@ -1680,9 +1697,10 @@ void ui_refresh_pid(AppState* s) {
 
     if (ui_BarAutotune) {
         if (s->autotune_status == AutotuneStatus::RUNNING) {
-            // Nelle schermate PID mostriamo una barra fissa al 50%
+            // Nelle schermate PID: 50% fisso fino al primo ciclo, poi i cicli
             lv_obj_clear_flag(ui_BarAutotune, LV_OBJ_FLAG_HIDDEN);
-            lv_bar_set_value(ui_BarAutotune, 50, LV_ANIM_OFF);
+            lv_bar_set_value(ui_BarAutotune, s->autotune_cycles > 0
+                             ? s->autotune_cycles * 100 / ATUNE_MAX_PEAKS : 50, LV_ANIM_OFF);
         } else {
             lv_bar_set_value(ui_BarAutotune, s->autotune_cycles > 0 ? 100 : 0, LV_ANIM_OFF);
             lv_obj_add_flag(ui_BarAutotune, LV_OBJ_FLAG_HIDDEN);
@@ -1696,9 +1714,12 @@ void ui_refresh_pid(AppState* s) {
 void ui_refresh_autotune(AppState* s) {
     if (!s || !ui_ScreenAutotune) return;
 
-    // Barra avanzamento: anim indeterminata quando RUNNING
+    // Barra avanzamento: anim indeterminata quando RUNNING fino al primo
+    // ciclo completo, poi cicli / ATUNE_MAX_PEAKS (la convergenza chiude prima)
     if (ui_AutoBar) {
-        if (s->autotune_status == AutotuneStatus::RUNNING) {
+        if (s->autotune_status == AutotuneStatus::RUNNING && s->autotune_cycles > 0) {
+            anim_autotune_bar_progress(ui_AutoBar, s->autotune_cycles * 100 / ATUNE_MAX_PEAKS);
+        } else if (s->autotune_status == AutotuneStatus::RUNNING) {
             anim_autotune_bar_start(ui_AutoBar);
         } else {
             anim_autotune_bar_stop(ui_AutoBar, s->autotune_cycles);
@@ -1713,12 +1734,28 @@ void ui_refresh_autotune(AppState* s) {
             case AutotuneStatus::RUNNING:  txt = "Stato: in corso...";               break;
             case AutotuneStatus::DONE:     txt = "Stato: completato";                break;
             case AutotuneStatus::ABORTED:  txt = "Stato: interrotto";                break;
+            case AutotuneStatus::OFFERED:  txt = "Stato: offerta dal preriscaldo (ARRESTO lungo: applica)"; break;
+        }
+        if (s->autotune_status == AutotuneStatus::RUNNING && s->autotune_bands > 0) {
+            if (s->autotune_cycles > 0)
+                lv_label_set_text_fmt(ui_AutoLblStatus, "Stato: fascia %d/%d, ciclo %d...",
+                                      s->autotune_band, s->autotune_bands, s->autotune_cycles);
+            else
+                lv_label_set_text_fmt(ui_AutoLblStatus, "Stato: fascia %d/%d...",
+                                      s->autotune_band, s->autotune_bands);
+        } else if (s->autotune_status == AutotuneStatus::RUNNING && s->autotune_cycles > 0) {
+            lv_label_set_text_fmt(ui_AutoLblStatus, "Stato: in corso, ciclo %d...", s->autotune_cycles);
+        } else {
+            lv_label_set_text(ui_AutoLblStatus, txt);
         }
-        lv_label_set_text(ui_AutoLblStatus, txt);
     }
 
-    // Split BASE/CIELO usato per autotune
-    if (ui_AutoLblSplit) {
+    // Split BASE/CIELO usato per autotune (per zona: ogni relay 0/100%)
+    if (ui_AutoLblSplit && s->autotune_per_zone &&
+        s->autotune_status != AutotuneStatus::IDLE &&
+        s->autotune_status != AutotuneStatus::OFFERED) {
+        lv_label_set_text(ui_AutoLblSplit, "Relay per zona, split ignorato");
+    } else if (ui_AutoLblSplit) {
         int split_b = s->autotune_split;
         if (split_b <= 0 || split_b >= 100) split_b = s->pct_base;
         int split_c = 100 - split_b;
@@ -1727,23 +1764,32 @@ void ui_refresh_autotune(AppState* s) {
         lv_label_set_text(ui_AutoLblSplit, buf);
     }
 
-    // Temperature + percentuali resistenze attuali (ERR se sonda non rilevata)
+    // Temperature + percentuali resistenze attuali (ERR se sonda non rilevata);
+    // a taratura finita o con un'offerta dal preriscaldo il Kp di ogni zona
+    bool done = s->autotune_status == AutotuneStatus::DONE ||
+                s->autotune_status == AutotuneStatus::OFFERED;
     if (ui_AutoLblBase) {
         char buf[64];
+        int n;
         if (s->tc_base_err)
-            snprintf(buf, sizeof(buf), "BASE: ERR  %3.0f%%", s->pid_out_base);
+            n = snprintf(buf, sizeof(buf), "BASE: ERR  %3.0f%%", s->pid_out_base);
         else
-            snprintf(buf, sizeof(buf), "BASE: %.0f\xC2\xB0""C  %3.0f%%",
-                     s->temp_base, s->pid_out_base);
+            n = snprintf(buf, sizeof(buf), "BASE: %.0f\xC2\xB0""C  %3.0f%%",
+                         s->temp_base, s->pid_out_base);
+        if (done && n > 0 && n < (int)sizeof(buf))
+            snprintf(buf + n, sizeof(buf) - n, "  Kp %.2f", s->autotune_kp_base);
         lv_label_set_text(ui_AutoLblBase, buf);
     }
     if (ui_AutoLblCielo) {
         char buf[64];
+        int n;
         if (s->tc_cielo_err)
-            snprintf(buf, sizeof(buf), "CIELO: ERR  %3.0f%%", s->pid_out_cielo);
+            n = snprintf(buf, sizeof(buf), "CIELO: ERR  %3.0f%%", s->pid_out_cielo);
         else
-            snprintf(buf, sizeof(buf), "CIELO: %.0f\xC2\xB0""C  %3.0f%%",
-                     s->temp_cielo, s->pid_out_cielo);
+            n = snprintf(buf, sizeof(buf), "CIELO: %.0f\xC2\xB0""C  %3.0f%%",
+                         s->temp_cielo, s->pid_out_cielo);
+        if (done && n > 0 && n < (int)sizeof(buf))
+            snprintf(buf + n, sizeof(buf) - n, "  Kp %.2f", s->autotune_kp_cielo);
         lv_label_set_text(ui_AutoLblCielo, buf);
     }
 }
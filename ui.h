@@ -12,74 +12,7 @@
 #include <esp_heap_caps.h>
 #include "nvs_storage.h"
 #include "ui_wifi.h"
-
-// ----------------------------------------------------------------
-//  ENUMERAZIONI
-// ----------------------------------------------------------------
-enum class AutotuneStatus { IDLE=0, RUNNING=1, DONE=2, ABORTED=3 };
-enum class SafetyReason   { NONE=0, TC_ERROR=1, OVERTEMP=2,
-                            RUNAWAY_DOWN=3, RUNAWAY_UP=4, WDG_TIMEOUT=5 };
-enum class SensorMode     { SINGLE, DUAL };
-enum class Screen         {
-  MAIN,
-  TEMP,
-  PID_BASE,
-  PID_CIELO,
-  AUTOTUNE,     // nuova schermata autotune PID
-  GRAPH,
-  WIFI_SCAN,
-  WIFI_PWD,
-  MQTT,         // configurazione broker MQTT
-  OTA,
-  TIMER,
-  RICETTE
-};
-
-// ----------------------------------------------------------------
-//  STATO APPLICAZIONE — in SRAM interna (accesso real-time da Task_PID)
-// ----------------------------------------------------------------
-struct AppState {
-  double  temp_base,     temp_cielo;
-  double  set_base,      set_cielo;
-  double  pid_out_base,  pid_out_cielo;
-  double  kp_base,  ki_base,  kd_base;
-  double  kp_cielo, ki_cielo, kd_cielo;
-  SensorMode sensor_mode;
-  int     pct_base;
-  int     pct_cielo;
-  bool    base_enabled, cielo_enabled, luce_on;
-  bool    relay_base,   relay_cielo,   fan_on;
-  bool    preheat_base, preheat_cielo;
-  bool    tc_base_err,  tc_cielo_err;
-  bool    safety_shutdown;
-  SafetyReason safety_reason;
-  AutotuneStatus autotune_status;
-  int     autotune_split, autotune_cycles;
-  float   autotune_kp, autotune_ki, autotune_kd;
-  int     timer_minutes;
-  bool    timer_running;
-  Screen  active_screen;
-  bool    nvs_dirty;
-};
-extern AppState g_state;
-
-// ----------------------------------------------------------------
-//  RING BUFFER GRAFICO — allocato in PSRAM via graph_alloc_psram()
-//  360 campioni × 2 array float × 4 byte = 2.880 byte in PSRAM
-//  head e count rimangono in SRAM (accesso frequente, 4 byte totali)
-// ----------------------------------------------------------------
-#define TIMER_DEFAULT_MIN  10
-#define GRAPH_SAMPLE_S     5
-#define GRAPH_MAX_MINUTES  30
-#define GRAPH_BUF_SIZE     (GRAPH_MAX_MINUTES * 60 / GRAPH_SAMPLE_S)  // 360
-
-struct GraphBuffer {
-  float*   base;   // puntatore → array in PSRAM
-  float*   cielo;  // puntatore → array in PSRAM
-  uint16_t head;
-  uint16_t count;
-};
-extern GraphBuffer g_graph;
+#include "app_state.h"   // enum, AppState, GraphBuffer (condivisi col core di controllo)
 
 // Alloca gli array base/cielo in PSRAM — chiama da setup() DOPO display_init()
 inline bool graph_alloc_psram() {
@@ -339,10 +272,3 @@ void ui_refresh_graph(AppState* s);
 void ui_timer_auto_start();
 void ui_timer_tick_1s();
 void ui_refresh_autotune(AppState* s);
-
-// ================================================================
-//  VARIABILI GLOBALI
-// ================================================================
-extern volatile uint32_t g_pid_heartbeat;
-extern volatile bool     g_emergency_shutdown;
-void emergency_shutdown(SafetyReason reason);
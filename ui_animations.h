@@ -398,6 +398,13 @@ static inline void anim_autotune_bar_start(lv_obj_t* bar) {
     lv_anim_set_path_cb(&a, lv_anim_path_ease_in_out);
     lv_anim_start(&a);
 }
+// Dal primo ciclo completo: avanzamento vero al posto dell'indeterminata
+static inline void anim_autotune_bar_progress(lv_obj_t* bar, int pct) {
+    if (!bar) return;
+    lv_anim_del(bar, NULL);
+    lv_obj_clear_flag(bar, LV_OBJ_FLAG_HIDDEN);
+    lv_bar_set_value(bar, pct > 100 ? 100 : pct, LV_ANIM_ON);
+}
 static inline void anim_autotune_bar_stop(lv_obj_t* bar, int cycles_done) {
     if (!bar) return;
     lv_anim_del(bar, NULL);
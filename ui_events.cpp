@@ -319,11 +319,26 @@ void cb_autotune_start(lv_event_t*) {
   autotune_start();
 }
 
+// Pressione lunga su AVVIA: taratura a fasce (AUTOTUNE_SCHED_TEMPS)
+void cb_autotune_schedule(lv_event_t*) {
+  if (g_state.safety_shutdown) return;
+  if (autotune_is_running())   return;
+
+  autotune_apply_default_split();
+  autotune_start_schedule();
+}
+
 void cb_autotune_stop(lv_event_t*) {
   if (!autotune_is_running()) return;
   autotune_stop();
 }
 
+// Pressione lunga su ARRESTO a taratura ferma: applica i guadagni offerti dal preriscaldo
+void cb_autotune_accept(lv_event_t*) {
+  if (autotune_is_running()) return;
+  autotune_accept_offer();
+}
+
 // ================================================================
 //  CALLBACKS — RICETTE
 // ================================================================
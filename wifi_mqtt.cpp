@@ -301,10 +301,10 @@ static void publish_state() {
   int ri = (int)reason;
   doc["safety_reason"] = (ri >= 0 && ri <= 5) ? reasons[ri] : "UNKNOWN";
 
-  const char* at_states[] = {"IDLE","RUNNING","DONE","ABORTED"};
+  const char* at_states[] = {"IDLE","RUNNING","DONE","ABORTED","OFFERED"};
   int ati = (int)g_state.autotune_status;
   doc["autotune_running"] = autotune_is_running();
-  doc["autotune_status"]  = (ati >= 0 && ati <= 3) ? at_states[ati] : "UNKNOWN";
+  doc["autotune_status"]  = (ati >= 0 && ati <= 4) ? at_states[ati] : "UNKNOWN";
   doc["autotune_split"]   = g_state.autotune_split;
   doc["autotune_cycles"]  = g_state.autotune_cycles;
 
@@ -313,6 +313,50 @@ static void publish_state() {
   mqtt.publish(T_STATE, payload, false);
 }
 
+// ================================================================
+//  PUBLISH AUTOTUNE — risultato per zona su T_AT_STATUS (retained)
+//  Base e Cielo separati: con la taratura per zona (DUAL) i guadagni
+//  differiscono, altrimenti sono gli stessi e per_zone = false.
+//  OFFERED: guadagni SIMC dal preriscaldo, applicati con ACCEPT
+// ================================================================
+static bool publish_autotune() {
+  if (!mqtt.connected()) return false;
+
+  AutotuneStatus st;
+  bool per_zone, converged;
+  float kp[2], ki[2], kd[2], ku[2], pu[2];
+
+  if (!MUTEX_TAKE_MS(20)) return false;
+  st        = g_state.autotune_status;
+  per_zone  = g_state.autotune_per_zone;
+  converged = g_state.autotune_converged;
+  kp[0] = g_state.autotune_kp_base;   ki[0] = g_state.autotune_ki_base;   kd[0] = g_state.autotune_kd_base;
+  kp[1] = g_state.autotune_kp_cielo;  ki[1] = g_state.autotune_ki_cielo;  kd[1] = g_state.autotune_kd_cielo;
+  ku[0] = g_state.autotune_ku_base;   pu[0] = g_state.autotune_pu_base;
+  ku[1] = g_state.autotune_ku_cielo;  pu[1] = g_state.autotune_pu_cielo;
+  MUTEX_GIVE();
+
+  const char* at_states[] = {"IDLE","RUNNING","DONE","ABORTED","OFFERED"};
+  int ati = (int)st;
+  StaticJsonDocument<384> doc;
+  doc["status"]    = (ati >= 0 && ati <= 4) ? at_states[ati] : "UNKNOWN";
+  doc["per_zone"]  = per_zone;
+  doc["converged"] = converged;
+  const char* zones[] = {"base", "cielo"};
+  for (int z = 0; z < 2; z++) {
+    JsonObject o = doc[zones[z]].to<JsonObject>();
+    o["kp"] = serialized(String(kp[z], 3));
+    o["ki"] = serialized(String(ki[z], 4));
+    o["kd"] = serialized(String(kd[z], 3));
+    o["ku"] = serialized(String(ku[z], 2));
+    o["pu"] = serialized(String(pu[z], 1));
+  }
+
+  char payload[384];
+  serializeJson(doc, payload, sizeof(payload));
+  return mqtt.publish(T_AT_STATUS, payload, true);
+}
+
 // ================================================================
 //  MQTT callback
 // ================================================================
@@ -350,8 +394,12 @@ static void mqtt_callback(char* topic_in, byte* pay, unsigned int len) {
   if (strcmp(topic_in, T_AT_CMD) == 0) {
     if (strcmp(msg, "START") == 0 && !g_state.safety_shutdown && !autotune_is_running())
       autotune_start();
+    else if (strcmp(msg, "STEP") == 0 && !g_state.safety_shutdown && !autotune_is_running())
+      autotune_start_step();
     else if (strcmp(msg, "STOP") == 0 && autotune_is_running())
       autotune_stop();
+    else if (strcmp(msg, "ACCEPT") == 0)
+      autotune_accept_offer();
     return;
   }
   if (strcmp(topic_in, T_AT_SPLIT) == 0) {
@@ -551,6 +599,10 @@ void Task_WiFi(void* param) {
       publish_state();
     }
 
+    static AutotuneStatus last_at = AutotuneStatus::IDLE;
+    AutotuneStatus at_now = g_state.autotune_status;
+    if (at_now != last_at && publish_autotune()) last_at = at_now;
+
     static bool last_shutdown = false;
     if (g_state.safety_shutdown && !last_shutdown) {
       publish_state();
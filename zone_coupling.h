@@ -0,0 +1,219 @@
+/**
+ * zone_coupling.h — Forno Pizza S3 — Accoppiamento termico Base/Cielo
+ * ================================================================
+ * Pietra e cupola si scambiano calore (conduzione, irraggiamento):
+ *
+ *   C_i dT_i/dt = P_i - k_i·(T_i - T_amb) - G·(T_i - T_j)
+ *
+ * Due PID indipendenti vedono la potenza dell'altra zona come un
+ * disturbo: la Base che sale scalda il Cielo, il PID del Cielo taglia,
+ * la Base perde calore verso il Cielo e spinge di più. Con setpoint
+ * diversi i due integrali si inseguono.
+ *
+ * A regime la potenza che tiene la zona i a T_i con l'altra a T_j è
+ *
+ *   P_i = K_ii·T_i + K_ij·T_j + P0_i
+ *   K_ii = k_i + G     K_ij = -G     P0_i = -k_i·T_amb
+ *
+ * (K è la matrice di accoppiamento). Task_PID (FEATURE_DECOUPLE, DUAL)
+ * ne fa il feedforward della zona col setpoint proprio e l'altra zona
+ * dov'è (misurata mentre va al suo setpoint, poi il setpoint): quando
+ * l'altra zona si muove, la quota di calore che arriva o se ne va è già
+ * nel duty e il PID vede solo la sua zona. Solo con rga() fino a
+ * DECOUPLE_RGA_MAX.
+ *
+ * STIMA (CouplingIdentifier): l'equazione della zona integrata su un
+ * blocco di block_ms è esatta sulle medie del blocco, qualunque cosa
+ * facciano i relay e l'altra zona dentro il blocco:
+ *
+ *   (T_i,fine - T_i,inizio)/Δ = a·T̄_i + b·T̄_j + c·P̄_i + d
+ *   a = -(k_i + G)/C_i   b = G/C_i   c = 1/C_i   d = k_i·T_amb/C_i
+ *
+ * Una regressione per zona, equazioni normali 4×4 accumulate (O(1)
+ * memoria, come plant_id.h). Il rumore della sonda finisce quasi tutto
+ * nella risposta, non nei regressori: la stima non si sposta. (Un ARX
+ * T[n+1] = a·T_i[n] + b·T_j[n] + ... non è esatto con due zone e sbaglia
+ * G del 20-40 %.) Da θ: K_ii = -a/c, K_ij = -b/c, P0_i = -d/c.
+ * Valida solo se fisica per entrambe le zone: c > 0, G = -K_ij ≥ 0,
+ * k = K_ii + K_ij > 0, T_amb ragionevole. T_i e T_j vanno quasi
+ * insieme: G si separa da k solo con lo scarto fra le zone (duty
+ * diversi, rampe, autotune), quindi servono DECOUPLE_MIN_BLOCKS e un
+ * sistema non singolare, altrimenti nessuna stima.
+ *
+ * ZoneCoupling è POD senza costruttori: sta in AppState (= {}) e in
+ * NVS come blob (nvs_storage.h). Indici: 0 = Base, 1 = Cielo.
+ * ================================================================
+ */
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define DECOUPLE_ZONES        2
+#define DECOUPLE_BLOCK_MS     5000    // decimazione (tempo del forno)
+#define DECOUPLE_MIN_BLOCKS   120     // 10 min di dati
+#define DECOUPLE_T_AMB_MIN    -10.0f  // T_amb implicita fuori da qui: stima scartata
+#define DECOUPLE_T_AMB_MAX    80.0f
+#define DECOUPLE_SOLVE_MS     60000UL // nuova stima ogni minuto
+#define DECOUPLE_SAVE_FRAC    0.05f   // scostamento che sostituisce la matrice (e va in NVS)
+#define DECOUPLE_RGA_MAX      4.0f    // oltre: zone inseparabili, PID indipendenti
+
+struct ZoneCoupling {
+  float   kii[DECOUPLE_ZONES];   // [W/°C] k_i + G
+  float   kij[DECOUPLE_ZONES];   // [W/°C] -G visto dalla zona i
+  float   p0[DECOUPLE_ZONES];    // [W]
+  uint8_t valid;
+
+  /** Potenza [W] che tiene la zona z a t_self con l'altra a t_other. */
+  float powerW(int z, float t_self, float t_other) const {
+    return kii[z] * t_self + kij[z] * t_other + p0[z];
+  }
+  float lossW(int z) const { return kii[z] + kij[z]; }           // k_i
+  float gW()         const { return -0.5f * (kij[0] + kij[1]); } // G medio
+
+  /**
+   * Guadagno relativo (RGA) λ = 1 / (1 - K_ij·K_ji / (K_ii·K_jj)): 1 zone
+   * indipendenti, ≫ 1 zone che si muovono insieme (G ≫ k). Lì la split
+   * raggiungibile è di pochi gradi e un errore di pochi % sulla matrice
+   * sposta il duty dell'altra zona più di quanto il disaccoppiamento
+   * tolga: meglio i PID indipendenti.
+   */
+  float rga() const {
+    float x = (kij[0] * kij[1]) / (kii[0] * kii[1]);
+    return x < 1.0f ? 1.0f / (1.0f - x) : INFINITY;
+  }
+
+  /** Scostamento relativo massimo da o (salvataggio in NVS). */
+  float diff(const ZoneCoupling& o) const {
+    if (!valid || !o.valid) return valid == o.valid ? 0.0f : 1.0f;
+    float d = 0.0f;
+    for (int z = 0; z < DECOUPLE_ZONES; z++) {
+      float e = fabsf(kii[z] - o.kii[z]) / kii[z];
+      if (e > d) d = e;
+      e = fabsf(kij[z] - o.kij[z]) / kii[z];
+      if (e > d) d = e;
+    }
+    return d;
+  }
+};
+
+class CouplingIdentifier {
+public:
+  void begin(float power_base_w, float power_cielo_w, uint32_t block_ms = DECOUPLE_BLOCK_MS) {
+    memset(this, 0, sizeof(*this));
+    _power_w[0] = power_base_w;
+    _power_w[1] = power_cielo_w;
+    _block_ms   = block_ms;
+  }
+
+  /**
+   * Un campione: temperature lette a now_ms, relay decisi per il ciclo
+   * che parte. valid=false (sonda in errore, SINGLE, reset) spezza la serie.
+   */
+  void feed(uint32_t now_ms, float t_base, float t_cielo, bool on_base, bool on_cielo,
+            bool valid = true) {
+    if (!valid || isnan(t_base) || isnan(t_cielo)) { _break(); return; }
+    if (_n > 0 && now_ms - _last_ms > _block_ms / 2) _break();   // buco nei dati
+    const float t[DECOUPLE_ZONES] = { t_base, t_cielo };
+    if (_n > 0 && now_ms - _blk_start >= _block_ms) _close_block(t, now_ms);
+    if (_n == 0) {
+      _blk_start = now_ms;
+      _t0[0] = t_base;
+      _t0[1] = t_cielo;
+      _t_sum[0] = _t_sum[1] = _p_sum[0] = _p_sum[1] = 0.0;
+    }
+    _t_sum[0] += t_base;
+    _t_sum[1] += t_cielo;
+    _p_sum[0] += on_base  ? _power_w[0] : 0.0f;
+    _p_sum[1] += on_cielo ? _power_w[1] : 0.0f;
+    _n++;
+    _last_ms = now_ms;
+  }
+
+  void restart() { _break(); }
+
+  uint32_t blocks() const { return _blocks; }
+
+  bool solve(ZoneCoupling& c) const {
+    memset(&c, 0, sizeof(c));
+    if (_blocks < DECOUPLE_MIN_BLOCKS) return false;
+    for (int z = 0; z < DECOUPLE_ZONES; z++) {
+      double th[NP];
+      if (!_solve_zone(z, th)) return false;
+      double a = th[0], b = th[1], g = th[2], d = th[3];
+      if (!(g > 0.0)) return false;
+      c.kii[z] = (float)(-a / g);
+      c.kij[z] = (float)(-b / g);
+      c.p0[z]  = (float)(-d / g);
+      float k  = c.lossW(z);
+      if (!(c.kij[z] <= 0.0f) || !(k > 0.0f)) return false;
+      float t_amb = -c.p0[z] / k;
+      if (!(t_amb > DECOUPLE_T_AMB_MIN && t_amb < DECOUPLE_T_AMB_MAX)) return false;
+    }
+    c.valid = 1;
+    return true;
+  }
+
+private:
+  static const int NP = 4;   // T_i, T_j, P_i, 1
+
+  float    _power_w[DECOUPLE_ZONES];
+  uint32_t _block_ms;
+  // Blocco corrente
+  uint32_t _n, _blk_start, _last_ms;
+  float    _t0[DECOUPLE_ZONES];
+  double   _t_sum[DECOUPLE_ZONES], _p_sum[DECOUPLE_ZONES];
+  // Σ xxᵀ e Σ x·y per zona
+  uint32_t _blocks;
+  double   _xx[DECOUPLE_ZONES][NP][NP];
+  double   _xy[DECOUPLE_ZONES][NP];
+
+  void _break() { _n = 0; }
+
+  // Fine blocco (t = primo campione del successivo): medie a trapezi per
+  // T, la potenza vale da un campione al successivo
+  void _close_block(const float t[DECOUPLE_ZONES], uint32_t now_ms) {
+    double dt_s = (now_ms - _blk_start) / 1000.0;
+    double tm[DECOUPLE_ZONES];
+    for (int z = 0; z < DECOUPLE_ZONES; z++)
+      tm[z] = (_t_sum[z] + 0.5 * (t[z] - _t0[z])) / _n;
+    for (int z = 0; z < DECOUPLE_ZONES; z++) {
+      const double x[NP] = { tm[z], tm[1 - z], _p_sum[z] / _n, 1.0 };
+      double y = (t[z] - _t0[z]) / dt_s;
+      for (int i = 0; i < NP; i++) {
+        for (int j = 0; j < NP; j++) _xx[z][i][j] += x[i] * x[j];
+        _xy[z][i] += x[i] * y;
+      }
+    }
+    _blocks++;
+    _n = 0;
+  }
+
+  // Eliminazione di Gauss con pivot parziale; pivot relativo minimo: il
+  // sistema senza scarto fra le zone è singolare
+  bool _solve_zone(int z, double th[NP]) const {
+    double m[NP][NP + 1];
+    for (int i = 0; i < NP; i++) {
+      for (int j = 0; j < NP; j++) m[i][j] = _xx[z][i][j];
+      m[i][NP] = _xy[z][i];
+    }
+    for (int col = 0; col < NP; col++) {
+      int p = col;
+      for (int r = col + 1; r < NP; r++)
+        if (fabs(m[r][col]) > fabs(m[p][col])) p = r;
+      if (!(fabs(m[p][col]) > 1e-9 * fabs(_xx[z][col][col]))) return false;
+      if (p != col)
+        for (int j = 0; j <= NP; j++) { double s = m[p][j]; m[p][j] = m[col][j]; m[col][j] = s; }
+      for (int r = col + 1; r < NP; r++) {
+        double f = m[r][col] / m[col][col];
+        for (int j = col; j <= NP; j++) m[r][j] -= f * m[col][j];
+      }
+    }
+    for (int i = NP - 1; i >= 0; i--) {
+      double s = m[i][NP];
+      for (int j = i + 1; j < NP; j++) s -= m[i][j] * th[j];
+      th[i] = s / m[i][i];
+    }
+    return true;
+  }
+};